@@ -178,7 +178,8 @@ public:
     */
     void set_backup(int n_values, ...)
     {
-        n_values &= 3;
+        if (n_values > 4)
+            n_values = 4;
         va_list list;
         va_start(list, n_values);
         for (int i = 0; i < n_values; i++)
@@ -194,7 +195,8 @@ public:
     */
     void get_backup(int n_values, ...)
     {
-        n_values &= 3;
+        if (n_values > 4)
+            n_values = 4;
         va_list list;
         va_start(list, n_values);
         for (int i = 0; i < n_values; i++)
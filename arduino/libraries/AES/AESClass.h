@@ -167,6 +167,92 @@ public:
         return block;
     }
 
+    /*
+        CTR mode: XOR len bytes of vData in place with the key stream that starts at
+        counter block vCounter. The peripheral increments the 16-bit block counter
+        in the last two bytes of the counter block for every block.
+    */
+    void encode_ctr(void *vData, int len, void *vKey, void *vCounter)
+    {
+        if (NULL == vData || NULL == vKey || NULL == vCounter)
+            abort();
+        uint8_t *data = (uint8_t *)vData;
+        uint8_t *key = (uint8_t *)vKey;
+        uint8_t *counter = (uint8_t *)vCounter;
+        uint8_t block[16];
+        /* Configure the AES. */
+        cfg.encrypt_mode = AES_ENCRYPTION;
+        cfg.key_size = AES_KEY_SIZE_128;
+        cfg.start_mode = AES_AUTO_START;
+        cfg.opmode = AES_CTR_MODE;
+        cfg.cfb_size = AES_CFB_SIZE_128;
+        cfg.lod = false;
+        config(&cfg);
+        for (uint8_t i = 0; i < 4; i++)
+            block_data[i] = convert_byte_array_to_32_bit(key + (i * (sizeof(uint32_t))));
+        write_key(block_data);
+        for (uint8_t i = 0; i < 4; i++)
+            block_data[i] = convert_byte_array_to_32_bit(counter + (i * (sizeof(uint32_t))));
+        write_vector(block_data);
+        for (int offset = 0; offset < len; offset += 16)
+        {
+            int n = (len - offset < 16) ? len - offset : 16;
+            memset(block, 0, sizeof(block)); /* last block is padded, only n bytes are used */
+            memcpy(block, data + offset, n);
+            for (uint8_t i = 0; i < 4; i++)
+                block_data[i] = convert_byte_array_to_32_bit(block + (i * (sizeof(uint32_t))));
+            if (0 == offset)
+                new_message(); /* load the counter block for the first block only */
+            write_data(block_data);
+            if (0 == offset)
+                clear_message();
+            wait_ready();
+            read_data(block_data);
+            memcpy(data + offset, block_data, n);
+        }
+    }
+
+    /*
+        CBC mode used as CBC-MAC: vChain = E(...E(vChain ^ block[0]) ^ ...) ^ block[blocks - 1])
+        vChain is the initialization vector on input and the last cipher block on output
+    */
+    void encode_cbc(void *vChain, void *vData, int blocks, void *vKey)
+    {
+        if (NULL == vChain || NULL == vData || NULL == vKey)
+            abort();
+        uint8_t *chain = (uint8_t *)vChain;
+        uint8_t *data = (uint8_t *)vData;
+        uint8_t *key = (uint8_t *)vKey;
+        /* Configure the AES. */
+        cfg.encrypt_mode = AES_ENCRYPTION;
+        cfg.key_size = AES_KEY_SIZE_128;
+        cfg.start_mode = AES_AUTO_START;
+        cfg.opmode = AES_CBC_MODE;
+        cfg.cfb_size = AES_CFB_SIZE_128;
+        cfg.lod = false;
+        config(&cfg);
+        for (uint8_t i = 0; i < 4; i++)
+            block_data[i] = convert_byte_array_to_32_bit(key + (i * (sizeof(uint32_t))));
+        write_key(block_data);
+        for (uint8_t i = 0; i < 4; i++)
+            block_data[i] = convert_byte_array_to_32_bit(chain + (i * (sizeof(uint32_t))));
+        write_vector(block_data);
+        for (int b = 0; b < blocks; b++)
+        {
+            for (uint8_t i = 0; i < 4; i++)
+                block_data[i] = convert_byte_array_to_32_bit(data + (b * 16) + (i * (sizeof(uint32_t))));
+            if (0 == b)
+                new_message(); /* chain from the initialization vector for the first block only */
+            write_data(block_data);
+            if (0 == b)
+                clear_message();
+            wait_ready();
+            read_data(block_data);
+        }
+        if (blocks > 0)
+            memcpy(chain, block_data, 16);
+    }
+
     void begin()
     {
         disable();
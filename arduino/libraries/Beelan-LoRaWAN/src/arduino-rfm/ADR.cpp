@@ -0,0 +1,204 @@
+/****************************************************************************************
+* File:     ADR.cpp
+*
+* Adaptive data rate of the node, driven by the link margin of received downlinks.
+* Every valid downlink adds its margin above the demodulation floor to a window. When the
+* window is full the best margin decides: every 3 dB above ADR_MARGIN raises the data rate
+* one step, at the highest data rate it lowers the transmit power 3 dB. A margin below
+* ADR_MARGIN raises the power and then lowers the data rate right away.
+* Without downlinks the backoff of LoRaWAN applies: after ADR_ACK_LIMIT uplinks ADRACKReq
+* is set, ADR_ACK_DELAY uplinks later the power goes to the maximum and then the data rate
+* goes one step down every ADR_ACK_DELAY uplinks.
+****************************************************************************************/
+
+#include "ADR.h"
+#include "Band-Plan.h"
+
+#define ADR_MAX_DATARATE SF7BW125
+
+#define ADR_MAX_POWER 0x0F
+
+/*
+*****************************************************************************************
+* Description : Function that moves the data rate and the transmit power in steps of
+*				3 dB of link budget
+*
+* Arguments   : Steps positive to use less link budget, negative to use more
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+static void ADR_Step(int Steps, sSettings *LoRa_Settings)
+{
+	unsigned char Datarate = LoRa_Settings->Datarate_Tx;
+
+	while(Steps > 0 && Datarate < ADR_MAX_DATARATE)
+	{
+		Datarate++;
+		Steps--;
+	}
+	while(Steps > 0 && LoRa_Settings->Transmit_Power > 0x00)
+	{
+		LoRa_Settings->Transmit_Power = (LoRa_Settings->Transmit_Power > 3) ? LoRa_Settings->Transmit_Power - 3 : 0x00;
+		Steps--;
+	}
+	while(Steps < 0 && LoRa_Settings->Transmit_Power < ADR_MAX_POWER)
+	{
+		LoRa_Settings->Transmit_Power = (LoRa_Settings->Transmit_Power < ADR_MAX_POWER - 3) ? LoRa_Settings->Transmit_Power + 3 : ADR_MAX_POWER;
+		Steps++;
+	}
+	while(Steps < 0 && Datarate > 0x00)
+	{
+		Datarate--;
+		Steps++;
+	}
+
+	Band_Set_Datarate(Datarate, LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that starts the ADR with an empty window
+*
+* Arguments   : *ADR pointer to sADR struct
+*				Enabled 0x01 to let the node adapt its data rate, 0x00 for a fixed one
+*				*LoRa_Settings pointer to sSettings struct, gets the ADR bit
+*****************************************************************************************
+*/
+void ADR_Init(sADR *ADR, unsigned char Enabled, sSettings *LoRa_Settings)
+{
+	ADR->Enabled = Enabled;
+	ADR->Count = 0;
+	ADR->Next = 0;
+	ADR->Ack_Counter = 0;
+
+	LoRa_Settings->Frame_Control = Enabled ? 0x80 : 0x00;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the margin of a received package above the
+*				demodulation floor of its spreading factor, -7.5 dB at SF7 and 2.5 dB
+*				lower every next SF
+*
+* Arguments   : SNR of the package in 0.25 dB
+*				Spreading_Factor the package was received with
+*
+* Return      : signed char margin in dB
+*****************************************************************************************
+*/
+signed char ADR_Margin(signed char SNR, unsigned char Spreading_Factor)
+{
+	int Margin = SNR + 30 + 10 * (Spreading_Factor - 7);
+
+	//Round down, also for negative margins
+	return (signed char)((Margin - (Margin < 0 ? 3 : 0)) / 4);
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call after every uplink, counts the uplinks without downlink
+*				and steps back when the network does not answer
+*
+* Arguments   : *ADR pointer to sADR struct
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+void ADR_Uplink(sADR *ADR, sSettings *LoRa_Settings)
+{
+	if(!ADR->Enabled)
+	{
+		return;
+	}
+
+	ADR->Ack_Counter++;
+
+	//Backoff, first the power to the maximum, then one data rate at a time
+	if(ADR->Ack_Counter >= ADR_ACK_LIMIT + ADR_ACK_DELAY && ((ADR->Ack_Counter - ADR_ACK_LIMIT) % ADR_ACK_DELAY) == 0)
+	{
+		if(LoRa_Settings->Transmit_Power < ADR_MAX_POWER)
+		{
+			LoRa_Settings->Transmit_Power = ADR_MAX_POWER;
+		}
+		else if(LoRa_Settings->Datarate_Tx > 0x00)
+		{
+			Band_Set_Datarate(LoRa_Settings->Datarate_Tx - 1, LoRa_Settings);
+		}
+		ADR->Count = 0;
+	}
+
+	//Ask for a downlink, not needed at the lowest data rate and the maximum power
+	if(ADR->Ack_Counter >= ADR_ACK_LIMIT &&
+	   (LoRa_Settings->Datarate_Tx > 0x00 || LoRa_Settings->Transmit_Power < ADR_MAX_POWER))
+	{
+		LoRa_Settings->Frame_Control |= 0x40;
+	}
+	else
+	{
+		LoRa_Settings->Frame_Control &= ~0x40;
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call with the link margin of every valid downlink. A margin
+*				from a LinkCheckAns can be given the same way.
+*
+* Arguments   : *ADR pointer to sADR struct
+*				Margin in dB, see ADR_Margin()
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+void ADR_Downlink(sADR *ADR, signed char Margin, sSettings *LoRa_Settings)
+{
+	signed char Best;
+	unsigned char i;
+	int Steps;
+
+	if(!ADR->Enabled)
+	{
+		return;
+	}
+
+	//The network answers, stop the backoff
+	ADR->Ack_Counter = 0;
+	LoRa_Settings->Frame_Control &= ~0x40;
+
+	ADR->Margin[ADR->Next] = Margin;
+	ADR->Next = (ADR->Next + 1) % ADR_WINDOW;
+	if(ADR->Count < ADR_WINDOW)
+	{
+		ADR->Count++;
+	}
+
+	//Too little margin is acted on at once
+	if(Margin < ADR_MARGIN)
+	{
+		Steps = (Margin - ADR_MARGIN - 2) / 3;
+	}
+	//More margin needs a full window, the best one decides
+	else if(ADR->Count == ADR_WINDOW)
+	{
+		Best = ADR->Margin[0];
+		for(i = 1; i < ADR_WINDOW; i++)
+		{
+			if(ADR->Margin[i] > Best)
+			{
+				Best = ADR->Margin[i];
+			}
+		}
+		Steps = (Best - ADR_MARGIN) / 3;
+	}
+	else
+	{
+		Steps = 0;
+	}
+
+	if(Steps != 0)
+	{
+		ADR_Step(Steps, LoRa_Settings);
+
+		//The margins were measured with the old settings
+		ADR->Count = 0;
+		ADR->Next = 0;
+	}
+}
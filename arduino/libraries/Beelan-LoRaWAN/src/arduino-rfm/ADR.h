@@ -0,0 +1,64 @@
+/****************************************************************************************
+* File:     ADR.h
+*
+* Adaptive data rate of the node, driven by the link margin of received downlinks
+****************************************************************************************/
+
+#ifndef ADR_H
+#define ADR_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Struct.h"
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Uplinks without a downlink before ADRACKReq is set, and between the backoff steps after
+#define ADR_ACK_LIMIT 64
+#define ADR_ACK_DELAY 32
+
+//Link margins kept, the data rate is only raised with a full window
+#ifndef ADR_WINDOW
+#define ADR_WINDOW 8
+#endif
+
+//Margin in dB that is kept above the demodulation floor
+#ifndef ADR_MARGIN
+#define ADR_MARGIN 10
+#endif
+
+/*
+********************************************************************************************
+* TYPE DEFINITION
+********************************************************************************************
+*/
+
+typedef struct {
+    unsigned char Enabled;
+    signed char Margin[ADR_WINDOW];     //Link margins in dB
+    unsigned char Count;                //Margins in the window
+    unsigned char Next;                 //Place of the next margin
+    unsigned int Ack_Counter;           //ADR_ACK_CNT, uplinks since the last downlink
+} sADR;
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+void ADR_Init(sADR *ADR, unsigned char Enabled, sSettings *LoRa_Settings);
+signed char ADR_Margin(signed char SNR, unsigned char Spreading_Factor);
+void ADR_Uplink(sADR *ADR, sSettings *LoRa_Settings);
+void ADR_Downlink(sADR *ADR, signed char Margin, sSettings *LoRa_Settings);
+
+#endif
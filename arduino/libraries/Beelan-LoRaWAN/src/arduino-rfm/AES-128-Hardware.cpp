@@ -0,0 +1,97 @@
+/****************************************************************************************
+* File:     AES-128-Hardware.cpp
+*
+* AES-128 backend on the SAMR34 AES peripheral (AESClass). Used by default on target,
+* define AES_SOFTWARE in Config.h to use a software backend instead.
+* ECB for single blocks, CTR mode for the FRMPayload and CBC mode for the CMAC.
+****************************************************************************************/
+
+#include <string.h>
+#include "AES-128.h"
+
+#ifdef AES_HARDWARE
+
+#include <AESClass.h>
+
+static AESClass AES_Engine;
+static bool AES_Engine_Started = false;
+
+static void AES_Engine_Begin(void)
+{
+	if(!AES_Engine_Started)
+	{
+		AES_Engine.begin();
+		AES_Engine_Started = true;
+	}
+}
+
+/*
+*****************************************************************************************
+* Title         : AES_Expand_Key
+* Description	: The peripheral expands the key itself, only a copy of the key is kept
+*****************************************************************************************
+*/
+void AES_Expand_Key(unsigned char *Key, sAES_Expanded_Key *Expanded_Key)
+{
+	AES_Engine_Begin();
+	memcpy(Expanded_Key->Key, Key, 16);
+} // AES_Expand_Key
+
+/*
+*****************************************************************************************
+* Title         : AES_Encrypt_Expanded
+* Description	: Encrypts one block in ECB mode
+*****************************************************************************************
+*/
+void AES_Encrypt_Expanded(unsigned char *Data, sAES_Expanded_Key *Expanded_Key)
+{
+	AES_Engine_Begin();
+	AES_Engine.encode(Data, Expanded_Key->Key);
+} // AES_Encrypt_Expanded
+
+/*
+*****************************************************************************************
+* Title         : AES_Encrypt
+* Description	: Encrypts one block in ECB mode
+*****************************************************************************************
+*/
+void AES_Encrypt(unsigned char *Data, unsigned char *Key)
+{
+	AES_Engine_Begin();
+	AES_Engine.encode(Data, Key);
+} // AES_Encrypt
+
+/*
+*****************************************************************************************
+* Title         : AES_Encrypt_CTR
+* Description	: XORs Length bytes of Data with the CTR key stream that starts at the
+*				  Counter block, the peripheral increments the block counter
+*****************************************************************************************
+*/
+void AES_Encrypt_CTR(unsigned char *Data, unsigned char Length, unsigned char *Counter, sAES_Expanded_Key *Expanded_Key)
+{
+	if(Length == 0)
+	{
+		return;
+	}
+	AES_Engine_Begin();
+	AES_Engine.encode_ctr(Data, Length, Expanded_Key->Key, Counter);
+} // AES_Encrypt_CTR
+
+/*
+*****************************************************************************************
+* Title         : AES_CBC_MAC
+* Description	: Chains Blocks full blocks of Data into Chain in CBC mode
+*****************************************************************************************
+*/
+void AES_CBC_MAC(unsigned char *Chain, unsigned char *Data, unsigned char Blocks, sAES_Expanded_Key *Expanded_Key)
+{
+	if(Blocks == 0)
+	{
+		return;
+	}
+	AES_Engine_Begin();
+	AES_Engine.encode_cbc(Chain, Data, Blocks, Expanded_Key->Key);
+} // AES_CBC_MAC
+
+#endif // AES_HARDWARE
@@ -0,0 +1,76 @@
+/****************************************************************************************
+* File:     AES-128-Modes.cpp
+*
+* CTR and CBC-MAC modes of the software AES-128 backends, built on AES_Encrypt_Expanded.
+* The AES peripheral backend implements them in hardware in AES-128-Hardware.cpp.
+****************************************************************************************/
+
+#include <string.h>
+#include "AES-128.h"
+
+#ifndef AES_HARDWARE
+
+/*
+*****************************************************************************************
+* Title         : AES_Encrypt_CTR
+* Description	: XORs Length bytes of Data with the key stream that starts at the
+*				  Counter block. The last two bytes of the counter are incremented for
+*				  every block, the Counter block of the caller is not changed.
+*****************************************************************************************
+*/
+void AES_Encrypt_CTR(unsigned char *Data, unsigned char Length, unsigned char *Counter, sAES_Expanded_Key *Expanded_Key)
+{
+	unsigned char i;
+	unsigned char Block_Size;
+	unsigned char Counter_Block[16];
+	unsigned char Key_Stream[16];
+
+	memcpy(Counter_Block, Counter, 16);
+
+	while(Length > 0)
+	{
+		memcpy(Key_Stream, Counter_Block, 16);
+		AES_Encrypt_Expanded(Key_Stream, Expanded_Key);
+
+		Block_Size = (Length < 16) ? Length : 16;
+		for(i = 0; i < Block_Size; i++)
+		{
+			Data[i] ^= Key_Stream[i];
+		}
+
+		Data += Block_Size;
+		Length -= Block_Size;
+
+		//Increment the 16-bit block counter
+		if(++Counter_Block[15] == 0x00)
+		{
+			Counter_Block[14]++;
+		}
+	}
+} // AES_Encrypt_CTR
+
+/*
+*****************************************************************************************
+* Title         : AES_CBC_MAC
+* Description	: Chains Blocks full blocks of Data into Chain:
+*				  Chain = AES(Chain ^ Block) for every block
+*****************************************************************************************
+*/
+void AES_CBC_MAC(unsigned char *Chain, unsigned char *Data, unsigned char Blocks, sAES_Expanded_Key *Expanded_Key)
+{
+	unsigned char i;
+
+	while(Blocks > 0)
+	{
+		for(i = 0; i < 16; i++)
+		{
+			Chain[i] ^= Data[i];
+		}
+		AES_Encrypt_Expanded(Chain, Expanded_Key);
+
+		Data += 16;
+		Blocks--;
+	}
+} // AES_CBC_MAC
+
+#endif // AES_HARDWARE
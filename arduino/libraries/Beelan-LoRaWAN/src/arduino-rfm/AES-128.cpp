@@ -29,6 +29,9 @@
 #include <string.h>
 #include "AES-128.h"
 
+//Byte oriented backend, the 32-bit backend is in AES-128-TTable.cpp
+//and the AES peripheral backend in AES-128-Hardware.cpp
+#if !defined(AES_T_TABLE) && !defined(AES_HARDWARE)
 
 static const unsigned char S_Table[16][16] = {
 	{0x63,0x7C,0x77,0x7B,0xF2,0x6B,0x6F,0xC5,0x30,0x01,0x67,0x2B,0xFE,0xD7,0xAB,0x76},
@@ -199,6 +202,98 @@ static void AES_Calculate_Round_Key(unsigned char Round, unsigned char *Round_Ke
 	}
 }   //  AES_Calculate_Round_Key
 
+/*
+*****************************************************************************************
+* Title         : AES_Expand_Key
+* Description	: Calculates all round keys of Key once, so they can be reused by
+*				  AES_Encrypt_Expanded for every block encrypted with the same key
+*****************************************************************************************
+*/
+void AES_Expand_Key(unsigned char *Key, sAES_Expanded_Key *Expanded_Key)
+{
+	unsigned char Round;
+
+	//  Round key 0 is the key itself
+	memcpy( &Expanded_Key->Round_Key[0], &Key[0], 16 );
+
+	//  Every next round key is calculated from the previous one
+	for( Round = 1 ; Round <= 10 ; Round++ )
+	{
+		memcpy( &Expanded_Key->Round_Key[Round << 4], &Expanded_Key->Round_Key[(Round - 1) << 4], 16 );
+		AES_Calculate_Round_Key( Round, &Expanded_Key->Round_Key[Round << 4] );
+	}
+}   //  AES_Expand_Key
+
+/*
+*****************************************************************************************
+* Title         : AES_Encrypt_Expanded
+* Description	: Encrypts one block with the round keys from AES_Expand_Key
+*****************************************************************************************
+*/
+void AES_Encrypt_Expanded(unsigned char *Data, sAES_Expanded_Key *Expanded_Key)
+{
+	unsigned char Row, Column, Round = 0;
+    unsigned char State[4][4];
+
+	//  Copy input to State arry
+	for( Column = 0; Column < 4; Column++ )
+	{
+		for( Row = 0; Row < 4; Row++ )
+		{
+			State[Row][Column] = Data[Row + (Column << 2)];
+		}
+	}
+
+	//  Add round key
+	AES_Add_Round_Key( &Expanded_Key->Round_Key[0], State );
+
+	//  Perform 9 full rounds with mixed collums
+	for( Round = 1 ; Round < 10 ; Round++ )
+	{
+		//  Perform Byte substitution with S table
+		for( Column = 0 ; Column < 4 ; Column++ )
+		{
+			for( Row = 0 ; Row < 4 ; Row++ )
+			{
+				State[Row][Column] = AES_Sub_Byte( State[Row][Column] );
+			}
+		}
+
+		//  Perform Row Shift
+		AES_Shift_Rows(State);
+
+		//  Mix Collums
+		AES_Mix_Collums(State);
+
+        //  Add the round key to the Round_key
+		AES_Add_Round_Key(&Expanded_Key->Round_Key[Round << 4], State);
+	}
+
+	//  Perform Byte substitution with S table whitout mix collums
+	for( Column = 0 ; Column < 4 ; Column++ )
+	{
+		for( Row = 0; Row < 4; Row++ )
+		{
+			State[Row][Column] = AES_Sub_Byte(State[Row][Column]);
+		}
+	}
+
+	//  Shift rows
+	AES_Shift_Rows(State);
+
+    //  Add round key
+	AES_Add_Round_Key( &Expanded_Key->Round_Key[Round << 4], State );
+
+	//  Copy the State into the data array
+	for( Column = 0; Column < 4; Column++ )
+	{
+		for( Row = 0; Row < 4; Row++ )
+		{
+			Data[Row + (Column << 2)] = State[Row][Column];
+		}
+	}
+} // AES_Encrypt_Expanded
+
 /*
 *****************************************************************************************
 * Title         : AES_Encrypt
@@ -282,3 +377,4 @@ void AES_Encrypt(unsigned char *Data, unsigned char *Key)
 
  
 
+#endif // !AES_T_TABLE && !AES_HARDWARE
@@ -29,6 +29,43 @@
 #ifndef AES128_H
 #define AES128_H
 
+#include <stdint.h>
+#include "Config.h"
+
+//The full four table variant is a T-table backend as well
+#if defined(AES_T_TABLE_FULL) && !defined(AES_T_TABLE)
+#define AES_T_TABLE
+#endif
+
+//T-table backends are software backends
+#if defined(AES_T_TABLE) && !defined(AES_SOFTWARE)
+#define AES_SOFTWARE
+#endif
+
+//AES peripheral on the SAMR34 unless a software backend is requested
+#if !defined(AES_SOFTWARE) && (defined(__SAMR34J16B__) || defined(__SAMR34J17B__) || defined(__SAMR34J18B__) || \
+                               defined(__ATSAMR34J16B__) || defined(__ATSAMR34J17B__) || defined(__ATSAMR34J18B__))
+#define AES_HARDWARE
+#endif
+
+/*
+********************************************************************************************
+* STRUCT DEFINITIONS
+********************************************************************************************
+*/
+
+//Struct used to store an AES-128 key in the form the backend uses it,
+//for the software backends these are the 11 round keys
+typedef struct {
+#if defined(AES_HARDWARE)
+    unsigned char Key[16];          //The peripheral calculates the round keys itself
+#elif defined(AES_T_TABLE)
+    uint32_t Round_Key[44];         //Big endian column words, see AES-128-TTable.cpp
+#else
+    unsigned char Round_Key[176];
+#endif
+} sAES_Expanded_Key;
+
 /*
 ********************************************************************************************
 * FUNCTION
@@ -36,6 +73,10 @@
 */
 
 void AES_Encrypt(unsigned char *Data, unsigned char *Key);
+void AES_Expand_Key(unsigned char *Key, sAES_Expanded_Key *Expanded_Key);
+void AES_Encrypt_Expanded(unsigned char *Data, sAES_Expanded_Key *Expanded_Key);
+void AES_Encrypt_CTR(unsigned char *Data, unsigned char Length, unsigned char *Counter, sAES_Expanded_Key *Expanded_Key);
+void AES_CBC_MAC(unsigned char *Chain, unsigned char *Data, unsigned char Blocks, sAES_Expanded_Key *Expanded_Key);
 
 #endif
 
@@ -0,0 +1,422 @@
+/****************************************************************************************
+* File:     Band-Plan.h
+*
+* Band plans of the regions as constant tables. A plan gives the frequencies of the
+* channels as the three FRF register bytes of the RFM, calculated by the compiler, the
+* spreading factor and bandwidth of every data rate, the defaults of the receive windows,
+* the sub-bands of the duty cycle and the limits the MAC commands are checked against.
+* The region of Config.h selects BAND_PLAN. Every plan is a constexpr object, so a plan
+* that is not used takes no flash and a build may refer to more than one of them.
+* The MAC only differs between the regions by the fields of BAND_PLAN, it is built for
+* the one region of Config.h.
+*
+* Channel numbers of the RFM: 0x00 and up the uplink channels, 0x08 and up the receive
+* channels of US_915 and 0x10 the channel of the second receive window.
+****************************************************************************************/
+
+#ifndef BAND_PLAN_H
+#define BAND_PLAN_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Struct.h"
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Sub-band of the 8 uplink channels within the 64 channels of US_915
+#if defined(SUBND_1)
+#define BAND_SUB_BAND 1
+#elif defined(SUBND_2)
+#define BAND_SUB_BAND 2
+#elif defined(SUBND_3)
+#define BAND_SUB_BAND 3
+#elif defined(SUBND_4)
+#define BAND_SUB_BAND 4
+#elif defined(SUBND_5)
+#define BAND_SUB_BAND 5
+#elif defined(SUBND_6)
+#define BAND_SUB_BAND 6
+#elif defined(SUBND_7)
+#define BAND_SUB_BAND 7
+#else
+#define BAND_SUB_BAND 0
+#endif
+
+//Channel of the second receive window
+#define BAND_RX2_CHANNEL 0x10
+
+//Most uplink channels of a plan
+#define BAND_MAX_CHANNELS 9
+
+//Bandwidth codes of RegModemConfig1
+#define BAND_BW_125 0x07
+#define BAND_BW_250 0x08
+#define BAND_BW_500 0x09
+
+/*
+********************************************************************************************
+* TYPE DEFINITION
+********************************************************************************************
+*/
+
+typedef struct {
+	unsigned char SF;					//Spreading factor, 0 the data rate is not used
+	unsigned char BW;					//Bandwidth code of RegModemConfig1
+} sBand_Datarate;
+
+typedef struct {
+	unsigned char Frf[3];				//RegFrfMsb, RegFrfMid and RegFrfLsb
+} sBand_Channel;
+
+typedef struct {
+	const sBand_Channel *Uplink;		//Uplink channels, also the first receive window
+	unsigned char Uplink_Channels;
+	const sBand_Channel *Downlink;		//Receive channels from 0x08 on, NULL when none
+	unsigned char Downlink_Channels;
+	sBand_Channel Rx2;					//Channel 0x10
+	const sBand_Datarate *Datarate;
+	unsigned char Datarates;
+	const unsigned char *Max_Payload;	//FRMPayload bytes of an uplink data rate
+	unsigned char Uplink_Datarates;
+	unsigned char Datarate_Tx;			//Defaults of sSettings
+	unsigned char Datarate_Rx2;
+	unsigned char Rx1_Datarate;			//RX1 data rate of an uplink on DR0 with RX1DROffset 0
+	unsigned int Channel_Mask;
+	unsigned char Default_Channels;		//Channels NewChannelReq can not change
+	unsigned char Fixed_Channel;		//Uplink channel with one data rate, 0xFF none
+	unsigned char Fixed_Datarate;		//Data rate of Fixed_Channel
+	unsigned char Max_Datarate;			//Limits of the MAC commands
+	unsigned char Max_Tx_Power;
+	unsigned char Max_EIRP;
+	unsigned char Max_Rx1_DR_Offset;
+	unsigned char Min_Rx2_Datarate;		//Downlink data rates, also the limits of RX1
+	unsigned char Max_Rx2_Datarate;
+	unsigned long Min_Frequency;		//Band of NewChannelReq and RXParamSetupReq, 0 fixed
+	unsigned long Max_Frequency;
+	const unsigned int *Duty_Cycle_Divider;	//1 / duty cycle of a sub-band, 100 is 1%
+	unsigned char Duty_Cycle_Bands;		//0 no duty cycle per sub-band
+	const unsigned char *Duty_Cycle_Band;	//Sub-band of an uplink channel
+} sBand_Plan;
+
+/*
+*****************************************************************************************
+* Description : Function that gives the FRF register value of a frequency, Frequency / 61.035 Hz
+*				in two parts to stay in 32 bits
+*
+* Arguments   : Frequency in Hz
+*
+* Return      : unsigned long FRF
+*****************************************************************************************
+*/
+static constexpr unsigned long Band_Frf(unsigned long Frequency)
+{
+	return (Frequency / 15625) * 256 + ((Frequency % 15625) * 256) / 15625;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the FRF register bytes of a frequency
+*
+* Arguments   : Frequency in Hz
+*
+* Return      : sBand_Channel channel on the frequency
+*****************************************************************************************
+*/
+static constexpr sBand_Channel Band_Channel(unsigned long Frequency)
+{
+	return sBand_Channel{{(unsigned char)(Band_Frf(Frequency) >> 16), (unsigned char)(Band_Frf(Frequency) >> 8), (unsigned char)Band_Frf(Frequency)}};
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the bandwidth of a bandwidth code of the band plans
+*
+* Arguments   : BW bandwidth code of RegModemConfig1
+*
+* Return      : unsigned long bandwidth in Hz
+*****************************************************************************************
+*/
+static constexpr unsigned long Band_Bandwidth(unsigned char BW)
+{
+	return (BW == BAND_BW_500) ? 500000 : (BW == BAND_BW_250) ? 250000 : 125000;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that finds the data rate of a spreading factor and bandwidth
+*
+* Arguments   : &Plan band plan
+*				SF spreading factor
+*				BW bandwidth code of RegModemConfig1
+*				Datarate first data rate to look at
+*
+* Return      : unsigned char lowest data rate with SF and BW, 0xFF the plan has none
+*****************************************************************************************
+*/
+static constexpr unsigned char Band_Find_Datarate(const sBand_Plan &Plan, unsigned char SF, unsigned char BW, unsigned char Datarate = 0)
+{
+	return (Datarate >= Plan.Datarates) ? 0xFF :
+		   (Plan.Datarate[Datarate].SF == SF && Plan.Datarate[Datarate].BW == BW) ? Datarate : Band_Find_Datarate(Plan, SF, BW, Datarate + 1);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the receive channel of RX1 for an uplink channel.
+*				Plans with receive channels of their own use them in turn, the others
+*				answer on the uplink channel.
+*
+* Arguments   : &Plan band plan
+*				Channel uplink channel
+*
+* Return      : unsigned char channel of RX1
+*****************************************************************************************
+*/
+static constexpr unsigned char Band_Rx1_Channel(const sBand_Plan &Plan, unsigned char Channel)
+{
+	return (Plan.Downlink_Channels != 0) ? 0x08 + Channel % Plan.Downlink_Channels : Channel;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that limits a data rate to the downlink data rates of a plan
+*
+* Arguments   : &Plan band plan
+*				Datarate data rate, may be out of the range
+*
+* Return      : unsigned char downlink data rate
+*****************************************************************************************
+*/
+static constexpr unsigned char Band_Downlink_Datarate(const sBand_Plan &Plan, int Datarate)
+{
+	return (Datarate < Plan.Min_Rx2_Datarate) ? Plan.Min_Rx2_Datarate : (Datarate > Plan.Max_Rx2_Datarate) ? Plan.Max_Rx2_Datarate : Datarate;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the data rate of the first receive window, the uplink
+*				data rate lowered by RX1DROffset. The offsets 6 and 7 of AS_923 raise it by
+*				one and two.
+*
+* Arguments   : &Plan band plan
+*				Datarate data rate of the uplink
+*				Offset RX1DROffset
+*
+* Return      : unsigned char data rate of RX1
+*****************************************************************************************
+*/
+static constexpr unsigned char Band_Rx1_Datarate(const sBand_Plan &Plan, unsigned char Datarate, unsigned char Offset)
+{
+	return Band_Downlink_Datarate(Plan, Plan.Rx1_Datarate + Datarate - ((Offset > 5) ? 5 - Offset : Offset));
+}
+
+/*
+********************************************************************************************
+* EU_868
+********************************************************************************************
+*/
+
+static constexpr sBand_Channel Band_EU_868_Uplink[] = {
+	Band_Channel(868100000UL),
+	Band_Channel(868300000UL),
+	Band_Channel(868500000UL),
+	Band_Channel(867100000UL),
+	Band_Channel(867300000UL),
+	Band_Channel(867500000UL),
+	Band_Channel(867700000UL),
+	Band_Channel(867900000UL),
+};
+
+static constexpr sBand_Datarate Band_EU_868_Datarate[] = {
+	{12, BAND_BW_125},
+	{11, BAND_BW_125},
+	{10, BAND_BW_125},
+	{9, BAND_BW_125},
+	{8, BAND_BW_125},
+	{7, BAND_BW_125},
+	{7, BAND_BW_250},
+};
+
+//Without dwell time limit, also for AS_923
+static constexpr unsigned char Band_EU_868_Max_Payload[] = {51, 51, 51, 115, 222, 222, 222};
+
+//Sub-bands of ETSI EN 300 220
+static constexpr unsigned int Band_EU_868_Duty_Cycle_Divider[] = {
+	1000,	//863.0 - 865.0 MHz 0.1%
+	100,	//865.0 - 868.0 MHz 1%, channels 3 to 7
+	100,	//868.0 - 868.6 MHz 1%, channels 0 to 2
+	1000,	//868.7 - 869.2 MHz 0.1%
+	10,		//869.4 - 869.65 MHz 10%, receive channel 869.525 MHz
+	100,	//869.7 - 870.0 MHz 1%
+};
+
+static constexpr unsigned char Band_EU_868_Duty_Cycle_Band[] = {2, 2, 2, 1, 1, 1, 1, 1};
+
+static constexpr sBand_Plan Band_EU_868 = {
+	Band_EU_868_Uplink, 8,
+	nullptr, 0,
+	Band_Channel(869525000UL),
+	Band_EU_868_Datarate, 7,
+	Band_EU_868_Max_Payload, 7,
+	0x00, 0x00, 0x00,		//SF12 BW 125 kHz, SF12 in RX2, RX1 as the uplink
+	0xFF,
+	3,
+	0xFF, 0x00,
+	0x06, 7, 16, 5, 0x00, 0x06,
+	863000000UL, 870000000UL,
+	Band_EU_868_Duty_Cycle_Divider, 6, Band_EU_868_Duty_Cycle_Band,
+};
+
+/*
+********************************************************************************************
+* AS_923
+********************************************************************************************
+*/
+
+static constexpr sBand_Channel Band_AS_923_Uplink[] = {
+	Band_Channel(923200000UL),
+	Band_Channel(923400000UL),
+	Band_Channel(923600000UL),
+	Band_Channel(923800000UL),
+	Band_Channel(924000000UL),
+	Band_Channel(924200000UL),
+	Band_Channel(924400000UL),
+	Band_Channel(924600000UL),
+	Band_Channel(924800000UL),
+};
+
+static constexpr sBand_Plan Band_AS_923 = {
+	Band_AS_923_Uplink, 9,
+	nullptr, 0,
+	Band_Channel(923200000UL),
+	Band_EU_868_Datarate, 7,
+	Band_EU_868_Max_Payload, 7,
+	0x00, 0x02, 0x00,		//SF12 BW 125 kHz, SF10 in RX2, RX1 as the uplink
+	0x1FF,
+	2,
+	0x08, 0x06,				//SF7 BW 250 kHz on channel 8
+	0x06, 7, 16, 7, 0x00, 0x06,
+	915000000UL, 928000000UL,
+	nullptr, 0, nullptr,
+};
+
+/*
+********************************************************************************************
+* US_915
+********************************************************************************************
+*/
+
+//Uplink channels of sub-band BAND_SUB_BAND, 125 kHz from 902.3 MHz every 200 kHz
+#define BAND_US_915_UPLINK(Channel) Band_Channel(902300000UL + 200000UL * (8 * BAND_SUB_BAND + (Channel)))
+
+static constexpr sBand_Channel Band_US_915_Uplink[] = {
+	BAND_US_915_UPLINK(0),
+	BAND_US_915_UPLINK(1),
+	BAND_US_915_UPLINK(2),
+	BAND_US_915_UPLINK(3),
+	BAND_US_915_UPLINK(4),
+	BAND_US_915_UPLINK(5),
+	BAND_US_915_UPLINK(6),
+	BAND_US_915_UPLINK(7),
+};
+
+static constexpr sBand_Channel Band_US_915_Downlink[] = {
+	Band_Channel(923300000UL),
+	Band_Channel(923900000UL),
+	Band_Channel(924500000UL),
+	Band_Channel(925100000UL),
+	Band_Channel(925700000UL),
+	Band_Channel(926300000UL),
+	Band_Channel(926900000UL),
+	Band_Channel(927500000UL),
+};
+
+static constexpr sBand_Datarate Band_US_915_Datarate[] = {
+	{10, BAND_BW_125},
+	{9, BAND_BW_125},
+	{8, BAND_BW_125},
+	{7, BAND_BW_125},
+	{8, BAND_BW_500},
+	{0, 0},
+	{0, 0},
+	{0, 0},
+	{12, BAND_BW_500},
+	{11, BAND_BW_500},
+	{10, BAND_BW_500},
+	{9, BAND_BW_500},
+	{8, BAND_BW_500},
+	{7, BAND_BW_500},
+};
+
+static constexpr unsigned char Band_US_915_Max_Payload[] = {11, 53, 125, 242, 242};
+
+static constexpr sBand_Plan Band_US_915 = {
+	Band_US_915_Uplink, 8,
+	Band_US_915_Downlink, 8,
+	Band_Channel(923300000UL),
+	Band_US_915_Datarate, 14,
+	Band_US_915_Max_Payload, 5,
+	0x02, 0x08, 0x0A,		//SF8 BW 125 kHz, SF12 at 500 kHz in RX2, RX1 from DR10
+	0xFF,
+	8,
+	0xFF, 0x00,
+	0x04, 14, 30, 3, 0x08, 0x0D,
+	0, 0,
+	nullptr, 0, nullptr,
+};
+
+/*
+********************************************************************************************
+* Plan of the region of Config.h
+********************************************************************************************
+*/
+
+#if defined(US_915)
+#define BAND_PLAN Band_US_915
+#elif defined(AS_923)
+#define BAND_PLAN Band_AS_923
+#else
+#define BAND_PLAN Band_EU_868
+#endif
+
+//Data rates of BAND_PLAN by spreading factor and bandwidth, 0xFF when the region has none
+typedef enum {
+	SF12BW125 = Band_Find_Datarate(BAND_PLAN, 12, BAND_BW_125),
+	SF11BW125 = Band_Find_Datarate(BAND_PLAN, 11, BAND_BW_125),
+	SF10BW125 = Band_Find_Datarate(BAND_PLAN, 10, BAND_BW_125),
+	SF9BW125 = Band_Find_Datarate(BAND_PLAN, 9, BAND_BW_125),
+	SF8BW125 = Band_Find_Datarate(BAND_PLAN, 8, BAND_BW_125),
+	SF7BW125 = Band_Find_Datarate(BAND_PLAN, 7, BAND_BW_125),
+	SF7BW250 = Band_Find_Datarate(BAND_PLAN, 7, BAND_BW_250),
+	SF12BW500 = Band_Find_Datarate(BAND_PLAN, 12, BAND_BW_500),
+	SF11BW500 = Band_Find_Datarate(BAND_PLAN, 11, BAND_BW_500),
+	SF10BW500 = Band_Find_Datarate(BAND_PLAN, 10, BAND_BW_500),
+	SF9BW500 = Band_Find_Datarate(BAND_PLAN, 9, BAND_BW_500),
+	SF8BW500 = Band_Find_Datarate(BAND_PLAN, 8, BAND_BW_500),
+	SF7BW500 = Band_Find_Datarate(BAND_PLAN, 7, BAND_BW_500)
+} dataRates_t;
+
+/*
+*****************************************************************************************
+* Description : Function that sets the uplink data rate and the data rate of RX1 that
+*				goes with it. Every change of the uplink data rate goes through here.
+*
+* Arguments   : Datarate the new uplink data rate
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+static inline void Band_Set_Datarate(unsigned char Datarate, sSettings *LoRa_Settings)
+{
+	LoRa_Settings->Datarate_Tx = Datarate;
+	LoRa_Settings->Datarate_Rx = Band_Rx1_Datarate(BAND_PLAN, Datarate, LoRa_Settings->Rx1_DR_Offset);
+}
+
+#endif
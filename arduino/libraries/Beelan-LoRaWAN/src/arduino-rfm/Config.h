@@ -4,7 +4,38 @@
 //debug 
 //#define DEBUG
 
-//LoRaWAN freq. band
+//AES-128 backend, the SAMR34 AES peripheral is used on target and the
+//byte oriented S_Table implementation on other builds
+//#define AES_SOFTWARE        //use a software backend on the SAMR34 as well
+//#define AES_T_TABLE         //software, 32-bit columns with one 1 KB table
+//#define AES_T_TABLE_FULL    //software, 32-bit columns with four 1 KB tables, fastest
+
+//Frame counters kept in the RWW EEPROM, restored by setDevAddr() for the same address.
+//Written every FCNT_NVM_INTERVAL frames, see NVM-Counter.h for the location of the log
+//#define FCNT_NVM
+//#define FCNT_NVM_INTERVAL 32
+
+//Key stream and Block B0 of the MIC of the next uplink prepared in update() while idle,
+//KEYSTREAM_SIZE payload bytes are encrypted with an XOR. See Keystream_Prepare in Encrypt.cpp
+//#define KEYSTREAM_PRECOMPUTE
+//#define KEYSTREAM_SIZE 32
+
+//Receive windows of class A: accuracy of micros() in ppm and us a window may open late.
+//Raise LORA_RX_LATENCY when update() is not called often. See LORA_Rx_Window in LoRaMAC.cpp
+//#define LORA_RX_CLOCK_PPM 50
+//#define LORA_RX_LATENCY 1000
+
+//Class C packages the RxDone interrupt keeps until update() reads them. See RFM95.cpp
+//#define RFM_RX_QUEUE_SIZE 2
+
+//EU_868 duty cycle, airtime in us a sub-band may save up for a burst. See Duty-Cycle.cpp
+//#define DUTY_CYCLE_BURST 0
+
+//Fragmented data block of port 201 into the flash for the bootloader to install, about 3 KB RAM.
+//The application has to end below FRAG_FLASH_ADDRESS. See Fragmentation.h
+//#define FUOTA
+
+//LoRaWAN freq. band, selects the band plan of Band-Plan.h
 
 #define EU_868
 
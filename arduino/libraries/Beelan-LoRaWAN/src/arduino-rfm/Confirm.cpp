@@ -0,0 +1,122 @@
+/****************************************************************************************
+* File:     Confirm.cpp
+*
+* Retransmissions of a confirmed uplink until the network acknowledges it.
+* A confirmed uplink without ACK in its receive windows is sent again after ACK_TIMEOUT,
+* with the same frame counter, up to NbTrans transmissions. Every retransmission is on
+* the next channel, every second one also one data rate lower. The data rate of the
+* first transmission is restored when the uplink is acknowledged or given up, unless the
+* network or the ADR changed the data rate meanwhile.
+****************************************************************************************/
+
+#include "Confirm.h"
+#include "Band-Plan.h"
+#include "Arduino.h"
+
+/*
+*****************************************************************************************
+* Description : Function that undoes the lower data rate of the retransmissions. A data
+*				rate the network or the ADR set after it is kept.
+*
+* Arguments   : *Confirm pointer to sConfirm struct
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+static void Confirm_Restore_Datarate(sConfirm *Confirm, sSettings *LoRa_Settings)
+{
+	if(Confirm->Lowered != CONFIRM_NOT_LOWERED && LoRa_Settings->Datarate_Tx == Confirm->Lowered)
+	{
+		Band_Set_Datarate(Confirm->Datarate, LoRa_Settings);
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call after the first transmission of a confirmed uplink
+*
+* Arguments   : *Confirm pointer to sConfirm struct
+*				Frame_Counter FCntUp the uplink was sent with
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+void Confirm_Init(sConfirm *Confirm, unsigned int Frame_Counter, sSettings *LoRa_Settings)
+{
+	Confirm->Active = 0x01;
+	Confirm->Attempts = 1;
+	Confirm->Datarate = LoRa_Settings->Datarate_Tx;
+	Confirm->Lowered = CONFIRM_NOT_LOWERED;
+	Confirm->Frame_Counter = Frame_Counter;
+	Confirm->Next = millis();
+}
+
+/*
+*****************************************************************************************
+* Description : Function that checks if the retransmission is due, only valid while the
+*				cycle of the last transmission is not running
+*
+* Arguments   : *Confirm pointer to sConfirm struct
+*
+* Return      : bool true when the uplink should be sent again
+*****************************************************************************************
+*/
+bool Confirm_Due(sConfirm *Confirm)
+{
+	return Confirm->Active == 0x01 && (long)(millis() - Confirm->Next) >= 0;
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call after a retransmission
+*
+* Arguments   : *Confirm pointer to sConfirm struct
+*****************************************************************************************
+*/
+void Confirm_Sent(sConfirm *Confirm)
+{
+	Confirm->Attempts++;
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call when the receive windows had no ACK, schedules the
+*				retransmission
+*
+* Arguments   : *Confirm pointer to sConfirm struct
+*				*LoRa_Settings pointer to sSettings struct
+*
+* Return      : bool true when the uplink is given up after NbTrans transmissions
+*****************************************************************************************
+*/
+bool Confirm_Failed(sConfirm *Confirm, sSettings *LoRa_Settings)
+{
+	if(Confirm->Attempts >= LoRa_Settings->Nb_Trans)
+	{
+		Confirm->Active = 0x00;
+		Confirm_Restore_Datarate(Confirm, LoRa_Settings);
+		return true;
+	}
+
+	//Lower data rate after every second transmission
+	if((Confirm->Attempts % 2) == 0 && LoRa_Settings->Datarate_Tx > 0x00)
+	{
+		Band_Set_Datarate(LoRa_Settings->Datarate_Tx - 1, LoRa_Settings);
+		Confirm->Lowered = LoRa_Settings->Datarate_Tx;
+	}
+
+	Confirm->Next = millis() + random(CONFIRM_ACK_TIMEOUT_MIN, CONFIRM_ACK_TIMEOUT_MAX + 1);
+	return false;
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call when a downlink acknowledged the uplink
+*
+* Arguments   : *Confirm pointer to sConfirm struct
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+void Confirm_Acked(sConfirm *Confirm, sSettings *LoRa_Settings)
+{
+	Confirm->Active = 0x00;
+	Confirm_Restore_Datarate(Confirm, LoRa_Settings);
+}
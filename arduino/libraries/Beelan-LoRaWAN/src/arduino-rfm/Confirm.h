@@ -0,0 +1,64 @@
+/****************************************************************************************
+* File:     Confirm.h
+*
+* Retransmissions of a confirmed uplink until the network acknowledges it
+****************************************************************************************/
+
+#ifndef CONFIRM_H
+#define CONFIRM_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Struct.h"
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Transmissions of a confirmed uplink until a LinkADRReq sets NbTrans
+#ifndef CONFIRM_NB_TRANS
+#define CONFIRM_NB_TRANS 8
+#endif
+
+//Retransmission in ms after the last receive window, ACK_TIMEOUT of LoRaWAN is 2 +- 1 s
+#define CONFIRM_ACK_TIMEOUT_MIN 1000
+#define CONFIRM_ACK_TIMEOUT_MAX 3000
+
+//Lowered of sConfirm while the retransmissions did not lower the data rate
+#define CONFIRM_NOT_LOWERED 0xFF
+
+/*
+********************************************************************************************
+* TYPE DEFINITION
+********************************************************************************************
+*/
+
+typedef struct {
+    unsigned char Active;       //0x01 while the uplink waits for its ACK
+    unsigned char Attempts;     //Transmissions of the uplink
+    unsigned char Datarate;     //Data rate of the first transmission
+    unsigned char Lowered;      //Data rate the retransmissions set last
+    unsigned int Frame_Counter; //FCntUp of the uplink
+    unsigned long Next;         //millis() of the retransmission
+} sConfirm;
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+void Confirm_Init(sConfirm *Confirm, unsigned int Frame_Counter, sSettings *LoRa_Settings);
+bool Confirm_Due(sConfirm *Confirm);
+void Confirm_Sent(sConfirm *Confirm);
+bool Confirm_Failed(sConfirm *Confirm, sSettings *LoRa_Settings);
+void Confirm_Acked(sConfirm *Confirm, sSettings *LoRa_Settings);
+
+#endif
@@ -0,0 +1,179 @@
+/****************************************************************************************
+* File:     Duty-Cycle.cpp
+*
+* Duty cycle budget of the sub-bands of the band plan, only EU_868 has them.
+* Every sub-band has a credit of airtime that grows with its duty cycle, 1% of the time
+* passed gives 1% of that time as airtime. A transmission takes its time on air from the
+* credit of the sub-band of its channel. The credit is limited to DUTY_CYCLE_BURST and
+* a frame may start when the credit covers it, or when it is not negative for a frame
+* longer than the burst. With the default DUTY_CYCLE_BURST of 0 this is the off time of
+* LoRaWAN, a frame of 100 ms on a 1% sub-band blocks it for 10 s.
+* The DutyCycleReq of the network limits all channels together the same way, in every
+* region.
+****************************************************************************************/
+
+#include <Arduino.h>
+#include "Duty-Cycle.h"
+#include "Band-Plan.h"
+
+typedef struct {
+	unsigned int Divider;		//1 / duty cycle, 100 is 1%
+	long Credit;				//Airtime in us that can be used, negative after a frame
+	unsigned long Update_Time;	//millis() of the last credit update
+} sDuty_Cycle_Band;
+
+//All channels together, 1 / 2^MaxDCycle of DutyCycleReq, 1 is no limit
+static sDuty_Cycle_Band Duty_Cycle_Total = {1, 0, 0};
+
+//Sub-bands of the band plan, the divider is set when a band is used
+static sDuty_Cycle_Band Duty_Cycle_Bands[BAND_PLAN.Duty_Cycle_Bands ? BAND_PLAN.Duty_Cycle_Bands : 1];
+
+/*
+*****************************************************************************************
+* Description : Function that gives the sub-band of a channel
+*
+* Arguments   : Channel the transmit channel
+*
+* Return      : sDuty_Cycle_Band pointer to the sub-band
+*****************************************************************************************
+*/
+static sDuty_Cycle_Band *Duty_Cycle_Band(unsigned char Channel)
+{
+	unsigned char Index = BAND_PLAN.Duty_Cycle_Band[Channel < BAND_PLAN.Uplink_Channels ? Channel : 0];
+
+	Duty_Cycle_Bands[Index].Divider = BAND_PLAN.Duty_Cycle_Divider[Index];
+	return &Duty_Cycle_Bands[Index];
+}
+
+/*
+*****************************************************************************************
+* Description : Function that brings the credit of a band up to date
+*
+* Arguments   : *Band pointer to the band
+*****************************************************************************************
+*/
+static void Duty_Cycle_Update(sDuty_Cycle_Band *Band)
+{
+	unsigned long Now = millis();
+	unsigned long long Gain;
+
+	//ms to us, times the duty cycle. In 64 bits, at 1 / 32768 of DutyCycleReq an off time
+	//takes days and the ms passed times 1000 no longer fit 32 bits.
+	Gain = (unsigned long long)(Now - Band->Update_Time) * 1000 / Band->Divider;
+
+	//Only a band that is not full gains credit
+	if(Band->Credit >= DUTY_CYCLE_BURST || Gain >= (unsigned long long)(DUTY_CYCLE_BURST - Band->Credit))
+	{
+		Band->Credit = DUTY_CYCLE_BURST;
+	}
+	else
+	{
+		Band->Credit += (long)Gain;
+	}
+	Band->Update_Time = Now;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the time until a band has the credit for a frame
+*
+* Arguments   : *Band pointer to the band
+*				Time_On_Air of the frame in us
+*
+* Return      : unsigned long ms to wait, 0 if the frame can be sent now
+*****************************************************************************************
+*/
+static unsigned long Duty_Cycle_Band_Wait(sDuty_Cycle_Band *Band, unsigned long Time_On_Air)
+{
+#if DUTY_CYCLE_BURST == 0
+	//No burst, the credit may not be negative
+	long Needed = 0;
+
+	(void)Time_On_Air;
+#else
+	long Needed = (Time_On_Air < DUTY_CYCLE_BURST) ? (long)Time_On_Air : DUTY_CYCLE_BURST;
+#endif
+
+	Duty_Cycle_Update(Band);
+	if(Band->Credit >= Needed)
+	{
+		return 0;
+	}
+
+	//Missing credit in us grows with 1000 / Divider per ms
+	return (unsigned long)(((unsigned long long)(Needed - Band->Credit) * Band->Divider + 999) / 1000);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the time until a frame can be sent on a channel
+*
+* Arguments   : Channel the transmit channel
+*				Time_On_Air of the frame in us
+*
+* Return      : unsigned long ms to wait, 0 if the frame can be sent now
+*****************************************************************************************
+*/
+unsigned long Duty_Cycle_Wait(unsigned char Channel, unsigned long Time_On_Air)
+{
+	unsigned long Wait = 0;
+	unsigned long Total_Wait;
+
+	if(BAND_PLAN.Duty_Cycle_Bands != 0)
+	{
+		Wait = Duty_Cycle_Band_Wait(Duty_Cycle_Band(Channel), Time_On_Air);
+	}
+
+	if(Duty_Cycle_Total.Divider > 1)
+	{
+		Total_Wait = Duty_Cycle_Band_Wait(&Duty_Cycle_Total, Time_On_Air);
+		if(Total_Wait > Wait)
+		{
+			Wait = Total_Wait;
+		}
+	}
+
+	return Wait;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that takes the airtime of a frame from the credit of its sub-band,
+*				call at the start of the transmission
+*
+* Arguments   : Channel the transmit channel
+*				Time_On_Air of the frame in us
+*****************************************************************************************
+*/
+void Duty_Cycle_Use(unsigned char Channel, unsigned long Time_On_Air)
+{
+	sDuty_Cycle_Band *Band;
+
+	if(BAND_PLAN.Duty_Cycle_Bands != 0)
+	{
+		Band = Duty_Cycle_Band(Channel);
+		Duty_Cycle_Update(Band);
+		Band->Credit -= (long)Time_On_Air;
+	}
+
+	if(Duty_Cycle_Total.Divider > 1)
+	{
+		Duty_Cycle_Update(&Duty_Cycle_Total);
+		Duty_Cycle_Total.Credit -= (long)Time_On_Air;
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function that sets the duty cycle of all channels together, from the
+*				DutyCycleReq of the network
+*
+* Arguments   : Max_Duty_Cycle the duty cycle is 1 / 2^Max_Duty_Cycle, 0 is no limit
+*****************************************************************************************
+*/
+void Duty_Cycle_Set_Total(unsigned char Max_Duty_Cycle)
+{
+	Duty_Cycle_Total.Divider = 1 << (Max_Duty_Cycle & 0x0F);
+	Duty_Cycle_Total.Credit = DUTY_CYCLE_BURST;
+	Duty_Cycle_Total.Update_Time = millis();
+}
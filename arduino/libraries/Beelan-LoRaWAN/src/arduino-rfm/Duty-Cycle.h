@@ -0,0 +1,40 @@
+/****************************************************************************************
+* File:     Duty-Cycle.h
+*
+* Duty cycle budget of the sub-bands, only limits the transmissions for EU_868, and the
+* duty cycle of all channels together set by the network
+****************************************************************************************/
+
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Airtime in us a sub-band may save up for a burst, the duty cycle still holds per hour
+#ifndef DUTY_CYCLE_BURST
+#define DUTY_CYCLE_BURST 0
+#endif
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+unsigned long Duty_Cycle_Wait(unsigned char Channel, unsigned long Time_On_Air);
+void Duty_Cycle_Use(unsigned char Channel, unsigned long Time_On_Air);
+void Duty_Cycle_Set_Total(unsigned char Max_Duty_Cycle);
+
+#endif
@@ -32,6 +32,7 @@
 *****************************************************************************************
 */
 
+#include <string.h>
 #include "Encrypt.h"
 #include "AES-128.h"
 #include "Struct.h"
@@ -84,83 +85,66 @@ static void Shift_Left(unsigned char *Data)
 }
 /*
 *****************************************************************************************
-* Description : Function used to encrypt and decrypt the data in a LoRaWAN data message
+* Description : Function used to construct Block A of the encryption or Block B0 of the
+*				MIC of a data message, they only differ in the first and the last byte
 *
-* Arguments   : *Buffer pointer to the buffer containing the data to de/encrypt
-*				*Session_Data pointer to sLoRa_Session sturct
+* Arguments   : *Block pointer to the 16 byte block
+*				Type 0x01 for Block A, 0x49 for Block B0
 *				*Message pointer to sLoRa_Message struct containing the message specific variables
+*				Last block counter of Block A, message length of Block B0
 *****************************************************************************************
 */
-void Encrypt_Payload(sBuffer *Buffer, unsigned char *Key, sLoRa_Message *Message)
+static void Construct_Block(unsigned char *Block, unsigned char Type, sLoRa_Message *Message, unsigned char Last)
 {
-	unsigned char i = 0x00;
-	unsigned char j;
-	unsigned char Number_of_Blocks = 0x00;
-	unsigned char Incomplete_Block_Size = 0x00;
-
-	unsigned char Block_A[16];
+	Block[0] = Type;
+	Block[1] = 0x00;
+	Block[2] = 0x00;
+	Block[3] = 0x00;
+	Block[4] = 0x00;
 
-	//Calculate number of blocks
-	Number_of_Blocks = Buffer->Counter / 16;
-	Incomplete_Block_Size = Buffer->Counter % 16;
-	if(Incomplete_Block_Size != 0)
-	{
-		Number_of_Blocks++;
-	}
-
-	for(i = 0x00; i < Number_of_Blocks; i++)
-	{
-		Block_A[0] = 0x01;
-		Block_A[1] = 0x00;
-		Block_A[2] = 0x00;
-		Block_A[3] = 0x00;
-		Block_A[4] = 0x00;
+	Block[5] = Message->Direction;
 
-		Block_A[5] = Message->Direction;
+	Block[6] = Message->DevAddr[3];
+	Block[7] = Message->DevAddr[2];
+	Block[8] = Message->DevAddr[1];
+	Block[9] = Message->DevAddr[0];
 
-		Block_A[6] = Message->DevAddr[3];
-		Block_A[7] = Message->DevAddr[2];
-		Block_A[8] = Message->DevAddr[1];
-		Block_A[9] = Message->DevAddr[0];
+	Block[10] = (Message->Frame_Counter & 0x00FF);
+	Block[11] = ((Message->Frame_Counter >> 8) & 0x00FF);
 
-		Block_A[10] = (Message->Frame_Counter & 0x00FF);
-		Block_A[11] = ((Message->Frame_Counter >> 8) & 0x00FF);
+	Block[12] = ((Message->Frame_Counter >> 16) & 0x00FF); //Frame counter upper bytes
+	Block[13] = ((Message->Frame_Counter >> 24) & 0x00FF);
 
-		Block_A[12] = 0x00; //Frame counter upper Bytes
-		Block_A[13] = 0x00;
+	Block[14] = 0x00;
 
-		Block_A[14] = 0x00;
+	Block[15] = Last;
+}
 
-		Block_A[15] = i + 1;
+/*
+*****************************************************************************************
+* Description : Function used to encrypt and decrypt the data in a LoRaWAN data message
+*
+* Arguments   : *Buffer pointer to the buffer containing the data to de/encrypt
+*				*Key pointer to the expanded AppSKey or NwkSKey
+*				*Message pointer to sLoRa_Message struct containing the message specific variables
+*****************************************************************************************
+*/
+void Encrypt_Payload(sBuffer *Buffer, sAES_Expanded_Key *Key, sLoRa_Message *Message)
+{
+	unsigned char Block_A[16];
 
-		//Calculate S
-		AES_Encrypt(Block_A,Key);
+	//Construct Block A for the first block, the block counter is in the last byte
+	Construct_Block(Block_A, 0x01, Message, 0x01);
 
-		//Check for last block
-		if(i != (Number_of_Blocks - 1))
-		{
-			for(j = 0; j < 16; j++)
-			{
-				Buffer->Data[(i*16)+j] ^= Block_A[j];
-			}
-		}
-		else
-		{
-			if(Incomplete_Block_Size == 0)
-			{
-				Incomplete_Block_Size = 16;
-			}
-			for(j = 0; j < Incomplete_Block_Size; j++)
-			{
-				Buffer->Data[(i*16)+j] ^= Block_A[j];
-			}
-		}
-	}
+	//XOR the data with S in CTR mode
+	AES_Encrypt_CTR(Buffer->Data, Buffer->Counter, Block_A, Key);
 }
 
 /*
 *****************************************************************************************
-* Description : Function used to build a the data that is used for calculating the MIC of a data message
+* Description : Function used to calculate the MIC of a data message. Block B0, the header
+*				and the payload are fed directly into the CMAC of the NwkSKey. Block B0 of
+*				an uplink is skipped when its chaining value is prepared in the key stream.
 *
 * Arguments   : *Buffer pointer to the buffer containing the data
 *				*Session_Data pointer to sLoRa_Session sturct
@@ -169,191 +153,284 @@ void Encrypt_Payload(sBuffer *Buffer, unsigned char *Key, sLoRa_Message *Message
 */
 void Construct_Data_MIC(sBuffer *Buffer, sLoRa_Session *Session_Data, sLoRa_Message *Message)
 {
-    unsigned char i;
-    unsigned char MIC_Data[80];
-    sBuffer MIC_Buffer = { &MIC_Data[0], 0x00 };
-
     unsigned char Block_B[16];
+    sCMAC_Context CMAC;
+    sKeystream *Keystream = Session_Data->Keystream;
 
-    //Construct Block B
-	Block_B[0] = 0x49;
-	Block_B[1] = 0x00;
-	Block_B[2] = 0x00;
-	Block_B[3] = 0x00;
-	Block_B[4] = 0x00;
+    CMAC_Init(&CMAC, Session_Data->NwkSKey_CMAC);
 
-	Block_B[5] = Message->Direction;
+    //Block B0 is chained already
+    if(Keystream_Ready(Keystream, Message) && Keystream->Length == Buffer->Counter)
+    {
+        memcpy(CMAC.X, Keystream->MIC_Chain, 16);
+    }
+    else
+    {
+        Construct_Block(Block_B, 0x49, Message, Buffer->Counter);
+        CMAC_Update(&CMAC, Block_B, 16);
+    }
 
-	Block_B[6] = Message->DevAddr[3];
-	Block_B[7] = Message->DevAddr[2];
-	Block_B[8] = Message->DevAddr[1];
-	Block_B[9] = Message->DevAddr[0];
+    //Calculate the MIC over Block B and the data
+    CMAC_Update(&CMAC, Buffer->Data, Buffer->Counter);
+    CMAC_Final(&CMAC, Message->MIC);
+}
 
-	Block_B[10] = (Message->Frame_Counter & 0x00FF);
-	Block_B[11] = ((Message->Frame_Counter >> 8) & 0x00FF);
+/*
+*****************************************************************************************
+* Description : Function used to prepare the encryption of the next uplink in idle time.
+*				The first KEYSTREAM_SIZE bytes of the key stream are calculated for the
+*				frame counter of the session, and when the length of the frame is known
+*				from the last uplink Block B0 of the MIC is chained as well.
+*
+* Arguments   : *Keystream pointer to sKeystream struct to fill, Length is kept
+*				*Session_Data pointer to sLoRa_Session sturct
+*****************************************************************************************
+*/
+void Keystream_Prepare(sKeystream *Keystream, sLoRa_Session *Session_Data)
+{
+	unsigned char Block[16];
+	sLoRa_Message Message;
+
+	Message.DevAddr[0] = Session_Data->DevAddr[0];
+	Message.DevAddr[1] = Session_Data->DevAddr[1];
+	Message.DevAddr[2] = Session_Data->DevAddr[2];
+	Message.DevAddr[3] = Session_Data->DevAddr[3];
+	Message.Direction = 0x00;
+	Message.Frame_Counter = *Session_Data->Frame_Counter;
+
+	//Key stream S is the encryption of zeros in CTR mode
+	Construct_Block(Block, 0x01, &Message, 0x01);
+	memset(Keystream->Stream, 0x00, KEYSTREAM_SIZE);
+	AES_Encrypt_CTR(Keystream->Stream, KEYSTREAM_SIZE, Block, Session_Data->AppSKey_Expanded);
+
+	//Block B0 is never the last block of the MIC, chain it like CMAC_Update would
+	if(Keystream->Length != 0x00)
+	{
+		Construct_Block(Block, 0x49, &Message, Keystream->Length);
+		memset(Keystream->MIC_Chain, 0x00, 16);
+		AES_CBC_MAC(Keystream->MIC_Chain, Block, 1, Session_Data->NwkSKey_Expanded);
+	}
 
-	Block_B[12] = 0x00; //Frame counter upper bytes
-	Block_B[13] = 0x00;
+	Keystream->Frame_Counter = Message.Frame_Counter;
+	Keystream->Valid = 0x01;
+}
 
-	Block_B[14] = 0x00;
-	Block_B[15] = Buffer->Counter;
+/*
+*****************************************************************************************
+* Description : Function that checks if the key stream is prepared for a message
+*
+* Arguments   : *Keystream pointer to sKeystream struct, may be NULL
+*				*Message pointer to sLoRa_Message struct of the message
+*
+* Return      : bool true for an uplink with the frame counter of the key stream
+*****************************************************************************************
+*/
+bool Keystream_Ready(sKeystream *Keystream, sLoRa_Message *Message)
+{
+	return Keystream != NULL && Keystream->Valid == 0x01 &&
+		   Message->Direction == 0x00 && Keystream->Frame_Counter == Message->Frame_Counter;
+}
 
-    //Copy Block B into MIC data
-    for(i = 0x00; i < 16; i++)
-    {
-        MIC_Data[i] = Block_B[i];
-    }
+/*
+*****************************************************************************************
+* Description : Function used to encrypt the payload of an uplink with the prepared key
+*				stream, only an XOR is left
+*
+* Arguments   : *Buffer pointer to the buffer containing the data to encrypt
+*				*Keystream pointer to sKeystream struct, may be NULL
+*				*Message pointer to sLoRa_Message struct containing the message specific variables
+*
+* Return      : bool false when the key stream does not cover the data, use Encrypt_Payload
+*****************************************************************************************
+*/
+bool Keystream_Encrypt(sBuffer *Buffer, sKeystream *Keystream, sLoRa_Message *Message)
+{
+	unsigned char i;
 
-    //Add data to it
-    for(i = 0x00; i < Buffer->Counter; i++)
-    {
-        MIC_Data[i + 16] = Buffer->Data[i];
-    }
+	if(!Keystream_Ready(Keystream, Message) || Buffer->Counter > KEYSTREAM_SIZE)
+	{
+		return false;
+	}
 
-    //Calculate the correct buffer length
-    MIC_Buffer.Counter = 16 + Buffer->Counter;
+	for(i = 0; i < Buffer->Counter; i++)
+	{
+		Buffer->Data[i] ^= Keystream->Stream[i];
+	}
 
-    //Calculate the MIC
-    Calculate_MIC(&MIC_Buffer, Session_Data->NwkSKey, Message);
+	return true;
 }
 
 /*
 *****************************************************************************************
-* Description : Function used to calculate the MIC of data
+* Description : Function used to drop the prepared key stream, when the keys or the
+*				device address change
 *
-* Arguments   : *Buffer pointer to the buffer containing the data the MIC should be calculated from
-*				*Key pointer to key used for the MIC calculation
-*				*Message pointer to sLoRa_Message struct containing the message specific variables
+* Arguments   : *Keystream pointer to sKeystream struct, may be NULL
 *****************************************************************************************
 */
-void Calculate_MIC(sBuffer *Buffer, unsigned char *Key, sLoRa_Message *Message)
+void Keystream_Clear(sKeystream *Keystream)
 {
-	unsigned char i, j;
-	unsigned char Key_K1[16] = {
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-	};
-	unsigned char Key_K2[16] = {
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-	};
-
-	unsigned char Old_Data[16] = {
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-	};
-	unsigned char New_Data[16] = {
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-	};
-
-	unsigned char Number_of_Blocks = 0x00;
-	unsigned char Incomplete_Block_Size = 0x00;
-
-	//Calculate number of Blocks and blocksize of last block
-	Number_of_Blocks = Buffer->Counter / 16;
-	Incomplete_Block_Size = Buffer->Counter % 16;
-
-    //if there is an incomplete block at the end add 1 to the number of blocks
-	if(Incomplete_Block_Size != 0)
+	if(Keystream != NULL)
 	{
-		Number_of_Blocks++;
+		Keystream->Valid = 0x00;
 	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function used to calculate the MIC of data with a key that is only used
+*				once, like the AppKey in the join procedure
+*
+* Arguments   : *Buffer pointer to the buffer containing the data the MIC should be calculated from
+*				*Key pointer to the expanded key used for the MIC calculation
+*				*Message pointer to sLoRa_Message struct containing the message specific variables
+*****************************************************************************************
+*/
+void Calculate_MIC(sBuffer *Buffer, sAES_Expanded_Key *Key, sLoRa_Message *Message)
+{
+	sCMAC_Key CMAC_Key;
+	sCMAC_Context CMAC;
+
+	CMAC_Key_Init(&CMAC_Key, Key);
+
+	CMAC_Init(&CMAC, &CMAC_Key);
+	CMAC_Update(&CMAC, Buffer->Data, Buffer->Counter);
+	CMAC_Final(&CMAC, Message->MIC);
+}
+
+/*
+*****************************************************************************************
+* Description : Function used to calculate the CMAC subkeys of a key. Only needed when
+*				the key changes.
+*
+* Arguments   : *CMAC_Key pointer to sCMAC_Key struct to fill
+*				*Key pointer to the expanded key
+*****************************************************************************************
+*/
+void CMAC_Key_Init(sCMAC_Key *CMAC_Key, sAES_Expanded_Key *Key)
+{
+	CMAC_Key->Key = Key;
+
+	memset(CMAC_Key->K1, 0x00, 16);
+	memset(CMAC_Key->K2, 0x00, 16);
+
+	Generate_Keys(Key, CMAC_Key->K1, CMAC_Key->K2);
+}
+
+/*
+*****************************************************************************************
+* Description : Function used to start a new CMAC calculation
+*
+* Arguments   : *Context pointer to sCMAC_Context struct
+*				*CMAC_Key pointer to the sCMAC_Key of the key to use
+*****************************************************************************************
+*/
+void CMAC_Init(sCMAC_Context *Context, sCMAC_Key *CMAC_Key)
+{
+	Context->Key = CMAC_Key;
+	memset(Context->X, 0x00, 16);
+	Context->Block_Length = 0;
+}
 
-	Generate_Keys(Key, Key_K1, Key_K2);
+/*
+*****************************************************************************************
+* Description : Function used to add data to a CMAC calculation. A full block is only
+*				chained when more data follows, the last block is left for CMAC_Final.
+*
+* Arguments   : *Context pointer to sCMAC_Context struct
+*				*Data pointer to the data
+*				Length number of bytes
+*****************************************************************************************
+*/
+void CMAC_Update(sCMAC_Context *Context, unsigned char *Data, unsigned char Length)
+{
+	unsigned char Blocks;
+	unsigned char Size;
 
-	//Perform full calculating until n-1 message blocks
-    for(j = 0x0; j < (Number_of_Blocks - 1); j++)
+	while(Length > 0)
 	{
-		//Copy data into array
-		for(i = 0; i < 16; i++)
+		//Block is full and there is more data so it is not the last block
+		if(Context->Block_Length == 16)
 		{
-			New_Data[i] = Buffer->Data[(j*16)+i];
+			AES_CBC_MAC(Context->X, Context->Block, 1, Context->Key->Key);
+			Context->Block_Length = 0;
 		}
 
-		//Perform XOR with old data
-		XOR(New_Data,Old_Data);
-
-		//Perform AES encryption
-		AES_Encrypt(New_Data,Key);
-
-		//Copy New_Data to Old_Data
-		for(i = 0; i < 16; i++)
+		//Chain full blocks directly from the data, keep the last one
+		if(Context->Block_Length == 0 && Length > 16)
 		{
-			Old_Data[i] = New_Data[i];
+			Blocks = (Length - 1) / 16;
+			AES_CBC_MAC(Context->X, Data, Blocks, Context->Key->Key);
+			Data += Blocks * 16;
+			Length -= Blocks * 16;
 		}
-	}
 
-	//Perform calculation on last block
-	//Check if Datalength is a multiple of 16
-	if(Incomplete_Block_Size == 0)
-	{
-		//Copy last data into array
-		for(i = 0; i < 16; i++)
+		Size = 16 - Context->Block_Length;
+		if(Size > Length)
 		{
-			New_Data[i] = Buffer->Data[((Number_of_Blocks -1)*16)+i];
+			Size = Length;
 		}
 
-		//Perform XOR with Key 1
-		XOR(New_Data,Key_K1);
+		memcpy(&Context->Block[Context->Block_Length], Data, Size);
+		Context->Block_Length += Size;
+		Data += Size;
+		Length -= Size;
+	}
+}
 
-		//Perform XOR with old data
-		XOR(New_Data,Old_Data);
+/*
+*****************************************************************************************
+* Description : Function used to finish a CMAC calculation
+*
+* Arguments   : *Context pointer to sCMAC_Context struct
+*				*MIC pointer to the 4 byte MIC, the first 4 bytes of the CMAC
+*****************************************************************************************
+*/
+void CMAC_Final(sCMAC_Context *Context, unsigned char *MIC)
+{
+	unsigned char i;
 
-		//Perform last AES routine
-		AES_Encrypt(New_Data,Key);
+	//Complete last block, XOR with Key 1
+	if(Context->Block_Length == 16)
+	{
+		XOR(Context->Block, Context->Key->K1);
 	}
+	//Incomplete last block, pad and XOR with Key 2
 	else
 	{
-		//Copy the remaining data and fill the rest
-		for(i =  0; i < 16; i++)
+		Context->Block[Context->Block_Length] = 0x80;
+		for(i = Context->Block_Length + 1; i < 16; i++)
 		{
-			if(i < Incomplete_Block_Size)
-			{
-				New_Data[i] = Buffer->Data[((Number_of_Blocks -1)*16)+i];
-			}
-			if(i == Incomplete_Block_Size)
-			{
-				New_Data[i] = 0x80;
-			}
-			if(i > Incomplete_Block_Size)
-			{
-				New_Data[i] = 0x00;
-			}
+			Context->Block[i] = 0x00;
 		}
-
-		//Perform XOR with Key 2
-		XOR(New_Data,Key_K2);
-
-		//Perform XOR with Old data
-		XOR(New_Data,Old_Data);
-
-		//Perform last AES routine
-		AES_Encrypt(New_Data,Key);
+		XOR(Context->Block, Context->Key->K2);
 	}
 
-	Message->MIC[0] = New_Data[0];
-	Message->MIC[1] = New_Data[1];
-	Message->MIC[2] = New_Data[2];
-	Message->MIC[3] = New_Data[3];
+	//Perform last AES routine
+	AES_CBC_MAC(Context->X, Context->Block, 1, Context->Key->Key);
+
+	MIC[0] = Context->X[0];
+	MIC[1] = Context->X[1];
+	MIC[2] = Context->X[2];
+	MIC[3] = Context->X[3];
 }
 
 /*
 *****************************************************************************************
 * Description : Function used to generate keys for the MIC calculation
 *
-* Arguments   : *Key pointer to key used for the MIC calculation
+* Arguments   : *Key pointer to the expanded key used for the MIC calculation
 *				*K1 pointer to Key1
 *				*K2 pointer ot Key2
 *****************************************************************************************
 */
-void Generate_Keys(unsigned char *Key, unsigned char *K1, unsigned char *K2)
+void Generate_Keys(sAES_Expanded_Key *Key, unsigned char *K1, unsigned char *K2)
 {
 	unsigned char i;
 	unsigned char MSB_Key;
 
 	//Encrypt the zeros in K1 with the NwkSkey
-	AES_Encrypt(K1,Key);
+	AES_Encrypt_Expanded(K1,Key);
 
 	//Create K1
 	//Check if MSB is 1
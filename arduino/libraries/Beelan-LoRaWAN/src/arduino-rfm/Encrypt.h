@@ -44,9 +44,17 @@
 */
 
 void Construct_Data_MIC(sBuffer *Buffer, sLoRa_Session *Session_Data, sLoRa_Message *Message);
-void Calculate_MIC(sBuffer *Buffer, unsigned char *Key, sLoRa_Message *Message);
-void Encrypt_Payload(sBuffer *Buffer, unsigned char *Key, sLoRa_Message *Message);
-void Generate_Keys(unsigned char *Key, unsigned char *K1, unsigned char *K2);
+void Calculate_MIC(sBuffer *Buffer, sAES_Expanded_Key *Key, sLoRa_Message *Message);
+void Encrypt_Payload(sBuffer *Buffer, sAES_Expanded_Key *Key, sLoRa_Message *Message);
+void Keystream_Prepare(sKeystream *Keystream, sLoRa_Session *Session_Data);
+bool Keystream_Ready(sKeystream *Keystream, sLoRa_Message *Message);
+bool Keystream_Encrypt(sBuffer *Buffer, sKeystream *Keystream, sLoRa_Message *Message);
+void Keystream_Clear(sKeystream *Keystream);
+void Generate_Keys(sAES_Expanded_Key *Key, unsigned char *K1, unsigned char *K2);
+void CMAC_Key_Init(sCMAC_Key *CMAC_Key, sAES_Expanded_Key *Key);
+void CMAC_Init(sCMAC_Context *Context, sCMAC_Key *CMAC_Key);
+void CMAC_Update(sCMAC_Context *Context, unsigned char *Data, unsigned char Length);
+void CMAC_Final(sCMAC_Context *Context, unsigned char *MIC);
 
 #endif
 
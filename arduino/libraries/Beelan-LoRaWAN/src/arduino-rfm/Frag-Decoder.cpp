@@ -0,0 +1,366 @@
+/****************************************************************************************
+* File:     Frag-Decoder.cpp
+*
+* Forward error correction of the LoRaWAN fragmented data block transport. The block has
+* Nb_Frag uncoded fragments, a coded fragment is the XOR of about half of them, chosen by
+* the parity row of the specification. The uncoded fragments are written to their place in
+* the storage. With the first coded fragment the fragments that are still missing are
+* fixed, each gets a column of a binary matrix. A coded fragment is reduced by the XOR of
+* the fragments that were received and by the rows already in the matrix, what is left is
+* a new row with its first lost fragment as pivot. Its data is kept in the storage at the
+* place of that fragment. Once every lost fragment has a row the matrix is solved from the
+* last row up and every place holds its fragment. A coded fragment that adds no row is not
+* needed, so the coded fragments received is the redundancy the loss took.
+* RAM is a bit per fragment and a triangle of FRAG_MAX_REDUNDANCY^2 / 2 bits, no fragment
+* is kept in RAM.
+****************************************************************************************/
+
+#include <string.h>
+#include "Frag-Decoder.h"
+
+//First bit of row Row in the triangle, the row has the columns from Row on
+#define FRAG_MATRIX_ROW(Row) ((unsigned long)(Row) * FRAG_MAX_REDUNDANCY - (unsigned long)(Row) * ((Row) - 1) / 2)
+
+static bool Frag_Bit(const unsigned char *Bits, unsigned long Index)
+{
+	return (Bits[Index >> 3] >> (Index & 0x07)) & 0x01;
+}
+
+static void Frag_Set_Bit(unsigned char *Bits, unsigned long Index)
+{
+	Bits[Index >> 3] |= 1 << (Index & 0x07);
+}
+
+static void Frag_Clear_Bit(unsigned char *Bits, unsigned long Index)
+{
+	Bits[Index >> 3] &= ~(1 << (Index & 0x07));
+}
+
+static void Frag_Xor(unsigned char *Data, const unsigned char *Other, unsigned char Length)
+{
+	unsigned char i;
+
+	for(i = 0; i < Length; i++)
+	{
+		Data[i] ^= Other[i];
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the next value of the PRBS23 generator of the parity rows
+*
+* Arguments   : Value the last value
+*
+* Return      : unsigned long the next value
+*****************************************************************************************
+*/
+static unsigned long Frag_Prbs23(unsigned long Value)
+{
+	unsigned long B0 = Value & 0x01;
+	unsigned long B1 = (Value & 0x20) >> 5;
+
+	return (Value >> 1) + ((B0 ^ B1) << 22);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the fragments of a coded fragment, the parity row of the
+*				fragmented data block transport specification
+*
+* Arguments   : N the coded fragment, 1 for the first one after the uncoded fragments
+*				Nb_Frag uncoded fragments of the block
+*				*Row pointer to (Nb_Frag + 7) / 8 bytes, bit i is fragment i + 1
+*****************************************************************************************
+*/
+void Frag_Parity_Row(unsigned int N, unsigned int Nb_Frag, unsigned char *Row)
+{
+	unsigned long X = 1 + 1001UL * N;
+	unsigned int Modulo = Nb_Frag;
+	unsigned int Coefficients;
+	unsigned long R;
+
+	memset(Row, 0x00, (Nb_Frag + 7) / 8);
+
+	//A power of two is not a good modulo for the generator
+	if((Nb_Frag & (Nb_Frag - 1)) == 0)
+	{
+		Modulo++;
+	}
+
+	for(Coefficients = 0; Coefficients < Nb_Frag / 2; Coefficients++)
+	{
+		R = Nb_Frag;
+		while(R >= Nb_Frag)
+		{
+			X = Frag_Prbs23(X);
+			R = X % Modulo;
+		}
+		Frag_Set_Bit(Row, R);
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function that starts the decoding of a block
+*
+* Arguments   : *Decoder pointer to sFrag_Decoder struct
+*				Nb_Frag uncoded fragments of the block
+*				Frag_Size bytes of a fragment
+*				Read function that reads from the storage of the block
+*				Write function that writes to the storage of the block
+*
+* Return      : bool false when the block is larger than FRAG_MAX_NB or FRAG_MAX_SIZE allow
+*****************************************************************************************
+*/
+bool Frag_Decoder_Init(sFrag_Decoder *Decoder, unsigned int Nb_Frag, unsigned char Frag_Size, frag_read_t Read, frag_write_t Write)
+{
+	if(Nb_Frag == 0 || Nb_Frag > FRAG_MAX_NB || Frag_Size == 0 || Frag_Size > FRAG_MAX_SIZE)
+	{
+		return false;
+	}
+
+	Decoder->Nb_Frag = Nb_Frag;
+	Decoder->Frag_Size = Frag_Size;
+	Decoder->Status = FRAG_DECODER_ONGOING;
+	Decoder->Nb_Received = 0;
+	Decoder->Nb_Coded = 0;
+	Decoder->Nb_Lost = 0;
+	Decoder->Nb_Rows = 0;
+	Decoder->Coding = 0x00;
+	Decoder->Read = Read;
+	Decoder->Write = Write;
+	memset(Decoder->Received, 0x00, sizeof(Decoder->Received));
+	memset(Decoder->Pivot, 0x00, sizeof(Decoder->Pivot));
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that fixes the lost fragments at the first coded fragment
+*
+* Arguments   : *Decoder pointer to sFrag_Decoder struct
+*
+* Return      : bool false when more fragments are lost than the matrix has columns
+*****************************************************************************************
+*/
+static bool Frag_Decoder_Start(sFrag_Decoder *Decoder)
+{
+	unsigned int i;
+
+	Decoder->Coding = 0x01;
+	Decoder->Nb_Lost = Decoder->Nb_Frag - Decoder->Nb_Received;
+	if(Decoder->Nb_Lost > FRAG_MAX_REDUNDANCY)
+	{
+		return false;
+	}
+
+	Decoder->Nb_Lost = 0;
+	for(i = 0; i < Decoder->Nb_Frag; i++)
+	{
+		if(!Frag_Bit(Decoder->Received, i))
+		{
+			Decoder->Missing[Decoder->Nb_Lost++] = i;
+		}
+	}
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that reduces Row and Data by the rows of the matrix and adds what
+*				is left as a new row, solves the matrix when it has a row for every lost
+*				fragment
+*
+* Arguments   : *Decoder pointer to sFrag_Decoder struct, Row and Data set
+*****************************************************************************************
+*/
+static void Frag_Decoder_Add_Row(sFrag_Decoder *Decoder)
+{
+	unsigned char Size = Decoder->Frag_Size;
+	unsigned int Lost = Decoder->Nb_Lost;
+	unsigned int Pivot;
+	unsigned int j;
+
+	for(Pivot = 0; Pivot < Lost; Pivot++)
+	{
+		if(!Frag_Bit(Decoder->Row, Pivot))
+		{
+			continue;
+		}
+		if(!Frag_Bit(Decoder->Pivot, Pivot))
+		{
+			break;
+		}
+
+		//Take out the row of this pivot, it only has columns from the pivot on
+		for(j = Pivot; j < Lost; j++)
+		{
+			if(Frag_Bit(Decoder->Matrix, FRAG_MATRIX_ROW(Pivot) + j - Pivot))
+			{
+				Decoder->Row[j >> 3] ^= 1 << (j & 0x07);
+			}
+		}
+		Decoder->Read((unsigned long)Decoder->Missing[Pivot] * Size, Decoder->Stored, Size);
+		Frag_Xor(Decoder->Data, Decoder->Stored, Size);
+	}
+
+	//Nothing new in it
+	if(Pivot == Lost)
+	{
+		return;
+	}
+
+	for(j = Pivot; j < Lost; j++)
+	{
+		if(Frag_Bit(Decoder->Row, j))
+		{
+			Frag_Set_Bit(Decoder->Matrix, FRAG_MATRIX_ROW(Pivot) + j - Pivot);
+		}
+		else
+		{
+			Frag_Clear_Bit(Decoder->Matrix, FRAG_MATRIX_ROW(Pivot) + j - Pivot);
+		}
+	}
+	Decoder->Write((unsigned long)Decoder->Missing[Pivot] * Size, Decoder->Data, Size);
+	Frag_Set_Bit(Decoder->Pivot, Pivot);
+	Decoder->Nb_Rows++;
+
+	if(Decoder->Nb_Rows < Lost)
+	{
+		return;
+	}
+
+	//The last row is one fragment, every row above it is its pivot and fragments below
+	for(Pivot = Lost; Pivot-- > 0; )
+	{
+		Decoder->Read((unsigned long)Decoder->Missing[Pivot] * Size, Decoder->Data, Size);
+		for(j = Pivot + 1; j < Lost; j++)
+		{
+			if(Frag_Bit(Decoder->Matrix, FRAG_MATRIX_ROW(Pivot) + j - Pivot))
+			{
+				Decoder->Read((unsigned long)Decoder->Missing[j] * Size, Decoder->Stored, Size);
+				Frag_Xor(Decoder->Data, Decoder->Stored, Size);
+			}
+		}
+		Decoder->Write((unsigned long)Decoder->Missing[Pivot] * Size, Decoder->Data, Size);
+	}
+	Decoder->Status = FRAG_DECODER_DONE;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that takes a fragment of the block
+*
+* Arguments   : *Decoder pointer to sFrag_Decoder struct
+*				N the fragment, 1 to Nb_Frag uncoded and the coded fragments after
+*				*Data pointer to the Frag_Size bytes of the fragment
+*
+* Return      : unsigned char FRAG_DECODER_DONE once the storage holds the whole block,
+*				FRAG_DECODER_FAILED when too many fragments were lost
+*****************************************************************************************
+*/
+unsigned char Frag_Decoder_Process(sFrag_Decoder *Decoder, unsigned int N, const unsigned char *Data)
+{
+	unsigned char Size = Decoder->Frag_Size;
+	unsigned int Lost;
+	unsigned int i;
+	unsigned int k;
+
+	if(Decoder->Status != FRAG_DECODER_ONGOING || N == 0)
+	{
+		return Decoder->Status;
+	}
+
+	if(N <= Decoder->Nb_Frag)
+	{
+		if(Frag_Bit(Decoder->Received, N - 1))
+		{
+			return Decoder->Status;
+		}
+
+		//In its place while there are no rows yet
+		if(Decoder->Coding == 0x00)
+		{
+			Decoder->Write((unsigned long)(N - 1) * Size, Data, Size);
+			Frag_Set_Bit(Decoder->Received, N - 1);
+			Decoder->Nb_Received++;
+			if(Decoder->Nb_Received == Decoder->Nb_Frag)
+			{
+				Decoder->Status = FRAG_DECODER_DONE;
+			}
+			return Decoder->Status;
+		}
+
+		//Late, a row with just this fragment
+		memset(Decoder->Row, 0x00, sizeof(Decoder->Row));
+		for(k = 0; Decoder->Missing[k] != N - 1; k++)
+		{
+		}
+		Frag_Set_Bit(Decoder->Row, k);
+		memcpy(Decoder->Data, Data, Size);
+		Decoder->Nb_Received++;
+		Frag_Decoder_Add_Row(Decoder);
+		return Decoder->Status;
+	}
+
+	Decoder->Nb_Coded++;
+	if(Decoder->Coding == 0x00 && !Frag_Decoder_Start(Decoder))
+	{
+		Decoder->Status = FRAG_DECODER_FAILED;
+		return Decoder->Status;
+	}
+	Lost = Decoder->Nb_Lost;
+
+	//Fragments that were received are taken out, the lost ones are the columns of the row
+	Frag_Parity_Row(N - Decoder->Nb_Frag, Decoder->Nb_Frag, Decoder->Parity);
+	memcpy(Decoder->Data, Data, Size);
+	memset(Decoder->Row, 0x00, sizeof(Decoder->Row));
+	k = 0;
+	for(i = 0; i < Decoder->Nb_Frag; i++)
+	{
+		while(k < Lost && Decoder->Missing[k] < i)
+		{
+			k++;
+		}
+		if(!Frag_Bit(Decoder->Parity, i))
+		{
+			continue;
+		}
+		if(k < Lost && Decoder->Missing[k] == i)
+		{
+			Frag_Set_Bit(Decoder->Row, k);
+		}
+		else
+		{
+			Decoder->Read((unsigned long)i * Size, Decoder->Stored, Size);
+			Frag_Xor(Decoder->Data, Decoder->Stored, Size);
+		}
+	}
+
+	Frag_Decoder_Add_Row(Decoder);
+	return Decoder->Status;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the fragments that are still missing
+*
+* Arguments   : *Decoder pointer to sFrag_Decoder struct
+*
+* Return      : unsigned int uncoded fragments not received, after the first coded fragment
+*				the lost fragments without a row
+*****************************************************************************************
+*/
+unsigned int Frag_Decoder_Missing(sFrag_Decoder *Decoder)
+{
+	if(Decoder->Status == FRAG_DECODER_DONE)
+	{
+		return 0;
+	}
+	if(Decoder->Coding == 0x00)
+	{
+		return Decoder->Nb_Frag - Decoder->Nb_Received;
+	}
+	return Decoder->Nb_Lost - Decoder->Nb_Rows;
+}
@@ -0,0 +1,88 @@
+/****************************************************************************************
+* File:     Frag-Decoder.h
+*
+* Forward error correction of the LoRaWAN fragmented data block transport. Rebuilds lost
+* fragments from the XOR parity of the coded fragments. Only needs a read and a write
+* function for the storage of the block, so it also runs on a host with a RAM block.
+****************************************************************************************/
+
+#ifndef FRAG_DECODER_H
+#define FRAG_DECODER_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Fragments of a data block, one bit each
+#ifndef FRAG_MAX_NB
+#define FRAG_MAX_NB 2048
+#endif
+
+//Bytes of a fragment
+#ifndef FRAG_MAX_SIZE
+#define FRAG_MAX_SIZE 232
+#endif
+
+//Lost fragments the parity can rebuild, the matrix takes FRAG_MAX_REDUNDANCY^2 / 16 bytes
+#ifndef FRAG_MAX_REDUNDANCY
+#define FRAG_MAX_REDUNDANCY 128
+#endif
+
+//Return values of Frag_Decoder_Process
+#define FRAG_DECODER_ONGOING 0x00
+#define FRAG_DECODER_DONE 0x01
+#define FRAG_DECODER_FAILED 0x02		//More fragments lost than FRAG_MAX_REDUNDANCY
+
+/*
+********************************************************************************************
+* TYPE DEFINITION
+********************************************************************************************
+*/
+
+//Storage of the block, Offset in bytes from the start of the block
+typedef void (*frag_read_t)(unsigned long Offset, unsigned char *Data, unsigned char Length);
+typedef void (*frag_write_t)(unsigned long Offset, const unsigned char *Data, unsigned char Length);
+
+typedef struct {
+	unsigned int Nb_Frag;				//Uncoded fragments of the block
+	unsigned char Frag_Size;
+	unsigned char Status;				//FRAG_DECODER_ONGOING, _DONE or _FAILED
+	unsigned int Nb_Received;			//Uncoded fragments received
+	unsigned int Nb_Coded;				//Coded fragments received
+	unsigned int Nb_Lost;				//Fragments missing at the first coded fragment
+	unsigned int Nb_Rows;				//Lost fragments with a row in the matrix
+	unsigned char Coding;				//0x01 from the first coded fragment on
+	frag_read_t Read;
+	frag_write_t Write;
+	unsigned char Received[(FRAG_MAX_NB + 7) / 8];				//Uncoded fragments received
+	unsigned short Missing[FRAG_MAX_REDUNDANCY];				//Lost fragments in order
+	unsigned char Pivot[(FRAG_MAX_REDUNDANCY + 7) / 8];			//Rows of the matrix that are set
+	unsigned char Matrix[(FRAG_MAX_REDUNDANCY * (FRAG_MAX_REDUNDANCY + 1) / 2 + 7) / 8];
+	unsigned char Parity[(FRAG_MAX_NB + 7) / 8];				//Parity of a coded fragment
+	unsigned char Row[(FRAG_MAX_REDUNDANCY + 7) / 8];			//Parity over the lost fragments
+	unsigned char Data[FRAG_MAX_SIZE];
+	unsigned char Stored[FRAG_MAX_SIZE];
+} sFrag_Decoder;
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+bool Frag_Decoder_Init(sFrag_Decoder *Decoder, unsigned int Nb_Frag, unsigned char Frag_Size, frag_read_t Read, frag_write_t Write);
+unsigned char Frag_Decoder_Process(sFrag_Decoder *Decoder, unsigned int N, const unsigned char *Data);
+unsigned int Frag_Decoder_Missing(sFrag_Decoder *Decoder);
+void Frag_Parity_Row(unsigned int N, unsigned int Nb_Frag, unsigned char *Row);
+
+#endif
@@ -0,0 +1,413 @@
+/****************************************************************************************
+* File:     Fragmentation.cpp
+*
+* Fragmented data block transport of LoRaWAN on FRAG_PORT, enabled with FUOTA in Config.h.
+* The network sets up a session with FragSessionSetupReq and sends the block as DataFragment
+* commands, the uncoded fragments and after them coded ones. Frag-Decoder.cpp rebuilds the
+* fragments that were lost from the coded ones, so the network does not have to repeat them.
+* One session at a time. The block goes to the flash after the row of FRAG_FLASH_ADDRESS.
+* Writes collect in a copy of one row that is written when a write goes to another row, so
+* a row is erased about once for the uncoded fragments. A write stops the CPU for the erase
+* and the four pages of the row. Frag_Install checks the block with a CRC-32 and writes the
+* sFrag_Image record to the row of FRAG_FLASH_ADDRESS, the bootloader copies the block to
+* the application and erases the record.
+****************************************************************************************/
+
+#include <string.h>
+#include "Fragmentation.h"
+
+#ifdef FUOTA
+
+#include <NVMClass.h>
+
+#define FRAG_BLOCK_ADDRESS (FRAG_FLASH_ADDRESS + NVM_ROW_SIZE)
+
+typedef struct {
+	unsigned char Active;
+	unsigned char Done;					//0x01 the block is complete and in the flash
+	unsigned char Index;				//FragIndex
+	unsigned char Padding;				//Bytes after the block in the last fragment
+	unsigned char Descriptor[4];
+} sFrag_Session;
+
+static NVMClass NVM;
+static sFrag_Session Frag_Session;
+static sFrag_Decoder Frag_Decoder;
+
+//Copy of the row that is written, 0 no row
+static unsigned char Frag_Row[NVM_ROW_SIZE];
+static uint32_t Frag_Row_Address = 0;
+static bool Frag_Row_Dirty = false;
+
+/*
+*****************************************************************************************
+* Description : Function that writes the copy of the row to the flash when it changed
+*****************************************************************************************
+*/
+static void Frag_Flash_Flush(void)
+{
+	unsigned int i;
+
+	if(!Frag_Row_Dirty)
+	{
+		return;
+	}
+
+	NVM.erase_row(Frag_Row_Address);
+	for(i = 0; i < NVM_ROW_SIZE; i += NVM_PAGE_SIZE)
+	{
+		NVM.write_page(Frag_Row_Address + i, &Frag_Row[i], NVM_PAGE_SIZE);
+	}
+	Frag_Row_Dirty = false;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that reads from the block, the copy of the row has the newest data
+*
+* Arguments   : Offset from the start of the block
+*				*Data pointer to the buffer
+*				Length bytes to read
+*****************************************************************************************
+*/
+static void Frag_Flash_Read(unsigned long Offset, unsigned char *Data, unsigned char Length)
+{
+	uint32_t Address = FRAG_BLOCK_ADDRESS + Offset;
+	uint32_t Row;
+	unsigned int Part;
+
+	while(Length != 0)
+	{
+		Row = Address & ~(uint32_t)(NVM_ROW_SIZE - 1);
+		Part = Row + NVM_ROW_SIZE - Address;
+		if(Part > Length)
+		{
+			Part = Length;
+		}
+
+		if(Row == Frag_Row_Address)
+		{
+			memcpy(Data, &Frag_Row[Address - Row], Part);
+		}
+		else
+		{
+			NVM.read(Address, Data, Part);
+		}
+
+		Address += Part;
+		Data += Part;
+		Length -= Part;
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function that writes to the block through the copy of the row
+*
+* Arguments   : Offset from the start of the block
+*				*Data pointer to the data
+*				Length bytes to write
+*****************************************************************************************
+*/
+static void Frag_Flash_Write(unsigned long Offset, const unsigned char *Data, unsigned char Length)
+{
+	uint32_t Address = FRAG_BLOCK_ADDRESS + Offset;
+	uint32_t Row;
+	unsigned int Part;
+
+	while(Length != 0)
+	{
+		Row = Address & ~(uint32_t)(NVM_ROW_SIZE - 1);
+		Part = Row + NVM_ROW_SIZE - Address;
+		if(Part > Length)
+		{
+			Part = Length;
+		}
+
+		if(Row != Frag_Row_Address)
+		{
+			Frag_Flash_Flush();
+			NVM.read(Row, Frag_Row, NVM_ROW_SIZE);
+			Frag_Row_Address = Row;
+		}
+		memcpy(&Frag_Row[Address - Row], Data, Part);
+		Frag_Row_Dirty = true;
+
+		Address += Part;
+		Data += Part;
+		Length -= Part;
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function that continues a CRC-32, reflected polynomial 0xEDB88320
+*
+* Arguments   : CRC the CRC so far, 0 at the start
+*				*Data pointer to the data
+*				Length bytes of data
+*
+* Return      : uint32_t the CRC
+*****************************************************************************************
+*/
+static uint32_t Frag_CRC32(uint32_t CRC, const unsigned char *Data, unsigned int Length)
+{
+	unsigned char Bit;
+
+	CRC = ~CRC;
+	while(Length--)
+	{
+		CRC ^= *Data++;
+		for(Bit = 0; Bit < 8; Bit++)
+		{
+			CRC = (CRC >> 1) ^ (0xEDB88320UL & (0 - (CRC & 0x01)));
+		}
+	}
+	return ~CRC;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that starts a session, the record of a block that was not installed
+*				yet is erased so a part of the new block is never installed
+*
+* Arguments   : *Request pointer to the FragSessionSetupReq after the CID
+*
+* Return      : unsigned char StatusBitMask of the answer
+*****************************************************************************************
+*/
+static unsigned char Frag_Setup(const unsigned char *Request)
+{
+	unsigned char Index = (Request[0] >> 4) & 0x03;
+	unsigned int Nb_Frag = Request[1] | (Request[2] << 8);
+	unsigned char Frag_Size = Request[3];
+	unsigned char Algorithm = (Request[4] >> 3) & 0x07;
+	unsigned char Status = Index << 6;
+
+	//Only the parity rows of the specification
+	if(Algorithm != 0)
+	{
+		Status |= 0x01;
+	}
+	if(Nb_Frag > FRAG_MAX_NB || Frag_Size > FRAG_MAX_SIZE || (unsigned long)Nb_Frag * Frag_Size > FRAG_FLASH_SIZE)
+	{
+		Status |= 0x02;
+	}
+	if(Frag_Session.Active == 0x01 && Frag_Session.Done == 0x00 && Frag_Session.Index != Index)
+	{
+		Status |= 0x04;
+	}
+	if((Status & 0x0F) != 0x00)
+	{
+		return Status;
+	}
+	if(!Frag_Decoder_Init(&Frag_Decoder, Nb_Frag, Frag_Size, Frag_Flash_Read, Frag_Flash_Write))
+	{
+		return Status | 0x02;
+	}
+
+	Frag_Session.Active = 0x01;
+	Frag_Session.Done = 0x00;
+	Frag_Session.Index = Index;
+	Frag_Session.Padding = Request[5];
+	memcpy(Frag_Session.Descriptor, &Request[6], 4);
+
+	Frag_Row_Address = 0;
+	Frag_Row_Dirty = false;
+	NVM.erase_row(FRAG_FLASH_ADDRESS);
+
+	return Status;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that handles the commands of a downlink on FRAG_PORT
+*
+* Arguments   : *Data pointer to the FRMPayload
+*				Length bytes of the FRMPayload
+*				*Answer pointer to FRAG_ANSWER_SIZE bytes for the answers
+*				*Answer_Length pointer to the bytes in Answer, the answers are added
+*
+* Return      : bool true when the downlink completed the block
+*****************************************************************************************
+*/
+bool Frag_Downlink(const unsigned char *Data, unsigned char Length, unsigned char *Answer, unsigned char *Answer_Length)
+{
+	unsigned char Ans[5];
+	unsigned char Ans_Length;
+	unsigned char Index;
+	unsigned int Received;
+	unsigned int Missing;
+	unsigned int N;
+	bool Done = false;
+
+	while(Length != 0)
+	{
+		Ans[0] = Data[0];
+		Ans_Length = 0;
+
+		//PackageVersionReq
+		if(Data[0] == 0x00)
+		{
+			Ans[1] = FRAG_PACKAGE_ID;
+			Ans[2] = FRAG_PACKAGE_VERSION;
+			Ans_Length = 3;
+			Data += 1;
+			Length -= 1;
+		}
+		//FragSessionStatusReq, without Participants only a session with missing fragments answers
+		else if(Data[0] == 0x01 && Length >= 2)
+		{
+			Index = (Data[1] >> 1) & 0x03;
+			if(Frag_Session.Active == 0x01 && Frag_Session.Index == Index)
+			{
+				Missing = Frag_Decoder_Missing(&Frag_Decoder);
+				if((Data[1] & 0x01) || Missing != 0)
+				{
+					Received = Frag_Decoder.Nb_Received + Frag_Decoder.Nb_Coded;
+					Ans[1] = Received & 0xFF;
+					Ans[2] = (Index << 6) | ((Received >> 8) & 0x3F);
+					Ans[3] = (Missing > 255) ? 255 : Missing;
+					Ans[4] = (Frag_Decoder.Status == FRAG_DECODER_FAILED) ? 0x01 : 0x00;
+					Ans_Length = 5;
+				}
+			}
+			Data += 2;
+			Length -= 2;
+		}
+		//FragSessionSetupReq
+		else if(Data[0] == 0x02 && Length >= 11)
+		{
+			Ans[1] = Frag_Setup(&Data[1]);
+			Ans_Length = 2;
+			Data += 11;
+			Length -= 11;
+		}
+		//FragSessionDeleteReq
+		else if(Data[0] == 0x03 && Length >= 2)
+		{
+			Index = Data[1] & 0x03;
+			Ans[1] = Index;
+			if(Frag_Session.Active == 0x01 && Frag_Session.Index == Index)
+			{
+				Frag_Session.Active = 0x00;
+			}
+			else
+			{
+				Ans[1] |= 0x04;
+			}
+			Ans_Length = 2;
+			Data += 2;
+			Length -= 2;
+		}
+		//DataFragment, the rest of the downlink
+		else if(Data[0] == 0x08 && Length >= 3)
+		{
+			Index = Data[2] >> 6;
+			N = Data[1] | ((Data[2] & 0x3F) << 8);
+			if(Frag_Session.Active == 0x01 && Frag_Session.Index == Index && Frag_Session.Done == 0x00 && Length - 3 >= Frag_Decoder.Frag_Size)
+			{
+				if(Frag_Decoder_Process(&Frag_Decoder, N, &Data[3]) == FRAG_DECODER_DONE)
+				{
+					Frag_Flash_Flush();
+					Frag_Session.Done = 0x01;
+					Done = true;
+				}
+			}
+			Length = 0;
+		}
+		//Unknown command, its length is not known
+		else
+		{
+			Length = 0;
+		}
+
+		if(Ans_Length != 0 && *Answer_Length + Ans_Length <= FRAG_ANSWER_SIZE)
+		{
+			memcpy(&Answer[*Answer_Length], Ans, Ans_Length);
+			*Answer_Length += Ans_Length;
+		}
+	}
+
+	return Done;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the size of the block of the session
+*
+* Return      : unsigned long bytes of the block without the padding
+*****************************************************************************************
+*/
+unsigned long Frag_Size(void)
+{
+	return (unsigned long)Frag_Decoder.Nb_Frag * Frag_Decoder.Frag_Size - Frag_Session.Padding;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the Descriptor of FragSessionSetupReq, 4 bytes the
+*				application gives a meaning
+*
+* Return      : const unsigned char pointer to the descriptor
+*****************************************************************************************
+*/
+const unsigned char *Frag_Descriptor(void)
+{
+	return Frag_Session.Descriptor;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that gives the fragments of the session. Lost against Coded is the
+*				redundancy the loss took, Lost can be FRAG_MAX_REDUNDANCY at most
+*
+* Arguments   : *Nb_Frag pointer to the uncoded fragments of the block
+*				*Received pointer to the uncoded fragments received
+*				*Lost pointer to the fragments missing at the first coded fragment
+*				*Coded pointer to the coded fragments received
+*****************************************************************************************
+*/
+void Frag_Stats(unsigned int *Nb_Frag, unsigned int *Received, unsigned int *Lost, unsigned int *Coded)
+{
+	*Nb_Frag = Frag_Decoder.Nb_Frag;
+	*Received = Frag_Decoder.Nb_Received;
+	*Lost = Frag_Decoder.Nb_Lost;
+	*Coded = Frag_Decoder.Nb_Coded;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that hands the complete block to the bootloader with its record
+*
+* Return      : bool false when there is no complete block
+*****************************************************************************************
+*/
+bool Frag_Install(void)
+{
+	sFrag_Image Image;
+	unsigned char Buffer[NVM_PAGE_SIZE];
+	unsigned long Offset;
+	unsigned int Part;
+
+	if(Frag_Session.Active != 0x01 || Frag_Session.Done != 0x01)
+	{
+		return false;
+	}
+
+	Image.Magic = FRAG_IMAGE_MAGIC;
+	Image.Size = Frag_Size();
+	Image.CRC = 0;
+	for(Offset = 0; Offset < Image.Size; Offset += Part)
+	{
+		Part = (Image.Size - Offset > NVM_PAGE_SIZE) ? NVM_PAGE_SIZE : Image.Size - Offset;
+		NVM.read(FRAG_BLOCK_ADDRESS + Offset, Buffer, Part);
+		Image.CRC = Frag_CRC32(Image.CRC, Buffer, Part);
+	}
+	Image.Check = ~(Image.Magic ^ Image.Size ^ Image.CRC);
+
+	NVM.erase_row(FRAG_FLASH_ADDRESS);
+	return NVM.write_page(FRAG_FLASH_ADDRESS, &Image, sizeof(Image)) == NVM_OK;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/****************************************************************************************
+* File:     Fragmentation.h
+*
+* Fragmented data block transport of LoRaWAN on FRAG_PORT, enabled with FUOTA in Config.h.
+* The block is stored in flash where the bootloader installs it from.
+****************************************************************************************/
+
+#ifndef FRAGMENTATION_H
+#define FRAGMENTATION_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include <stdint.h>
+#include "Frag-Decoder.h"
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Port of the package, identifier 3 version 1
+#define FRAG_PORT 201
+#define FRAG_PACKAGE_ID 3
+#define FRAG_PACKAGE_VERSION 1
+
+//Row with the sFrag_Image record of a block to install, the block follows in the next rows.
+//Must be STAGING of bootloader/src/cfg.h, the application has to end below it
+#ifndef FRAG_FLASH_ADDRESS
+#define FRAG_FLASH_ADDRESS 0x00020F00
+#endif
+
+//Start of the application, APPLICATION of bootloader/src/cfg.h
+#ifndef FRAG_APPLICATION_ADDRESS
+#define FRAG_APPLICATION_ADDRESS 0x00002000
+#endif
+
+//Largest block in bytes, the bootloader installs no image above STAGING - APPLICATION
+#ifndef FRAG_FLASH_SIZE
+#define FRAG_FLASH_SIZE (FRAG_FLASH_ADDRESS - FRAG_APPLICATION_ADDRESS)
+#endif
+
+//Answers of one downlink, they are sent with one uplink on FRAG_PORT
+#define FRAG_ANSWER_SIZE 16
+
+#define FRAG_IMAGE_MAGIC 0x544F5546UL		//"FUOT"
+
+/*
+********************************************************************************************
+* TYPE DEFINITION
+********************************************************************************************
+*/
+
+//Record of a block to install, Check is ~(Magic ^ Size ^ CRC)
+typedef struct {
+	uint32_t Magic;
+	uint32_t Size;						//Bytes of the block
+	uint32_t CRC;						//CRC-32 of the block
+	uint32_t Check;
+} sFrag_Image;
+
+typedef void (*lora_frag_callback_t)(unsigned long Size, const unsigned char *Descriptor);
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+bool Frag_Downlink(const unsigned char *Data, unsigned char Length, unsigned char *Answer, unsigned char *Answer_Length);
+unsigned long Frag_Size(void);
+const unsigned char *Frag_Descriptor(void);
+void Frag_Stats(unsigned int *Nb_Frag, unsigned int *Received, unsigned int *Lost, unsigned int *Coded);
+bool Frag_Install(void);
+
+#endif
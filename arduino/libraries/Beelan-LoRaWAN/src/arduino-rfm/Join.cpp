@@ -0,0 +1,133 @@
+/****************************************************************************************
+* File:     Join.cpp
+*
+* Schedule of the JoinRequests of an OTAA join that runs in the background.
+* After a JoinRequest without JoinAccept the next one waits a backoff that starts at
+* JOIN_BACKOFF_MIN and doubles up to JOIN_BACKOFF_MAX. The wait is random between half the
+* backoff and the backoff, so nodes that lost the network at the same time spread out
+* instead of joining in step. The first JoinRequest has a random delay for the same reason.
+* The wait is at least the off time of the retransmission duty cycle of LoRaWAN for
+* JoinRequests: 1% in the first hour of the join, 0.1% up to 11 hours and 0.01% after.
+* Every second JoinRequest goes one data rate lower, after DR0 the first one is used again.
+****************************************************************************************/
+
+#include "Join.h"
+#include "Band-Plan.h"
+#include "Arduino.h"
+
+/*
+*****************************************************************************************
+* Description : Function that starts a join
+*
+* Arguments   : *Join pointer to sJoin struct
+*				Tries JoinRequests before the join fails, 0 until it joins
+*				Jitter ms the first JoinRequest is delayed at most, 0 sends it right away
+*				*LoRa_Settings pointer to sSettings struct, the data rate is the first one
+*****************************************************************************************
+*/
+void Join_Init(sJoin *Join, unsigned int Tries, unsigned long Jitter, sSettings *LoRa_Settings)
+{
+	Join->Active = 0x01;
+	Join->Joined = 0x00;
+	Join->Datarate = LoRa_Settings->Datarate_Tx;
+	Join->Attempts = 0;
+	Join->Tries = Tries;
+	Join->Start = millis();
+	Join->Next = Join->Start + ((Jitter != 0) ? random(Jitter) : 0);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that checks if the next JoinRequest of the join is due
+*
+* Arguments   : *Join pointer to sJoin struct
+*
+* Return      : bool true when a JoinRequest should be sent
+*****************************************************************************************
+*/
+bool Join_Due(sJoin *Join)
+{
+	return Join->Active == 0x01 && (long)(millis() - Join->Next) >= 0;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that sets the data rate of the next JoinRequest
+*
+* Arguments   : *Join pointer to sJoin struct
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+void Join_Datarate(sJoin *Join, sSettings *LoRa_Settings)
+{
+	Band_Set_Datarate(Join->Datarate - (Join->Attempts / 2) % (Join->Datarate + 1), LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call when a JoinRequest got no JoinAccept, schedules the next
+*
+* Arguments   : *Join pointer to sJoin struct
+*				Time_On_Air us of the JoinRequest
+*				*LoRa_Settings pointer to sSettings struct
+*
+* Return      : bool true when the join failed after its tries, the data rate is restored
+*****************************************************************************************
+*/
+bool Join_Failed(sJoin *Join, unsigned long Time_On_Air, sSettings *LoRa_Settings)
+{
+	unsigned long Backoff = JOIN_BACKOFF_MIN;
+	unsigned long Wait;
+	unsigned long Off_Time;
+	unsigned long Elapsed = millis() - Join->Start;
+	unsigned int i;
+
+	Join->Attempts++;
+
+	if(Join->Tries != 0 && Join->Attempts >= Join->Tries)
+	{
+		Join->Active = 0x00;
+		Band_Set_Datarate(Join->Datarate, LoRa_Settings);
+		return true;
+	}
+
+	for(i = 1; i < Join->Attempts && Backoff < JOIN_BACKOFF_MAX; i++)
+	{
+		Backoff *= 2;
+	}
+	if(Backoff > JOIN_BACKOFF_MAX)
+	{
+		Backoff = JOIN_BACKOFF_MAX;
+	}
+	Wait = Backoff / 2 + random(Backoff / 2 + 1);
+
+	//Retransmission duty cycle of the JoinRequests
+	if(Elapsed < 3600000UL)
+	{
+		Off_Time = Time_On_Air / 1000 * 100;
+	}
+	else if(Elapsed < 11 * 3600000UL)
+	{
+		Off_Time = Time_On_Air / 1000 * 1000;
+	}
+	else
+	{
+		Off_Time = Time_On_Air / 1000 * 10000;
+	}
+
+	Join->Next = millis() + ((Wait > Off_Time) ? Wait : Off_Time);
+	return false;
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call when a JoinAccept set up the session
+*
+* Arguments   : *Join pointer to sJoin struct
+*****************************************************************************************
+*/
+void Join_Accepted(sJoin *Join)
+{
+	Join->Active = 0x00;
+	Join->Joined = 0x01;
+}
@@ -0,0 +1,63 @@
+/****************************************************************************************
+* File:     Join.h
+*
+* Schedule of the JoinRequests of an OTAA join that runs in the background
+****************************************************************************************/
+
+#ifndef JOIN_H
+#define JOIN_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Struct.h"
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Backoff in ms after the first JoinRequest without JoinAccept, doubles for every next one
+#ifndef JOIN_BACKOFF_MIN
+#define JOIN_BACKOFF_MIN 15000UL
+#endif
+
+//Largest backoff in ms
+#ifndef JOIN_BACKOFF_MAX
+#define JOIN_BACKOFF_MAX 3600000UL
+#endif
+
+/*
+********************************************************************************************
+* TYPE DEFINITION
+********************************************************************************************
+*/
+
+typedef struct {
+    unsigned char Active;       //0x01 while JoinRequests are sent
+    unsigned char Joined;       //0x01 the last join got a JoinAccept
+    unsigned char Datarate;     //Data rate of the first JoinRequest
+    unsigned int Attempts;      //JoinRequests sent without JoinAccept
+    unsigned int Tries;         //JoinRequests before the join fails, 0 no limit
+    unsigned long Start;        //millis() of the start of the join, for the join duty cycle
+    unsigned long Next;         //millis() of the next JoinRequest
+} sJoin;
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+void Join_Init(sJoin *Join, unsigned int Tries, unsigned long Jitter, sSettings *LoRa_Settings);
+bool Join_Due(sJoin *Join);
+void Join_Datarate(sJoin *Join, sSettings *LoRa_Settings);
+bool Join_Failed(sJoin *Join, unsigned long Time_On_Air, sSettings *LoRa_Settings);
+void Join_Accepted(sJoin *Join);
+
+#endif
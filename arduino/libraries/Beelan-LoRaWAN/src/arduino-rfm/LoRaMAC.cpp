@@ -31,10 +31,15 @@
 */
 
 #include <RF.h>
+#include <RFTiming.h>
 #include "AES-128.h"
 #include "RFM95.h"
 #include "Encrypt.h"
 #include "LoRaMAC.h"
+#include "NVM-Counter.h"
+#include "Duty-Cycle.h"
+#include "MAC-Commands.h"
+#include "Band-Plan.h"
 #include "Struct.h"
 #include "Config.h"
 #include "Arduino.h"
@@ -45,81 +50,318 @@
 *****************************************************************************************
 */
 
+static void LORA_Build_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *LoRa_Settings, sBuffer *RFM_Package);
+static void LORA_Next_Frame(sLoRa_Session *Session_Data, sSettings *LoRa_Settings);
+static void LORA_Hop_Channel(sSettings *LoRa_Settings);
+static message_t LORA_Read_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_Message *Message, sSettings *LoRa_Settings);
+static message_t LORA_Read_Join_Accept(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message, sSettings *LoRa_Settings);
+static void LoRa_Build_JoinReq(sLoRa_OTAA *OTAA_Data, sBuffer *RFM_Package);
+static void LORA_Timing(unsigned char Datarate, rf_timing_t *Timing);
+static void LORA_Rx_Window(unsigned char Datarate, unsigned long Delay, unsigned long *Open, unsigned short *Symbols);
+
 
 /*
 *****************************************************************************************
 * Description : Function that handles a send and receive cycle with timing for receive slots.
 *				This function is only used for Class A motes. The wait times are tested with
 *				the iot.semtech.com site.
+*				The cycle is a state machine that never waits: every call checks the DIO
+*				events and the receive delays, moves to the next state when one of them
+*				fired and returns. Call it from the main loop until the state is LORA_IDLE.
+*
+*				LORA_IDLE     -> LORA_TX        on a new RFM command, transmission started. A JOIN
+*				                                command sends a JoinRequest, its windows follow
+*				                                JOIN_ACCEPT_DELAY and end in LORA_EVENT_JOINED or
+*				                                LORA_EVENT_JOIN_FAILED. RETRANSMIT sends the last
+*				                                uplink again with the same frame counter
+*				LORA_TX       -> LORA_WAIT_RX1  on TxDone (DIO0)
+*				LORA_WAIT_RX1 -> LORA_RX1       when the RX1 window is due, Receive_Delay_1 after
+*				                                the TxDone interrupt less the margin of
+*				                                LORA_Rx_Window. It follows the RX_DELAY of the network,
+*				                                the data rate is the one of the uplink less RX1DROffset
+*				LORA_RX1      -> LORA_DONE      on a valid downlink (DIO0)
+*				LORA_RX1      -> LORA_WAIT_RX2  on RxTimeout (DIO1) or an invalid package
+*				LORA_WAIT_RX2 -> LORA_RX2       when the RX2 window is due, Receive_Delay_2 after
+*				                                the TxDone interrupt less the margin, on the data rate
+*				                                and channel of RX2
+*				LORA_RX2      -> LORA_DONE      on RxDone (DIO0) or RxTimeout (DIO1)
+*				LORA_DONE     -> LORA_IDLE
+*
+*				For benchmarks the cycle keeps the time spent in this function for the frame,
+*				how late each receive window was opened and how long the RFM was receiving.
 *
-* Arguments   : *Data_Tx pointer to tranmit buffer
+* Arguments   : *Cycle pointer to sLoRa_Cycle struct with the state of the cycle
+*				*Data_Tx pointer to tranmit buffer
 *				*Data_Rx pointer to receive buffer
 *				*RFM_Command pointer to current RFM state
 *				*Session_Data pointer to sLoRa_Session sturct
 *				*OTAA_Data pointer to sLoRa_OTAA struct
 *				*Message_Rx pointer to sLoRa_Message struct used for the received message information
 *				*LoRa_Settings pointer to sSetting struct
+*
+* Return      : lora_event_t event that happened during this call, LORA_EVENT_NONE if nothing
 *****************************************************************************************
 */
-void LORA_Cycle(sBuffer *Data_Tx, sBuffer *Data_Rx, RFM_command_t *RFM_Command, sLoRa_Session *Session_Data,
+lora_event_t LORA_Cycle(sLoRa_Cycle *Cycle, sBuffer *Data_Tx, sBuffer *Data_Rx, RFM_command_t *RFM_Command, sLoRa_Session *Session_Data,
 				sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message_Rx, sSettings *LoRa_Settings)
 {
-	static const unsigned int Receive_Delay_1 = 500;
-	static const unsigned int Receive_Delay_2 = 1000;
-	unsigned long prevTime = 0;
-
-	//Transmit
-	if (*RFM_Command == NEW_RFM_COMMAND)
+	//us from TxDone, RECEIVE_DELAY2 and JOIN_ACCEPT_DELAY2 are one second later
+	const unsigned long Receive_Delay_1 = (Cycle->Command == JOIN ? LORA_JOIN_ACCEPT_DELAY : LoRa_Settings->Rx_Delay) * 1000000UL;
+	const unsigned long Receive_Delay_2 = Receive_Delay_1 + 1000000UL;
+	lora_event_t Event = LORA_EVENT_NONE;
+	message_t Message_Status;
+	unsigned long Start = micros();
+
+	switch (Cycle->State)
 	{
-		//Lora send data
-		LORA_Send_Data(Data_Tx, Session_Data, LoRa_Settings);
-		prevTime = millis();
-		*RFM_Command = NO_RFM_COMMAND;
+		case LORA_IDLE:
+			//Transmit
+			if (*RFM_Command == NEW_RFM_COMMAND || *RFM_Command == JOIN || *RFM_Command == RETRANSMIT)
+			{
+				Cycle->Cpu_Time = 0;
+				Cycle->Rx_Error[0] = 0;
+				Cycle->Rx_Error[1] = 0;
+				Cycle->Rx_On_Time[0] = 0;
+				Cycle->Rx_On_Time[1] = 0;
+				Cycle->Command = *RFM_Command;
+
+				//RX1 is on the downlink channel of this uplink, before it hops
+				Cycle->Rx_Channel[0] = Band_Rx1_Channel(BAND_PLAN, LoRa_Settings->Channel_Tx);
+				Cycle->Rx_Channel[1] = BAND_RX2_CHANNEL;
+
+				if (*RFM_Command == JOIN)
+				{
+					LoRa_Start_JoinReq(OTAA_Data, LoRa_Settings);
+				}
+				else if (*RFM_Command == RETRANSMIT)
+				{
+					LORA_Start_Resend_Data(&Cycle->Package, LoRa_Settings);
+				}
+				else
+				{
+					//Lora send data
+					LORA_Start_Send_Data(Data_Tx, Session_Data, LoRa_Settings, &Cycle->Package);
+				}
+				*RFM_Command = NO_RFM_COMMAND;
+				Cycle->State = LORA_TX;
+
+				//RX1 follows the data rate of this uplink, RX2 has the data rate of the network.
+				//The JoinAccept comes on the defaults, the settings are of the last session
+				if (Cycle->Command == JOIN)
+				{
+					Cycle->Rx_Datarate[0] = Band_Rx1_Datarate(BAND_PLAN, LoRa_Settings->Datarate_Tx, 0x00);
+					Cycle->Rx_Datarate[1] = BAND_PLAN.Datarate_Rx2;
+				}
+				else
+				{
+					Cycle->Rx_Datarate[0] = Band_Rx1_Datarate(BAND_PLAN, LoRa_Settings->Datarate_Tx, LoRa_Settings->Rx1_DR_Offset);
+					Cycle->Rx_Datarate[1] = LoRa_Settings->Datarate_Rx2;
+				}
+			}
+			break;
+
+		case LORA_TX:
+			//Wait for TxDone
+			if (RFM_Get_Events(RFM_EVENT_DIO0))
+			{
+				RFM_Finish_Send_Package(LoRa_Settings);
+				Cycle->Tx_Done_Time = millis();
+				Cycle->Tx_Done_Micros = RFM_Get_Event_Time();
+
+				LORA_Rx_Window(Cycle->Rx_Datarate[0], Receive_Delay_1, &Cycle->Rx_Open[0], &Cycle->Rx_Symbols[0]);
+				LORA_Rx_Window(Cycle->Rx_Datarate[1], Receive_Delay_2, &Cycle->Rx_Open[1], &Cycle->Rx_Symbols[1]);
+				Cycle->State = LORA_WAIT_RX1;
+				Event = LORA_EVENT_TX_DONE;
+			}
+			break;
+
+		case LORA_WAIT_RX1:
+			//Wait for rx1 window
+			if ((micros() - Cycle->Tx_Done_Micros) >= Cycle->Rx_Open[0])
+			{
+				RFM_Start_Single_Receive(Cycle->Rx_Datarate[0], Cycle->Rx_Channel[0], Cycle->Rx_Symbols[0]);
+				Cycle->Rx_Error[0] = (long)(micros() - Cycle->Tx_Done_Micros - Cycle->Rx_Open[0]);
+				Cycle->State = LORA_RX1;
+			}
+			break;
+
+		case LORA_RX1:
+			Message_Status = RFM_Receive_Status();
+
+			if (Message_Status != NO_MESSAGE)
+			{
+				Cycle->Rx_On_Time[0] = RFM_Get_Event_Time() - Cycle->Tx_Done_Micros - Cycle->Rx_Open[0] - Cycle->Rx_Error[0];
+			}
+
+			if (Message_Status == NEW_MESSAGE)
+			{
+				//Get data
+				Message_Status = (Cycle->Command == JOIN) ? LORA_Read_Join_Accept(Data_Rx, Session_Data, OTAA_Data, Message_Rx, LoRa_Settings) :
+								 LORA_Read_Data(Data_Rx, Session_Data, Message_Rx, LoRa_Settings);
+			}
+
+			if (Message_Status == ADDRESS_OK || Message_Status == MESSAGE_DONE)
+			{
+				Cycle->Result = (Cycle->Command == JOIN) ? LORA_EVENT_JOINED : LORA_EVENT_RX_DONE;
+				Cycle->State = LORA_DONE;
+			}
+			else if (Message_Status != NO_MESSAGE)
+			{
+				Cycle->State = LORA_WAIT_RX2;
+			}
+			break;
+
+		case LORA_WAIT_RX2:
+			//Wait for rx2 window
+			if ((micros() - Cycle->Tx_Done_Micros) >= Cycle->Rx_Open[1])
+			{
+				RFM_Start_Single_Receive(Cycle->Rx_Datarate[1], Cycle->Rx_Channel[1], Cycle->Rx_Symbols[1]);
+				Cycle->Rx_Error[1] = (long)(micros() - Cycle->Tx_Done_Micros - Cycle->Rx_Open[1]);
+				Cycle->State = LORA_RX2;
+			}
+			break;
+
+		case LORA_RX2:
+			Message_Status = RFM_Receive_Status();
+
+			if (Message_Status != NO_MESSAGE)
+			{
+				Cycle->Rx_On_Time[1] = RFM_Get_Event_Time() - Cycle->Tx_Done_Micros - Cycle->Rx_Open[1] - Cycle->Rx_Error[1];
+			}
+
+			if (Message_Status == NEW_MESSAGE)
+			{
+				//Get data
+				Message_Status = (Cycle->Command == JOIN) ? LORA_Read_Join_Accept(Data_Rx, Session_Data, OTAA_Data, Message_Rx, LoRa_Settings) :
+								 LORA_Read_Data(Data_Rx, Session_Data, Message_Rx, LoRa_Settings);
+			}
+
+			if (Message_Status == ADDRESS_OK || Message_Status == MESSAGE_DONE)
+			{
+				Cycle->Result = (Cycle->Command == JOIN) ? LORA_EVENT_JOINED : LORA_EVENT_RX_DONE;
+				Cycle->State = LORA_DONE;
+			}
+			else if (Message_Status != NO_MESSAGE)
+			{
+				Cycle->Result = (Cycle->Command == JOIN) ? LORA_EVENT_JOIN_FAILED : LORA_EVENT_RX_TIMEOUT;
+				Cycle->State = LORA_DONE;
+			}
+			break;
+
+		case LORA_DONE:
+			break;
 	}
 
-	// wait rx1 window
-	while ((digitalRead(RFM_pins.DIO0) != HIGH) && ((millis() - prevTime) < Receive_Delay_1))
+	//Idle calls are not part of a frame
+	if (Cycle->State != LORA_IDLE)
 	{
+		Cycle->Cpu_Time += micros() - Start;
 	}
 
-	//Get data
-	LORA_Receive_Data(Data_Rx, Session_Data, OTAA_Data, Message_Rx, LoRa_Settings);
-	*RFM_Command = NO_RFM_COMMAND;
-
-	// wait rx2 window
-	while ((digitalRead(RFM_pins.DIO0) != HIGH) && ((millis() - prevTime) < Receive_Delay_2))
+	//Report the end of the cycle in the same call
+	if (Cycle->State == LORA_DONE)
 	{
+		Cycle->State = LORA_IDLE;
+		Event = Cycle->Result;
 	}
 
-	//Get data
-	LORA_Receive_Data(Data_Rx, Session_Data, OTAA_Data, Message_Rx, LoRa_Settings);
-	*RFM_Command = NO_RFM_COMMAND;
+	return Event;
 }
 
 /*
 *****************************************************************************************
 * Description : Function that is used to build a LoRaWAN data message and then tranmit it.
+*				Waits until the message is sent.
 *
-* Arguments   : *Data_Tx pointer to tranmit buffer
+* Arguments   : *Data_Tx pointer to tranmit buffer, see LORA_Build_Data
 *				*Session_Data pointer to sLoRa_Session sturct
 *				*LoRa_Settings pointer to sSetting struct
 *****************************************************************************************
 */
 void LORA_Send_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *LoRa_Settings)
+{
+  //The package is built in the head and tail room of the transmit buffer
+  sBuffer RFM_Package;
+
+  LORA_Build_Data(Data_Tx, Session_Data, LoRa_Settings, &RFM_Package);
+
+  //Send Package
+  Duty_Cycle_Use(LoRa_Settings->Channel_Tx, LORA_Time_On_Air(LoRa_Settings->Datarate_Tx, RFM_Package.Counter));
+  RFM_Send_Package(&RFM_Package, LoRa_Settings);
+
+  LORA_Next_Frame(Session_Data, LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that is used to build a LoRaWAN data message and start the
+*				transmission without waiting for TxDone.
+*
+* Arguments   : *Data_Tx pointer to tranmit buffer, see LORA_Build_Data
+*				*Session_Data pointer to sLoRa_Session sturct
+*				*LoRa_Settings pointer to sSetting struct
+*				*RFM_Package pointer to sBuffer struct that is set to the frame, it stays
+*				valid in the transmit buffer until the next frame is built
+*****************************************************************************************
+*/
+void LORA_Start_Send_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *LoRa_Settings, sBuffer *RFM_Package)
+{
+  //The package is built in the head and tail room of the transmit buffer
+  LORA_Build_Data(Data_Tx, Session_Data, LoRa_Settings, RFM_Package);
+
+  //Start sending Package
+  Duty_Cycle_Use(LoRa_Settings->Channel_Tx, LORA_Time_On_Air(LoRa_Settings->Datarate_Tx, RFM_Package->Counter));
+  RFM_Start_Send_Package(RFM_Package, LoRa_Settings);
+
+  LORA_Next_Frame(Session_Data, LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that starts the transmission of a frame that was sent before,
+*				the retransmission of a confirmed uplink. The frame counter stays the same,
+*				the data rate and the channel may be different.
+*
+* Arguments   : *RFM_Package pointer to sBuffer struct of the frame from LORA_Start_Send_Data
+*				*LoRa_Settings pointer to sSetting struct
+*****************************************************************************************
+*/
+void LORA_Start_Resend_Data(sBuffer *RFM_Package, sSettings *LoRa_Settings)
+{
+  Duty_Cycle_Use(LoRa_Settings->Channel_Tx, LORA_Time_On_Air(LoRa_Settings->Datarate_Tx, RFM_Package->Counter));
+  RFM_Start_Send_Package(RFM_Package, LoRa_Settings);
+
+  LORA_Hop_Channel(LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that is used to build a LoRaWAN data message around the payload.
+*				The payload in Data_Tx is encrypted in place, the header goes in the
+*				LORA_FRAME_HEADROOM bytes in front of it and the MIC behind it. The package
+*				is one block that is written to the FiFo without copying the payload.
+*
+* Arguments   : *Data_Tx pointer to tranmit buffer with LORA_FRAME_HEADROOM bytes in front
+*				of Data and LORA_FRAME_TAILROOM bytes behind the payload
+*				*Session_Data pointer to sLoRa_Session sturct
+*				*LoRa_Settings pointer to sSetting struct
+*				*RFM_Package pointer to sBuffer struct that is set to the package
+*****************************************************************************************
+*/
+static void LORA_Build_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *LoRa_Settings, sBuffer *RFM_Package)
 {
   //Define variables
   unsigned char i;
-
-  //Initialise RFM buffer
-  unsigned char RFM_Data[64];
-  sBuffer RFM_Package = {&RFM_Data[0], 0x00};
+  unsigned char *RFM_Data;
+  unsigned char Frame_Options_Length = 0x00;
+  sMAC_Commands *MAC = Session_Data->MAC_Commands;
 
   //Initialise Message struct for a transmit message
   sLoRa_Message Message;
 
   Message.MAC_Header = 0x00;
-  Message.Frame_Port = 0x01; //Frame port always 1 for now
-  Message.Frame_Control = 0x00;
+  Message.Frame_Port = LoRa_Settings->Frame_Port;
+  Message.Frame_Control = LoRa_Settings->Frame_Control & 0xC0;
 
   //Load device address from session data into the message
   Message.DevAddr[0] = Session_Data->DevAddr[0];
@@ -145,7 +387,18 @@ void LORA_Send_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *Lo
       Message.MAC_Header = Message.MAC_Header | 0x80;
   }
 
-  //Build the Radio Package
+  //Send the MAC command answers in the frame options when they fit with the data
+  if(MAC->Answer_Length != 0 &&
+     8 + MAC->Answer_Length + 1 + Data_Tx->Counter + 4 <= LORA_FRAME_SIZE &&
+     MAC->Answer_Length + Data_Tx->Counter <= LORA_Max_Payload(LoRa_Settings->Datarate_Tx))
+  {
+    Frame_Options_Length = MAC->Answer_Length;
+  }
+
+  //Build the Radio Package, it starts at the header in front of the payload
+  RFM_Data = Data_Tx->Data - 8 - Frame_Options_Length - ((Data_Tx->Counter > 0x00) ? 1 : 0);
+  RFM_Package->Data = RFM_Data;
+
   //Load mac header
   RFM_Data[0] = Message.MAC_Header;
 
@@ -163,67 +416,109 @@ void LORA_Send_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *Lo
   RFM_Data[7] = ((*Session_Data->Frame_Counter >> 8) & 0x00FF);
 
   //Set data counter to 8
-  RFM_Package.Counter = 8;
+  RFM_Package->Counter = 8;
+
+  //Load the MAC command answers in the frame options
+  if(Frame_Options_Length != 0x00)
+  {
+    RFM_Data[5] |= MAC->Answer_Length;
+
+    for(i = 0; i < MAC->Answer_Length; i++)
+    {
+      RFM_Data[8 + i] = MAC->Answer[i];
+    }
+
+    RFM_Package->Counter = RFM_Package->Counter + MAC->Answer_Length;
+
+    MAC_Sent(MAC);
+  }
 
   //If there is data load the Frame_Port field
   //Encrypt the data and load the data
   if(Data_Tx->Counter > 0x00)
   {
 	//Load Frame port field
-    RFM_Data[8] = Message.Frame_Port;
+    RFM_Data[RFM_Package->Counter] = Message.Frame_Port;
 
     //Raise package counter
-    RFM_Package.Counter++;
+    RFM_Package->Counter++;
 
-    //Encrypt the data
-    Encrypt_Payload(Data_Tx, Session_Data->AppSKey, &Message);
-
-    //Load Data
-    for(i = 0; i < Data_Tx->Counter; i++)
+    //Encrypt the data, it is already in place behind the header
+    if(!Keystream_Encrypt(Data_Tx, Session_Data->Keystream, &Message))
     {
-      RFM_Data[RFM_Package.Counter + i] = Data_Tx->Data[i];
+      Encrypt_Payload(Data_Tx, Session_Data->AppSKey_Expanded, &Message);
     }
 
     //Add data Length to package counter
-    RFM_Package.Counter = RFM_Package.Counter + Data_Tx->Counter;
+    RFM_Package->Counter = RFM_Package->Counter + Data_Tx->Counter;
   }
 
   //Calculate MIC
-  Construct_Data_MIC(&RFM_Package, Session_Data, &Message);
+  Construct_Data_MIC(RFM_Package, Session_Data, &Message);
 
   //Load MIC in package
   for(i = 0; i < 4; i++)
   {
-    RFM_Data[i + RFM_Package.Counter] = Message.MIC[i];
+    RFM_Data[i + RFM_Package->Counter] = Message.MIC[i];
+  }
+
+  //The key stream is used, the next one is prepared for a frame of the same length
+  if(Session_Data->Keystream != NULL)
+  {
+    Session_Data->Keystream->Valid = 0x00;
+    Session_Data->Keystream->Length = RFM_Package->Counter;
   }
 
   //Add MIC length to RFM package length
-  RFM_Package.Counter = RFM_Package.Counter + 4;
+  RFM_Package->Counter = RFM_Package->Counter + 4;
 
-  //Send Package
-  RFM_Send_Package(&RFM_Package, LoRa_Settings);
+}
 
-  //Raise Frame counter
-  if(*Session_Data->Frame_Counter != 0xFFFF)
-  {
-    //Raise frame counter
-    *Session_Data->Frame_Counter = *Session_Data->Frame_Counter + 1;
-  }
-  else
-  {
-    *Session_Data->Frame_Counter = 0x0000;
-  }
+/*
+*****************************************************************************************
+* Description : Function that is used to prepare the session for the next frame after a
+*				data message is sent. Raises the frame counter and hops the channel.
+*
+* Arguments   : *Session_Data pointer to sLoRa_Session sturct
+*				*LoRa_Settings pointer to sSetting struct
+*****************************************************************************************
+*/
+static void LORA_Next_Frame(sLoRa_Session *Session_Data, sSettings *LoRa_Settings)
+{
+  //Raise Frame counter, 32 bits of which the lower 16 are sent
+  *Session_Data->Frame_Counter = *Session_Data->Frame_Counter + 1;
 
-  //Change channel for next message if hopping is activated
+#ifdef FCNT_NVM
+  //Store the counters every FCNT_NVM_INTERVAL frames
+  NVM_Counter_Update(Session_Data);
+#endif
+
+  LORA_Hop_Channel(LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that moves to the next channel of the mask when channel hopping
+*				is activated
+*
+* Arguments   : *LoRa_Settings pointer to sSetting struct
+*****************************************************************************************
+*/
+static void LORA_Hop_Channel(sSettings *LoRa_Settings)
+{
+  unsigned char i;
+
+  //Change channel for next message if hopping is activated, skip the masked channels
   if(LoRa_Settings->Channel_Hopping == 0x01)
   {
-    if(LoRa_Settings->Channel_Tx < 0x07)
+    for(i = 0; i < BAND_PLAN.Uplink_Channels; i++)
     {
-      LoRa_Settings->Channel_Tx++;
-    }
-    else
-    {
-      LoRa_Settings->Channel_Tx = 0x00;
+      LoRa_Settings->Channel_Tx = (LoRa_Settings->Channel_Tx + 1) % BAND_PLAN.Uplink_Channels;
+
+      if(LoRa_Settings->Channel_Mask & (1 << LoRa_Settings->Channel_Tx))
+      {
+        break;
+      }
     }
   }
 }
@@ -237,17 +532,55 @@ void LORA_Send_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *Lo
 *
 * Arguments   : *Data_Rx pointer to receive buffer
 *				*Session_Data pointer to sLoRa_Session sturct
-*				*OTAA_Data pointer to sLoRa_OTAA struct
 *				*Message_Rx pointer to sLoRa_Message struct used for the received message information
 *				*LoRa_Settings pointer to sSetting struct
+*
+* Return      : bool true for a valid downlink of the session
+*****************************************************************************************
+*/
+bool LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_Message *Message, sSettings *LoRa_Settings)
+{
+	message_t Message_Status = NO_MESSAGE;
+
+	//If it is a type A device switch RFM to single receive
+	if(LoRa_Settings->Mote_Class == 0x00)
+	{
+		Message_Status = RFM_Single_Receive(LoRa_Settings);  
+	}
+	else
+	{
+		//The RFM stays in continuous receive, the RxDone interrupt kept the package
+		Message_Status = (RFM_Queued_Packages() != 0x00) ? NEW_MESSAGE : NO_MESSAGE;
+	}
+
+	//If there is a message received get the data from the RFM
+	if(Message_Status == NEW_MESSAGE)
+	{
+		Message_Status = LORA_Read_Data(Data_Rx, Session_Data, Message, LoRa_Settings);
+	}
+
+	return Message_Status == ADDRESS_OK || Message_Status == MESSAGE_DONE;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that is used to retrieve a received LoRaWAN message from the RFM
+*               after RxDone. Also checks on CRC, MIC and Device Address
+*
+* Arguments   : *Data_Rx pointer to receive buffer
+*				*Session_Data pointer to sLoRa_Session sturct
+*				*Message_Rx pointer to sLoRa_Message struct used for the received message information
+*				*LoRa_Settings pointer to sSetting struct
+*
+* Return      : message_t ADDRESS_OK or MESSAGE_DONE for a valid message
 *****************************************************************************************
 */
-void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message, sSettings *LoRa_Settings)
+static message_t LORA_Read_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_Message *Message, sSettings *LoRa_Settings)
 {
 	unsigned char i;
 
     //Initialise RFM buffer
-	unsigned char RFM_Data[64];
+	unsigned char RFM_Data[LORA_FRAME_SIZE];
 	sBuffer RFM_Package = {&RFM_Data[0], 0x00};
 
 	unsigned char MIC_Check;
@@ -257,31 +590,23 @@ void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA
 
 	unsigned char Data_Location;
 
+	unsigned int Frame_Counter;
+
 	message_t Message_Status = NO_MESSAGE;
 
-	//If it is a type A device switch RFM to single receive
-	if(LoRa_Settings->Mote_Class == 0x00)
+	//Get the data from the RFM, for class C from the ring of the RxDone interrupt
+	if(LoRa_Settings->Mote_Class == 0x01)
 	{
-		Message_Status = RFM_Single_Receive(LoRa_Settings);  
+		Message_Status = RFM_Get_Queued_Package(&RFM_Package, &Message->SNR, &Message->RSSI, &Message->Spreading_Factor);
 	}
 	else
-	{
-		//Switch RFM to standby
-		RFM_Switch_Mode(0x01);
-
-		Message_Status = NEW_MESSAGE;
-	}
-
-	//If there is a message received get the data from the RFM
-	if(Message_Status == NEW_MESSAGE)
 	{
 		Message_Status = RFM_Get_Package(&RFM_Package);
 
-		//If mote class C switch RFM back to continuous receive
-		if(LoRa_Settings->Mote_Class == 0x01)
+		//Signal quality for ADR
+		if(Message_Status == CRC_OK)
 		{
-			//Switch RFM to Continuous Receive
-			RFM_Continuous_Receive(LoRa_Settings);
+			RFM_Get_Package_Quality(&Message->SNR, &Message->RSSI, &Message->Spreading_Factor);
 		}
 	}
 
@@ -303,9 +628,15 @@ void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA
 			//Get frame control field
 			Message->Frame_Control = RFM_Data[5];
 
-			 //Get frame counter
-			Message->Frame_Counter = RFM_Data[7];
-			Message->Frame_Counter = (Message->Frame_Counter << 8) + RFM_Data[6];
+			//Get frame counter, the upper 16 bits follow from the last downlink counter
+			Frame_Counter = RFM_Data[7];
+			Frame_Counter = (Frame_Counter << 8) + RFM_Data[6];
+
+			Message->Frame_Counter = (*Session_Data->Frame_Counter_Down & 0xFFFF0000) | Frame_Counter;
+			if(Message->Frame_Counter < *Session_Data->Frame_Counter_Down)
+			{
+				Message->Frame_Counter += 0x10000;
+			}
 
 			//Lower Package length with 4 to remove MIC length
 			RFM_Package.Counter -= 4;
@@ -351,6 +682,9 @@ void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA
 		  	if(Address_Check == 0x04)
 		  	{
 				Message_Status = ADDRESS_OK;
+
+				//Keep the downlink counter of the valid message
+				*Session_Data->Frame_Counter_Down = Message->Frame_Counter;
 		  	}
 		  	else
 		  	{
@@ -367,6 +701,10 @@ void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA
 				//Get length of frame options field
 				Frame_Options_Length = (Message->Frame_Control & 0x0F);
 
+				//The downlink acknowledges the sticky answers, then handle the MAC commands in the frame options
+				MAC_Received(Session_Data->MAC_Commands);
+				MAC_Process(&RFM_Data[Data_Location], Frame_Options_Length, Session_Data->MAC_Commands, Message, LoRa_Settings);
+
 				//Add length of frame options field to data location
 				Data_Location = Data_Location + Frame_Options_Length;
 
@@ -377,8 +715,8 @@ void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA
 				}
 				else
 				{
-					//Get port field when ther is data
-					Message->Frame_Port = RFM_Data[8];
+					//Get port field when ther is data, it follows the frame options
+					Message->Frame_Port = RFM_Data[Data_Location];
 
 					//Calculate the amount of data in the package
 					Data_Rx->Counter = (RFM_Package.Counter - Data_Location -1);
@@ -398,11 +736,15 @@ void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA
          //Check frame port fiels. When zero it is a mac command message encrypted with NwkSKey
          if(Message->Frame_Port == 0x00)
          {
-          Encrypt_Payload(Data_Rx, Session_Data->NwkSKey, Message);
+          Encrypt_Payload(Data_Rx, Session_Data->NwkSKey_Expanded, Message);
+
+          //MAC commands are not for the application
+          MAC_Process(Data_Rx->Data, Data_Rx->Counter, Session_Data->MAC_Commands, Message, LoRa_Settings);
+          Data_Rx->Counter = 0x00;
          }
          else
          {
-          Encrypt_Payload(Data_Rx, Session_Data->AppSKey, Message);
+          Encrypt_Payload(Data_Rx, Session_Data->AppSKey_Expanded, Message);
          }
 
 					Message_Status = MESSAGE_DONE;
@@ -415,6 +757,8 @@ void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA
 			Data_Rx->Counter = 0x00;
  		}
 	}
+
+	return Message_Status;
 }
 /*
 *****************************************************************************************
@@ -436,6 +780,7 @@ static void Generate_DevNonce(unsigned char *DevNonce)
 /*
 *****************************************************************************************
 * Description : Function that is used to send a join request to a network.
+*				Waits until the message is sent.
 *
 * Arguments   : *OTAA_Data pointer to sLoRa_OTAA struct
 *				*LoRa_Settings pointer to sSetting struct
@@ -443,12 +788,51 @@ static void Generate_DevNonce(unsigned char *DevNonce)
 */
 void LoRa_Send_JoinReq(sLoRa_OTAA *OTAA_Data, sSettings *LoRa_Settings)
 {
-    unsigned char i;
+    unsigned char RFM_Data[LORA_JOIN_REQUEST_SIZE];
+    sBuffer RFM_Package = { &RFM_Data[0], 0x00};
+
+    LoRa_Build_JoinReq(OTAA_Data, &RFM_Package);
 
-	//Initialise RFM data buffer
-    unsigned char RFM_Data[23];
+    //Send Package
+    Duty_Cycle_Use(LoRa_Settings->Channel_Tx, LORA_Time_On_Air(LoRa_Settings->Datarate_Tx, RFM_Package.Counter));
+    RFM_Send_Package(&RFM_Package, LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that is used to send a join request to a network and start the
+*				transmission without waiting for TxDone.
+*
+* Arguments   : *OTAA_Data pointer to sLoRa_OTAA struct
+*				*LoRa_Settings pointer to sSetting struct
+*****************************************************************************************
+*/
+void LoRa_Start_JoinReq(sLoRa_OTAA *OTAA_Data, sSettings *LoRa_Settings)
+{
+    unsigned char RFM_Data[LORA_JOIN_REQUEST_SIZE];
     sBuffer RFM_Package = { &RFM_Data[0], 0x00};
 
+    LoRa_Build_JoinReq(OTAA_Data, &RFM_Package);
+
+    //Start sending Package
+    Duty_Cycle_Use(LoRa_Settings->Channel_Tx, LORA_Time_On_Air(LoRa_Settings->Datarate_Tx, RFM_Package.Counter));
+    RFM_Start_Send_Package(&RFM_Package, LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that is used to build a join request with a new DevNonce
+*
+* Arguments   : *OTAA_Data pointer to sLoRa_OTAA struct
+*				*RFM_Package pointer to sBuffer struct with LORA_JOIN_REQUEST_SIZE bytes
+*****************************************************************************************
+*/
+static void LoRa_Build_JoinReq(sLoRa_OTAA *OTAA_Data, sBuffer *RFM_Package)
+{
+    unsigned char i;
+    unsigned char *RFM_Data = RFM_Package->Data;
+    sAES_Expanded_Key AppKey_Expanded;
+
  	//Initialise message sturct
     sLoRa_Message Message;
 
@@ -479,10 +863,11 @@ void LoRa_Send_JoinReq(sLoRa_OTAA *OTAA_Data, sSettings *LoRa_Settings)
     RFM_Data[18] = OTAA_Data->DevNonce[1];
 
     //Set length of package
-    RFM_Package.Counter = 19;
+    RFM_Package->Counter = 19;
 
     //Get MIC
-    Calculate_MIC(&RFM_Package, OTAA_Data->AppKey, &Message);
+    AES_Expand_Key(OTAA_Data->AppKey, &AppKey_Expanded);
+    Calculate_MIC(RFM_Package, &AppKey_Expanded, &Message);
 
     //Load MIC in package
     RFM_Data[19] = Message.MIC[0];
@@ -491,28 +876,59 @@ void LoRa_Send_JoinReq(sLoRa_OTAA *OTAA_Data, sSettings *LoRa_Settings)
     RFM_Data[22] = Message.MIC[3];
 
     //Set length of package to the right length
-    RFM_Package.Counter = 23;
-
-    //Send Package
-    RFM_Send_Package(&RFM_Package, LoRa_Settings);
+    RFM_Package->Counter = LORA_JOIN_REQUEST_SIZE;
 }
+/*
+*****************************************************************************************
+* Description : Function that waits for one single receive and takes the JoinAccept of it
+*
+* Arguments   : *Data_Rx pointer to receive buffer
+*				*Session_Data pointer to sLoRa_Session sturct
+*				*OTAA_Data pointer to sLoRa_OTAA struct
+*				*Message pointer to sLoRa_Message struct used for the received message information
+*				*LoRa_Settings pointer to sSetting struct
+*
+* Return      : bool true when the session of the JoinAccept is set up
+*****************************************************************************************
+*/
 bool LORA_join_Accept(sBuffer *Data_Rx,sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message, sSettings *LoRa_Settings)
 {
-	bool joinStatus = false;
+	//RFM to single receive
+	if(RFM_Single_Receive(LoRa_Settings) != NEW_MESSAGE)
+	{
+		return false;
+	}
+
+	return LORA_Read_Join_Accept(Data_Rx, Session_Data, OTAA_Data, Message, LoRa_Settings) == MESSAGE_DONE;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that is used to retrieve a JoinAccept from the RFM after RxDone.
+*				Checks the MIC and sets up the session of the join.
+*
+* Arguments   : *Data_Rx pointer to receive buffer
+*				*Session_Data pointer to sLoRa_Session sturct
+*				*OTAA_Data pointer to sLoRa_OTAA struct
+*				*Message pointer to sLoRa_Message struct used for the received message information
+*				*LoRa_Settings pointer to sSetting struct
+*
+* Return      : message_t MESSAGE_DONE when the session is set up
+*****************************************************************************************
+*/
+static message_t LORA_Read_Join_Accept(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message, sSettings *LoRa_Settings)
+{
 	unsigned char i;
     //Initialise RFM buffer
-	unsigned char RFM_Data[64];
+	unsigned char RFM_Data[LORA_FRAME_SIZE];
 	sBuffer RFM_Package = {&RFM_Data[0], 0x00};
 	unsigned char MIC_Check;
+	sAES_Expanded_Key AppKey_Expanded;
 
 	message_t Message_Status = NO_MESSAGE;
 
-	//RFM to single receive
-	Message_Status = RFM_Single_Receive(LoRa_Settings);  
-
-	//If there is a message received get the data from the RFM
-	if(Message_Status == NEW_MESSAGE)
-		Message_Status = RFM_Get_Package(&RFM_Package);
+	//Get the data from the RFM
+	Message_Status = RFM_Get_Package(&RFM_Package);
 
 	//if CRC ok breakdown package
 	if(Message_Status == CRC_OK)
@@ -520,8 +936,9 @@ bool LORA_join_Accept(sBuffer *Data_Rx,sLoRa_Session *Session_Data, sLoRa_OTAA *
 		//Get MAC_Header
     	Message->MAC_Header = RFM_Data[0];
 
-		//Join Accept message
-		if(Message->MAC_Header == 0x20)
+		//Join Accept message, 17 bytes or 33 with the CFList. Other lengths would overrun
+		//Data_Rx or leave no MIC
+		if(Message->MAC_Header == 0x20 && (RFM_Package.Counter == 17 || RFM_Package.Counter == 33))
 		{	
 			//Copy the data into the data array
 			for(i = 0x00; i < RFM_Package.Counter; i++)
@@ -530,16 +947,19 @@ bool LORA_join_Accept(sBuffer *Data_Rx,sLoRa_Session *Session_Data, sLoRa_OTAA *
 			//Set data counter
 			Data_Rx->Counter = RFM_Package.Counter;
 
+			//Expand the AppKey once for decryption, MIC and key derivation
+			AES_Expand_Key(OTAA_Data->AppKey, &AppKey_Expanded);
+
 			//Decrypt the data
 			for(i = 0x00; i < ((Data_Rx->Counter - 1) / 16); i++)
-				AES_Encrypt(&(Data_Rx->Data[(i*16)+1]),OTAA_Data->AppKey);
+				AES_Encrypt_Expanded(&(Data_Rx->Data[(i*16)+1]),&AppKey_Expanded);
 
 			//Calculate MIC
 			//Remove MIC from number of bytes
 			Data_Rx->Counter -= 4;
 
 			//Get MIC
-			Calculate_MIC(Data_Rx, OTAA_Data->AppKey, Message);
+			Calculate_MIC(Data_Rx, &AppKey_Expanded, Message);
 
 			//Clear MIC check counter
 			MIC_Check = 0x00;
@@ -597,11 +1017,41 @@ bool LORA_join_Accept(sBuffer *Data_Rx,sLoRa_Session *Session_Data, sLoRa_OTAA *
 				Session_Data->AppSKey[0] = 0x02;
 
 				//Calculate the keys
-				AES_Encrypt(Session_Data->NwkSKey,OTAA_Data->AppKey);
-				AES_Encrypt(Session_Data->AppSKey,OTAA_Data->AppKey);
+				AES_Encrypt_Expanded(Session_Data->NwkSKey,&AppKey_Expanded);
+				AES_Encrypt_Expanded(Session_Data->AppSKey,&AppKey_Expanded);
 
-				//Reset Frame counter
+				//Expand the new session keys for the rest of the session
+				AES_Expand_Key(Session_Data->NwkSKey, Session_Data->NwkSKey_Expanded);
+				AES_Expand_Key(Session_Data->AppSKey, Session_Data->AppSKey_Expanded);
+				CMAC_Key_Init(Session_Data->NwkSKey_CMAC, Session_Data->NwkSKey_Expanded);
+				Keystream_Clear(Session_Data->Keystream);
+
+				//Reset Frame counters
 				*Session_Data->Frame_Counter = 0x0000;
+				*Session_Data->Frame_Counter_Down = 0x0000;
+
+				//Receive settings of the network, DLSettings and RxDelay. Values the band plan
+				//does not have leave the default
+				LoRa_Settings->Rx1_DR_Offset = 0x00;
+				LoRa_Settings->Datarate_Rx2 = BAND_PLAN.Datarate_Rx2;
+				if(((Data_Rx->Data[11] >> 4) & 0x07) <= BAND_PLAN.Max_Rx1_DR_Offset)
+				{
+					LoRa_Settings->Rx1_DR_Offset = (Data_Rx->Data[11] >> 4) & 0x07;
+				}
+				if((Data_Rx->Data[11] & 0x0F) >= BAND_PLAN.Min_Rx2_Datarate && (Data_Rx->Data[11] & 0x0F) <= BAND_PLAN.Max_Rx2_Datarate)
+				{
+					LoRa_Settings->Datarate_Rx2 = Data_Rx->Data[11] & 0x0F;
+				}
+				LoRa_Settings->Rx_Delay = (Data_Rx->Data[12] & 0x0F) ? (Data_Rx->Data[12] & 0x0F) : 1;
+				Band_Set_Datarate(LoRa_Settings->Datarate_Tx, LoRa_Settings);
+
+				//No answers of the old session
+				MAC_Init(Session_Data->MAC_Commands);
+
+#ifdef FCNT_NVM
+				//Start the counters of the new session in NVM
+				NVM_Counter_Save(Session_Data);
+#endif
 
 				//Clear Data counter
 				Data_Rx->Counter = 0x00;
@@ -615,12 +1065,125 @@ bool LORA_join_Accept(sBuffer *Data_Rx,sLoRa_Session *Session_Data, sLoRa_OTAA *
 					Serial.print(Session_Data->AppSKey[i],HEX);
 				Serial.println();
 #endif	
-				joinStatus = true;
+				Message_Status = MESSAGE_DONE;
 			}
 		}
+		else
+		{
+			Message_Status = WRONG_MESSAGE;
+		}
 	}
-	return joinStatus;
+	return Message_Status;
 }
 
 
 
+
+/*
+*****************************************************************************************
+* Description : Function that gives the largest FRMPayload of an uplink data rate without
+*				FOpts, limited by the frame buffers
+*
+* Arguments   : Datarate the uplink data rate
+*
+* Return      : unsigned char maximum number of payload bytes
+*****************************************************************************************
+*/
+unsigned char LORA_Max_Payload(unsigned char Datarate)
+{
+	unsigned char Length;
+
+	Length = BAND_PLAN.Max_Payload[(Datarate < BAND_PLAN.Uplink_Datarates) ? Datarate : 0];
+	if(Length > LORA_FRAME_SIZE - LORA_FRAME_OVERHEAD)
+	{
+		Length = LORA_FRAME_SIZE - LORA_FRAME_OVERHEAD;
+	}
+	return Length;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that sets the modem settings of a data rate, 8 preamble symbols,
+*				explicit header, CRC and coding rate 4/5
+*
+* Arguments   : Datarate the data rate
+*				*Timing pointer to the rf_timing_t struct to set
+*****************************************************************************************
+*/
+static void LORA_Timing(unsigned char Datarate, rf_timing_t *Timing)
+{
+	rfTimingInit(Timing);
+	Timing->crc = 1;
+
+	//Data rates that are not in the band plan count as DR0
+	if(Datarate >= BAND_PLAN.Datarates || BAND_PLAN.Datarate[Datarate].SF == 0)
+	{
+		Datarate = 0x00;
+	}
+	Timing->sf = BAND_PLAN.Datarate[Datarate].SF;
+	Timing->bandwidth = Band_Bandwidth(BAND_PLAN.Datarate[Datarate].BW);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that calculates the time on air of a frame with 8 preamble symbols,
+*				explicit header, CRC and coding rate 4/5. Low data rate optimisation is
+*				counted for SF11 and SF12 at 125 kHz. Integer only, see RFTiming.h.
+*
+* Arguments   : Datarate the data rate of the frame
+*				Length number of bytes of the PHYPayload
+*
+* Return      : unsigned long time on air in us
+*****************************************************************************************
+*/
+unsigned long LORA_Time_On_Air(unsigned char Datarate, unsigned char Length)
+{
+	rf_timing_t Timing;
+
+	LORA_Timing(Datarate, &Timing);
+	return rfTimeOnAir(&Timing, Length);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that calculates when a receive window opens and its symbol
+*				timeout. The preamble of the downlink starts Delay after TxDone and has 8
+*				symbols, the RFM has to be receiving LORA_RX_MIN_SYMBOLS of them. The window
+*				opens so that it is in time with the drift of micros() and LORA_RX_LATENCY,
+*				the symbol timeout covers the preamble when the window opened early.
+*				The RFM is on for LORA_RX_MIN_SYMBOLS symbols when nothing is sent.
+*
+* Arguments   : Datarate the data rate of the window
+*				Delay us from TxDone to the downlink
+*				*Open pointer to the us from TxDone to open the window
+*				*Symbols pointer to the symbol timeout
+*****************************************************************************************
+*/
+static void LORA_Rx_Window(unsigned char Datarate, unsigned long Delay, unsigned long *Open, unsigned short *Symbols)
+{
+	rf_timing_t Timing;
+	unsigned long Symbol_Time;
+	unsigned long Drift;
+	unsigned long Margin;
+	unsigned long Spare;
+	unsigned long Timeout;
+
+	LORA_Timing(Datarate, &Timing);
+	Symbol_Time = rfSymbolTime(&Timing);
+
+	//Drift of both clocks over the delay
+	Drift = (Delay / 1000) * LORA_RX_CLOCK_PPM / 1000;
+	Margin = Drift + LORA_RX_LATENCY;
+
+	//Preamble that may pass before the window opens
+	Spare = (8 - LORA_RX_MIN_SYMBOLS) * Symbol_Time;
+	*Open = Delay + Spare - Margin;
+
+	//From the earliest opening to the latest preamble and the symbols to detect it
+	Timeout = LORA_RX_MIN_SYMBOLS;
+	if(2 * Drift + LORA_RX_LATENCY > Spare)
+	{
+		Timeout += (2 * Drift + LORA_RX_LATENCY - Spare + Symbol_Time - 1) / Symbol_Time;
+	}
+	*Symbols = (Timeout > 1023) ? 1023 : Timeout;
+}
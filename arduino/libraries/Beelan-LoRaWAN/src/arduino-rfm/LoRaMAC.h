@@ -36,6 +36,7 @@
 */
 
 #include "Struct.h"
+#include "Config.h"
 
 /*
 ********************************************************************************************
@@ -43,7 +44,72 @@
 ********************************************************************************************
 */
 
-typedef enum {NO_RFM_COMMAND, NEW_RFM_COMMAND, RFM_COMMAND_DONE, JOIN} RFM_command_t;
+//Size of the frame buffers, the largest PHYPayload with header, FOpts, payload and MIC
+#define LORA_FRAME_SIZE 255
+
+//MHDR, FHDR without FOpts, FPort and MIC of a data message
+#define LORA_FRAME_OVERHEAD 13
+
+//A transmit buffer keeps room in front of the payload for MHDR, FHDR with 15 bytes of FOpts
+//and FPort and behind it for the MIC, the frame is built around the payload
+#define LORA_FRAME_HEADROOM 24
+#define LORA_FRAME_TAILROOM 4
+#define LORA_TX_BUFFER_SIZE (LORA_FRAME_HEADROOM + LORA_FRAME_SIZE - LORA_FRAME_OVERHEAD + LORA_FRAME_TAILROOM)
+
+//JoinRequest length and the receive delay of the JoinAccept in seconds
+#define LORA_JOIN_REQUEST_SIZE 23
+#define LORA_JOIN_ACCEPT_DELAY 5
+
+//Receive windows, see LORA_Rx_Window. Accuracy of micros() in ppm, us a window may open late
+//for the polling of update() and the switch of the RFM to receive, preamble symbols the RFM
+//needs to detect a downlink.
+#ifndef LORA_RX_CLOCK_PPM
+#define LORA_RX_CLOCK_PPM 50
+#endif
+#ifndef LORA_RX_LATENCY
+#define LORA_RX_LATENCY 1000
+#endif
+#ifndef LORA_RX_MIN_SYMBOLS
+#define LORA_RX_MIN_SYMBOLS 6
+#endif
+
+typedef enum {NO_RFM_COMMAND, NEW_RFM_COMMAND, RFM_COMMAND_DONE, JOIN, RETRANSMIT} RFM_command_t;
+
+typedef enum {LORA_IDLE, LORA_TX, LORA_WAIT_RX1, LORA_RX1, LORA_WAIT_RX2, LORA_RX2, LORA_DONE} lora_state_t;
+
+typedef enum {LORA_EVENT_NONE, LORA_EVENT_TX_DONE, LORA_EVENT_RX_DONE, LORA_EVENT_RX_TIMEOUT, LORA_EVENT_JOINED, LORA_EVENT_JOIN_FAILED} lora_event_t;
+
+typedef struct {
+	lora_state_t State;
+	unsigned long Tx_Done_Time;
+	lora_event_t Result;
+	unsigned long Tx_Done_Micros;	//micros() of the TxDone interrupt
+	unsigned long Rx_Open[2];		//us after TxDone the RX1 and RX2 windows open
+	unsigned short Rx_Symbols[2];	//Symbol timeout of the RX1 and RX2 windows
+	unsigned char Rx_Datarate[2];	//Data rate of the RX1 and RX2 windows
+	unsigned char Rx_Channel[2];	//Channel of the RX1 and RX2 windows
+	long Rx_Error[2];				//us the RX1 and RX2 windows opened after Rx_Open
+	unsigned long Rx_On_Time[2];	//us the RFM was receiving in the RX1 and RX2 windows
+	unsigned long Cpu_Time;			//us spent in LORA_Cycle for the last frame
+	RFM_command_t Command;			//NEW_RFM_COMMAND, JOIN or RETRANSMIT that started the cycle
+	sBuffer Package;				//Frame of the last uplink, RETRANSMIT sends it again
+} sLoRa_Cycle;
+
+typedef void (*lora_callback_t)(lora_event_t Event);
+typedef void (*lora_join_callback_t)(bool Joined);
+typedef void (*lora_confirm_callback_t)(unsigned int Frame_Counter, bool Acked, unsigned char Attempts, short RSSI);
+
+//Received application payload, Data points into the receive buffer and is valid during the handler
+typedef struct {
+	unsigned char Port;
+	const unsigned char *Data;
+	unsigned char Length;
+	unsigned int Frame_Counter;		//FCntDown of the downlink
+	short RSSI;						//dBm
+	signed char SNR;				//0.25 dB
+} sLoRa_Downlink;
+
+typedef void (*lora_downlink_callback_t)(const sLoRa_Downlink *Downlink);
 
 /*
 *****************************************************************************************
@@ -51,10 +117,15 @@ typedef enum {NO_RFM_COMMAND, NEW_RFM_COMMAND, RFM_COMMAND_DONE, JOIN} RFM_comma
 *****************************************************************************************
 */
 
-void LORA_Cycle(sBuffer *Data_Tx, sBuffer *Data_Rx, RFM_command_t *RFM_Command, sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message_Rx, sSettings *LoRa_Settings);
+lora_event_t LORA_Cycle(sLoRa_Cycle *Cycle, sBuffer *Data_Tx, sBuffer *Data_Rx, RFM_command_t *RFM_Command, sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message_Rx, sSettings *LoRa_Settings);
 void LORA_Send_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *LoRa_Settings);
-void LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message, sSettings *LoRa_Settings);
+void LORA_Start_Send_Data(sBuffer *Data_Tx, sLoRa_Session *Session_Data, sSettings *LoRa_Settings, sBuffer *RFM_Package);
+void LORA_Start_Resend_Data(sBuffer *RFM_Package, sSettings *LoRa_Settings);
+bool LORA_Receive_Data(sBuffer *Data_Rx, sLoRa_Session *Session_Data, sLoRa_Message *Message, sSettings *LoRa_Settings);
 bool LORA_join_Accept(sBuffer *Data_Rx,sLoRa_Session *Session_Data, sLoRa_OTAA *OTAA_Data, sLoRa_Message *Message, sSettings *LoRa_Settings);
 void LoRa_Send_JoinReq(sLoRa_OTAA *OTAA_Data, sSettings *LoRa_Settings);
+void LoRa_Start_JoinReq(sLoRa_OTAA *OTAA_Data, sSettings *LoRa_Settings);
+unsigned char LORA_Max_Payload(unsigned char Datarate);
+unsigned long LORA_Time_On_Air(unsigned char Datarate, unsigned char Length);
 #endif
 
@@ -0,0 +1,520 @@
+/****************************************************************************************
+* File:     MAC-Commands.cpp
+*
+* MAC commands of LoRaWAN 1.0. The commands of a downlink are looked up in a table that
+* gives their length, the length of the answer and the function that handles them.
+* A function checks the request, changes the settings when all of it is accepted and
+* writes the answer. The answers are kept until the next uplink takes them in its FOpts,
+* RXParamSetupAns and RXTimingSetupAns are sent with every uplink until a downlink is
+* received. Parsing stops at an unknown command, its length is not known.
+* Contiguous LinkADRReqs are one block (LoRaWAN 1.0.2 section 5.2): the channel masks in
+* order, the rest of the last command, one status that every LinkADRAns of the block gets.
+****************************************************************************************/
+
+#include <string.h>
+#include "MAC-Commands.h"
+#include "Duty-Cycle.h"
+#include "RFM95.h"
+#include "Band-Plan.h"
+
+//Count commands of a block at Request, each 1 + Length bytes from its CID on, 1 for others
+typedef bool (*MAC_Handler)(unsigned char *Request, unsigned char Count, unsigned char *Answer, sMAC_Commands *MAC, sLoRa_Message *Message, sSettings *LoRa_Settings);
+
+typedef struct {
+	unsigned char CID;
+	unsigned char Length;			//Bytes of the request after the CID
+	unsigned char Answer_Length;	//Bytes of the uplink command after the CID
+	unsigned char Sticky;			//0x01 answer is repeated until a downlink
+	unsigned char Block;			//0x01 contiguous commands are handled together
+	MAC_Handler Handler;			//Returns true when there is an answer, one per command
+} sMAC_Command;
+
+/*
+*****************************************************************************************
+* Description : Function that checks a frequency of the network for the region
+*
+* Arguments   : Frequency in Hz
+*
+* Return      : bool true when the frequency is in the band of the region
+*****************************************************************************************
+*/
+static bool MAC_Frequency_Valid(unsigned long Frequency)
+{
+	//0 when the frequencies of the region are fixed
+	return BAND_PLAN.Min_Frequency != 0 && Frequency >= BAND_PLAN.Min_Frequency && Frequency <= BAND_PLAN.Max_Frequency;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that applies the ChMask of a LinkADRReq to the channel mask, the
+*				block checks that a channel stays on
+*
+* Arguments   : *Channel_Mask pointer to the mask, changed when accepted
+*				Mask the ChMask of the request
+*				Mask_Control the ChMaskCntl of the request
+*
+* Return      : bool true when the mask is accepted
+*****************************************************************************************
+*/
+static bool MAC_Channel_Mask(unsigned int *Channel_Mask, unsigned int Mask, unsigned char Mask_Control)
+{
+	unsigned int New_Mask = *Channel_Mask;
+
+	//Plans of 64 channels, blocks of 16 of which ours are one half. 6 and 7 switch all
+	//125 kHz channels on or off, their ChMask is for the 500 kHz channels we do not use.
+	if(BAND_PLAN.Downlink_Channels != 0)
+	{
+		if(Mask_Control == (BAND_SUB_BAND >> 1))
+		{
+			New_Mask = (Mask >> ((BAND_SUB_BAND & 0x01) * 8)) & 0xFF;
+		}
+		else if(Mask_Control == 6)
+		{
+			New_Mask = 0xFF;
+		}
+		else if(Mask_Control == 7)
+		{
+			New_Mask = 0x00;
+		}
+		else if(Mask_Control == 5)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if(Mask_Control == 0)
+		{
+			//Channels that are not there can not be switched on
+			if(Mask & ~((1 << BAND_PLAN.Uplink_Channels) - 1))
+			{
+				return false;
+			}
+			New_Mask = Mask;
+		}
+		else if(Mask_Control == 6)
+		{
+			New_Mask = (1 << BAND_PLAN.Uplink_Channels) - 1;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	*Channel_Mask = New_Mask;
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : LinkCheckAns, margin and number of gateways of the last LinkCheckReq
+*****************************************************************************************
+*/
+static bool MAC_Link_Check_Ans(unsigned char *Request, unsigned char, unsigned char *, sMAC_Commands *MAC, sLoRa_Message *, sSettings *)
+{
+	MAC->Link_Margin = Request[0];
+	MAC->Link_Gateways = Request[1];
+	MAC->Link_Check = 0x01;
+
+	return false;
+}
+
+/*
+*****************************************************************************************
+* Description : LinkADRReq block, data rate, transmit power, channel mask and NbTrans.
+*				Nothing changes unless all three are accepted. The masks of the block are
+*				applied in order and at least one channel has to stay on, the other
+*				fields are the ones of the last command. NbTrans is the number of
+*				transmissions of a confirmed uplink, unconfirmed uplinks are sent once.
+*****************************************************************************************
+*/
+static bool MAC_Link_ADR_Req(unsigned char *Request, unsigned char Count, unsigned char *Answer, sMAC_Commands *, sLoRa_Message *, sSettings *LoRa_Settings)
+{
+	unsigned char *Last = &Request[(Count - 1) * 5];		//CID and 4 bytes per command
+	unsigned char Datarate = Last[0] >> 4;
+	unsigned char Power = Last[0] & 0x0F;
+	unsigned int Channel_Mask = LoRa_Settings->Channel_Mask;
+	unsigned char Status = 0x01;
+	unsigned char *Command;
+	unsigned char i;
+	int Power_dBm;
+
+	for(i = 0; i < Count; i++)
+	{
+		Command = &Request[i * 5];
+		if(!MAC_Channel_Mask(&Channel_Mask, Command[1] | (Command[2] << 8), (Command[3] >> 4) & 0x07))
+		{
+			Status = 0x00;
+		}
+	}
+	if(Channel_Mask == 0)
+	{
+		Status = 0x00;
+	}
+
+	//0x0F keeps the data rate or the power
+	if(Datarate == 0x0F)
+	{
+		Datarate = LoRa_Settings->Datarate_Tx;
+		Status |= 0x02;
+	}
+	else if(Datarate <= BAND_PLAN.Max_Datarate)
+	{
+		Status |= 0x02;
+	}
+
+	if(Power == 0x0F || Power <= BAND_PLAN.Max_Tx_Power)
+	{
+		Status |= 0x04;
+	}
+
+	if(Status == 0x07)
+	{
+		LoRa_Settings->Channel_Mask = Channel_Mask;
+		Band_Set_Datarate(Datarate, LoRa_Settings);
+
+		//Power index of the PA_BOOST output is 2 dBm lower than the power
+		if(Power != 0x0F)
+		{
+			Power_dBm = BAND_PLAN.Max_EIRP - 2 * Power;
+			LoRa_Settings->Transmit_Power = (Power_dBm > 17) ? 0x0F : (Power_dBm < 2) ? 0x00 : Power_dBm - 2;
+		}
+
+		//0 keeps NbTrans
+		if((Last[3] & 0x0F) != 0x00)
+		{
+			LoRa_Settings->Nb_Trans = Last[3] & 0x0F;
+		}
+	}
+
+	Answer[0] = Status;
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : DutyCycleReq, duty cycle of all channels together
+*****************************************************************************************
+*/
+static bool MAC_Duty_Cycle_Req(unsigned char *Request, unsigned char, unsigned char *, sMAC_Commands *, sLoRa_Message *, sSettings *LoRa_Settings)
+{
+	LoRa_Settings->Max_Duty_Cycle = Request[0] & 0x0F;
+	Duty_Cycle_Set_Total(LoRa_Settings->Max_Duty_Cycle);
+
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : RXParamSetupReq, data rate offset of RX1, data rate and frequency of RX2
+*****************************************************************************************
+*/
+static bool MAC_RX_Param_Setup_Req(unsigned char *Request, unsigned char, unsigned char *Answer, sMAC_Commands *, sLoRa_Message *, sSettings *LoRa_Settings)
+{
+	unsigned char Rx1_DR_Offset = (Request[0] >> 4) & 0x07;
+	unsigned char Datarate = Request[0] & 0x0F;
+	unsigned long Frequency = (Request[1] | ((unsigned long)Request[2] << 8) | ((unsigned long)Request[3] << 16)) * 100;
+	unsigned char Status = 0x00;
+
+	if(MAC_Frequency_Valid(Frequency))
+	{
+		Status |= 0x01;
+	}
+	if(Datarate >= BAND_PLAN.Min_Rx2_Datarate && Datarate <= BAND_PLAN.Max_Rx2_Datarate)
+	{
+		Status |= 0x02;
+	}
+	if(Rx1_DR_Offset <= BAND_PLAN.Max_Rx1_DR_Offset)
+	{
+		Status |= 0x04;
+	}
+
+	if(Status == 0x07)
+	{
+		RFM_Set_Frequency(BAND_RX2_CHANNEL, Frequency);
+		LoRa_Settings->Rx1_DR_Offset = Rx1_DR_Offset;
+		LoRa_Settings->Datarate_Rx2 = Datarate;
+		Band_Set_Datarate(LoRa_Settings->Datarate_Tx, LoRa_Settings);
+	}
+
+	Answer[0] = Status;
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : DevStatusReq, battery level and the SNR of the downlink in dB
+*****************************************************************************************
+*/
+static bool MAC_Dev_Status_Req(unsigned char *, unsigned char, unsigned char *Answer, sMAC_Commands *MAC, sLoRa_Message *Message, sSettings *)
+{
+	signed char Margin = Message->SNR / 4;
+
+	//6 bit signed value
+	if(Margin < -32)
+	{
+		Margin = -32;
+	}
+	else if(Margin > 31)
+	{
+		Margin = 31;
+	}
+
+	Answer[0] = MAC->Battery;
+	Answer[1] = Margin & 0x3F;
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : NewChannelReq, frequency of a channel that is not a default channel.
+*				Frequency 0 switches the channel off. The data rate range is checked but
+*				the channels are not limited to it.
+*****************************************************************************************
+*/
+static bool MAC_New_Channel_Req(unsigned char *Request, unsigned char, unsigned char *Answer, sMAC_Commands *, sLoRa_Message *, sSettings *LoRa_Settings)
+{
+	unsigned char Channel = Request[0];
+	unsigned long Frequency = (Request[1] | ((unsigned long)Request[2] << 8) | ((unsigned long)Request[3] << 16)) * 100;
+	unsigned char Min_Datarate = Request[4] & 0x0F;
+	unsigned char Max_Datarate = Request[4] >> 4;
+	unsigned char Status = 0x00;
+
+	if(Channel >= BAND_PLAN.Default_Channels && Channel < BAND_PLAN.Uplink_Channels)
+	{
+		if(Frequency == 0 || MAC_Frequency_Valid(Frequency))
+		{
+			Status |= 0x01;
+		}
+		if(Min_Datarate <= Max_Datarate && Max_Datarate <= BAND_PLAN.Max_Datarate)
+		{
+			Status |= 0x02;
+		}
+	}
+
+	if(Status == 0x03)
+	{
+		if(Frequency == 0)
+		{
+			LoRa_Settings->Channel_Mask &= ~(1 << Channel);
+		}
+		else
+		{
+			RFM_Set_Frequency(Channel, Frequency);
+			LoRa_Settings->Channel_Mask |= (1 << Channel);
+		}
+	}
+
+	Answer[0] = Status;
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : RXTimingSetupReq, delay of the first receive window in seconds
+*****************************************************************************************
+*/
+static bool MAC_RX_Timing_Setup_Req(unsigned char *Request, unsigned char, unsigned char *, sMAC_Commands *, sLoRa_Message *, sSettings *LoRa_Settings)
+{
+	LoRa_Settings->Rx_Delay = (Request[0] & 0x0F) ? (Request[0] & 0x0F) : 1;
+
+	return true;
+}
+
+static const sMAC_Command MAC_Command_Table[] = {
+	{0x02, 2, 0, 0x00, 0x00, MAC_Link_Check_Ans},		//Answer to the LinkCheckReq of the mote
+	{0x03, 4, 1, 0x00, 0x01, MAC_Link_ADR_Req},
+	{0x04, 1, 0, 0x00, 0x00, MAC_Duty_Cycle_Req},
+	{0x05, 4, 1, 0x01, 0x00, MAC_RX_Param_Setup_Req},
+	{0x06, 0, 2, 0x00, 0x00, MAC_Dev_Status_Req},
+	{0x07, 5, 1, 0x00, 0x00, MAC_New_Channel_Req},
+	{0x08, 1, 0, 0x01, 0x00, MAC_RX_Timing_Setup_Req},
+};
+
+/*
+*****************************************************************************************
+* Description : Function that finds a command in the table
+*
+* Arguments   : CID command identifier
+*
+* Return      : sMAC_Command pointer to the table entry, NULL for an unknown command
+*****************************************************************************************
+*/
+static const sMAC_Command *MAC_Find(unsigned char CID)
+{
+	unsigned char i;
+
+	for(i = 0; i < sizeof(MAC_Command_Table) / sizeof(MAC_Command_Table[0]); i++)
+	{
+		if(MAC_Command_Table[i].CID == CID)
+		{
+			return &MAC_Command_Table[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that removes the sticky or the other uplink commands
+*
+* Arguments   : *MAC pointer to sMAC_Commands struct
+*				Sticky 0x01 to remove the sticky answers, 0x00 to remove the others
+*****************************************************************************************
+*/
+static void MAC_Remove(sMAC_Commands *MAC, unsigned char Sticky)
+{
+	const sMAC_Command *Command;
+	unsigned char Position = 0;
+	unsigned char Length = 0;
+	unsigned char Size;
+
+	while(Position < MAC->Answer_Length)
+	{
+		Command = MAC_Find(MAC->Answer[Position]);
+		Size = 1 + Command->Answer_Length;
+
+		if(Command->Sticky != Sticky)
+		{
+			memmove(&MAC->Answer[Length], &MAC->Answer[Position], Size);
+			Length += Size;
+		}
+		Position += Size;
+	}
+	MAC->Answer_Length = Length;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that adds a command to the answers
+*
+* Arguments   : *MAC pointer to sMAC_Commands struct
+*				*Command pointer to the table entry of the command
+*				*Data pointer to the bytes after the CID
+*****************************************************************************************
+*/
+static void MAC_Add(sMAC_Commands *MAC, const sMAC_Command *Command, unsigned char *Data)
+{
+	//Answers that do not fit the FOpts are lost, the network asks again
+	if(MAC->Answer_Length + 1 + Command->Answer_Length > (int)sizeof(MAC->Answer))
+	{
+		return;
+	}
+
+	MAC->Answer[MAC->Answer_Length] = Command->CID;
+	memcpy(&MAC->Answer[MAC->Answer_Length + 1], Data, Command->Answer_Length);
+	MAC->Answer_Length += 1 + Command->Answer_Length;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that starts the MAC commands of a new session
+*
+* Arguments   : *MAC pointer to sMAC_Commands struct
+*****************************************************************************************
+*/
+void MAC_Init(sMAC_Commands *MAC)
+{
+	MAC->Answer_Length = 0;
+	MAC->Link_Check = 0x00;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that handles the MAC commands of a downlink, from the FOpts or
+*				from the payload of port 0
+*
+* Arguments   : *Commands pointer to the commands
+*				Length number of bytes
+*				*MAC pointer to sMAC_Commands struct
+*				*Message pointer to sLoRa_Message struct of the downlink
+*				*LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+void MAC_Process(unsigned char *Commands, unsigned char Length, sMAC_Commands *MAC, sLoRa_Message *Message, sSettings *LoRa_Settings)
+{
+	const sMAC_Command *Command;
+	unsigned char Answer[2];
+	unsigned char Position = 0;
+	unsigned char Count, Size, i;
+
+	while(Position < Length)
+	{
+		Command = MAC_Find(Commands[Position]);
+
+		//The rest can not be parsed
+		if(Command == NULL || Position + 1 + Command->Length > Length)
+		{
+			break;
+		}
+
+		//The same command right after it belongs to the block
+		Size = 1 + Command->Length;
+		Count = 1;
+		while(Command->Block && Position + (Count + 1) * Size <= Length && Commands[Position + Count * Size] == Command->CID)
+		{
+			Count++;
+		}
+
+		if(Command->Handler(&Commands[Position + 1], Count, Answer, MAC, Message, LoRa_Settings))
+		{
+			for(i = 0; i < Count; i++)
+			{
+				MAC_Add(MAC, Command, Answer);
+			}
+		}
+		Position += Count * Size;
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call for every valid downlink before its commands, the
+*				sticky answers are acknowledged by it
+*
+* Arguments   : *MAC pointer to sMAC_Commands struct
+*****************************************************************************************
+*/
+void MAC_Received(sMAC_Commands *MAC)
+{
+	MAC_Remove(MAC, 0x01);
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call when the answers are in the FOpts of an uplink, only the
+*				sticky answers stay
+*
+* Arguments   : *MAC pointer to sMAC_Commands struct
+*****************************************************************************************
+*/
+void MAC_Sent(sMAC_Commands *MAC)
+{
+	MAC_Remove(MAC, 0x00);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that asks the network for a LinkCheckAns with the next uplink
+*
+* Arguments   : *MAC pointer to sMAC_Commands struct
+*****************************************************************************************
+*/
+void MAC_Link_Check(sMAC_Commands *MAC)
+{
+	unsigned char Position = 0;
+
+	//Once is enough
+	while(Position < MAC->Answer_Length)
+	{
+		if(MAC->Answer[Position] == 0x02)
+		{
+			return;
+		}
+		Position += 1 + MAC_Find(MAC->Answer[Position])->Answer_Length;
+	}
+
+	MAC->Link_Check = 0x00;
+	MAC_Add(MAC, MAC_Find(0x02), MAC->Answer);
+}
@@ -0,0 +1,32 @@
+/****************************************************************************************
+* File:     MAC-Commands.h
+*
+* MAC commands of the network in the FOpts or on port 0, the answers go in the FOpts of
+* the next uplink
+****************************************************************************************/
+
+#ifndef MAC_COMMANDS_H
+#define MAC_COMMANDS_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Struct.h"
+#include "Config.h"
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+void MAC_Init(sMAC_Commands *MAC);
+void MAC_Process(unsigned char *Commands, unsigned char Length, sMAC_Commands *MAC, sLoRa_Message *Message, sSettings *LoRa_Settings);
+void MAC_Received(sMAC_Commands *MAC);
+void MAC_Sent(sMAC_Commands *MAC);
+void MAC_Link_Check(sMAC_Commands *MAC);
+
+#endif
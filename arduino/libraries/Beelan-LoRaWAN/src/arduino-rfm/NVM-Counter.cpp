@@ -0,0 +1,210 @@
+/****************************************************************************************
+* File:     NVM-Counter.cpp
+*
+* Frame counters of the session kept in the RWW EEPROM, enabled with FCNT_NVM in Config.h.
+* The counters are appended as records to a log of FCNT_NVM_ROWS rows, one record per page.
+* A row is only erased when the log moves into it, so the NVM wears evenly and the last
+* record is never lost during an erase. A record is written every FCNT_NVM_INTERVAL frames,
+* on a restore the uplink counter skips ahead FCNT_NVM_INTERVAL frames so a counter value
+* that was sent after the last record is never used again.
+****************************************************************************************/
+
+#include <string.h>
+#include "NVM-Counter.h"
+
+#ifdef FCNT_NVM
+
+#include <NVMClass.h>
+
+#define FCNT_NVM_SLOTS (FCNT_NVM_ROWS * (NVM_ROW_SIZE / NVM_PAGE_SIZE))
+#define FCNT_NVM_CHECK 0xA5A5A5A5
+
+//Record as it is stored in a page
+typedef struct {
+	uint32_t Sequence;
+	uint8_t  DevAddr[4];
+	uint32_t Frame_Counter_Up;
+	uint32_t Frame_Counter_Down;
+	uint32_t Check;
+} sNVM_Counter_Record;
+
+static NVMClass NVM;
+static bool NVM_Counter_Scanned = false;
+static uint32_t NVM_Counter_Sequence = 0;   //Sequence of the next record
+static unsigned int NVM_Counter_Slot = 0;   //Slot of the next record
+static uint32_t NVM_Counter_Saved = 0;      //Uplink counter of the last record
+
+static uint32_t NVM_Counter_Address(unsigned int Slot)
+{
+	return FCNT_NVM_ADDRESS + (uint32_t)Slot * NVM_PAGE_SIZE;
+}
+
+static uint32_t NVM_Counter_Checksum(sNVM_Counter_Record *Record)
+{
+	uint32_t DevAddr;
+
+	memcpy(&DevAddr, Record->DevAddr, 4);
+
+	return Record->Sequence ^ DevAddr ^ Record->Frame_Counter_Up ^ Record->Frame_Counter_Down ^ FCNT_NVM_CHECK;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that finds the newest valid record in the log and the slot for
+*				the next record
+*
+* Arguments   : *Last pointer to a record that gets the newest record
+*
+* Return      : bool true if there is a valid record
+*****************************************************************************************
+*/
+static bool NVM_Counter_Scan(sNVM_Counter_Record *Last)
+{
+	sNVM_Counter_Record Record;
+	unsigned int Slot;
+	bool Found = false;
+
+	for(Slot = 0; Slot < FCNT_NVM_SLOTS; Slot++)
+	{
+		NVM.read(NVM_Counter_Address(Slot), &Record, sizeof(Record));
+
+		if(Record.Check != NVM_Counter_Checksum(&Record))
+		{
+			continue;
+		}
+
+		if(!Found || Record.Sequence > Last->Sequence)
+		{
+			*Last = Record;
+			NVM_Counter_Sequence = Record.Sequence + 1;
+			NVM_Counter_Slot = (Slot + 1) % FCNT_NVM_SLOTS;
+			Found = true;
+		}
+	}
+
+	NVM_Counter_Scanned = true;
+
+	return Found;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that loads the frame counters of the session from the newest
+*				record when it has the same device address. The uplink counter continues
+*				FCNT_NVM_INTERVAL frames after the stored value and is written at once,
+*				so a reset before the next record does not use the same counters again.
+*
+* Arguments   : *Session_Data pointer to sLoRa_Session struct
+*
+* Return      : bool true if the counters are restored, false if there is no record for
+*				this device address and the counters are unchanged
+*****************************************************************************************
+*/
+bool NVM_Counter_Restore(sLoRa_Session *Session_Data)
+{
+	sNVM_Counter_Record Record;
+
+	if(!NVM_Counter_Scan(&Record))
+	{
+		return false;
+	}
+
+	if(memcmp(Record.DevAddr, Session_Data->DevAddr, 4) != 0)
+	{
+		return false;
+	}
+
+	*Session_Data->Frame_Counter = Record.Frame_Counter_Up + FCNT_NVM_INTERVAL;
+	*Session_Data->Frame_Counter_Down = Record.Frame_Counter_Down;
+	NVM_Counter_Save(Session_Data);
+
+	return true;
+}
+
+/*
+*****************************************************************************************
+* Description : Function for a session whose exact frame counters are already known,
+*				like after restoreSession(). The counters are not changed, only the
+*				uplink counter of the newest record is taken so the next record is
+*				written FCNT_NVM_INTERVAL frames after it. A record is written when the
+*				log has none for this device address.
+*
+* Arguments   : *Session_Data pointer to sLoRa_Session struct
+*****************************************************************************************
+*/
+void NVM_Counter_Resume(sLoRa_Session *Session_Data)
+{
+	sNVM_Counter_Record Record;
+
+	if(NVM_Counter_Scan(&Record) && memcmp(Record.DevAddr, Session_Data->DevAddr, 4) == 0)
+	{
+		NVM_Counter_Saved = Record.Frame_Counter_Up;
+	}
+	else
+	{
+		NVM_Counter_Save(Session_Data);
+	}
+}
+
+/*
+*****************************************************************************************
+* Description : Function that appends a record with the frame counters of the session.
+*				The row of the next slot is erased when the log enters it.
+*
+* Arguments   : *Session_Data pointer to sLoRa_Session struct
+*****************************************************************************************
+*/
+void NVM_Counter_Save(sLoRa_Session *Session_Data)
+{
+	sNVM_Counter_Record Record;
+	sNVM_Counter_Record Blank;
+	unsigned int Pages = NVM_ROW_SIZE / NVM_PAGE_SIZE;
+
+	if(!NVM_Counter_Scanned)
+	{
+		NVM_Counter_Scan(&Record);
+	}
+
+	//Erase the row when the log enters it. A page left over from an interrupted write
+	//is skipped by moving on to the next row.
+	memset(&Blank, 0xFF, sizeof(Blank));
+	NVM.read(NVM_Counter_Address(NVM_Counter_Slot), &Record, sizeof(Record));
+	if((NVM_Counter_Slot % Pages) != 0 && memcmp(&Record, &Blank, sizeof(Record)) != 0)
+	{
+		NVM_Counter_Slot = ((NVM_Counter_Slot / Pages + 1) * Pages) % FCNT_NVM_SLOTS;
+	}
+	if((NVM_Counter_Slot % Pages) == 0)
+	{
+		NVM.erase_row(NVM_Counter_Address(NVM_Counter_Slot));
+	}
+
+	Record.Sequence = NVM_Counter_Sequence;
+	memcpy(Record.DevAddr, Session_Data->DevAddr, 4);
+	Record.Frame_Counter_Up = *Session_Data->Frame_Counter;
+	Record.Frame_Counter_Down = *Session_Data->Frame_Counter_Down;
+	Record.Check = NVM_Counter_Checksum(&Record);
+
+	NVM.write_page(NVM_Counter_Address(NVM_Counter_Slot), &Record, sizeof(Record));
+
+	NVM_Counter_Sequence++;
+	NVM_Counter_Slot = (NVM_Counter_Slot + 1) % FCNT_NVM_SLOTS;
+	NVM_Counter_Saved = Record.Frame_Counter_Up;
+}
+
+/*
+*****************************************************************************************
+* Description : Function to call after the uplink counter is raised, appends a record
+*				every FCNT_NVM_INTERVAL frames
+*
+* Arguments   : *Session_Data pointer to sLoRa_Session struct
+*****************************************************************************************
+*/
+void NVM_Counter_Update(sLoRa_Session *Session_Data)
+{
+	if((uint32_t)(*Session_Data->Frame_Counter - NVM_Counter_Saved) >= FCNT_NVM_INTERVAL)
+	{
+		NVM_Counter_Save(Session_Data);
+	}
+}
+
+#endif
@@ -0,0 +1,51 @@
+/****************************************************************************************
+* File:     NVM-Counter.h
+*
+* Frame counters of the session kept in the RWW EEPROM, enabled with FCNT_NVM in Config.h
+****************************************************************************************/
+
+#ifndef NVM_COUNTER_H
+#define NVM_COUNTER_H
+
+/*
+********************************************************************************************
+* INCLUDES
+********************************************************************************************
+*/
+
+#include "Struct.h"
+#include "Config.h"
+
+/*
+********************************************************************************************
+* DEFINITIONS
+********************************************************************************************
+*/
+
+//Frames sent between two records, also the skip ahead of the uplink counter on a restore
+#ifndef FCNT_NVM_INTERVAL
+#define FCNT_NVM_INTERVAL 32
+#endif
+
+//Start of the log, must be the start of a row. Default the first row of the RWW EEPROM
+#ifndef FCNT_NVM_ADDRESS
+#define FCNT_NVM_ADDRESS 0x00400000
+#endif
+
+//Rows used for the log, one record per page. At least 2 so the last record survives an erase
+#ifndef FCNT_NVM_ROWS
+#define FCNT_NVM_ROWS 4
+#endif
+
+/*
+*****************************************************************************************
+* FUNCTION PROTOTYPES
+*****************************************************************************************
+*/
+
+bool NVM_Counter_Restore(sLoRa_Session *Session_Data);
+void NVM_Counter_Resume(sLoRa_Session *Session_Data);
+void NVM_Counter_Save(sLoRa_Session *Session_Data);
+void NVM_Counter_Update(sLoRa_Session *Session_Data);
+
+#endif
@@ -28,138 +28,58 @@
 
 #include <Arduino.h>
 #include <RF.h>
+#include <RFTiming.h>
 #include "RFM95.h"
 #include "Config.h"
+#include "Band-Plan.h"
 
-/**
- *  Lora Frequencies
- *    Tested on all subbands in US915 
- */
-#if defined(US_915)
-  #if defined(SUBND_0)//[902.3 - 903.7] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE1, 0x93, 0x59 }, //Channel [0], 902.3 MHz / 61.035 Hz = 14783321 = 0xE19359
-      { 0xE1, 0xA0, 0x26 }, //Channel [1], 902.5 MHz / 61.035 Hz = 14786598 = 0xE1A026
-      { 0xE1, 0xAC, 0xF3 }, //Channel [2], 902.7 MHz / 61.035 Hz = 14789875 = 0xE1ACF3
-      { 0xE1, 0xB9, 0xBF }, //Channel [3], 902.9 MHz / 61.035 Hz = 14793151 = 0xE1B9BF
-      { 0xE1, 0xC6, 0x8C }, //Channel [4], 903.1 MHz / 61.035 Hz = 14796428 = 0xE1C68C
-      { 0xE1, 0xD3, 0x59 }, //Channel [5], 903.3 MHz / 61.035 Hz = 14799705 = 0xE1D359
-      { 0xE1, 0xE0, 0x26 }, //Channel [6], 903.5 MHz / 61.035 Hz = 14802982 = 0xE1E026
-      { 0xE1, 0xEC, 0xF3 }, //Channel [7], 903.7 MHz / 61.035 Hz = 14806259 = 0xE1ECF3
-    };
-  #elif  defined(SUBND_1)//[903.9 - 905.3] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE1, 0xF9, 0xC0 }, //Channel [0], 903.9 MHz / 61.035 Hz = 14809536 = 0xE1F9C0
-      { 0xE2, 0x06, 0x8C }, //Channel [1], 904.1 MHz / 61.035 Hz = 14812812 = 0xE2068C
-      { 0xE2, 0x13, 0x59 }, //Channel [2], 904.3 MHz / 61.035 Hz = 14816089 = 0xE21359
-      { 0xE2, 0x20, 0x26 }, //Channel [3], 904.5 MHz / 61.035 Hz = 14819366 = 0xE22026
-      { 0xE2, 0x2C, 0xF3 }, //Channel [4], 904.7 MHz / 61.035 Hz = 14822643 = 0xE22CF3
-      { 0xE2, 0x39, 0xC0 }, //Channel [5], 904.9 MHz / 61.035 Hz = 14825920 = 0xE239C0
-      { 0xE2, 0x46, 0x8C }, //Channel [6], 905.1 MHz / 61.035 Hz = 14829196 = 0xE2468C
-      { 0xE2, 0x53, 0x59 }, //Channel [7], 905.3 MHz / 61.035 Hz = 14832473 = 0xE25359
-    };
-  #elif  defined(SUBND_2)//[905.5 - 906.9] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE2, 0x60, 0x26 }, //Channel [0], 905.5 MHz / 61.035 Hz = 14835750 = 0xE26026
-      { 0xE2, 0x6C, 0xF3 }, //Channel [1], 905.7 MHz / 61.035 Hz = 14839027 = 0xE26CF3
-      { 0xE2, 0x79, 0xC0 }, //Channel [2], 905.9 MHz / 61.035 Hz = 14842304 = 0xE279C0
-      { 0xE2, 0x86, 0x8C }, //Channel [3], 906.1 MHz / 61.035 Hz = 14845580 = 0xE2868C
-      { 0xE2, 0x93, 0x59 }, //Channel [4], 906.3 MHz / 61.035 Hz = 14848857 = 0xE29359
-      { 0xE2, 0xA0, 0x26 }, //Channel [5], 906.5 MHz / 61.035 Hz = 14852134 = 0xE2A026
-      { 0xE2, 0xAC, 0xF3 }, //Channel [6], 906.7 MHz / 61.035 Hz = 14855411 = 0xE2ACF3
-      { 0xE2, 0xB9, 0xC0 }, //Channel [7], 906.9 MHz / 61.035 Hz = 14858688 = 0xE2B9C0
-    };
-  #elif  defined(SUBND_3)//[907.1 - 908.5] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE2, 0xC6, 0x8C }, //Channel [0], 907.1 MHz / 61.035 Hz = 14861964 = 0xE2C68C
-      { 0xE2, 0xD3, 0x59 }, //Channel [1], 907.3 MHz / 61.035 Hz = 14865241 = 0xE2D359
-      { 0xE2, 0xE0, 0x26 }, //Channel [2], 907.5 MHz / 61.035 Hz = 14868518 = 0xE2E026
-      { 0xE2, 0xEC, 0xF3 }, //Channel [3], 907.7 MHz / 61.035 Hz = 14871795 = 0xE2ECF3
-      { 0xE2, 0xF9, 0xC0 }, //Channel [4], 907.9 MHz / 61.035 Hz = 14875072 = 0xE2F9C0
-      { 0xE3, 0x06, 0x8C }, //Channel [5], 908.1 MHz / 61.035 Hz = 14878348 = 0xE3068C
-      { 0xE3, 0x13, 0x59 }, //Channel [6], 908.3 MHz / 61.035 Hz = 14881625 = 0xE31359
-      { 0xE3, 0x20, 0x26 }, //Channel [7], 908.5 MHz / 61.035 Hz = 14884902 = 0xE32026
-    };
-  #elif  defined(SUBND_4)//[908.7 - 910.1] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE3, 0x2C, 0xF3 }, //Channel [0], 908.7 MHz / 61.035 Hz = 14888179 = 0xE32CF3
-      { 0xE3, 0x39, 0xC0 }, //Channel [1], 908.9 MHz / 61.035 Hz = 14891456 = 0xE339C0
-      { 0xE3, 0x46, 0x8D }, //Channel [2], 909.1 MHz / 61.035 Hz = 14894733 = 0xE3468D
-      { 0xE3, 0x53, 0x59 }, //Channel [3], 909.3 MHz / 61.035 Hz = 14898009 = 0xE35359
-      { 0xE3, 0x60, 0x26 }, //Channel [4], 909.5 MHz / 61.035 Hz = 14901286 = 0xE36026
-      { 0xE3, 0x6C, 0xF3 }, //Channel [5], 909.7 MHz / 61.035 Hz = 14904563 = 0xE36CF3
-      { 0xE3, 0x79, 0xC0 }, //Channel [6], 909.9 MHz / 61.035 Hz = 14907840 = 0xE379C0
-      { 0xE3, 0x86, 0x8D }, //Channel [7], 910.1 MHz / 61.035 Hz = 14911117 = 0xE3868D
-    };
-  #elif  defined(SUBND_5)//[910.3 - 911.7] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE3, 0x93, 0x59 }, //Channel [0], 910.3 MHz / 61.035 Hz = 14914393 = 0xE39359
-      { 0xE3, 0xA0, 0x26 }, //Channel [1], 910.5 MHz / 61.035 Hz = 14917670 = 0xE3A026
-      { 0xE3, 0xAC, 0xF3 }, //Channel [2], 910.7 MHz / 61.035 Hz = 14920947 = 0xE3ACF3
-      { 0xE3, 0xB9, 0xC0 }, //Channel [3], 910.9 MHz / 61.035 Hz = 14924224 = 0xE3B9C0
-      { 0xE3, 0xC6, 0x8D }, //Channel [4], 911.1 MHz / 61.035 Hz = 14927501 = 0xE3C68D
-      { 0xE3, 0xD3, 0x59 }, //Channel [5], 911.3 MHz / 61.035 Hz = 14930777 = 0xE3D359
-      { 0xE3, 0xE0, 0x26 }, //Channel [6], 911.5 MHz / 61.035 Hz = 14934054 = 0xE3E026
-      { 0xE3, 0xEC, 0xF3 }, //Channel [7], 911.7 MHz / 61.035 Hz = 14937331 = 0xE3ECF3
-    };
-  #elif  defined(SUBND_6)//[911.9 - 913.3] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE3, 0xF9, 0xC0 }, //Channel [0], 911.9 MHz / 61.035 Hz = 14940608 = 0xE3F9C0
-      { 0xE4, 0x06, 0x8D }, //Channel [1], 912.1 MHz / 61.035 Hz = 14943885 = 0xE4068D
-      { 0xE4, 0x13, 0x59 }, //Channel [2], 912.3 MHz / 61.035 Hz = 14947161 = 0xE41359
-      { 0xE4, 0x20, 0x26 }, //Channel [3], 912.5 MHz / 61.035 Hz = 14950438 = 0xE42026
-      { 0xE4, 0x2C, 0xF3 }, //Channel [4], 912.7 MHz / 61.035 Hz = 14953715 = 0xE42CF3
-      { 0xE4, 0x39, 0xC0 }, //Channel [5], 912.9 MHz / 61.035 Hz = 14956992 = 0xE439C0
-      { 0xE4, 0x46, 0x8D }, //Channel [6], 913.1 MHz / 61.035 Hz = 14960269 = 0xE4468D
-      { 0xE4, 0x53, 0x5A }, //Channel [7], 913.3 MHz / 61.035 Hz = 14963546 = 0xE4535A
-    };
-  #elif  defined(SUBND_7)//[913.5 - 914.9] MHz
-    static const unsigned char LoRa_TX_Freq[8][3] = {
-      { 0xE4, 0x60, 0x26 }, //Channel [0], 913.5 MHz / 61.035 Hz = 14966822 = 0xE46026
-      { 0xE4, 0x6C, 0xF3 }, //Channel [1], 913.7 MHz / 61.035 Hz = 14970099 = 0xE46CF3
-      { 0xE4, 0x79, 0xC0 }, //Channel [2], 913.9 MHz / 61.035 Hz = 14973376 = 0xE479C0
-      { 0xE4, 0x86, 0x8D }, //Channel [3], 914.1 MHz / 61.035 Hz = 14976653 = 0xE4868D
-      { 0xE4, 0x93, 0x5A }, //Channel [4], 914.3 MHz / 61.035 Hz = 14979930 = 0xE4935A
-      { 0xE4, 0xA0, 0x26 }, //Channel [5], 914.5 MHz / 61.035 Hz = 14983206 = 0xE4A026
-      { 0xE4, 0xAC, 0xF3 }, //Channel [6], 914.7 MHz / 61.035 Hz = 14986483 = 0xE4ACF3
-      { 0xE4, 0xB9, 0xC0 }, //Channel [7], 914.9 MHz / 61.035 Hz = 14989760 = 0xE4B9C0
-    };
-  #endif
-  static const unsigned char LoRa_RX_Freq[8][3] = {
-    { 0xE6, 0xD3, 0x5A}, //Rcv Channel [0] 923.3 Mhz / 61.035 Hz = 15127386 = 0xE6D35A
-    { 0xE6, 0xF9, 0xC0}, //Rcv Channel [1] 923.9 Mhz / 61.035 Hz = 15137216 = 0xE6F9C0
-    { 0xE7, 0x20, 0x27}, //Rcv Channel [2] 924.5 Mhz / 61.035 Hz = 15147047 = 0xE72027
-    { 0xE7, 0x46, 0x8D}, //Rcv Channel [3] 925.1 Mhz / 61.035 Hz = 15156877 = 0xE7468D
-    { 0xE7, 0x6C, 0xF4}, //Rcv Channel [4] 925.7 Mhz / 61.035 Hz = 15166708 = 0xE76CF4
-    { 0xE7, 0x93, 0x5A}, //Rcv Channel [5] 926.3 Mhz / 61.035 Hz = 15176538 = 0xE7935A
-    { 0xE7, 0xB9, 0xC0}, //Rcv Channel [6] 926.9 Mhz / 61.035 Hz = 15186368 = 0xE7B9C0
-    { 0xE7, 0xE0, 0x27}, //Rcv Channel [7] 927.5 Mhz / 61.035 Hz = 15196199 = 0xE7E027
-  };
-#elif defined(AS_923)
-  const unsigned char  [9][3] = {//[923.2 - 924.8] MHz
-    { 0xE6, 0xCC, 0xF4 }, //Channel [0], 923.2 MHz / 61.035 Hz = 15125748 = 0xE6CCF4
-    { 0xE6, 0xD9, 0xC0 }, //Channel [1], 923.4 MHz / 61.035 Hz = 15129024 = 0xE6D9C0
-    { 0xE6, 0xE6, 0x8D }, //Channel [2], 923.6 MHz / 61.035 Hz = 15132301 = 0xE6E68D
-    { 0xE6, 0xF3, 0x5A }, //Channel [3], 923.8 MHz / 61.035 Hz = 15135578 = 0xE6F35A
-    { 0xE7, 0x00, 0x27 }, //Channel [4], 924.0 MHz / 61.035 Hz = 15138855 = 0xE70027
-    { 0xE7, 0x0C, 0xF4 }, //Channel [5], 924.2 MHz / 61.035 Hz = 15142132 = 0xE70CF4
-    { 0xE7, 0x19, 0xC0 }, //Channel [6], 924.4 MHz / 61.035 Hz = 15145408 = 0xE719C0
-    { 0xE7, 0x26, 0x8D }, //Channel [7], 924.6 MHz / 61.035 Hz = 15148685 = 0xE7268D
-    { 0xE7, 0x33, 0x5A }, //Channel [8], 924.8 MHz / 61.035 Hz = 15151962 = 0xE7335A
-  };
-#elif defined(EU_868)
-  static const unsigned char LoRa_Frequency[9][3] = {//[868.1 - 867.9] MHz
-    { 0xD9, 0x06, 0x8B }, //Channel [0], 868.1 MHz / 61.035 Hz = 14222987 = 0xD9068B
-    { 0xD9, 0x13, 0x58 }, //Channel [1], 868.3 MHz / 61.035 Hz = 14226264 = 0xD91358
-    { 0xD9, 0x20, 0x24 }, //Channel [2], 868.5 MHz / 61.035 Hz = 14229540 = 0xD92024
-    { 0xD8, 0xC6, 0x8B }, //Channel [3], 867.1 MHz / 61.035 Hz = 14206603 = 0xD8C68B
-    { 0xD8, 0xD3, 0x58 }, //Channel [4], 867.3 MHz / 61.035 Hz = 14209880 = 0xD8D358
-    { 0xD8, 0xE0, 0x24 }, //Channel [5], 867.5 MHz / 61.035 Hz = 14213156 = 0xD8E024
-    { 0xD8, 0xEC, 0xF1 }, //Channel [6], 867.7 MHz / 61.035 Hz = 14216433 = 0xD8ECF1
-    { 0xD8, 0xF9, 0xBE }, //Channel [7], 867.9 MHz / 61.035 Hz = 14219710 = 0xD8F9BE
-    { 0xD9, 0x61, 0xBE }, //Receive channel 869.525 MHz / 61.035 Hz = 14246334 = 0xD961BE    
-  };
+//Packages the RxDone interrupt of class C keeps until RFM_Get_Queued_Package
+#ifndef RFM_RX_QUEUE_SIZE
+#define RFM_RX_QUEUE_SIZE 2
 #endif
+//One slot of the ring stays free to tell a full ring from an empty one
+#define RFM_RX_QUEUE_SLOTS (RFM_RX_QUEUE_SIZE + 1)
+
+//Frequencies NewChannelReq and RXParamSetupReq set, in place of the band plan for the
+//channels of RFM_Frequency_Set. Index BAND_MAX_CHANNELS is the receive channel 0x10
+static unsigned char RFM_Frequency[BAND_MAX_CHANNELS + 1][3];
+static unsigned int RFM_Frequency_Set = 0;
+
+//0x01 while the RFM is in continuous receive and the interrupt owns the SPI bus
+static volatile unsigned char RFM_Rx_Armed = 0x00;
+//0x01 while the RxDone interrupt reads a package, its transfers need no lock
+static volatile unsigned char RFM_In_Interrupt = 0x00;
+
+/*
+*****************************************************************************************
+* Description : Functions around one SPI transfer. In continuous receive the RxDone
+*               interrupt reads the RFM, the transfers of the main context are done with
+*               interrupts masked so it can not cut into them. Out of continuous receive
+*               the interrupt does not use the SPI bus and nothing is masked. The mask of
+*               the caller is kept, a transfer inside noInterrupts() leaves them masked.
+*
+* Returns     : RFM_Lock the PRIMASK of the caller, to give to RFM_Unlock
+*****************************************************************************************
+*/
+
+static unsigned int RFM_Lock(void)
+{
+  unsigned int Mask = __get_PRIMASK();
+
+  if(RFM_Rx_Armed && !RFM_In_Interrupt)
+  {
+    __disable_irq();
+  }
+  return Mask;
+}
+
+static void RFM_Unlock(unsigned int Mask)
+{
+  if(!RFM_In_Interrupt)
+  {
+    __set_PRIMASK(Mask);
+  }
+}
 
 /*
 *****************************************************************************************
@@ -175,6 +95,8 @@ static unsigned char RFM_Read(unsigned char RFM_Address)
 {
   unsigned char RFM_Data;
 
+  unsigned int Irq_Mask = RFM_Lock();
+
   //Set NSS pin low to start RF communication
   digitalWrite(RFM_pins.CS,LOW);
 
@@ -186,6 +108,8 @@ static unsigned char RFM_Read(unsigned char RFM_Address)
   //Set NSS high to end communication
   digitalWrite(RFM_pins.CS,HIGH);
 
+  RFM_Unlock(Irq_Mask);
+
   #ifdef DEBUG
   //Serial.print("RF Read ADDR: ");
   //Serial.print(RFM_Address, HEX);
@@ -205,11 +129,23 @@ static unsigned char RFM_Read(unsigned char RFM_Address)
 *                      0x04 -> 31.25khz , 0x05 -> 41.7khz, 0x06 -> 62.5khz, 0x07 -> 125khz, 
 *                      0x08 -> 250khz   , 0x09 -> 500khz}
 ********************************************************************************************/
+//Modem config 2 without the symbol timeout bits, see RFM_Start_Single_Receive
+static unsigned char RFM_Modem_Config_2 = 0x74;
+
 static void RFM_change_SF_BW(unsigned char _SF, unsigned char _BW)
 {
-	RFM_Write(0x1E,(_SF << 4) | 0x04); //SFx CRC On
+	static const unsigned long Bandwidth[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+	rf_timing_t Timing;
+
+	rfTimingInit(&Timing);
+	Timing.sf = _SF;
+	Timing.bandwidth = Bandwidth[_BW];
+
+	RFM_Modem_Config_2 = (_SF << 4) | 0x04;
+	RFM_Write(0x1E,RFM_Modem_Config_2); //SFx CRC On
 	RFM_Write(0x1D,(_BW << 4) | 0x02); //x kHz 4/5 coding rate explicit header mode
-	RFM_Write(0x26,0x04); //Mobile node, low datarate optimization on AGC acorging to register LnaGain
+	//Mobile node, AGC acording to register LnaGain, low datarate optimization for symbols of 16 ms and more
+	RFM_Write(0x26,rfLowDataRate(&Timing) ? 0x0C : 0x04);
 }
 /*
 *****************************************************************************************
@@ -221,100 +157,332 @@ static void RFM_change_SF_BW(unsigned char _SF, unsigned char _BW)
 */
 static void RFM_Change_Datarate(unsigned char Datarate)
 {
-#if defined(US_915)
-  switch (Datarate) {
-  case 0x00:  // SF10BW125
-    RFM_change_SF_BW(10,0x07);
-    break;
-  case 0x01:  // SF9BW125
-    RFM_change_SF_BW(9,0x07);
-    break;
-  case 0x02:  // SF8BW125
-    RFM_change_SF_BW(8,0x07);
-    break;
-  case 0x03:  // SF7BW125
-    RFM_change_SF_BW(7,0x07);
-    break;
-  case 0x04:  // SF8BW500
-    RFM_change_SF_BW(8,0x09);
-    break;
-  case 0x08:  // SF12BW500
-    RFM_change_SF_BW(12,0x09);
-    break;
-  case 0x09:  // SF11BW500
-    RFM_change_SF_BW(11,0x09);
-    break;
-  case 0x0A:  // SF10BW500
-    RFM_change_SF_BW(10,0x09);
-    break;
-  case 0x0B:  // SF9BW500
-    RFM_change_SF_BW(9,0x09);
-    break;
-  case 0x0C:  // SF8BW500
-    RFM_change_SF_BW(8,0x09);
-    break;
-  case 0x0D:  // SF7BW500
-    RFM_change_SF_BW(7,0x09);
-    break;
-  }
-#else
-  switch (Datarate) {
-  case 0x00:  // SF12BW125
-    RFM_change_SF_BW(12,0x07);
-    break;
-  case 0x01:  // SF11BW125
-    RFM_change_SF_BW(11,0x07);
-    break;
-  case 0x02:  // SF10BW125
-    RFM_change_SF_BW(10,0x07);
-    break;
-  case 0x03:  // SF9BW125
-    RFM_change_SF_BW(9,0x07);
-    break;
-  case 0x04:  // SF8BW125
-    RFM_change_SF_BW(8,0x07);
-    break;
-  case 0x05:  // SF7BW125
-    RFM_change_SF_BW(7,0x07);
-    break;
-  case 0x06:  // SF7BW250
-    RFM_change_SF_BW(7,0x08);
-    break;
-  }
-#endif
+  if (Datarate < BAND_PLAN.Datarates && BAND_PLAN.Datarate[Datarate].SF != 0)
+    RFM_change_SF_BW(BAND_PLAN.Datarate[Datarate].SF, BAND_PLAN.Datarate[Datarate].BW);
 }
 /*
 *****************************************************************************************
 * Description : Function to change the channel of the RFM module. Setting the following
 *				register: Channel
 *
-* Arguments   : Channel the channel to set
+* Arguments   : Channel the channel to set, see Band-Plan.h
 *****************************************************************************************
 */
 static void RFM_Change_Channel(unsigned char Channel)
 {
-#if defined(AS_923)
-  if (Channel <= 0x08)
-    for(unsigned char i = 0 ; i < 3 ; ++i)
-      RFM_Write(0x06 + i, pgm_read_byte(&(LoRa_Frequency[Channel][i])));
-  else if (Channel == 0x10)
-    for(unsigned char i = 0 ; i < 3 ; ++i)
-      RFM_Write(0x06 + i, pgm_read_byte(&(LoRa_Frequency[0][i])));
-#elif defined(EU_868)
-  if (Channel <= 0x08)
-    for(unsigned char i = 0 ; i < 3 ; ++i)
-      RFM_Write(0x06 + i, pgm_read_byte(&(LoRa_Frequency[Channel][i])));
-  else if (Channel == 0x10)
-    for(unsigned char i = 0 ; i < 3 ; ++i)
-      RFM_Write(0x06 + i, pgm_read_byte(&(LoRa_Frequency[8][i])));
-#else   //US915
-  if (Channel <= 0x07)
-    for(unsigned char i = 0 ; i < 3 ; ++i)
-      RFM_Write(0x06 + i, pgm_read_byte(&(LoRa_TX_Freq[Channel][i])));
-  else if (Channel >= 0x08 && Channel <= 0x0F)
-    for(unsigned char i = 0 ; i < 3 ; ++i)
-      RFM_Write(0x06 + i, pgm_read_byte(&(LoRa_RX_Freq[Channel - 0x08][i])));
-#endif
+  const unsigned char *Frf;
+
+  if (Channel < BAND_PLAN.Uplink_Channels)
+    Frf = (RFM_Frequency_Set & (1 << Channel)) ? RFM_Frequency[Channel] : BAND_PLAN.Uplink[Channel].Frf;
+  else if (Channel >= 0x08 && Channel - 0x08 < BAND_PLAN.Downlink_Channels)
+    Frf = BAND_PLAN.Downlink[Channel - 0x08].Frf;
+  else if (Channel == BAND_RX2_CHANNEL)
+    Frf = (RFM_Frequency_Set & (1 << BAND_MAX_CHANNELS)) ? RFM_Frequency[BAND_MAX_CHANNELS] : BAND_PLAN.Rx2.Frf;
+  else
+    return;
+
+  for(unsigned char i = 0 ; i < 3 ; ++i)
+    RFM_Write(0x06 + i, Frf[i]);
+}
+
+/*
+*****************************************************************************************
+* Description : Function to change the frequency of a channel, for the NewChannelReq and
+*				RXParamSetupReq of the network. Used at the next switch to the channel.
+*
+* Arguments   : Channel the channel to change, 0x10 for the receive channel
+*				Frequency in Hz
+*
+* Return      : bool false when the channel has a fixed frequency
+*****************************************************************************************
+*/
+bool RFM_Set_Frequency(unsigned char Channel, unsigned long Frequency)
+{
+  unsigned long Frf;
+
+  if (BAND_PLAN.Min_Frequency == 0)
+    return false;
+  if (Channel == BAND_RX2_CHANNEL)
+    Channel = BAND_MAX_CHANNELS;
+  else if (Channel >= BAND_PLAN.Uplink_Channels)
+    return false;
+
+  Frf = Band_Frf(Frequency);
+
+  RFM_Frequency[Channel][0] = (Frf >> 16) & 0xFF;
+  RFM_Frequency[Channel][1] = (Frf >> 8) & 0xFF;
+  RFM_Frequency[Channel][2] = Frf & 0xFF;
+  RFM_Frequency_Set |= (1 << Channel);
+  return true;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that copies the frequencies the network set, for saveSession()
+*
+* Arguments   : *Frequency pointer to (BAND_MAX_CHANNELS + 1) * 3 bytes, the FRF registers
+*				of the channels and of the receive channel
+*
+* Return      : unsigned int bit per channel with a frequency of the network
+*****************************************************************************************
+*/
+unsigned int RFM_Get_Frequencies(unsigned char *Frequency)
+{
+  memcpy(Frequency, RFM_Frequency, sizeof(RFM_Frequency));
+  return RFM_Frequency_Set;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that sets the frequencies of RFM_Get_Frequencies() again, for
+*				restoreSession()
+*
+* Arguments   : Set bit per channel with a frequency of the network
+*				*Frequency pointer to (BAND_MAX_CHANNELS + 1) * 3 bytes
+*****************************************************************************************
+*/
+void RFM_Set_Frequencies(unsigned int Set, const unsigned char *Frequency)
+{
+  memcpy(RFM_Frequency, Frequency, sizeof(RFM_Frequency));
+  RFM_Frequency_Set = Set & ((1 << (BAND_MAX_CHANNELS + 1)) - 1);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that goes back to the frequencies of the band plan, the network
+*				of a new join did not set any yet
+*****************************************************************************************
+*/
+void RFM_Reset_Frequencies(void)
+{
+  RFM_Frequency_Set = 0;
+}
+
+//Shadow copy of the configuration registers, a write with the same value is skipped
+static unsigned char RFM_Shadow[0x41];
+static unsigned char RFM_Shadow_Valid[9];
+static unsigned char RFM_Frf_Pending = 0x00;
+static unsigned long RFM_Writes_Issued = 0;
+static unsigned long RFM_Writes_Elided = 0;
+
+/*
+*****************************************************************************************
+* Description : Function that tells if a register is kept in the shadow. Only registers
+*               that the RFM does not change by itself are shadowed.
+*
+* Arguments   : RFM_Address Address of the register
+*****************************************************************************************
+*/
+
+static bool RFM_Is_Shadowed(unsigned char RFM_Address)
+{
+  switch(RFM_Address)
+  {
+    case 0x06: //Frequency
+    case 0x07:
+    case 0x08:
+    case 0x09: //PA config
+    case 0x0C: //LNA
+    case 0x0E: //FiFo Tx base address
+    case 0x0F: //FiFo Rx base address
+    case 0x1D: //Modem config 1
+    case 0x1E: //Modem config 2
+    case 0x1F: //Symbol timeout
+    case 0x20: //Preamble length
+    case 0x21:
+    case 0x26: //Modem config 3
+    case 0x33: //IQ
+    case 0x39: //Sync word
+    case 0x3B: //IQ2
+    case 0x40: //DIO mapping
+      return true;
+    default:
+      return false;
+  }
+}
+
+//Events set by the DIO interrupts, cleared by RFM_Get_Events
+static volatile unsigned char RFM_Events = 0x00;
+//micros() of the last DIO0 or DIO1 interrupt, TxDone, RxDone and RxTimeout
+static volatile unsigned long RFM_Event_Time = 0;
+//micros() of the last switch to TX
+static unsigned long RFM_Tx_Time = 0;
+
+//Package taken from the FiFo by the RxDone interrupt
+typedef struct {
+  unsigned char Length;
+  signed char SNR;
+  short RSSI;
+  unsigned char SF;
+  unsigned char Data[255];
+} sRFM_Rx_Slot;
+
+//Ring of received packages, the interrupt writes at the head and the MAC reads at the tail
+static sRFM_Rx_Slot RFM_Rx_Queue[RFM_RX_QUEUE_SLOTS];
+static volatile unsigned char RFM_Rx_Head = 0;
+static volatile unsigned char RFM_Rx_Tail = 0;
+//Packages lost because the ring was full
+static volatile unsigned long RFM_Rx_Dropped = 0;
+
+static void RFM_Rx_Queue_Take(void);
+
+static void RFM_DIO0_Interrupt(void)
+{
+  RFM_Event_Time = micros();
+
+  //Class C, take the package so the next one can not overwrite it
+  if(RFM_Rx_Armed)
+  {
+    RFM_In_Interrupt = 0x01;
+    RFM_Rx_Queue_Take();
+    RFM_In_Interrupt = 0x00;
+  }
+
+  RFM_Events |= RFM_EVENT_DIO0;
+}
+
+static void RFM_DIO1_Interrupt(void)
+{
+  RFM_Event_Time = micros();
+  RFM_Events |= RFM_EVENT_DIO1;
+}
+
+static void RFM_DIO2_Interrupt(void)
+{
+  RFM_Events |= RFM_EVENT_DIO2;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that returns the DIO events that fired and clears them
+*
+* Arguments   : Mask RFM_EVENT_DIOx bits to check
+*
+* Return      : unsigned char the bits of Mask that fired, 0x00 if none
+*****************************************************************************************
+*/
+
+unsigned char RFM_Get_Events(unsigned char Mask)
+{
+  unsigned char Events;
+
+  noInterrupts();
+  Events = RFM_Events & Mask;
+  RFM_Events &= ~Mask;
+  interrupts();
+
+  return Events;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that returns when the last DIO0 or DIO1 event fired. The event
+*               is seen by the MAC when it polls, this is the time the radio raised the line.
+*
+* Arguments   : -
+*
+* Return      : unsigned long micros() of the last DIO0 or DIO1 interrupt
+*****************************************************************************************
+*/
+
+unsigned long RFM_Get_Event_Time(void)
+{
+  unsigned long Time;
+
+  noInterrupts();
+  Time = RFM_Event_Time;
+  interrupts();
+
+  return Time;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that returns when the last transmission was started
+*
+* Arguments   : -
+*
+* Return      : unsigned long micros() right after the switch to TX
+*****************************************************************************************
+*/
+
+unsigned long RFM_Get_Tx_Time(void)
+{
+  return RFM_Tx_Time;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that puts the core in idle sleep until one of the DIO events in
+*               Mask fires. The events are not cleared, use RFM_Get_Events for that.
+*               Other interrupts (SysTick, UART) wake the core too, it goes back to sleep
+*               until the radio event is there.
+*
+* Arguments   : Mask RFM_EVENT_DIOx bits to wait for
+*
+* Return      : unsigned char the bits of Mask that fired
+*****************************************************************************************
+*/
+
+unsigned char RFM_Wait_Event(unsigned char Mask)
+{
+  unsigned char Events;
+
+  sys_set_sleep_mode(SLEEP_MODE_IDLE);
+
+  //Check and sleep with interrupts masked, a pending interrupt still ends the WFI
+  noInterrupts();
+  while((RFM_Events & Mask) == 0x00)
+  {
+    sys_sleep();
+    interrupts();
+    noInterrupts();
+  }
+  Events = RFM_Events & Mask;
+  interrupts();
+
+  return Events;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that returns the number of register writes sent to the RFM and
+*               the number of writes skipped because the shadow register already had the value
+*
+* Arguments   : *Issued pointer to the number of writes sent
+*               *Elided pointer to the number of writes skipped
+*****************************************************************************************
+*/
+
+void RFM_Get_Write_Stats(unsigned long *Issued, unsigned long *Elided)
+{
+  *Issued = RFM_Writes_Issued;
+  *Elided = RFM_Writes_Elided;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that clears the write counters
+*****************************************************************************************
+*/
+
+void RFM_Clear_Write_Stats(void)
+{
+  RFM_Writes_Issued = 0;
+  RFM_Writes_Elided = 0;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that forgets the shadow registers, the next write of every
+*               register goes to the RFM. Used after a reset of the RFM.
+*****************************************************************************************
+*/
+
+static void RFM_Clear_Shadow(void)
+{
+  memset(RFM_Shadow_Valid, 0x00, sizeof(RFM_Shadow_Valid));
+  RFM_Frf_Pending = 0x00;
 }
 
 /*
@@ -329,6 +497,18 @@ bool RFM_Init()
   if(ver!=18){
     return 0;
   }
+
+  //The RFM is just reset, the shadow registers are unknown
+  RFM_Clear_Shadow();
+
+  //Attach the DIO lines to the event flags
+  RFM_Events = 0x00;
+  RFM_Rx_Armed = 0x00;
+  RFM_Rx_Head = RFM_Rx_Tail;
+  attachInterrupt(RFM_pins.DIO0, RFM_DIO0_Interrupt, RISING);
+  attachInterrupt(RFM_pins.DIO1, RFM_DIO1_Interrupt, RISING);
+  attachInterrupt(RFM_pins.DIO2, RFM_DIO2_Interrupt, RISING);
+
   //Switch RFM to sleep
   //DON'T USE Switch mode function
   RFM_Write(0x01,0x00);
@@ -356,7 +536,7 @@ bool RFM_Init()
   RFM_Change_Datarate(0x00);
 
   //Rx Timeout set to 37 symbols
-  RFM_Write(0x1F,0x25);
+  RFM_Write(0x1F,RFM_RX_SYMBOL_TIMEOUT);
 
   //Preamble length set to 8 symbols
   //0x0008 + 4 = 12
@@ -376,7 +556,57 @@ bool RFM_Init()
 
 /*
 *****************************************************************************************
-* Description : Function for sending a package with the RFM
+* Description: Function used to take over a RFM that kept its registers during a sleep
+*              of the MCU, like the BACKUP mode. The registers that RFM_Init sets and that
+*              never change afterwards are checked, the RFM is not reset.
+*
+* Return     : bool true if the RFM is configured and in standby, false if it needs a
+*              reset and RFM_Init
+*****************************************************************************************
+*/
+
+bool RFM_Resume()
+{
+  unsigned char Mode;
+
+  if(RFM_Read(0x42) != 18)
+  {
+    return 0;
+  }
+
+  //LoRa mode, sleep or standby
+  Mode = RFM_Read(0x01);
+  if((Mode & 0x80) == 0x00 || (Mode & 0x07) > 0x01)
+  {
+    return 0;
+  }
+
+  //Sync word and FIFO pointers
+  if(RFM_Read(0x39) != 0x34 || RFM_Read(0x0E) != 0x80 || RFM_Read(0x0F) != 0x00)
+  {
+    return 0;
+  }
+
+  //The MCU has lost the shadow registers
+  RFM_Clear_Shadow();
+
+  //Attach the DIO lines to the event flags
+  RFM_Events = 0x00;
+  RFM_Rx_Armed = 0x00;
+  RFM_Rx_Head = RFM_Rx_Tail;
+  attachInterrupt(RFM_pins.DIO0, RFM_DIO0_Interrupt, RISING);
+  attachInterrupt(RFM_pins.DIO1, RFM_DIO1_Interrupt, RISING);
+  attachInterrupt(RFM_pins.DIO2, RFM_DIO2_Interrupt, RISING);
+
+  //Clear the interrupts of the last cycle and switch to standby
+  RFM_Write(0x12,0xFF);
+  RFM_Switch_Mode(0x01);
+  return 1;
+}
+
+/*
+*****************************************************************************************
+* Description : Function for sending a package with the RFM, waits until the package is sent
 *
 * Arguments   : *RFM_Tx_Package pointer to buffer with data and counter of data
 *               *LoRa_Settings pointer to sSettings struct
@@ -385,7 +615,27 @@ bool RFM_Init()
 
 void RFM_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings)
 {
-  unsigned char i;
+  RFM_Start_Send_Package(RFM_Tx_Package, LoRa_Settings);
+
+  //Sleep until TxDone
+  RFM_Wait_Event(RFM_EVENT_DIO0);
+  RFM_Get_Events(RFM_EVENT_DIO0);
+
+  RFM_Finish_Send_Package(LoRa_Settings);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that loads a package in the RFM and starts the transmission.
+*               DIO0 goes high on TxDone, then call RFM_Finish_Send_Package.
+*
+* Arguments   : *RFM_Tx_Package pointer to buffer with data and counter of data
+*               *LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
+
+void RFM_Start_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings)
+{
   unsigned char RFM_Tx_Location = 0x00;
 
   //Set RFM in Standby mode
@@ -397,6 +647,9 @@ void RFM_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings)
   //Switch Channel
   RFM_Change_Channel(LoRa_Settings->Channel_Tx);
 
+  //Transmit power, PA_BOOST with 2 dBm + Transmit_Power
+  RFM_Write(0x09,0xF0 + LoRa_Settings->Transmit_Power);
+
   //Switch DIO0 to TxDone
   RFM_Write(0x40,0x40);
 
@@ -414,17 +667,25 @@ void RFM_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings)
   RFM_Write(0x0D,RFM_Tx_Location);
 
   //Write Payload to FiFo
-  for (i = 0;i < RFM_Tx_Package->Counter; i++)
-  {
-    RFM_Write(0x00, RFM_Tx_Package->Data[i]);
-  }
+  RFM_Write_Burst(0x00, RFM_Tx_Package->Data, RFM_Tx_Package->Counter);
 
-  //Switch RFM to Tx
+  //Clear old events and switch RFM to Tx
+  RFM_Get_Events(RFM_EVENT_DIO0 | RFM_EVENT_DIO1 | RFM_EVENT_DIO2);
   RFM_Write(0x01,0x83);
+  RFM_Tx_Time = micros();
+}
 
-  //Wait for TxDone
-  while(digitalRead(RFM_pins.DIO0) == LOW);
+/*
+*****************************************************************************************
+* Description : Function to call after TxDone, clears the interrupt and switches a type C
+*               mote back to continuous receive
+*
+* Arguments   : *LoRa_Settings pointer to sSettings struct
+*****************************************************************************************
+*/
 
+void RFM_Finish_Send_Package(sSettings *LoRa_Settings)
+{
   //Clear interrupt
   RFM_Write(0x12,0x08);
 
@@ -438,7 +699,8 @@ void RFM_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings)
 
 /*
 *****************************************************************************************
-* Description : Function to switch RFM to single receive mode, used for Class A motes
+* Description : Function to switch RFM to single receive mode, used for Class A motes.
+*               Waits until a package is received or the receive timeout.
 *
 * Arguments   : *LoRa_Settings pointer to sSettings struct
 *
@@ -448,8 +710,27 @@ void RFM_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings)
 
 message_t RFM_Single_Receive(sSettings *LoRa_Settings)
 {
-  message_t Message_Status = NO_MESSAGE;
+  RFM_Start_Single_Receive(LoRa_Settings->Datarate_Rx, LoRa_Settings->Channel_Rx, RFM_RX_SYMBOL_TIMEOUT);
+
+  //Sleep until RxDone or Timeout
+  RFM_Wait_Event(RFM_EVENT_DIO0 | RFM_EVENT_DIO1);
+
+  return RFM_Receive_Status();
+}
+
+/*
+*****************************************************************************************
+* Description : Function that switches the RFM to single receive mode and returns.
+*               DIO0 goes high on RxDone and DIO1 on RxTimeout, see RFM_Receive_Status.
+*
+* Arguments   : Datarate data rate of the receive window
+*               Channel channel of the receive window
+*               Symbol_Timeout symbols the RFM searches for a preamble, 4 to 1023
+*****************************************************************************************
+*/
 
+void RFM_Start_Single_Receive(unsigned char Datarate, unsigned char Channel, unsigned short Symbol_Timeout)
+{
   //Change DIO 0 back to RxDone
   RFM_Write(0x40,0x00);
 
@@ -458,20 +739,36 @@ message_t RFM_Single_Receive(sSettings *LoRa_Settings)
   RFM_Write(0x3B,0x19);
 
   //Change Datarate
-  RFM_Change_Datarate(LoRa_Settings->Datarate_Rx);
+  RFM_Change_Datarate(Datarate);
 
   //Change Channel
-  RFM_Change_Channel(LoRa_Settings->Channel_Rx);
+  RFM_Change_Channel(Channel);
+
+  //Symbol timeout, bits 9:8 are in modem config 2
+  RFM_Write(0x1E,RFM_Modem_Config_2 | ((Symbol_Timeout >> 8) & 0x03));
+  RFM_Write(0x1F,Symbol_Timeout & 0xFF);
 
-  //Switch RFM to Single reception
+  //Clear old events and switch RFM to Single reception
+  RFM_Get_Events(RFM_EVENT_DIO0 | RFM_EVENT_DIO1 | RFM_EVENT_DIO2);
   RFM_Switch_Mode(0x06);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that checks the state of a single receive without waiting
+*
+* Return	  : message_t NO_MESSAGE while still receiving, TIMEOUT or NEW_MESSAGE
+*****************************************************************************************
+*/
 
-  //Wait until RxDone or Timeout
-  //Wait until timeout or RxDone interrupt
-  while((digitalRead(RFM_pins.DIO0) == LOW) && (digitalRead(RFM_pins.DIO1) == LOW));
+message_t RFM_Receive_Status(void)
+{
+  message_t Message_Status = NO_MESSAGE;
+
+  unsigned char Events = RFM_Get_Events(RFM_EVENT_DIO0 | RFM_EVENT_DIO1);
 
   //Check for Timeout
-  if(digitalRead(RFM_pins.DIO1) == HIGH)
+  if(Events & RFM_EVENT_DIO1)
   {
     //Clear interrupt register
     RFM_Write(0x12,0xE0);
@@ -479,7 +776,7 @@ message_t RFM_Single_Receive(sSettings *LoRa_Settings)
   }
 
   //Check for RxDone
-  if(digitalRead(RFM_pins.DIO0) == HIGH)
+  if(Events & RFM_EVENT_DIO0)
   {
 	  Message_Status = NEW_MESSAGE;
   }
@@ -490,13 +787,19 @@ message_t RFM_Single_Receive(sSettings *LoRa_Settings)
 
 /*
 *****************************************************************************************
-* Description : Function to switch RFM to continuous receive mode, used for Class C motes
+* Description : Function to switch RFM to continuous receive mode, used for Class C motes.
+*               From here on the RxDone interrupt reads every package into a ring and the
+*               RFM stays in receive, get them with RFM_Get_Queued_Package. The next
+*               RFM_Switch_Mode hands the SPI bus back to the caller.
 *
 * Arguments   : *LoRa_Settings pointer to sSettings struct
 *****************************************************************************************
 */
 void RFM_Continuous_Receive(sSettings *LoRa_Settings)
 {
+  //The interrupt may not use the SPI bus during the setup
+  RFM_Rx_Armed = 0x00;
+
   //Change DIO 0 back to RxDone
   RFM_Write(0x40,0x00);
 
@@ -504,14 +807,111 @@ void RFM_Continuous_Receive(sSettings *LoRa_Settings)
   RFM_Write(0x33,0x67);
   RFM_Write(0x3B,0x19);
   
-	//Change Datarate
-	RFM_Change_Datarate(LoRa_Settings->Datarate_Rx);
-
-	//Change Channel
-	RFM_Change_Channel(LoRa_Settings->Channel_Rx);
+	//Receives on the data rate and channel of RX2 like the network sends to class C
+	RFM_Change_Datarate(LoRa_Settings->Datarate_Rx2);
+	RFM_Change_Channel(BAND_RX2_CHANNEL);
 
-	//Switch to continuous receive
+	//Clear old events and switch to continuous receive
+	RFM_Get_Events(RFM_EVENT_DIO0 | RFM_EVENT_DIO1 | RFM_EVENT_DIO2);
 	RFM_Switch_Mode(0x05);
+	RFM_Rx_Armed = 0x01;
+}
+
+/*
+*****************************************************************************************
+* Description : Function called from the RxDone interrupt in continuous receive. Reads
+*               the package and its signal quality into the ring with a burst read and
+*               clears the interrupt, the RFM goes on receiving.
+*****************************************************************************************
+*/
+
+static void RFM_Rx_Queue_Take(void)
+{
+  sRFM_Rx_Slot *Slot;
+  unsigned char Next = (RFM_Rx_Head + 1) % RFM_RX_QUEUE_SLOTS;
+
+  //Drop a package with a CRC error or without room in the ring
+  if((RFM_Read(0x12) & 0x20) == 0x20 || Next == RFM_Rx_Tail)
+  {
+    if(Next == RFM_Rx_Tail)
+    {
+      RFM_Rx_Dropped++;
+    }
+    RFM_Write(0x12,0xE0);
+    return;
+  }
+
+  Slot = &RFM_Rx_Queue[RFM_Rx_Head];
+  Slot->Length = RFM_Read(0x13);
+  RFM_Write(0x0D,RFM_Read(0x10));
+  RFM_Read_Burst(0x00, Slot->Data, Slot->Length);
+  RFM_Get_Package_Quality(&Slot->SNR, &Slot->RSSI, &Slot->SF);
+  RFM_Write(0x12,0xE0);
+
+  RFM_Rx_Head = Next;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that returns how many packages of class C wait in the ring
+*
+* Return      : unsigned char number of packages
+*****************************************************************************************
+*/
+
+unsigned char RFM_Queued_Packages(void)
+{
+  return (RFM_Rx_Head + RFM_RX_QUEUE_SLOTS - RFM_Rx_Tail) % RFM_RX_QUEUE_SLOTS;
+}
+
+/*
+*****************************************************************************************
+* Description : Function that returns how many packages of class C were lost because the
+*               ring was full
+*
+* Return      : unsigned long number of packages
+*****************************************************************************************
+*/
+
+unsigned long RFM_Get_Rx_Dropped(void)
+{
+  return RFM_Rx_Dropped;
+}
+
+/*
+*****************************************************************************************
+* Description : Function to retrieve the oldest package the RxDone interrupt of class C
+*               kept
+*
+* Arguments   : *RFM_Rx_Package pointer to sBuffer struct for the data, 255 bytes
+*               *SNR pointer to the SNR in 0.25 dB
+*               *RSSI pointer to the RSSI in dBm
+*               *SF pointer to the spreading factor it was received with
+*
+* Return	  : message_t CRC_OK or NO_MESSAGE when the ring is empty
+*****************************************************************************************
+*/
+
+message_t RFM_Get_Queued_Package(sBuffer *RFM_Rx_Package, signed char *SNR, short *RSSI, unsigned char *SF)
+{
+  sRFM_Rx_Slot *Slot;
+
+  if(RFM_Rx_Tail == RFM_Rx_Head)
+  {
+    return NO_MESSAGE;
+  }
+
+  Slot = &RFM_Rx_Queue[RFM_Rx_Tail];
+  RFM_Rx_Package->Counter = Slot->Length;
+  memcpy(RFM_Rx_Package->Data, Slot->Data, Slot->Length);
+  *SNR = Slot->SNR;
+  *RSSI = Slot->RSSI;
+  *SF = Slot->SF;
+
+  //Hand the slot back to the interrupt
+  RFM_Rx_Tail = (RFM_Rx_Tail + 1) % RFM_RX_QUEUE_SLOTS;
+
+  return CRC_OK;
 }
 
 /*
@@ -527,7 +927,6 @@ void RFM_Continuous_Receive(sSettings *LoRa_Settings)
 
 message_t RFM_Get_Package(sBuffer *RFM_Rx_Package)
 {
-  unsigned char i;
   unsigned char RFM_Interrupts = 0x00;
   unsigned char RFM_Package_Location = 0x00;
   message_t Message_Status;
@@ -550,10 +949,8 @@ message_t RFM_Get_Package(sBuffer *RFM_Rx_Package)
 
   RFM_Write(0x0D,RFM_Package_Location); /*Set RF pointer to start of package*/
 
-  for (i = 0x00; i < RFM_Rx_Package->Counter; i++)
-  {
-    RFM_Rx_Package->Data[i] = RFM_Read(0x00);
-  }
+  //Read Payload from FiFo
+  RFM_Read_Burst(0x00, RFM_Rx_Package->Data, RFM_Rx_Package->Counter);
 
   //Clear interrupt register
   RFM_Write(0x12,0xE0);
@@ -561,6 +958,30 @@ message_t RFM_Get_Package(sBuffer *RFM_Rx_Package)
   return Message_Status;
 }
 
+/*
+*****************************************************************************************
+* Description : Function that gives the signal quality of the last received package,
+*               read after RxDone
+*
+* Arguments   : *SNR pointer to the SNR in 0.25 dB
+*               *RSSI pointer to the RSSI in dBm
+*               *SF pointer to the spreading factor it was received with
+*****************************************************************************************
+*/
+
+void RFM_Get_Package_Quality(signed char *SNR, short *RSSI, unsigned char *SF)
+{
+  *SNR = (signed char)RFM_Read(0x19);
+  *RSSI = -157 + RFM_Read(0x1A);
+  *SF = RFM_Read(0x1E) >> 4;
+
+  //Below the noise floor the SNR is part of the RSSI
+  if(*SNR < 0)
+  {
+    *RSSI += *SNR / 4;
+  }
+}
+
 /*
 *****************************************************************************************
 * Description : Function that writes a register from the RFM
@@ -572,6 +993,52 @@ message_t RFM_Get_Package(sBuffer *RFM_Rx_Package)
 
 void RFM_Write(unsigned char RFM_Address, unsigned char RFM_Data)
 {
+  unsigned char Index = RFM_Address >> 3;
+  unsigned char Mask = 1 << (RFM_Address & 0x07);
+
+  //The shadow is part of the transfer, the interrupt writes registers too
+  unsigned int Irq_Mask = RFM_Lock();
+
+  //Skip the write when the register already holds the value.
+  //The frequency is only taken over on a write of 0x08, so write it when 0x06 or 0x07 changed.
+  if(RFM_Is_Shadowed(RFM_Address))
+  {
+    if((RFM_Shadow_Valid[Index] & Mask) && RFM_Shadow[RFM_Address] == RFM_Data &&
+       !(RFM_Address == 0x08 && RFM_Frf_Pending))
+    {
+      RFM_Writes_Elided++;
+      RFM_Unlock(Irq_Mask);
+      return;
+    }
+
+    RFM_Shadow[RFM_Address] = RFM_Data;
+    RFM_Shadow_Valid[Index] |= Mask;
+  }
+
+  if(RFM_Address == 0x06 || RFM_Address == 0x07)
+  {
+    RFM_Frf_Pending = 0x01;
+  }
+  else if(RFM_Address == 0x08)
+  {
+    RFM_Frf_Pending = 0x00;
+  }
+
+  RFM_Writes_Issued++;
+
+  //Set NSS pin Low to start communication
+  digitalWrite(RFM_pins.CS,LOW);
+
+  //Send Address with MSB 1 to make it a writ command
+  RF.transfer(RFM_Address | 0x80);
+  //Send Data
+  RF.transfer(RFM_Data);
+
+  //Set NSS pin High to end communication
+  digitalWrite(RFM_pins.CS,HIGH);
+
+  RFM_Unlock(Irq_Mask);
+
   // br: RF Transfer Debug
   #ifdef DEBUG
     //Serial.print("RF Write ADDR: ");
@@ -580,17 +1047,64 @@ void RFM_Write(unsigned char RFM_Address, unsigned char RFM_Data)
     //Serial.println(RFM_Data, HEX);
     Serial.printf("[RF-W] ADDR %02X, DATA %02X\n", RFM_Address, RFM_Data);
   #endif
+}
+
+/*
+*****************************************************************************************
+* Description : Function that writes a number of bytes to one register of the RFM in a
+*               single SPI transfer. Used for the FiFo, register 0x00.
+*
+* Arguments   : RFM_Address Address of register to be written
+*               *RFM_Data   Data to be written
+*               Length      Number of bytes
+*****************************************************************************************
+*/
+
+void RFM_Write_Burst(unsigned char RFM_Address, unsigned char *RFM_Data, unsigned char Length)
+{
+  unsigned int Irq_Mask = RFM_Lock();
 
   //Set NSS pin Low to start communication
   digitalWrite(RFM_pins.CS,LOW);
 
-  //Send Address with MSB 1 to make it a writ command
+  //Send Address with MSB 1 to make it a write command
   RF.transfer(RFM_Address | 0x80);
   //Send Data
-  RF.transfer(RFM_Data);
+  RF.transfer(RFM_Data, NULL, Length);
 
   //Set NSS pin High to end communication
   digitalWrite(RFM_pins.CS,HIGH);
+
+  RFM_Unlock(Irq_Mask);
+}
+
+/*
+*****************************************************************************************
+* Description : Function that reads a number of bytes from one register of the RFM in a
+*               single SPI transfer. Used for the FiFo, register 0x00.
+*
+* Arguments   : RFM_Address Address of register to be read
+*               *RFM_Data   Buffer for the data
+*               Length      Number of bytes
+*****************************************************************************************
+*/
+
+void RFM_Read_Burst(unsigned char RFM_Address, unsigned char *RFM_Data, unsigned char Length)
+{
+  unsigned int Irq_Mask = RFM_Lock();
+
+  //Set NSS pin low to start RF communication
+  digitalWrite(RFM_pins.CS,LOW);
+
+  //Send Address
+  RF.transfer(RFM_Address);
+  //Clock out the data
+  RF.transfer(RFM_Data, Length);
+
+  //Set NSS high to end communication
+  digitalWrite(RFM_pins.CS,HIGH);
+
+  RFM_Unlock(Irq_Mask);
 }
 
 /*
@@ -604,6 +1118,9 @@ void RFM_Write(unsigned char RFM_Address, unsigned char RFM_Data)
 */
 void RFM_Switch_Mode(unsigned char Mode)
 {
+    //Leaves continuous receive, the RxDone interrupt no longer uses the SPI bus
+    RFM_Rx_Armed = 0x00;
+
     Mode = Mode | 0x80; //Set high bit for LoRa mode
 
     //Switch mode on RFM module
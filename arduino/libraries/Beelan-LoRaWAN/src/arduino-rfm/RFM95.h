@@ -45,6 +45,14 @@
 
 typedef enum {NO_MESSAGE,NEW_MESSAGE,CRC_OK,MIC_OK,ADDRESS_OK,MESSAGE_DONE,TIMEOUT,WRONG_MESSAGE} message_t;
 
+//DIO events set from the pin interrupts
+#define RFM_EVENT_DIO0 0x01
+#define RFM_EVENT_DIO1 0x02
+#define RFM_EVENT_DIO2 0x04
+
+//Symbol timeout of a single receive without a computed window, 37 symbols
+#define RFM_RX_SYMBOL_TIMEOUT 0x25
+
 /*
 *****************************************************************************************
 * FUNCTION PROTOTYPES
@@ -52,11 +60,32 @@ typedef enum {NO_MESSAGE,NEW_MESSAGE,CRC_OK,MIC_OK,ADDRESS_OK,MESSAGE_DONE,TIMEO
 */
 
 bool RFM_Init();
+bool RFM_Resume();
 void RFM_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings);
+void RFM_Start_Send_Package(sBuffer *RFM_Tx_Package, sSettings *LoRa_Settings);
+void RFM_Finish_Send_Package(sSettings *LoRa_Settings);
 message_t RFM_Single_Receive(sSettings *LoRa_Settings);
+void RFM_Start_Single_Receive(unsigned char Datarate, unsigned char Channel, unsigned short Symbol_Timeout);
+message_t RFM_Receive_Status(void);
+unsigned char RFM_Get_Events(unsigned char Mask);
+unsigned long RFM_Get_Event_Time(void);
+unsigned long RFM_Get_Tx_Time(void);
+unsigned char RFM_Wait_Event(unsigned char Mask);
 void RFM_Continuous_Receive(sSettings *LoRa_Settings);
 message_t RFM_Get_Package(sBuffer *RFM_Rx_Package);
+unsigned char RFM_Queued_Packages(void);
+unsigned long RFM_Get_Rx_Dropped(void);
+message_t RFM_Get_Queued_Package(sBuffer *RFM_Rx_Package, signed char *SNR, short *RSSI, unsigned char *SF);
+void RFM_Get_Package_Quality(signed char *SNR, short *RSSI, unsigned char *SF);
+bool RFM_Set_Frequency(unsigned char Channel, unsigned long Frequency);
+unsigned int RFM_Get_Frequencies(unsigned char *Frequency);
+void RFM_Set_Frequencies(unsigned int Set, const unsigned char *Frequency);
+void RFM_Reset_Frequencies(void);
 void RFM_Write(unsigned char RFM_Address, unsigned char RFM_Data);
+void RFM_Write_Burst(unsigned char RFM_Address, unsigned char *RFM_Data, unsigned char Length);
+void RFM_Read_Burst(unsigned char RFM_Address, unsigned char *RFM_Data, unsigned char Length);
+void RFM_Get_Write_Stats(unsigned long *Issued, unsigned long *Elided);
+void RFM_Clear_Write_Stats(void);
 void RFM_Switch_Mode(unsigned char Mode);
 
 #endif
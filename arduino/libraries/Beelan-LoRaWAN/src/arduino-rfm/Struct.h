@@ -30,6 +30,8 @@
 #ifndef STRUCT_H
 #define STRUCT_H
 
+#include "AES-128.h"
+
 /*
 ********************************************************************************************
 * STRUCT DEFINITIONS
@@ -53,12 +55,57 @@ typedef struct {
     unsigned char Counter;
 } sBuffer;
 
+//Struct used to store the CMAC subkeys of a key, calculated once per key
+typedef struct {
+    sAES_Expanded_Key *Key;
+    unsigned char K1[16];
+    unsigned char K2[16];
+} sCMAC_Key;
+
+//Struct used to calculate a CMAC over data that is added in parts
+typedef struct {
+    sCMAC_Key *Key;
+    unsigned char X[16];            //Chaining value
+    unsigned char Block[16];        //Input not yet processed, last block is kept for CMAC_Final
+    unsigned char Block_Length;
+} sCMAC_Context;
+
+//Struct used for the MAC commands of the network and the answers of the mote
+typedef struct {
+    unsigned char Answer[15];       //MAC commands for the FOpts of the next uplink
+    unsigned char Answer_Length;
+    unsigned char Battery;          //DevStatusAns, 0 external power, 1 to 254 level, 255 unknown
+    unsigned char Link_Check;       //0x00 no LinkCheckAns, 0x01 new, 0x02 given to the ADR
+    unsigned char Link_Margin;      //LinkCheckAns, margin of the uplink in dB
+    unsigned char Link_Gateways;    //LinkCheckAns, gateways that received the uplink
+} sMAC_Commands;
+
+//Bytes of key stream prepared for the FRMPayload of the next uplink, see Keystream_Prepare
+#ifndef KEYSTREAM_SIZE
+#define KEYSTREAM_SIZE 32
+#endif
+
+//Struct used for the encryption of the next uplink that is prepared in idle time
+typedef struct {
+    unsigned char Valid;                    //0x01 prepared for Frame_Counter, 0x00 empty
+    unsigned int  Frame_Counter;            //FCntUp the state is prepared for
+    unsigned char Length;                   //Frame length without MIC of Block B0, 0 no MIC state
+    unsigned char MIC_Chain[16];            //CMAC chaining value after Block B0
+    unsigned char Stream[KEYSTREAM_SIZE];   //First bytes of the key stream of the FRMPayload
+} sKeystream;
+
 //Struct used to store session data of a LoRaWAN session
 typedef struct {
     unsigned char *NwkSKey;
     unsigned char *AppSKey;
     unsigned char *DevAddr;
-    unsigned int  *Frame_Counter;
+    unsigned int  *Frame_Counter;           //32-bit uplink frame counter, FCntUp
+    unsigned int  *Frame_Counter_Down;      //32-bit frame counter of the last downlink, FCntDown
+    sAES_Expanded_Key *NwkSKey_Expanded;    //Round keys of NwkSKey, update when NwkSKey changes
+    sAES_Expanded_Key *AppSKey_Expanded;    //Round keys of AppSKey, update when AppSKey changes
+    sCMAC_Key *NwkSKey_CMAC;                //CMAC subkeys of NwkSKey, update when NwkSKey changes
+    sMAC_Commands *MAC_Commands;            //MAC command answers and results of the session
+    sKeystream *Keystream;                  //Prepared encryption of the next uplink, NULL if not used
 } sLoRa_Session;
 
 typedef struct {
@@ -80,18 +127,29 @@ typedef struct{
     unsigned char Frame_Options[15];
     unsigned char MIC[4];
     unsigned char Direction;
+    signed char SNR;                    //Received message, SNR in 0.25 dB
+    short RSSI;                         //Received message, RSSI in dBm
+    unsigned char Spreading_Factor;     //Received message, SF it was received with
 } sLoRa_Message;
 
 //Struct used for storing settings of the mote
 typedef struct {
     unsigned char Confirm;			//0x00 Unconfirmed, 0x01 Confirmed
+    unsigned char Frame_Port;		//FPort of the uplinks, 1 to 223 and FRAG_PORT
     unsigned char Mote_Class;		//0x00 Class A, 0x01 Class C
     unsigned char Datarate_Tx;		//See RFM file
-    unsigned char Datarate_Rx;		//See RFM file
+    unsigned char Datarate_Rx;		//Data rate of RX1, see Band_Set_Datarate
     unsigned char Channel_Tx;		//See RFM file
     unsigned char Channel_Rx;		//See RFM filed
     unsigned char Channel_Hopping;	//0x00 No hopping, 0x01 Hopping
     unsigned char Transmit_Power;	//0x00 to 0x0F
+    unsigned char Frame_Control;	//ADR 0x80 and ADRACKReq 0x40 bits of the uplinks
+    unsigned int Channel_Mask;		//Bit per transmit channel that may be used
+    unsigned char Rx_Delay;			//Seconds from TxDone to the first receive window
+    unsigned char Rx1_DR_Offset;	//RX1DRoffset of RXParamSetupReq
+    unsigned char Datarate_Rx2;		//RX2DataRate of RXParamSetupReq
+    unsigned char Max_Duty_Cycle;	//Duty cycle of all channels together is 1 / 2^Max_Duty_Cycle
+    unsigned char Nb_Trans;			//Transmissions of a confirmed uplink without ACK, NbTrans of LinkADRReq
 } sSettings;
 
 typedef enum {
@@ -107,29 +165,6 @@ typedef enum {
 } channel_t;
 
 
-/* Edit: Miguel Romaní */
-typedef enum {
-#ifdef US_915
-    SF10BW125   = 0x00,
-    SF9BW125    = 0x01,
-    SF8BW125    = 0x02,
-    SF7BW125    = 0x03,
-    SF8BW500    = 0x04,
-    SF12BW500   = 0x08,
-    SF11BW500   = 0x09,
-    SF10BW500   = 0x0A,
-    SF9BW500    = 0x0B,
-    SF7BW500    = 0x0D
-#elif defined(EU_868)
-    SF12BW125   = 0x00,
-    SF11BW125   = 0x01,
-    SF10BW125   = 0x02,
-    SF9BW125    = 0x03,
-    SF8BW125    = 0x04,
-    SF7BW125    = 0x05
-#endif
-} dataRates_t;
-
 typedef enum {CLASS_A, CLASS_C} devclass_t;
 
 typedef enum {NO_RX, NEW_RX} rx_t;
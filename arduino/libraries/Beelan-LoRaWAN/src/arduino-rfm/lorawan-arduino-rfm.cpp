@@ -28,8 +28,59 @@
     Use of this source code is governed by the MIT license that can be found in the LICENSE file.
 */
 
+#include <stddef.h>
+#include <RTC.h>
+#include <NVMClass.h>
 #include "lorawan-arduino-rfm.h"
 #include "Conversions.h"
+#include "Band-Plan.h"
+
+// Part of the session that only changes with a join, a setter or a MAC command that sets up the
+// channels, kept in the RWW EEPROM. The counters, data rate, channel, power and the ADR_ACK_CNT
+// change every uplink and go to the RTC backup registers. RX1 follows from the data rate and the
+// channel. The ADR margins and the MAC answers change with every downlink and would erase the
+// row each time, they are not kept: the ADR window starts empty and the network repeats a
+// request that it got no answer for.
+typedef struct
+{
+    unsigned char NwkSKey[16];
+    unsigned char AppSKey[16];
+    unsigned char DevAddr[4];
+    unsigned char Mote_Class;
+    unsigned char Confirm;
+    unsigned char Channel_Hopping;
+    unsigned char Datarate;
+    unsigned char Channel;
+    unsigned char Rx_Delay;
+    unsigned char Rx1_DR_Offset;
+    unsigned char Datarate_Rx2;
+    unsigned char Max_Duty_Cycle;
+    unsigned char Nb_Trans;
+    unsigned short Channel_Mask;
+    unsigned char Battery;
+    unsigned char ADR_Enabled;
+    unsigned short Frequency_Set;       // Frequencies of NewChannelReq and RXParamSetupReq
+    unsigned char Frequency[BAND_MAX_CHANNELS + 1][3];
+    uint32_t Check;
+} sSession_Record;
+
+// ADR_ACK_CNT in 7 bits of the backup registers. From ADR_ACK_LIMIT + ADR_ACK_DELAY on only
+// the step within ADR_ACK_DELAY counts, so the counter is kept modulo ADR_ACK_DELAY there.
+#define SESSION_ADR_ACK_MAX (ADR_ACK_LIMIT + ADR_ACK_DELAY)
+
+// CRC-32 (IEEE, reflected) without final xor, the value is chained from the record to the backup registers
+static uint32_t Session_CRC(uint32_t crc, const void *data, unsigned int len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+    while (len--)
+    {
+        crc ^= *p++;
+        for (byte i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return crc;
+}
 
 LoRaWANClass::LoRaWANClass()
 {
@@ -40,6 +91,12 @@ LoRaWANClass::~LoRaWANClass()
 }
 
 bool LoRaWANClass::init(void)
+{
+    initState();
+    return initRadio(false);
+}
+
+void LoRaWANClass::initState(void)
 {
     // Lora Setting Class
     dev_class = CLASS_A;
@@ -49,6 +106,20 @@ bool LoRaWANClass::init(void)
     // Status
     RFM_Command_Status = NO_RFM_COMMAND;
     Rx_Status = NO_RX;
+    Cycle.State = LORA_IDLE;
+    Event_Callback = NULL;
+    Trigger_Time = 0;
+    Cycle.Command = NO_RFM_COMMAND;
+    Join.Active = 0x00;
+    Join.Joined = 0x00;
+    Join_Callback = NULL;
+    Confirm.Active = 0x00;
+    Confirm_Callback = NULL;
+    memset(Downlink_Handler, 0x00, sizeof(Downlink_Handler));
+#ifdef FUOTA
+    Frag_Answer_Length = 0;
+    Frag_Callback = NULL;
+#endif
 
     // current channel
     currentChannel = MULTI;
@@ -59,10 +130,28 @@ bool LoRaWANClass::init(void)
     memset(AppSKey, 0x00, 16);
 
     Frame_Counter_Tx = 0x0000;
+    Frame_Counter_Rx = 0x0000;
     Session_Data.NwkSKey = NwkSKey;
     Session_Data.AppSKey = AppSKey;
     Session_Data.DevAddr = Address_Tx;
     Session_Data.Frame_Counter = &Frame_Counter_Tx;
+    Session_Data.Frame_Counter_Down = &Frame_Counter_Rx;
+    Session_Data.NwkSKey_Expanded = &NwkSKey_Expanded;
+    Session_Data.AppSKey_Expanded = &AppSKey_Expanded;
+    Session_Data.NwkSKey_CMAC = &NwkSKey_CMAC;
+    Session_Data.MAC_Commands = &MAC_Commands;
+#ifdef KEYSTREAM_PRECOMPUTE
+    Keystream.Valid = 0x00;
+    Keystream.Length = 0x00;
+    Session_Data.Keystream = &Keystream;
+#else
+    Session_Data.Keystream = NULL;
+#endif
+    AES_Expand_Key(NwkSKey, &NwkSKey_Expanded);
+    AES_Expand_Key(AppSKey, &AppSKey_Expanded);
+    CMAC_Key_Init(&NwkSKey_CMAC, &NwkSKey_Expanded);
+    MAC_Init(&MAC_Commands);
+    MAC_Commands.Battery = 0xFF;
 
     //Initialize OTAA data struct
     memset(DevEUI, 0x00, 8);
@@ -82,30 +171,32 @@ bool LoRaWANClass::init(void)
     // Device Class
     LoRa_Settings.Mote_Class = 0x00; //0x00 is type A, 0x01 is type C
 
-    // Rx
-#if defined(AS_923)
-    LoRa_Settings.Datarate_Rx = 0x02; //set to SF10 BW 125 kHz
-#elif defined(EU_868)
-    LoRa_Settings.Datarate_Rx = 0x03;                //set to SF9 BW 125 kHz
-#else //US_915
-    LoRa_Settings.Datarate_Rx = 0x0C; //set to SF8 BW 500 kHz
-#endif
-    LoRa_Settings.Channel_Rx = 0x0A; // set to recv channel
+    // Rx, defaults of the band plan
+    LoRa_Settings.Channel_Rx = Band_Rx1_Channel(BAND_PLAN, 0x00); // RX1 of channel 0
+    LoRa_Settings.Datarate_Rx2 = BAND_PLAN.Datarate_Rx2; //RX2 of the network
+    LoRa_Settings.Rx1_DR_Offset = 0x00;
+    LoRa_Settings.Rx_Delay = 1;
 
     // Tx
-#if defined(US_915)
-    LoRa_Settings.Datarate_Tx = drate_common = 0x02; //set to SF7 BW 125 kHz
-#else
-    LoRa_Settings.Datarate_Tx = drate_common = 0x00; //set to SF12 BW 125 kHz
-#endif
+    drate_common = BAND_PLAN.Datarate_Tx;
+    Band_Set_Datarate(drate_common, &LoRa_Settings);
     LoRa_Settings.Channel_Tx = 0x00; // set to channel 0
+    LoRa_Settings.Transmit_Power = 0x00;
+    LoRa_Settings.Channel_Mask = BAND_PLAN.Channel_Mask; // all channels on
+    LoRa_Settings.Max_Duty_Cycle = 0;
+    Duty_Cycle_Set_Total(0);
+    LoRa_Settings.Nb_Trans = CONFIRM_NB_TRANS;
+
+    // ADR off, fixed data rate
+    ADR_Init(&ADR, 0x00, &LoRa_Settings);
 
     LoRa_Settings.Confirm = 0x00;         //0x00 unconfirmed, 0x01 confirmed
+    LoRa_Settings.Frame_Port = 0x01;
     LoRa_Settings.Channel_Hopping = 0x00; //0x00 no channel hopping, 0x01 channel hopping
 
     // Initialise buffer for data to transmit
     memset(Data_Tx, 0x00, sizeof(Data_Tx));
-    Buffer_Tx.Data = Data_Tx;
+    Buffer_Tx.Data = &Data_Tx[LORA_FRAME_HEADROOM];
     Buffer_Tx.Counter = 0x00;
     // Initialise buffer for data to receive
     memset(Data_Rx, 0x00, sizeof(Data_Rx));
@@ -113,6 +204,15 @@ bool LoRaWANClass::init(void)
     Buffer_Rx.Counter = 0x00;
     Message_Rx.Direction = 0x01; //Set down direction for Rx message
 
+    // Empty uplink queue
+    Queue_Length = 0;
+    Queue_Records = 0;
+    Queue_Bytes_Saved = 0;
+    Queue_Airtime_Saved = 0;
+}
+
+bool LoRaWANClass::initRadio(bool warm)
+{
     //Initialize I/O pins
     pinMode(RFM_pins.DIO0, INPUT);
     pinMode(RFM_pins.DIO1, INPUT);
@@ -125,6 +225,17 @@ bool LoRaWANClass::init(void)
 
     digitalWrite(RFM_pins.CS, HIGH);
 
+    //Take over the RFM as it was left by saveSession(), it kept its registers in sleep
+    if (warm)
+    {
+        RF.resume();
+        RF.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0));
+        if (RFM_Resume())
+        {
+            return 1;
+        }
+    }
+
     RF.enableOscilator();
 
     // Reset
@@ -151,36 +262,49 @@ bool LoRaWANClass::init(void)
 
 bool LoRaWANClass::join(void)
 {
-    bool join_status;
-    const unsigned long timeout = 6000;
-    unsigned long prev_millis;
-    //unsigned char i = 0;
-
-    if (currentChannel == MULTI)
+    // One JoinRequest right away, waits for the duty cycle and the JoinAccept windows
+    startJoin(NULL, 1, 0);
+    while (Join.Active || busy())
     {
-        randomChannel();
+        update();
     }
-    // join request
-    LoRa_Send_JoinReq(&OTAA_Data, &LoRa_Settings);
 
-    // loop for <timeout> wait for join accept
-    prev_millis = millis();
-    do
+    return Join.Joined;
+}
+
+void LoRaWANClass::joinAsync(lora_join_callback_t callback, unsigned int tries)
+{
+    startJoin(callback, tries, JOIN_BACKOFF_MIN);
+}
+
+void LoRaWANClass::startJoin(lora_join_callback_t callback, unsigned int tries, unsigned long jitter)
+{
+    // The join is done as class A
+    if (LoRa_Settings.Mote_Class != 0x00)
     {
-        join_status = LORA_join_Accept(&Buffer_Rx, &Session_Data, &OTAA_Data, &Message_Rx, &LoRa_Settings);
+        setDeviceClass(CLASS_A);
+    }
 
-    } while ((millis() - prev_millis) < timeout && !join_status);
+    // The JoinAccept windows are on the frequencies of the band plan
+    RFM_Reset_Frequencies();
 
-    //Serial.printf("[JOIN] %d", join_status);
-    return join_status;
+    Join_Callback = callback;
+    Join_Init(&Join, tries, jitter, &LoRa_Settings);
+}
+
+unsigned long LoRaWANClass::nextJoinTime(void)
+{
+    return Join.Next;
 }
 
 void LoRaWANClass::setDevEUI(const char *devEUI_in)
 {
     for (byte i = 0; i < 8; ++i)
         DevEUI[i] = ASCII2Hex(devEUI_in[i * 2], devEUI_in[(i * 2) + 1]);
-    //Reset frame counter
+#ifndef FCNT_NVM
+    //Reset frame counter, with FCNT_NVM setDevAddr() restores it
     Frame_Counter_Tx = 0x0000;
+#endif
 
     //Reset RFM command status
     RFM_Command_Status = NO_RFM_COMMAND;
@@ -190,8 +314,10 @@ void LoRaWANClass::setAppEUI(const char *appEUI_in)
 {
     for (byte i = 0; i < 8; ++i)
         AppEUI[i] = ASCII2Hex(appEUI_in[i * 2], appEUI_in[(i * 2) + 1]);
-    //Reset frame counter
+#ifndef FCNT_NVM
+    //Reset frame counter, with FCNT_NVM setDevAddr() restores it
     Frame_Counter_Tx = 0x0000;
+#endif
 
     //Reset RFM command status
     RFM_Command_Status = NO_RFM_COMMAND;
@@ -201,8 +327,10 @@ void LoRaWANClass::setAppKey(const char *appKey_in)
 {
     for (byte i = 0; i < 16; ++i)
         AppKey[i] = ASCII2Hex(appKey_in[i * 2], appKey_in[(i * 2) + 1]);
-    //Reset frame counter
+#ifndef FCNT_NVM
+    //Reset frame counter, with FCNT_NVM setDevAddr() restores it
     Frame_Counter_Tx = 0x0000;
+#endif
 
     //Reset RFM command status
     RFM_Command_Status = NO_RFM_COMMAND;
@@ -212,9 +340,14 @@ void LoRaWANClass::setNwkSKey(const char *NwkKey_in)
 {
     for (uint8_t i = 0; i < 16; ++i)
         NwkSKey[i] = ASCII2Hex(NwkKey_in[i * 2], NwkKey_in[(i * 2) + 1]);
+    AES_Expand_Key(NwkSKey, &NwkSKey_Expanded);
+    CMAC_Key_Init(&NwkSKey_CMAC, &NwkSKey_Expanded);
+    Keystream_Clear(Session_Data.Keystream);
 
-    //Reset frame counter
+#ifndef FCNT_NVM
+    //Reset frame counter, with FCNT_NVM setDevAddr() restores it
     Frame_Counter_Tx = 0x0000;
+#endif
 
     //Reset RFM command status
     RFM_Command_Status = NO_RFM_COMMAND;
@@ -224,9 +357,13 @@ void LoRaWANClass::setAppSKey(const char *ApskKey_in)
 {
     for (uint8_t i = 0; i < 16; ++i)
         AppSKey[i] = ASCII2Hex(ApskKey_in[i * 2], ApskKey_in[(i * 2) + 1]);
+    AES_Expand_Key(AppSKey, &AppSKey_Expanded);
+    Keystream_Clear(Session_Data.Keystream);
 
-    //Reset frame counter
+#ifndef FCNT_NVM
+    //Reset frame counter, with FCNT_NVM setDevAddr() restores it
     Frame_Counter_Tx = 0x0000;
+#endif
 
     //Reset RFM command status
     RFM_Command_Status = NO_RFM_COMMAND;
@@ -241,9 +378,21 @@ void LoRaWANClass::setDevAddr(const char *devAddr_in)
     Address_Tx[1] = ASCII2Hex(devAddr_in[2], devAddr_in[3]);
     Address_Tx[2] = ASCII2Hex(devAddr_in[4], devAddr_in[5]);
     Address_Tx[3] = ASCII2Hex(devAddr_in[6], devAddr_in[7]);
+    Keystream_Clear(Session_Data.Keystream);
 
+#ifdef FCNT_NVM
+    //Continue the frame counters of this device address, start a new record otherwise
+    if (!NVM_Counter_Restore(&Session_Data))
+    {
+        Frame_Counter_Tx = 0x0000;
+        Frame_Counter_Rx = 0x0000;
+        NVM_Counter_Save(&Session_Data);
+    }
+#else
     //Reset frame counter
     Frame_Counter_Tx = 0x0000;
+    Frame_Counter_Rx = 0x0000;
+#endif
 
     //Reset RFM command status
     RFM_Command_Status = NO_RFM_COMMAND;
@@ -266,51 +415,144 @@ void LoRaWANClass::setDeviceClass(devclass_t dev_class)
     RFM_Command_Status = NO_RFM_COMMAND;
 }
 
-void LoRaWANClass::sendUplink(char *data, unsigned int len, unsigned char confirm)
+bool LoRaWANClass::sendUplink(char *data, unsigned int len, unsigned char confirm, unsigned char port)
 {
+    // No session yet or the transmit buffer holds a confirmed uplink. A frame that waits
+    // for the duty cycle or is on the air still owns Buffer_Tx and LoRa_Settings.Confirm
+    if (Join.Active || Confirm.Active || Cycle.State != LORA_IDLE || RFM_Command_Status != NO_RFM_COMMAND)
+    {
+        return false;
+    }
+
+    // Too long for the data rate, the same limit as the queue
+    if (len > LORA_Max_Payload(LoRa_Settings.Datarate_Tx))
+    {
+        return false;
+    }
+
+    Trigger_Time = micros();
+
     if (currentChannel == MULTI)
     {
-        randomChannel();
+        randomChannel(LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, len + LORA_FRAME_OVERHEAD));
     }
 
     LoRa_Settings.Confirm = (confirm == 0) ? 0 : 1;
+    LoRa_Settings.Frame_Port = port;
 
     //Set new command for RFM
     RFM_Command_Status = NEW_RFM_COMMAND;
 
+    //The only copy of the payload, the frame is built around it
     Buffer_Tx.Counter = len;
     memcpy(Buffer_Tx.Data, data, len);
+    return true;
 }
 
-void LoRaWANClass::setDataRate(unsigned char data_rate)
+bool LoRaWANClass::queueUplink(const char *data, unsigned int len, unsigned long budget_ms)
 {
-    drate_common = data_rate;
-#ifndef US_915
-    //Check if the value is oke
-    if (drate_common <= 0x06)
+    // Must fit a frame of the current data rate with its length byte
+    if (len == 0 || len + 1 > LORA_Max_Payload(LoRa_Settings.Datarate_Tx))
     {
-        LoRa_Settings.Datarate_Tx = drate_common;
+        return false;
     }
-#else
-    if (drate_common <= 0x04)
+    if (Queue_Records == UPLINK_QUEUE_RECORDS || Queue_Length + len + 1 > UPLINK_QUEUE_SIZE)
     {
-        LoRa_Settings.Datarate_Tx = drate_common;
-        LoRa_Settings.Datarate_Rx = data_rate + 0x0A;
+        return false;
     }
 
-#endif
+    Queue_Data[Queue_Length] = len;
+    memcpy(&Queue_Data[Queue_Length + 1], data, len);
+    Queue_Length += len + 1;
+    Queue_Deadline[Queue_Records] = millis() + budget_ms;
+    Queue_Records++;
+    return true;
+}
+
+void LoRaWANClass::getQueueStats(long *bytes_saved, long *airtime_saved_us)
+{
+    *bytes_saved = Queue_Bytes_Saved;
+    *airtime_saved_us = Queue_Airtime_Saved;
+}
+
+void LoRaWANClass::sendQueue(void)
+{
+    unsigned long now = millis();
+    unsigned char max_payload;
+    unsigned int len = 0;
+    unsigned char records = 0;
+    unsigned long airtime = 0;
+    bool due = (Queue_Records == UPLINK_QUEUE_RECORDS);
+
+    for (unsigned char i = 0; i < Queue_Records; i++)
+    {
+        if ((long)(now - Queue_Deadline[i]) >= 0)
+            due = true;
+    }
+    // Wait for more records while the frame is not full
+    if (!due && Queue_Length < LORA_Max_Payload(LoRa_Settings.Datarate_Tx))
+    {
+        return;
+    }
+
+    if (currentChannel == MULTI)
+    {
+        randomChannel(LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, Queue_Length + LORA_FRAME_OVERHEAD));
+    }
+    max_payload = LORA_Max_Payload(LoRa_Settings.Datarate_Tx);
+
+    // Oldest records first, as many as fit
+    while (records < Queue_Records && len + Queue_Data[len] + 1 <= max_payload)
+    {
+        airtime += LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, Queue_Data[len] + LORA_FRAME_OVERHEAD);
+        len += Queue_Data[len] + 1;
+        records++;
+    }
+
+    if (records != 0)
+    {
+        memcpy(Buffer_Tx.Data, Queue_Data, len);
+        Buffer_Tx.Counter = len;
+        LoRa_Settings.Confirm = 0;
+        LoRa_Settings.Frame_Port = 0x01;
+        RFM_Command_Status = NEW_RFM_COMMAND;
+        Trigger_Time = micros();
+
+        // Compared to one frame per record
+        Queue_Bytes_Saved += (long)(records - 1) * LORA_FRAME_OVERHEAD - records;
+        Queue_Airtime_Saved += (long)(airtime - LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, len + LORA_FRAME_OVERHEAD));
+    }
+    else
+    {
+        // The data rate was lowered after the record was queued, it can not be sent
+        len = Queue_Data[0] + 1;
+        records = 1;
+    }
+
+    memmove(Queue_Data, &Queue_Data[len], Queue_Length - len);
+    memmove(Queue_Deadline, &Queue_Deadline[records], (Queue_Records - records) * sizeof(Queue_Deadline[0]));
+    Queue_Length -= len;
+    Queue_Records -= records;
+}
+
+void LoRaWANClass::setDataRate(unsigned char data_rate)
+{
+    drate_common = data_rate;
+    //Check if the value is oke
+    if (drate_common <= BAND_PLAN.Max_Datarate)
+    {
+        Band_Set_Datarate(drate_common, &LoRa_Settings);
+    }
     RFM_Command_Status = NO_RFM_COMMAND;
 }
 
 void LoRaWANClass::setChannel(unsigned char channel)
 {
-    if (channel <= 7)
+    if (channel < BAND_PLAN.Uplink_Channels)
     {
         currentChannel = channel;
         LoRa_Settings.Channel_Tx = channel;
-#ifdef US_915
-        LoRa_Settings.Channel_Rx = channel + 0x08;
-#endif
+        LoRa_Settings.Channel_Rx = Band_Rx1_Channel(BAND_PLAN, channel);
     }
     else if (channel == MULTI)
     {
@@ -335,6 +577,33 @@ void LoRaWANClass::setTxPower(unsigned char power_idx)
     RFM_Write(0x09, RFM_Data);
 }
 
+void LoRaWANClass::setADR(bool enable)
+{
+    ADR_Init(&ADR, enable ? 0x01 : 0x00, &LoRa_Settings);
+}
+
+void LoRaWANClass::setBattery(unsigned char level)
+{
+    MAC_Commands.Battery = level;
+}
+
+void LoRaWANClass::linkCheck(void)
+{
+    MAC_Link_Check(&MAC_Commands);
+}
+
+bool LoRaWANClass::getLinkCheck(unsigned char *margin, unsigned char *gateways)
+{
+    if (MAC_Commands.Link_Check == 0x00)
+    {
+        return false;
+    }
+
+    *margin = MAC_Commands.Link_Margin;
+    *gateways = MAC_Commands.Link_Gateways;
+    return true;
+}
+
 int LoRaWANClass::readData(char *outBuff)
 {
     int res = 0;
@@ -357,58 +626,440 @@ int LoRaWANClass::readData(char *outBuff)
 
 void LoRaWANClass::update(void)
 {
-    //Type A mote transmit receive cycle
-    if ((RFM_Command_Status == NEW_RFM_COMMAND || RFM_Command_Status == JOIN) && LoRa_Settings.Mote_Class == 0x00)
+    lora_event_t Event;
+    bool hold = false;
+    bool confirm_done = false;
+
+    //Start a frame from the uplink queue when the radio is free, the records wait for a join
+    //and for the ACK of a confirmed uplink
+    if (Queue_Records != 0 && RFM_Command_Status != NEW_RFM_COMMAND && Cycle.State == LORA_IDLE && !Join.Active && !Confirm.Active)
+    {
+        sendQueue();
+    }
+
+#ifdef FUOTA
+    //Answers of the fragmentation package, unconfirmed on FRAG_PORT when the radio is free
+    if (Frag_Answer_Length != 0 && RFM_Command_Status != NEW_RFM_COMMAND && Cycle.State == LORA_IDLE && !Join.Active && !Confirm.Active)
+    {
+        sendUplink((char *)Frag_Answer, Frag_Answer_Length, 0, FRAG_PORT);
+        Frag_Answer_Length = 0;
+    }
+#endif
+
+    //Next JoinRequest of a join, on the data rate of this attempt
+    if (Join_Due(&Join) && RFM_Command_Status != JOIN && Cycle.State == LORA_IDLE)
+    {
+        Join_Datarate(&Join, &LoRa_Settings);
+        if (currentChannel == MULTI)
+        {
+            randomChannel(LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, LORA_JOIN_REQUEST_SIZE));
+        }
+        RFM_Command_Status = JOIN;
+    }
+
+    //Retransmission of a confirmed uplink without ACK, on the next channel
+    if (Confirm_Due(&Confirm) && RFM_Command_Status != RETRANSMIT && Cycle.State == LORA_IDLE)
+    {
+        if (currentChannel == MULTI)
+        {
+            randomChannel(LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, Cycle.Package.Counter));
+        }
+        RFM_Command_Status = RETRANSMIT;
+    }
+
+    //Hold a new frame until a channel is within the duty cycle
+    if (RFM_Command_Status == NEW_RFM_COMMAND && Cycle.State == LORA_IDLE)
+    {
+        hold = selectChannel(LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, Buffer_Tx.Counter + MAC_Commands.Answer_Length + LORA_FRAME_OVERHEAD)) != 0;
+    }
+    if (RFM_Command_Status == JOIN && Cycle.State == LORA_IDLE)
+    {
+        hold = selectChannel(LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, LORA_JOIN_REQUEST_SIZE)) != 0;
+    }
+    if (RFM_Command_Status == RETRANSMIT && Cycle.State == LORA_IDLE)
+    {
+        hold = selectChannel(LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, Cycle.Package.Counter)) != 0;
+    }
+
+    //Type A mote transmit receive cycle, advances one step and returns
+    if (!hold && (RFM_Command_Status == NEW_RFM_COMMAND || RFM_Command_Status == JOIN || RFM_Command_Status == RETRANSMIT || Cycle.State != LORA_IDLE) && LoRa_Settings.Mote_Class == 0x00)
     {
         //LoRa cycle
-        LORA_Cycle(&Buffer_Tx, &Buffer_Rx, &RFM_Command_Status, &Session_Data, &OTAA_Data, &Message_Rx, &LoRa_Settings);
+        Event = LORA_Cycle(&Cycle, &Buffer_Tx, &Buffer_Rx, &RFM_Command_Status, &Session_Data, &OTAA_Data, &Message_Rx, &LoRa_Settings);
+
+        //Adapt the data rate, once per frame counter
+        if (Event == LORA_EVENT_TX_DONE && Cycle.Command == NEW_RFM_COMMAND)
+        {
+            ADR_Uplink(&ADR, &LoRa_Settings);
+        }
+
+        //A confirmed uplink waits for its ACK
+        if (Event == LORA_EVENT_TX_DONE && Cycle.Command == NEW_RFM_COMMAND && LoRa_Settings.Confirm == 0x01)
+        {
+            Confirm_Init(&Confirm, Frame_Counter_Tx - 1, &LoRa_Settings);
+        }
+        if (Event == LORA_EVENT_TX_DONE && Cycle.Command == RETRANSMIT)
+        {
+            Confirm_Sent(&Confirm);
+        }
+
+        if (Event == LORA_EVENT_RX_DONE)
+        {
+            adrDownlink();
+        }
+
+        //The confirmed uplink is acknowledged, sent again or given up
+        if ((Event == LORA_EVENT_RX_DONE || Event == LORA_EVENT_RX_TIMEOUT) && Confirm.Active)
+        {
+            if (Event == LORA_EVENT_RX_DONE && (Message_Rx.Frame_Control & 0x20))
+            {
+                Confirm_Acked(&Confirm, &LoRa_Settings);
+                confirm_done = true;
+            }
+            else
+            {
+                confirm_done = Confirm_Failed(&Confirm, &LoRa_Settings);
+            }
+        }
 
-        if (Buffer_Rx.Counter != 0x00)
+        //The join goes on with a backoff or ends
+        if (Event == LORA_EVENT_JOINED)
+        {
+            Join_Accepted(&Join);
+        }
+        if (Event == LORA_EVENT_JOIN_FAILED && !Join_Failed(&Join, LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, LORA_JOIN_REQUEST_SIZE), &LoRa_Settings))
         {
-            Rx_Status = NEW_RX;
+            Event = LORA_EVENT_NONE;
         }
 
-        RFM_Command_Status = NO_RFM_COMMAND;
+        if (Event != LORA_EVENT_NONE)
+        {
+            syncDataRate();
+        }
+
+        if ((Event == LORA_EVENT_JOINED || Event == LORA_EVENT_JOIN_FAILED) && Join_Callback != NULL)
+        {
+            Join_Callback(Event == LORA_EVENT_JOINED);
+        }
+
+        if (confirm_done && Confirm_Callback != NULL)
+        {
+            bool acked = (Event == LORA_EVENT_RX_DONE && (Message_Rx.Frame_Control & 0x20));
+            Confirm_Callback(Confirm.Frame_Counter, acked, Confirm.Attempts, acked ? Message_Rx.RSSI : 0);
+        }
+
+        if (Event == LORA_EVENT_RX_DONE && Buffer_Rx.Counter != 0x00)
+        {
+            dispatchDownlink();
+        }
+
+        if (Event != LORA_EVENT_NONE && Event_Callback != NULL)
+        {
+            Event_Callback(Event);
+        }
     }
 
     //Type C mote transmit and receive handling
     if (LoRa_Settings.Mote_Class == 0x01)
     {
         //Transmit
-        if (RFM_Command_Status == NEW_RFM_COMMAND)
+        if (RFM_Command_Status == NEW_RFM_COMMAND && !hold)
         {
             //Lora send data
             LORA_Send_Data(&Buffer_Tx, &Session_Data, &LoRa_Settings);
+            ADR_Uplink(&ADR, &LoRa_Settings);
+            syncDataRate();
 
             RFM_Command_Status = NO_RFM_COMMAND;
         }
 
-        //Receive
-        if (digitalRead(RFM_pins.DIO0) == HIGH)
+        //Receive, the RxDone interrupt keeps the packages until readData() took the last one
+        RFM_Get_Events(RFM_EVENT_DIO0);
+        while (RFM_Queued_Packages() != 0x00 && Rx_Status != NEW_RX)
         {
             //Get data
-            LORA_Receive_Data(&Buffer_Rx, &Session_Data, &OTAA_Data, &Message_Rx, &LoRa_Settings);
+            if (LORA_Receive_Data(&Buffer_Rx, &Session_Data, &Message_Rx, &LoRa_Settings))
+            {
+                adrDownlink();
+                syncDataRate();
+            }
 
             if (Buffer_Rx.Counter != 0x00)
             {
-                Rx_Status = NEW_RX;
+                dispatchDownlink();
             }
         }
-        RFM_Command_Status = NO_RFM_COMMAND;
+        if (!hold)
+        {
+            RFM_Command_Status = NO_RFM_COMMAND;
+        }
     }
+
+#ifdef KEYSTREAM_PRECOMPUTE
+    //Prepare the encryption of the next uplink while the radio waits, also for a held frame
+    if (Cycle.State == LORA_IDLE && (Keystream.Valid == 0x00 || Keystream.Frame_Counter != Frame_Counter_Tx))
+    {
+        Keystream_Prepare(&Keystream, &Session_Data);
+    }
+#endif
 }
 
-void LoRaWANClass::randomChannel()
+void LoRaWANClass::adrDownlink(void)
 {
-    unsigned char freq_idx;
-#ifdef AS_923
-    freq_idx = random(0, 9);
-    // limit drate, ch 8 -> sf7bw250
-    LoRa_Settings.Datarate_Tx = freq_idx == 0x08 ? 0x06 : drate_common;
-#else
-    freq_idx = random(0, 8);
-    LoRa_Settings.Channel_Rx = freq_idx + 0x08;
+    // The margin of the uplink from a LinkCheckAns is the better measure
+    if (MAC_Commands.Link_Check == 0x01)
+    {
+        ADR_Downlink(&ADR, MAC_Commands.Link_Margin > 127 ? 127 : MAC_Commands.Link_Margin, &LoRa_Settings);
+        MAC_Commands.Link_Check = 0x02;
+    }
+    else
+    {
+        ADR_Downlink(&ADR, ADR_Margin(Message_Rx.SNR, Message_Rx.Spreading_Factor), &LoRa_Settings);
+    }
+}
+
+void LoRaWANClass::syncDataRate(void)
+{
+    // ADR and LinkADRReq change the data rate, the channel selection starts from drate_common
+    if (LoRa_Settings.Channel_Tx == BAND_PLAN.Fixed_Channel)
+    {
+        return;
+    }
+    drate_common = LoRa_Settings.Datarate_Tx;
+}
+
+void LoRaWANClass::onEvent(lora_callback_t callback)
+{
+    Event_Callback = callback;
+}
+
+void LoRaWANClass::onConfirm(lora_confirm_callback_t callback)
+{
+    Confirm_Callback = callback;
+}
+
+bool LoRaWANClass::onDownlink(unsigned char port, lora_downlink_callback_t handler)
+{
+    int i;
+    int free = -1;
+
+    for (i = 0; i < DOWNLINK_HANDLERS; i++)
+    {
+        //Replace or remove the handler of the port
+        if (Downlink_Handler[i] != NULL && Downlink_Port[i] == port)
+        {
+            Downlink_Handler[i] = handler;
+            return true;
+        }
+        if (Downlink_Handler[i] == NULL && free < 0)
+        {
+            free = i;
+        }
+    }
+
+    if (handler == NULL)
+    {
+        return true;
+    }
+    if (free < 0)
+    {
+        return false;
+    }
+
+    Downlink_Port[free] = port;
+    Downlink_Handler[free] = handler;
+    return true;
+}
+
+void LoRaWANClass::dispatchDownlink(void)
+{
+    sLoRa_Downlink Downlink;
+    lora_downlink_callback_t handler = NULL;
+    int i;
+
+#ifdef FUOTA
+    //The fragmentation package takes its port, the block goes to the flash
+    if (Message_Rx.Frame_Port == FRAG_PORT)
+    {
+        if (Frag_Downlink(Buffer_Rx.Data, Buffer_Rx.Counter, Frag_Answer, &Frag_Answer_Length) && Frag_Callback != NULL)
+        {
+            Frag_Callback(Frag_Size(), Frag_Descriptor());
+        }
+        Buffer_Rx.Counter = 0x00;
+        Rx_Status = NO_RX;
+        return;
+    }
+#endif
+
+    //Handler of the port, else the one of port 0
+    for (i = 0; i < DOWNLINK_HANDLERS; i++)
+    {
+        if (Downlink_Handler[i] != NULL && Downlink_Port[i] == Message_Rx.Frame_Port)
+        {
+            handler = Downlink_Handler[i];
+            break;
+        }
+        if (Downlink_Handler[i] != NULL && Downlink_Port[i] == 0x00)
+        {
+            handler = Downlink_Handler[i];
+        }
+    }
+
+    //Without a handler the payload waits for readData()
+    if (handler == NULL)
+    {
+        Rx_Status = NEW_RX;
+        return;
+    }
+
+    //The handler reads the payload in the receive buffer
+    Downlink.Port = Message_Rx.Frame_Port;
+    Downlink.Data = Buffer_Rx.Data;
+    Downlink.Length = Buffer_Rx.Counter;
+    Downlink.Frame_Counter = Message_Rx.Frame_Counter;
+    Downlink.RSSI = Message_Rx.RSSI;
+    Downlink.SNR = Message_Rx.SNR;
+    handler(&Downlink);
+
+    Buffer_Rx.Counter = 0x00;
+    Rx_Status = NO_RX;
+}
+
+#ifdef FUOTA
+void LoRaWANClass::onFragDone(lora_frag_callback_t callback)
+{
+    Frag_Callback = callback;
+}
+
+bool LoRaWANClass::installFirmware(void)
+{
+    if (!Frag_Install())
+    {
+        return false;
+    }
+
+    //The bootloader copies the block to the application
+    NVIC_SystemReset();
+    return true;
+}
+
+void LoRaWANClass::getFragStats(unsigned int *nb_frag, unsigned int *received, unsigned int *lost, unsigned int *coded)
+{
+    Frag_Stats(nb_frag, received, lost, coded);
+}
 #endif
+
+bool LoRaWANClass::busy(void)
+{
+    return Cycle.State != LORA_IDLE || Confirm.Active;
+}
+
+void LoRaWANClass::getCycleStats(unsigned long *cpu_us, long *rx1_error_us, long *rx2_error_us)
+{
+    *cpu_us = Cycle.Cpu_Time;
+    *rx1_error_us = Cycle.Rx_Error[0];
+    *rx2_error_us = Cycle.Rx_Error[1];
+}
+
+void LoRaWANClass::getRxOnTime(unsigned long *rx1_us, unsigned long *rx2_us)
+{
+    *rx1_us = Cycle.Rx_On_Time[0];
+    *rx2_us = Cycle.Rx_On_Time[1];
+}
+
+unsigned long LoRaWANClass::getTxLatency(void)
+{
+    return RFM_Get_Tx_Time() - Trigger_Time;
+}
+
+unsigned long LoRaWANClass::earliestTxTime(unsigned int len)
+{
+    unsigned long time_on_air = LORA_Time_On_Air(LoRa_Settings.Datarate_Tx, len + LORA_FRAME_OVERHEAD);
+    unsigned long wait = Duty_Cycle_Wait(LoRa_Settings.Channel_Tx, time_on_air);
+    unsigned long channel_wait;
+
+    // With MULTI or hopping the first channel with budget is taken
+    if (currentChannel == MULTI || LoRa_Settings.Channel_Hopping == 0x01)
+    {
+        for (unsigned char i = 0; i < BAND_PLAN.Uplink_Channels; i++)
+        {
+            if (!(LoRa_Settings.Channel_Mask & (1 << i)))
+                continue;
+            channel_wait = Duty_Cycle_Wait(i, time_on_air);
+            if (channel_wait < wait)
+                wait = channel_wait;
+        }
+    }
+    return millis() + wait;
+}
+
+unsigned long LoRaWANClass::selectChannel(unsigned long time_on_air)
+{
+    unsigned long wait = Duty_Cycle_Wait(LoRa_Settings.Channel_Tx, time_on_air);
+
+    // A fixed channel waits for its sub-band
+    if (wait == 0 || (currentChannel != MULTI && LoRa_Settings.Channel_Hopping == 0x00))
+    {
+        return wait;
+    }
+
+    if (currentChannel == MULTI)
+    {
+        randomChannel(time_on_air);
+    }
+    else
+    {
+        // Hopping goes on to the next channel with budget
+        for (unsigned char i = 1; i < BAND_PLAN.Uplink_Channels; i++)
+        {
+            unsigned char channel = (LoRa_Settings.Channel_Tx + i) % BAND_PLAN.Uplink_Channels;
+            if ((LoRa_Settings.Channel_Mask & (1 << channel)) && Duty_Cycle_Wait(channel, time_on_air) == 0)
+            {
+                LoRa_Settings.Channel_Tx = channel;
+                break;
+            }
+        }
+    }
+    return Duty_Cycle_Wait(LoRa_Settings.Channel_Tx, time_on_air);
+}
+
+void LoRaWANClass::randomChannel(unsigned long time_on_air)
+{
+    unsigned char freq_idx = 0;
+    unsigned char ready[BAND_MAX_CHANNELS];
+    unsigned char count = 0;
+    unsigned long wait, best = 0xFFFFFFFF;
+    const unsigned char channels = BAND_PLAN.Uplink_Channels;
+
+    // Random over the channels within the duty cycle, the one that is first ready otherwise.
+    // Only the channels of the mask of the network.
+    for (unsigned char i = 0; i < channels; i++)
+    {
+        if (!(LoRa_Settings.Channel_Mask & (1 << i)))
+        {
+            continue;
+        }
+        wait = Duty_Cycle_Wait(i, time_on_air);
+        if (wait == 0)
+        {
+            ready[count++] = i;
+        }
+        else if (count == 0 && wait < best)
+        {
+            best = wait;
+            freq_idx = i;
+        }
+    }
+    if (count != 0)
+    {
+        freq_idx = ready[random(0, count)];
+    }
+    // A channel with one data rate, the others are back on drate_common
+    if (BAND_PLAN.Fixed_Channel != 0xFF)
+    {
+        Band_Set_Datarate(freq_idx == BAND_PLAN.Fixed_Channel ? BAND_PLAN.Fixed_Datarate : drate_common, &LoRa_Settings);
+    }
+    LoRa_Settings.Channel_Rx = Band_Rx1_Channel(BAND_PLAN, freq_idx);
     LoRa_Settings.Channel_Tx = freq_idx;
 }
 
@@ -420,6 +1071,152 @@ unsigned int LoRaWANClass::getFrameCounter()
 void LoRaWANClass::setFrameCounter(unsigned int FrameCounter)
 {
     Frame_Counter_Tx = FrameCounter;
+#ifdef FCNT_NVM
+    NVM_Counter_Save(&Session_Data);
+#endif
+}
+
+bool LoRaWANClass::saveSession(void)
+{
+    NVMClass nvm;
+    RTCClass rtc;
+    sSession_Record Record;
+    sSession_Record Stored;
+    uint32_t Backup[4];
+    uint32_t ack;
+
+    // A cycle can not be continued after a wake up
+    if (Cycle.State != LORA_IDLE)
+    {
+        return false;
+    }
+
+    memset(&Record, 0x00, sizeof(Record));
+    memcpy(Record.NwkSKey, NwkSKey, 16);
+    memcpy(Record.AppSKey, AppSKey, 16);
+    memcpy(Record.DevAddr, Address_Tx, 4);
+    Record.Mote_Class = LoRa_Settings.Mote_Class;
+    Record.Confirm = LoRa_Settings.Confirm;
+    Record.Channel_Hopping = LoRa_Settings.Channel_Hopping;
+    Record.Datarate = drate_common;
+    Record.Channel = currentChannel;
+    Record.Rx_Delay = LoRa_Settings.Rx_Delay;
+    Record.Rx1_DR_Offset = LoRa_Settings.Rx1_DR_Offset;
+    Record.Datarate_Rx2 = LoRa_Settings.Datarate_Rx2;
+    Record.Max_Duty_Cycle = LoRa_Settings.Max_Duty_Cycle;
+    Record.Nb_Trans = LoRa_Settings.Nb_Trans;
+    Record.Channel_Mask = LoRa_Settings.Channel_Mask;
+    Record.Battery = MAC_Commands.Battery;
+    Record.ADR_Enabled = ADR.Enabled;
+    Record.Frequency_Set = RFM_Get_Frequencies(&Record.Frequency[0][0]);
+    Record.Check = Session_CRC(0xFFFFFFFF, &Record, offsetof(sSession_Record, Check));
+
+    // The row is only written when the keys or the settings changed
+    nvm.read(SESSION_NVM_ADDRESS, &Stored, sizeof(Stored));
+    if (memcmp(&Record, &Stored, sizeof(Record)) != 0)
+    {
+        if (nvm.erase_row(SESSION_NVM_ADDRESS) != NVM_OK)
+        {
+            return false;
+        }
+        for (unsigned int i = 0; i < sizeof(Record); i += NVM_PAGE_SIZE)
+        {
+            int len = (sizeof(Record) - i > NVM_PAGE_SIZE) ? NVM_PAGE_SIZE : sizeof(Record) - i;
+            if (nvm.write_page(SESSION_NVM_ADDRESS + i, (unsigned char *)&Record + i, len) != NVM_OK)
+            {
+                return false;
+            }
+        }
+    }
+
+    ack = ADR.Ack_Counter;
+    if (ack >= SESSION_ADR_ACK_MAX)
+    {
+        ack = SESSION_ADR_ACK_MAX + (ack - ADR_ACK_LIMIT) % ADR_ACK_DELAY;
+    }
+
+    Backup[0] = Frame_Counter_Tx;
+    Backup[1] = Frame_Counter_Rx;
+    Backup[2] = LoRa_Settings.Datarate_Tx | (LoRa_Settings.Channel_Tx << 8) | (LoRa_Settings.Transmit_Power << 16) | (ack << 24);
+    if (LoRa_Settings.Frame_Control & 0x40)
+    {
+        Backup[2] |= 0x80000000UL;
+    }
+    Backup[3] = Session_CRC(Record.Check, Backup, 3 * sizeof(uint32_t));
+    rtc.set_backup(4, Backup[0], Backup[1], Backup[2], Backup[3]);
+    return true;
+}
+
+bool LoRaWANClass::restoreSession(void)
+{
+    NVMClass nvm;
+    RTCClass rtc;
+    sSession_Record Record;
+    uint32_t Backup[4];
+
+    rtc.get_backup(4, &Backup[0], &Backup[1], &Backup[2], &Backup[3]);
+    nvm.read(SESSION_NVM_ADDRESS, &Record, sizeof(Record));
+
+    // The record and the backup registers of the same saveSession()
+    if (Record.Check != Session_CRC(0xFFFFFFFF, &Record, offsetof(sSession_Record, Check)) ||
+        Backup[3] != Session_CRC(Record.Check, Backup, 3 * sizeof(uint32_t)))
+    {
+        return false;
+    }
+
+    initState();
+
+    memcpy(NwkSKey, Record.NwkSKey, 16);
+    memcpy(AppSKey, Record.AppSKey, 16);
+    memcpy(Address_Tx, Record.DevAddr, 4);
+    AES_Expand_Key(NwkSKey, &NwkSKey_Expanded);
+    AES_Expand_Key(AppSKey, &AppSKey_Expanded);
+    CMAC_Key_Init(&NwkSKey_CMAC, &NwkSKey_Expanded);
+
+    LoRa_Settings.Mote_Class = Record.Mote_Class;
+    LoRa_Settings.Confirm = Record.Confirm;
+    LoRa_Settings.Channel_Hopping = Record.Channel_Hopping;
+    drate_common = Record.Datarate;
+    currentChannel = Record.Channel;
+    LoRa_Settings.Rx_Delay = Record.Rx_Delay;
+    LoRa_Settings.Rx1_DR_Offset = Record.Rx1_DR_Offset;
+    LoRa_Settings.Datarate_Rx2 = Record.Datarate_Rx2;
+    LoRa_Settings.Max_Duty_Cycle = Record.Max_Duty_Cycle;
+    LoRa_Settings.Nb_Trans = (Record.Nb_Trans != 0x00) ? Record.Nb_Trans : CONFIRM_NB_TRANS;
+    LoRa_Settings.Channel_Mask = Record.Channel_Mask;
+    Duty_Cycle_Set_Total(Record.Max_Duty_Cycle);
+    MAC_Commands.Battery = Record.Battery;
+    RFM_Set_Frequencies(Record.Frequency_Set, &Record.Frequency[0][0]);
+    ADR_Init(&ADR, Record.ADR_Enabled, &LoRa_Settings);
+    dev_class = (Record.Mote_Class == 0x00) ? CLASS_A : CLASS_C;
+
+    Frame_Counter_Tx = Backup[0];
+    Frame_Counter_Rx = Backup[1];
+    // Band_Set_Datarate() also sets the data rate of RX1 after the Rx1_DR_Offset of the record
+    Band_Set_Datarate(Backup[2] & 0xFF, &LoRa_Settings);
+    LoRa_Settings.Channel_Tx = (Backup[2] >> 8) & 0xFF;
+    LoRa_Settings.Channel_Rx = Band_Rx1_Channel(BAND_PLAN, LoRa_Settings.Channel_Tx);
+    LoRa_Settings.Transmit_Power = (Backup[2] >> 16) & 0xFF;
+    ADR.Ack_Counter = (Backup[2] >> 24) & 0x7F;
+    if (Backup[2] & 0x80000000UL)
+    {
+        LoRa_Settings.Frame_Control |= 0x40;
+    }
+#ifdef FCNT_NVM
+    // The counters are exact, the log only learns where its last record is
+    NVM_Counter_Resume(&Session_Data);
+#endif
+
+    if (!initRadio(true))
+    {
+        return false;
+    }
+
+    if (LoRa_Settings.Mote_Class == 0x01)
+    {
+        RFM_Continuous_Receive(&LoRa_Settings);
+    }
+    return true;
 }
 
 // define lora objet
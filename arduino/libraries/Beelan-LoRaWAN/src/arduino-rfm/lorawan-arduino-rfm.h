@@ -37,6 +37,14 @@
 #include "Encrypt.h"
 #include "RFM95.h"
 #include "LoRaMAC.h"
+#include "NVM-Counter.h"
+#include "Duty-Cycle.h"
+#include "ADR.h"
+#include "Join.h"
+#include "Confirm.h"
+#include "MAC-Commands.h"
+#include "Fragmentation.h"
+#include "Band-Plan.h"
 #include "Struct.h"
 #include "Config.h"
 
@@ -48,6 +56,25 @@
 
 
 #define LORAWAN_VERSION "1.0.0"
+
+// Uplink queue, bytes for the records with their length byte and number of records.
+// The default fills the largest frame of the fast data rates.
+#ifndef UPLINK_QUEUE_SIZE
+#define UPLINK_QUEUE_SIZE (LORA_FRAME_SIZE - LORA_FRAME_OVERHEAD)
+#endif
+#ifndef UPLINK_QUEUE_RECORDS
+#define UPLINK_QUEUE_RECORDS 16
+#endif
+
+// Handlers of onDownlink()
+#ifndef DOWNLINK_HANDLERS
+#define DOWNLINK_HANDLERS 4
+#endif
+
+// Row of the RWW EEPROM for the keys of saveSession(), default the row after the frame counter log
+#ifndef SESSION_NVM_ADDRESS
+#define SESSION_NVM_ADDRESS (FCNT_NVM_ADDRESS + FCNT_NVM_ROWS * 256)
+#endif
 /*
 *****************************************************************************************
 * CLASS
@@ -62,7 +89,15 @@ class LoRaWANClass
         ~LoRaWANClass();
         
         bool init(void);
+        // One JoinRequest, returns after the JoinAccept windows
         bool join(void);
+        // OTAA join in the background of update(), callback(true) once joined or callback(false)
+        // after tries JoinRequests, 0 tries until it joins. The JoinRequests have a random
+        // backoff and rotate the data rate, see Join.cpp. The join is done as class A,
+        // sendUplink() is ignored while it runs and queueUplink() records wait for it.
+        void joinAsync(lora_join_callback_t callback, unsigned int tries = 0);
+        // millis() of the next JoinRequest, the node can sleep until then
+        unsigned long nextJoinTime(void);
         void setDeviceClass(devclass_t dev_class);
         // OTAA credentials
         void setDevEUI(const char *devEUI_in);
@@ -72,35 +107,118 @@ class LoRaWANClass
         void setNwkSKey(const char *NwkKey_in);
         void setAppSKey(const char *ApskKey_in);
         void setDevAddr(const char *devAddr_in);
-        void sendUplink(char *data, unsigned int len, unsigned char confirm);
+        // Port 1 to 223. False when len is above LORA_Max_Payload() of the data rate,
+        // a join or confirmed uplink is running or the last frame is not sent yet,
+        // nothing is sent then.
+        bool sendUplink(char *data, unsigned int len, unsigned char confirm, unsigned char port = 1);
+        // Records are packed into one unconfirmed frame as a length byte and the data.
+        // The frame is sent when the payload of the data rate is full or a record is
+        // budget_ms old.
+        bool queueUplink(const char *data, unsigned int len, unsigned long budget_ms);
+        void getQueueStats(long *bytes_saved, long *airtime_saved_us);
+        // millis() from which a frame with len payload bytes is within the duty cycle
+        unsigned long earliestTxTime(unsigned int len);
         void setDataRate(unsigned char data_rate);
         void setChannel(unsigned char channel);
         unsigned char getChannel();
         unsigned char getDataRate();
         void setTxPower(unsigned char power_idx);
+        // The node raises the data rate and lowers the power while the downlinks have
+        // margin, setDataRate() and setTxPower() give the start values
+        void setADR(bool enable);
+        // Battery level for the DevStatusAns, 0 external power, 1 to 254, 255 unknown
+        void setBattery(unsigned char level);
+        // LinkCheckReq with the next uplink, getLinkCheck() is true once it is answered
+        void linkCheck(void);
+        bool getLinkCheck(unsigned char *margin, unsigned char *gateways);
+        // outBuff takes up to 243 bytes, the data and a 0
         int readData(char *outBuff);
+        // handler gets the payloads of port (1 to 255) from update(), port 0 the ports without a
+        // handler. A NULL handler removes it, false when all DOWNLINK_HANDLERS are taken.
+        // A payload given to a handler is not returned by readData().
+        bool onDownlink(unsigned char port, lora_downlink_callback_t handler);
         void update(void);
+        // TX done, downlink received and RX timeout of the class A cycle
+        void onEvent(lora_callback_t callback);
+        // Class A confirmed uplinks are sent until the ACK, up to NbTrans times (CONFIRM_NB_TRANS
+        // until the network sets it). callback(fcnt, true, attempts, rssi of the ACK) when it is
+        // acknowledged, callback(fcnt, false, attempts, 0) when it is given up. busy() meanwhile.
+        void onConfirm(lora_confirm_callback_t callback);
+        bool busy(void);
+        // Last class A frame: us of MAC processing and how many us the RX1 and RX2
+        // windows opened later than planned, 0 for a window that was not opened
+        void getCycleStats(unsigned long *cpu_us, long *rx1_error_us, long *rx2_error_us);
+        // Last class A frame: us the radio was receiving in the RX1 and RX2 windows
+        void getRxOnTime(unsigned long *rx1_us, unsigned long *rx2_us);
+        // us from sendUplink() or the flush of the queue to the radio switching to TX,
+        // of the last frame once it is sent. Includes a wait for the duty cycle.
+        unsigned long getTxLatency(void);
+#ifdef FUOTA
+        // Fragmented data block of FRAG_PORT, see Fragmentation.cpp. callback(size, descriptor)
+        // once the block is complete in the flash, the answers to the network go out with the
+        // next free uplinks on FRAG_PORT.
+        void onFragDone(lora_frag_callback_t callback);
+        // Hands the complete block to the bootloader and resets, false when there is none
+        bool installFirmware(void);
+        // Fragments of the block, lost ones at the first coded fragment and coded ones received
+        void getFragStats(unsigned int *nb_frag, unsigned int *received, unsigned int *lost, unsigned int *coded);
+#endif
 
         // frame counter
         unsigned int getFrameCounter();
         void setFrameCounter(unsigned int FrameCounter);
 
+        // Session kept over the BACKUP sleep, uses the four RTC backup registers.
+        // saveSession() and RF.end() before the sleep, restoreSession() instead of init()
+        // after the wake up and before rtc.begin(). False from restoreSession(): init() and join.
+        bool saveSession(void);
+        bool restoreSession(void);
+
     private:
-        void randomChannel();
+        void initState(void);
+        void startJoin(lora_join_callback_t callback, unsigned int tries, unsigned long jitter);
+        bool initRadio(bool warm);
+        void sendQueue(void);
+        unsigned long selectChannel(unsigned long time_on_air);
+        void randomChannel(unsigned long time_on_air);
+        void adrDownlink(void);
+        void syncDataRate(void);
+        void dispatchDownlink(void);
 
     private:        
         // Messages
-        unsigned char Data_Tx[64];
+        unsigned char Data_Tx[LORA_TX_BUFFER_SIZE];
         sBuffer Buffer_Tx;
-        unsigned char Data_Rx[64];
+        unsigned char Queue_Data[UPLINK_QUEUE_SIZE];
+        unsigned long Queue_Deadline[UPLINK_QUEUE_RECORDS];
+        unsigned int Queue_Length;
+        unsigned char Queue_Records;
+        long Queue_Bytes_Saved;
+        long Queue_Airtime_Saved;
+        unsigned char Data_Rx[LORA_FRAME_SIZE - LORA_FRAME_OVERHEAD];
         sBuffer Buffer_Rx;
         sLoRa_Message Message_Rx;
+        unsigned char Downlink_Port[DOWNLINK_HANDLERS];
+        lora_downlink_callback_t Downlink_Handler[DOWNLINK_HANDLERS];
+#ifdef FUOTA
+        unsigned char Frag_Answer[FRAG_ANSWER_SIZE];
+        unsigned char Frag_Answer_Length;
+        lora_frag_callback_t Frag_Callback;
+#endif
 
         // Declare ABP session
         unsigned char Address_Tx[4];
         unsigned char NwkSKey[16];
         unsigned char AppSKey[16];
+        sAES_Expanded_Key NwkSKey_Expanded;
+        sAES_Expanded_Key AppSKey_Expanded;
+        sCMAC_Key NwkSKey_CMAC;
+        sMAC_Commands MAC_Commands;
+#ifdef KEYSTREAM_PRECOMPUTE
+        sKeystream Keystream;
+#endif
         unsigned int Frame_Counter_Tx;
+        unsigned int Frame_Counter_Rx;
         sLoRa_Session Session_Data;
 
         // Declare OTAA data struct
@@ -117,6 +235,11 @@ class LoRaWANClass
         sRFM_pins LoRa_Pins;
 
         unsigned char drate_common;
+        sADR ADR;
+        sJoin Join;
+        lora_join_callback_t Join_Callback;
+        sConfirm Confirm;
+        lora_confirm_callback_t Confirm_Callback;
 
         // Lora Setting Class
         devclass_t dev_class;
@@ -127,6 +250,9 @@ class LoRaWANClass
         // UART
         RFM_command_t RFM_Command_Status;
         rx_t Rx_Status;
+        sLoRa_Cycle Cycle;
+        lora_callback_t Event_Callback;
+        unsigned long Trigger_Time;
 };
 
 #endif
@@ -71,6 +71,7 @@ LoRaClass::LoRaClass() : _spiSettings(LORA_DEFAULT_SPI_FREQUENCY, MSBFIRST, SPI_
 {
   // overide Stream timeout value
   setTimeout(0);
+  rfTimingInit(&_timing);
 }
 
 int LoRaClass::begin(long frequency)
@@ -102,6 +103,9 @@ int LoRaClass::begin(long frequency)
   // put in sleep mode
   sleep();
 
+  // modem settings after reset
+  rfTimingInit(&_timing);
+
   // set frequency
   setFrequency(frequency);
 
@@ -457,7 +461,7 @@ void LoRaClass::setFrequency(long frequency)
 
 int LoRaClass::getSpreadingFactor()
 {
-  return readRegister(REG_MODEM_CONFIG_2) >> 4;
+  return _timing.sf;
 }
 
 void LoRaClass::setSpreadingFactor(int sf)
@@ -483,38 +487,13 @@ void LoRaClass::setSpreadingFactor(int sf)
   }
 
   writeRegister(REG_MODEM_CONFIG_2, (readRegister(REG_MODEM_CONFIG_2) & 0x0f) | ((sf << 4) & 0xf0));
+  _timing.sf = sf;
   setLdoFlag();
 }
 
 long LoRaClass::getSignalBandwidth()
 {
-  byte bw = (readRegister(REG_MODEM_CONFIG_1) >> 4);
-
-  switch (bw)
-  {
-  case 0:
-    return 7.8E3;
-  case 1:
-    return 10.4E3;
-  case 2:
-    return 15.6E3;
-  case 3:
-    return 20.8E3;
-  case 4:
-    return 31.25E3;
-  case 5:
-    return 41.7E3;
-  case 6:
-    return 62.5E3;
-  case 7:
-    return 125E3;
-  case 8:
-    return 250E3;
-  case 9:
-    return 500E3;
-  }
-
-  return -1;
+  return _timing.bandwidth;
 }
 
 void LoRaClass::setSignalBandwidth(long sbw)
@@ -562,17 +541,17 @@ void LoRaClass::setSignalBandwidth(long sbw)
     bw = 9;
   }
 
+  static const uint32_t bandwidths[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+
   writeRegister(REG_MODEM_CONFIG_1, (readRegister(REG_MODEM_CONFIG_1) & 0x0f) | (bw << 4));
+  _timing.bandwidth = bandwidths[bw];
   setLdoFlag();
 }
 
 void LoRaClass::setLdoFlag()
 {
-  // Section 4.1.1.5
-  long symbolDuration = 1000 / (getSignalBandwidth() / (1L << getSpreadingFactor()));
-
-  // Section 4.1.1.6
-  boolean ldoOn = symbolDuration > 16;
+  // Section 4.1.1.5 and 4.1.1.6, symbols of 16 ms and more
+  boolean ldoOn = rfLowDataRate(&_timing);
 
   uint8_t config3 = readRegister(REG_MODEM_CONFIG_3);
   bitWrite(config3, 3, ldoOn);
@@ -593,12 +572,14 @@ void LoRaClass::setCodingRate4(int denominator)
   int cr = denominator - 4;
 
   writeRegister(REG_MODEM_CONFIG_1, (readRegister(REG_MODEM_CONFIG_1) & 0xf1) | (cr << 1));
+  _timing.cr = denominator;
 }
 
 void LoRaClass::setPreambleLength(long length)
 {
   writeRegister(REG_PREAMBLE_MSB, (uint8_t)(length >> 8));
   writeRegister(REG_PREAMBLE_LSB, (uint8_t)(length >> 0));
+  _timing.preamble = length;
 }
 
 void LoRaClass::setSyncWord(int sw)
@@ -609,11 +590,13 @@ void LoRaClass::setSyncWord(int sw)
 void LoRaClass::enableCrc()
 {
   writeRegister(REG_MODEM_CONFIG_2, readRegister(REG_MODEM_CONFIG_2) | 0x04);
+  _timing.crc = 1;
 }
 
 void LoRaClass::disableCrc()
 {
   writeRegister(REG_MODEM_CONFIG_2, readRegister(REG_MODEM_CONFIG_2) & 0xfb);
+  _timing.crc = 0;
 }
 
 void LoRaClass::enableInvertIQ()
@@ -644,6 +627,11 @@ void LoRaClass::setOCP(uint8_t mA)
   writeRegister(REG_OCP, 0x20 | (0x1F & ocpTrim));
 }
 
+uint32_t LoRaClass::timeOnAir(int size)
+{
+  return rfTimeOnAir(&_timing, size);
+}
+
 byte LoRaClass::random()
 {
   return readRegister(REG_RSSI_WIDEBAND);
@@ -680,6 +668,7 @@ void LoRaClass::dumpRegisters(Stream &out)
 void LoRaClass::explicitHeaderMode()
 {
   _implicitHeaderMode = 0;
+  _timing.implicitHeader = 0;
 
   writeRegister(REG_MODEM_CONFIG_1, readRegister(REG_MODEM_CONFIG_1) & 0xfe);
 }
@@ -687,6 +676,7 @@ void LoRaClass::explicitHeaderMode()
 void LoRaClass::implicitHeaderMode()
 {
   _implicitHeaderMode = 1;
+  _timing.implicitHeader = 1;
 
   writeRegister(REG_MODEM_CONFIG_1, readRegister(REG_MODEM_CONFIG_1) | 0x01);
 }
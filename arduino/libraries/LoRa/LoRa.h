@@ -8,6 +8,7 @@
 
 #include <Arduino.h>
 #include <RF.h>
+#include <RFTiming.h>
 
 #define LORA_DEFAULT_SPI RF
 #define LORA_DEFAULT_SPI_FREQUENCY 8000000U
@@ -64,6 +65,8 @@ public:
 
   void setOCP(uint8_t mA); // Over Current Protection control
 
+  uint32_t timeOnAir(int size); // us of a packet with the current settings
+
   // deprecated
   void crc() { enableCrc(); }
   void noCrc() { disableCrc(); }
@@ -110,6 +113,7 @@ private:
   long _frequency;
   int _packetIndex;
   int _implicitHeaderMode;
+  rf_timing_t _timing; // settings written to the radio
   void (*_onReceive)(int);
 };
 
@@ -192,13 +192,13 @@ int16_t SX1278::setBandwidth(float bw) {
   int16_t state = SX1278::setBandwidthRaw(newBandwidth);
   if(state == ERR_NONE) {
     SX127x::_bw = bw;
+    _timing.bandwidth = (uint32_t)(bw * 1000.0 + 0.5);
 
     // calculate symbol length and set low data rate optimization, if needed
-    float symbolLength = (float)(uint32_t(1) << SX127x::_sf) / (float)SX127x::_bw;
     RADIOLIB_DEBUG_PRINT("Symbol length: ");
-    RADIOLIB_DEBUG_PRINT(symbolLength);
-    RADIOLIB_DEBUG_PRINTLN(" ms");
-    if(symbolLength >= 16.0) {
+    RADIOLIB_DEBUG_PRINT(rfSymbolTime(&_timing));
+    RADIOLIB_DEBUG_PRINTLN(" us");
+    if(rfLowDataRate(&_timing)) {
       state = _mod->SPIsetRegValue(SX1278_REG_MODEM_CONFIG_3, SX1278_LOW_DATA_RATE_OPT_ON, 3, 3);
     } else {
       state = _mod->SPIsetRegValue(SX1278_REG_MODEM_CONFIG_3, SX1278_LOW_DATA_RATE_OPT_OFF, 3, 3);
@@ -246,13 +246,16 @@ int16_t SX1278::setSpreadingFactor(uint8_t sf) {
   int16_t state = SX1278::setSpreadingFactorRaw(newSpreadingFactor);
   if(state == ERR_NONE) {
     SX127x::_sf = sf;
+    _timing.sf = sf;
+    // SF6 needs implicit header, both with CRC, see setSpreadingFactorRaw()
+    _timing.implicitHeader = (sf == 6);
+    _timing.crc = 1;
 
     // calculate symbol length and set low data rate optimization, if needed
-    float symbolLength = (float)(uint32_t(1) << SX127x::_sf) / (float)SX127x::_bw;
     RADIOLIB_DEBUG_PRINT("Symbol length: ");
-    RADIOLIB_DEBUG_PRINT(symbolLength);
-    RADIOLIB_DEBUG_PRINTLN(" ms");
-    if(symbolLength >= 16.0) {
+    RADIOLIB_DEBUG_PRINT(rfSymbolTime(&_timing));
+    RADIOLIB_DEBUG_PRINTLN(" us");
+    if(rfLowDataRate(&_timing)) {
       state = _mod->SPIsetRegValue(SX1278_REG_MODEM_CONFIG_3, SX1278_LOW_DATA_RATE_OPT_ON, 3, 3);
     } else {
       state = _mod->SPIsetRegValue(SX1278_REG_MODEM_CONFIG_3, SX1278_LOW_DATA_RATE_OPT_OFF, 3, 3);
@@ -291,6 +294,7 @@ int16_t SX1278::setCodingRate(uint8_t cr) {
   int16_t state = SX1278::setCodingRateRaw(newCodingRate);
   if(state == ERR_NONE) {
     SX127x::_cr = cr;
+    _timing.cr = cr;
   }
   return(state);
 }
@@ -450,6 +454,7 @@ float SX1278::getRSSI() {
 int16_t SX1278::setCRC(bool enableCRC) {
   if(getActiveModem() == SX127X_LORA) {
     // set LoRa CRC
+    _timing.crc = enableCRC;
     if(enableCRC) {
       return(_mod->SPIsetRegValue(SX127X_REG_MODEM_CONFIG_2, SX1278_RX_CRC_MODE_ON, 2, 2));
     } else {
@@ -3,6 +3,7 @@
 SX127x::SX127x(Module* mod) : PhysicalLayer(SX127X_CRYSTAL_FREQ, SX127X_DIV_EXPONENT, SX127X_MAX_PACKET_LENGTH) {
   _mod = mod;
   _packetLengthQueried = false;
+  rfTimingInit(&_timing);
 }
 
 int16_t SX127x::begin(uint8_t chipVersion, uint8_t syncWord, uint8_t currentLimit, uint16_t preambleLength) {
@@ -141,16 +142,8 @@ int16_t SX127x::transmit(uint8_t* data, size_t len, uint8_t addr) {
   uint32_t start = 0;
   if(modem == SX127X_LORA) {
     // calculate timeout (150 % of expected time-one-air)
-    float symbolLength = (float)(uint32_t(1) <<_sf) / (float)_bw;
-    float de = 0;
-    if(symbolLength >= 16.0) {
-      de = 1;
-    }
-    float ih = (float)_mod->SPIgetRegValue(SX127X_REG_MODEM_CONFIG_1, 0, 0);
-    float crc = (float)(_mod->SPIgetRegValue(SX127X_REG_MODEM_CONFIG_2, 2, 2) >> 2);
-    float n_pre = (float)((_mod->SPIgetRegValue(SX127X_REG_PREAMBLE_MSB) << 8) | _mod->SPIgetRegValue(SX127X_REG_PREAMBLE_LSB));
-    float n_pay = 8.0 + max(ceil((8.0 * (float)len - 4.0 * (float)_sf + 28.0 + 16.0 * crc - 20.0 * ih)/(4.0 * (float)_sf - 8.0 * de)) * (float)_cr, 0.0);
-    uint32_t timeout = ceil(symbolLength * (n_pre + n_pay + 4.25) * 1500.0);
+    uint32_t timeOnAir = rfTimeOnAir(&_timing, len);
+    uint32_t timeout = timeOnAir + (timeOnAir + 1) / 2;
 
     // start transmission
     state = startTransmit(data, len, addr);
@@ -582,6 +575,9 @@ int16_t SX127x::setPreambleLength(uint16_t preambleLength) {
     // set preamble length
     state = _mod->SPIsetRegValue(SX127X_REG_PREAMBLE_MSB, (uint8_t)((preambleLength >> 8) & 0xFF));
     state |= _mod->SPIsetRegValue(SX127X_REG_PREAMBLE_LSB, (uint8_t)(preambleLength & 0xFF));
+    if(state == ERR_NONE) {
+      _timing.preamble = preambleLength;
+    }
     return(state);
 
   } else if(modem == SX127X_FSK_OOK) {
@@ -3,6 +3,7 @@
 
 #include "../../TypeDef.h"
 #include "../../Module.h"
+#include <RFTiming.h>
 
 #include "../../protocols/PhysicalLayer/PhysicalLayer.h"
 
@@ -876,6 +877,7 @@ class SX127x: public PhysicalLayer {
     float _bw;
     uint8_t _sf;
     uint8_t _cr;
+    rf_timing_t _timing; // LoRa settings written to the module, for the time on air
     float _br;
     float _rxBw;
     bool _ook;
@@ -0,0 +1,123 @@
+/*
+  SAMR3 - NVM
+    Flash and RWW EEPROM access, ported from ASF nvm.c
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+  Notes:
+    A row (256 bytes) is the erase unit, a page (64 bytes) the write unit
+    Addresses from NVMCTRL_RWW_EEPROM_ADDR are in the RWW EEPROM area,
+    it can be written while the code runs from the main array
+ */
+
+#ifndef _NVM_H_INCLUDED
+#define _NVM_H_INCLUDED
+
+#include <Arduino.h>
+#include <samr3.h>
+
+#define NVM_PAGE_SIZE NVMCTRL_PAGE_SIZE
+#define NVM_ROW_SIZE (NVMCTRL_PAGE_SIZE * NVMCTRL_ROW_PAGES)
+
+/* Return values */
+#define NVM_OK 0
+#define NVM_ERROR_ADDRESS -1 /* Address out of range or not aligned */
+#define NVM_ERROR_LENGTH -2  /* More than a page */
+#define NVM_ERROR_WRITE -3   /* Lock or program error of the controller */
+
+class NVMClass
+{
+public:
+    NVMClass() {}
+
+    /* Erase the row at the address, all bytes read 0xFF after */
+    int erase_row(uint32_t address)
+    {
+        if (!valid(address) || (address & (NVM_ROW_SIZE - 1)))
+            return NVM_ERROR_ADDRESS;
+        return command(rww(address) ? NVMCTRL_CTRLA_CMD_RWWEEER : NVMCTRL_CTRLA_CMD_ER, address);
+    }
+
+    /* Write up to a page at a page aligned address, the page must be erased */
+    int write_page(uint32_t address, const void *vData, int len)
+    {
+        if (!valid(address) || (address & (NVM_PAGE_SIZE - 1)))
+            return NVM_ERROR_ADDRESS;
+        if (len > NVM_PAGE_SIZE)
+            return NVM_ERROR_LENGTH;
+        const uint8_t *data = (const uint8_t *)vData;
+        uint32_t ctrlb = NVMCTRL->CTRLB.reg;
+        NVMCTRL->CTRLB.reg = ctrlb | NVMCTRL_CTRLB_MANW; /* Page is written by command only */
+        int res = command(NVMCTRL_CTRLA_CMD_PBC, address);
+        if (NVM_OK == res)
+        {
+            /* The page buffer must be written with 16 bit accesses */
+            volatile uint16_t *mem = (volatile uint16_t *)address;
+            for (int i = 0; i < len; i += 2)
+            {
+                uint16_t w = data[i];
+                if (i + 1 < len)
+                    w |= data[i + 1] << 8;
+                else
+                    w |= 0xFF00;
+                *mem++ = w;
+            }
+            res = command(rww(address) ? NVMCTRL_CTRLA_CMD_RWWEEWP : NVMCTRL_CTRLA_CMD_WP, address);
+        }
+        NVMCTRL->CTRLB.reg = ctrlb;
+        return res;
+    }
+
+    /* Flash is memory mapped */
+    int read(uint32_t address, void *vData, int len)
+    {
+        if (!valid(address))
+            return NVM_ERROR_ADDRESS;
+        memcpy(vData, (const void *)address, len);
+        return NVM_OK;
+    }
+
+    inline bool rww(uint32_t address) { return address >= NVMCTRL_RWW_EEPROM_ADDR; }
+
+    inline uint32_t rww_size() { return NVMCTRL_RWW_EEPROM_SIZE; }
+
+private:
+    inline bool is_ready() { return NVMCTRL->INTFLAG.reg & NVMCTRL_INTFLAG_READY; }
+
+    bool valid(uint32_t address)
+    {
+        if (address < FLASH_SIZE)
+            return true;
+        return address >= NVMCTRL_RWW_EEPROM_ADDR && address < NVMCTRL_RWW_EEPROM_ADDR + NVMCTRL_RWW_EEPROM_SIZE;
+    }
+
+    int command(uint32_t cmd, uint32_t address)
+    {
+        uint32_t ctrlb = NVMCTRL->CTRLB.reg;
+        NVMCTRL->CTRLB.reg = ctrlb | NVMCTRL_CTRLB_CACHEDIS; /* Cache off while the array changes */
+        NVMCTRL->STATUS.reg = NVMCTRL_STATUS_MASK;
+        while (!is_ready())
+        {
+        }
+        NVMCTRL->ADDR.reg = address / 2; /* 16 bit word address */
+        NVMCTRL->CTRLA.reg = cmd | NVMCTRL_CTRLA_CMDEX_KEY;
+        while (!is_ready())
+        {
+        }
+        NVMCTRL->CTRLB.reg = ctrlb;
+        if (NVMCTRL->STATUS.reg & (NVMCTRL_STATUS_PROGE | NVMCTRL_STATUS_LOCKE | NVMCTRL_STATUS_NVME))
+            return NVM_ERROR_WRITE;
+        return NVM_OK;
+    }
+};
+
+#endif // _NVM_H_INCLUDED
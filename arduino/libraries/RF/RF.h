@@ -48,6 +48,20 @@ public:
         }
     }
 
+    void resume() // begin without reset, the radio kept its registers in sleep
+    {
+        if (0 == _started)
+        {
+            enableOscilator();
+            SPIClass::begin();
+            pinMode(RF_SEL, OUTPUT);
+            digitalWrite(RF_SEL, 1);
+            pinMode(RF_RST, OUTPUT);
+            digitalWrite(RF_RST, 1);
+            _started = 1;
+        }
+    }
+
     void end() // goto full sleep
     {
         if (_started)
@@ -0,0 +1,74 @@
+/*
+  SAMR3 - LoRa timing
+    Created on: 15.10.2026
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA   
+ */
+
+#include "RFTiming.h"
+
+// time of quarter symbols, 2^SF / BW per symbol. 64 bit as SF12 at 7.8 kHz with a long preamble
+// needs 48, times above 71 minutes are cut to 0xFFFFFFFF
+static uint32_t quartersTime(const rf_timing_t *timing, uint32_t quarters)
+{
+    uint64_t time = (uint64_t)quarters * ((uint32_t)250000 << timing->sf);
+    time = (time + timing->bandwidth - 1) / timing->bandwidth;
+    return (time > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)time;
+}
+
+void rfTimingInit(rf_timing_t *timing)
+{
+    timing->bandwidth = 125000;
+    timing->preamble = 8;
+    timing->sf = 7;
+    timing->cr = 5;
+    timing->implicitHeader = 0;
+    timing->crc = 0;
+}
+
+bool rfLowDataRate(const rf_timing_t *timing)
+{
+    // 2^SF / BW >= 16 ms
+    return ((uint32_t)1000 << timing->sf) >= 16 * timing->bandwidth;
+}
+
+uint32_t rfSymbolTime(const rf_timing_t *timing)
+{
+    return quartersTime(timing, 4);
+}
+
+uint32_t rfSymbolsTime(const rf_timing_t *timing, uint32_t symbols)
+{
+    return quartersTime(timing, 4 * symbols);
+}
+
+uint32_t rfPayloadSymbols(const rf_timing_t *timing, uint8_t length)
+{
+    // 8 + max(ceil((8PL - 4SF + 28 + 16CRC - 20IH) / 4(SF - 2DE)) * CR, 0)
+    int32_t bits = 8 * (int32_t)length - 4 * timing->sf + 28 + 16 * timing->crc - 20 * timing->implicitHeader;
+    int32_t perBlock = 4 * (timing->sf - (rfLowDataRate(timing) ? 2 : 0));
+    uint32_t symbols = 8;
+    if (bits > 0)
+    {
+        symbols += ((bits + perBlock - 1) / perBlock) * timing->cr;
+    }
+    return symbols;
+}
+
+uint32_t rfTimeOnAir(const rf_timing_t *timing, uint8_t length)
+{
+    // preamble + 4.25 + payload symbols
+    return quartersTime(timing, 4 * (timing->preamble + rfPayloadSymbols(timing, length)) + 17);
+}
@@ -0,0 +1,56 @@
+/*
+  SAMR3 - LoRa timing
+    Created on: 15.10.2026
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA   
+
+  Notes:
+    Time on air and symbol times of LoRa frames (SX1276 datasheet 4.1.1.6) in integer math,
+    the Cortex-M0+ has no FPU. The LoRa, LoRaLib and Beelan-LoRaWAN drivers keep the settings
+    they wrote to the radio in a rf_timing_t, nothing is read back over SPI.
+    Times are in us and rounded up.
+ */
+
+#ifndef _RF_TIMING_H_INCLUDED
+#define _RF_TIMING_H_INCLUDED
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t bandwidth;     // Hz, 7800 ... 500000
+    uint16_t preamble;      // programmed preamble symbols, the radio adds 4.25
+    uint8_t sf;             // 6 ... 12
+    uint8_t cr;             // 5 ... 8 for coding rate 4/5 ... 4/8
+    uint8_t implicitHeader; // 1 no header
+    uint8_t crc;            // 1 payload CRC on
+} rf_timing_t;
+
+// settings of the radio after reset: 125 kHz, SF7, 4/5, 8 symbols, explicit header, no CRC
+void rfTimingInit(rf_timing_t *timing);
+
+// low data rate optimization, on when a symbol is 16 ms or longer
+bool rfLowDataRate(const rf_timing_t *timing);
+
+uint32_t rfSymbolTime(const rf_timing_t *timing);
+
+uint32_t rfSymbolsTime(const rf_timing_t *timing, uint32_t symbols);
+
+// symbols after the preamble: header and payload
+uint32_t rfPayloadSymbols(const rf_timing_t *timing, uint8_t length);
+
+uint32_t rfTimeOnAir(const rf_timing_t *timing, uint8_t length);
+
+#endif
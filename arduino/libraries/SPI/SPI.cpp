@@ -232,6 +232,19 @@ void SPIClass::transfer(void *buf, size_t count)
   }
 }
 
+// txbuf NULL sends 0xFF, rxbuf NULL drops the received bytes
+void SPIClass::transfer(const void *txbuf, void *rxbuf, size_t count)
+{
+  const uint8_t *txbuffer = reinterpret_cast<const uint8_t *>(txbuf);
+  uint8_t *rxbuffer = reinterpret_cast<uint8_t *>(rxbuf);
+  for (size_t i = 0; i < count; i++)
+  {
+    uint8_t data = transfer(txbuffer ? txbuffer[i] : 0xFF);
+    if (rxbuffer)
+      rxbuffer[i] = data;
+  }
+}
+
 void SPIClass::attachInterrupt()
 {
   // Should be enableInterrupt()
@@ -109,6 +109,7 @@ public:
   byte transfer(uint8_t data);
   uint16_t transfer16(uint16_t data);
   void transfer(void *buf, size_t count);
+  void transfer(const void *txbuf, void *rxbuf, size_t count);
 
   // Transaction Functions
   void usingInterrupt(int interruptNumber);
@@ -49,6 +49,12 @@
 #define MIN_ADDRESS        0x02000     /* protect bootloader */
 #define MAX_ADDRESS        0x40000     /* from linker script */
 
+/* Image of the fragmented data block of the LoRaWAN library (FUOTA),
+   record row at STAGING, the image from the next row. Must be FRAG_FLASH_ADDRESS of
+   Fragmentation.h, the application ends below STAGING */
+#define STAGING            0x00020F00
+#define STAGING_MAGIC      0x544F5546  /* "FUOT" */
+
 #define CLOCK_DEFAULT      48000000ul
 
 #define BOOT_UART          SERCOM0
@@ -44,6 +44,61 @@ void delayUs(uint32_t delay)
         __asm__ __volatile__("");
 }
 
+int nvdm_flash_erase(uint32_t addr);
+int nvdm_flash_write(uint32_t addr, uint8_t data[64]);
+
+/* Record of the staged image: magic, size, CRC-32, ~(magic ^ size ^ crc) */
+struct staging_record
+{
+    uint32_t magic;
+    uint32_t size;
+    uint32_t crc;
+    uint32_t check;
+};
+
+uint32_t crc32(uint32_t crc, const uint8_t *buff, uint32_t size)
+{
+    crc = ~crc;
+    while (size--)
+    {
+        crc ^= *buff++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+/* Copies a complete staged image to the application, a reset during the copy starts it again */
+void install_staging(void)
+{
+    const struct staging_record *rec = (const struct staging_record *)STAGING;
+    const uint8_t *image = (const uint8_t *)(STAGING + 256);
+    uint32_t page[16]; /* 64 bytes, 16 bit aligned for nvdm_flash_write */
+    uint32_t addr;
+
+    if (rec->magic != STAGING_MAGIC || rec->check != ~(rec->magic ^ rec->size ^ rec->crc))
+        return;
+    if (rec->size == 0 || rec->size > STAGING - APPLICATION || crc32(0, image, rec->size) != rec->crc)
+    {
+        nvdm_flash_erase(STAGING);
+        return;
+    }
+
+    for (addr = 0; addr < rec->size; addr += 64)
+    {
+        if (0 == (addr % 256) && nvdm_flash_erase(APPLICATION + addr))
+            return;
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, image + addr, (rec->size - addr < 64) ? rec->size - addr : 64);
+        if (nvdm_flash_write(APPLICATION + addr, (uint8_t *)page))
+            return;
+    }
+
+    /* Keep the record when the copy is wrong, the next reset tries again */
+    if (0 == memcmp((const void *)APPLICATION, image, rec->size))
+        nvdm_flash_erase(STAGING);
+}
+
 __attribute__((naked, noreturn)) void jump_app(uint32_t SP, uint32_t RH)
 {
     __asm("MSR MSP, r0");
@@ -52,6 +107,7 @@ __attribute__((naked, noreturn)) void jump_app(uint32_t SP, uint32_t RH)
 
 int main(void)
 {
+    install_staging();
     UART_INIT();
     uint32_t cnt = BOOT_DELAY;
     volatile uint32_t *Address = (uint32_t *)(APPLICATION);
@@ -0,0 +1,108 @@
+/*
+    Beelan LoRaWAN software AES benchmark
+
+    Measures the crypto cost of one uplink frame (51 byte FRMPayload):
+        CTR payload encryption (4 blocks) + CMAC over B0 | header | payload (5 blocks + subkeys)
+    "per block key" the frame with the AES key schedule recalculated for every block
+    "expanded key"  the same frame with the session keys expanded once with AES_Expand_Key()
+    "block"         is one AES_Encrypt_Expanded() call of the backend selected in Config.h
+*/
+
+#include <Arduino.h>
+#include <beelan-lorawan.h>
+
+const sRFM_pins RFM_pins = {
+    .CS = RF_SEL,
+    .RST = RF_RST,
+    .DIO0 = RF_DIO0,
+    .DIO1 = RF_DIO1,
+    .DIO2 = RF_DIO2,
+};
+
+#define FRAMES 100
+#define BLOCKS 1000
+#define PAYLOAD_SIZE 51
+#define AES_PER_FRAME 10 // 4 CTR blocks, 5 CMAC blocks and the CMAC subkeys
+
+unsigned char NwkSKey[16] = {0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+unsigned char AppSKey[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+unsigned char DevAddr[4] = {0x26, 0x01, 0x1B, 0xDA};
+unsigned int Frame_Counter = 0;
+unsigned int Frame_Counter_Down = 0;
+
+sAES_Expanded_Key NwkSKey_Expanded;
+sAES_Expanded_Key AppSKey_Expanded;
+sCMAC_Key NwkSKey_CMAC;
+
+unsigned char Payload[PAYLOAD_SIZE];
+
+#if defined(AES_HARDWARE)
+const char *backend = "AES peripheral";
+#elif defined(AES_T_TABLE_FULL)
+const char *backend = "T-table, four tables";
+#elif defined(AES_T_TABLE)
+const char *backend = "T-table, one table";
+#else
+const char *backend = "byte S_Table";
+#endif
+
+static uint32_t to_cycles(uint32_t us)
+{
+  return us * (SystemCoreClock / 1000000);
+}
+
+// Encrypt_Payload() and Construct_Data_MIC() of one frame, AES_Expand_Key() before every AES block is the key schedule
+// AES_Encrypt() calculated for every block before the keys were expanded once
+static uint32_t bench_frame(bool per_block_key)
+{
+  sLoRa_Session Session = {NwkSKey, AppSKey, DevAddr, &Frame_Counter, &Frame_Counter_Down, &NwkSKey_Expanded, &AppSKey_Expanded, &NwkSKey_CMAC};
+  sLoRa_Message Message;
+  sBuffer Buffer = {Payload, PAYLOAD_SIZE};
+  memcpy(Message.DevAddr, DevAddr, 4);
+  Message.Direction = 0;
+  uint32_t start = micros();
+  for (int f = 0; f < FRAMES; f++)
+  {
+    if (per_block_key)
+    {
+      for (int b = 0; b < AES_PER_FRAME; b++)
+        AES_Expand_Key((b < 4) ? AppSKey : NwkSKey, (b < 4) ? &AppSKey_Expanded : &NwkSKey_Expanded);
+    }
+    Message.Frame_Counter = Frame_Counter++;
+    Encrypt_Payload(&Buffer, &AppSKey_Expanded, &Message);
+    Construct_Data_MIC(&Buffer, &Session, &Message);
+  }
+  return micros() - start;
+}
+
+static uint32_t bench_block()
+{
+  unsigned char Block[16] = {0};
+  uint32_t start = micros();
+  for (int b = 0; b < BLOCKS; b++)
+    AES_Encrypt_Expanded(Block, &AppSKey_Expanded);
+  return micros() - start;
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("\nBeelan LoRaWAN AES benchmark");
+  Serial.printf("backend: %s\n", backend);
+  AES_Expand_Key(NwkSKey, &NwkSKey_Expanded);
+  AES_Expand_Key(AppSKey, &AppSKey_Expanded);
+  CMAC_Key_Init(&NwkSKey_CMAC, &NwkSKey_Expanded);
+  for (int i = 0; i < PAYLOAD_SIZE; i++)
+    Payload[i] = i;
+}
+
+void loop()
+{
+  uint32_t before = bench_frame(true);
+  uint32_t after = bench_frame(false);
+  uint32_t block = bench_block();
+  Serial.printf("per block key : %u cycles/frame\n", (unsigned)to_cycles(before / FRAMES));
+  Serial.printf("expanded key  : %u cycles/frame\n", (unsigned)to_cycles(after / FRAMES));
+  Serial.printf("block         : %u cycles/block\n", (unsigned)(to_cycles(block) / BLOCKS));
+  delay(5000);
+}
@@ -0,0 +1,145 @@
+/*
+    Beelan LoRaWAN fragmentation benchmark
+
+    Runs the forward error correction of Frag-Decoder.cpp on a block in RAM, without the radio.
+    The fragments of a block are sent as the network would, the uncoded ones and after them the
+    coded ones, and every fragment is lost with the loss rate. For every loss rate:
+        "lost"    uncoded fragments lost, the decoder rebuilds them
+        "coded"   coded fragments received until the block was complete
+        "extra"   coded fragments more than lost ones, the overhead of the parity
+        "sent"    fragments the network had to send, in % of the block
+        "time"    us of Frag_Decoder_Process for the whole block
+    A block fails when more than FRAG_MAX_REDUNDANCY fragments are lost. The network plans the
+    redundancy, coded fragments it sends, from "sent" of the loss rate it expects.
+*/
+
+#include <Arduino.h>
+#include <beelan-lorawan.h>
+
+const sRFM_pins RFM_pins = {
+    .CS = RF_SEL,
+    .RST = RF_RST,
+    .DIO0 = RF_DIO0,
+    .DIO1 = RF_DIO1,
+    .DIO2 = RF_DIO2,
+};
+
+#define NB_FRAG 200
+#define FRAG_SIZE 50
+#define BLOCKS 5
+
+const int Loss[] = {0, 5, 10, 20, 30, 40};
+
+unsigned char Block[NB_FRAG * FRAG_SIZE];
+unsigned char Fragment[FRAG_SIZE];
+unsigned char Row[(NB_FRAG + 7) / 8];
+sFrag_Decoder Decoder;
+
+static void block_read(unsigned long offset, unsigned char *data, unsigned char length)
+{
+  memcpy(data, &Block[offset], length);
+}
+
+static void block_write(unsigned long offset, const unsigned char *data, unsigned char length)
+{
+  memcpy(&Block[offset], data, length);
+}
+
+// Content of fragment i of block b, the same on both sides
+static unsigned char content(int b, int i, int j)
+{
+  return (unsigned char)((b * 131 + i * 31 + j * 7) ^ (i >> 3));
+}
+
+// Fragment n of the network, 1 to NB_FRAG uncoded and from there coded
+static void make_fragment(int b, int n)
+{
+  if (n <= NB_FRAG)
+  {
+    for (int j = 0; j < FRAG_SIZE; j++)
+      Fragment[j] = content(b, n - 1, j);
+    return;
+  }
+
+  memset(Fragment, 0x00, FRAG_SIZE);
+  Frag_Parity_Row(n - NB_FRAG, NB_FRAG, Row);
+  for (int i = 0; i < NB_FRAG; i++)
+  {
+    if (Row[i >> 3] & (1 << (i & 7)))
+    {
+      for (int j = 0; j < FRAG_SIZE; j++)
+        Fragment[j] ^= content(b, i, j);
+    }
+  }
+}
+
+static bool check_block(int b)
+{
+  for (int i = 0; i < NB_FRAG; i++)
+  {
+    for (int j = 0; j < FRAG_SIZE; j++)
+    {
+      if (Block[i * FRAG_SIZE + j] != content(b, i, j))
+        return false;
+    }
+  }
+  return true;
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("\nBeelan LoRaWAN fragmentation benchmark");
+  Serial.printf("block %u fragments of %u bytes, %u blocks per loss rate\n", NB_FRAG, FRAG_SIZE, BLOCKS);
+  randomSeed(1);
+}
+
+void loop()
+{
+  for (unsigned int l = 0; l < sizeof(Loss) / sizeof(Loss[0]); l++)
+  {
+    unsigned long lost = 0, coded = 0, sent = 0, time = 0;
+    int failed = 0;
+
+    for (int b = 0; b < BLOCKS; b++)
+    {
+      unsigned char status = FRAG_DECODER_ONGOING;
+      int n;
+
+      memset(Block, 0xFF, sizeof(Block));
+      Frag_Decoder_Init(&Decoder, NB_FRAG, FRAG_SIZE, block_read, block_write);
+      for (n = 1; status == FRAG_DECODER_ONGOING && n <= 3 * NB_FRAG; n++)
+      {
+        make_fragment(b, n);
+        if ((int)random(100) < Loss[l])
+          continue;
+        uint32_t start = micros();
+        status = Frag_Decoder_Process(&Decoder, n, Fragment);
+        time += micros() - start;
+      }
+
+      if (status != FRAG_DECODER_DONE || !check_block(b))
+      {
+        failed++;
+        continue;
+      }
+      lost += Decoder.Nb_Lost;
+      coded += Decoder.Nb_Coded;
+      sent += n - 1;
+    }
+
+    if (failed == BLOCKS)
+    {
+      Serial.printf("loss %2d%% : failed\n", Loss[l]);
+      continue;
+    }
+    int done = BLOCKS - failed;
+    Serial.printf("loss %2d%% : lost %3u coded %3u extra %2u sent %3u%% time %u us", Loss[l], (unsigned)(lost / done), (unsigned)(coded / done),
+                  (unsigned)((coded - lost) / done), (unsigned)(sent * 100 / done / NB_FRAG), (unsigned)(time / done));
+    if (failed)
+      Serial.printf(", %d failed", failed);
+    Serial.println();
+  }
+  Serial.println();
+  delay(10000);
+}
@@ -15,8 +15,6 @@ extern const char *devAddr;
 extern const char *nwkSKey;
 extern const char *appSKey;
 
-const unsigned long interval = 10000; // 10 s interval to send message
-unsigned long previousMillis = 0;     // will store last time message sent
 unsigned int counter = 0;             // message counter
 
 char myStr[50];
@@ -54,9 +52,9 @@ void setup()
 
 void loop()
 {
-  if (millis() - previousMillis > interval)
+  // send as often as the duty cycle allows, "Hello World 0000" is 16 bytes
+  if (!lora.busy() && (long)(millis() - lora.earliestTxTime(16)) >= 0)
   {
-    previousMillis = millis();
     sprintf(myStr, "Hello World %04d", counter++);
     Serial.printf("Sending: %s ", myStr);
     lora.sendUplink(myStr, strlen(myStr), 0);
@@ -0,0 +1,143 @@
+/*
+    Beelan LoRaWAN MAC benchmark
+
+    Sends unconfirmed ABP uplinks as often as the duty cycle allows and measures every class A cycle:
+        "mac"   time spent in the MAC for one frame: build, encrypt, MIC, FIFO load, the polls of the
+                receive delays and the downlink check, everything but the wait for the radio
+        "rx1"   how late the RX1 window opened after the planned time, RECEIVE_DELAY1 after TxDone (TxDone
+                of the DIO0 interrupt) less the margin for LORA_RX_CLOCK_PPM and LORA_RX_LATENCY
+        "rx2"   the same for RX2, only when RX1 had no downlink
+        "on"    how long the radio was receiving in the RX1 and RX2 windows
+        "rate"  completed cycles per second, limited by the duty cycle of the band
+        "tx"    trigger to RF, from sendUplink() to the radio switching to TX
+
+    Define KEYSTREAM_PRECOMPUTE in Config.h to compare "tx" with the encryption prepared in idle time.
+
+    A network is not needed, without one every cycle ends with the RX2 timeout.
+    Edit the keys to see the cycles with downlinks from a real network.
+*/
+
+#include <Arduino.h>
+#include <beelan-lorawan.h>
+
+const sRFM_pins RFM_pins = {
+    .CS = RF_SEL,
+    .RST = RF_RST,
+    .DIO0 = RF_DIO0,
+    .DIO1 = RF_DIO1,
+    .DIO2 = RF_DIO2,
+};
+
+#define FRAMES 10
+#define PAYLOAD_SIZE 1
+
+const char *devAddr = "260B1BDA";
+const char *nwkSKey = "2B7E151628AED2A6ABF7158809CF4F3C";
+const char *appSKey = "000102030405060708090A0B0C0D0E0F";
+
+char Payload[PAYLOAD_SIZE];
+
+int frames = 0;
+uint32_t start;
+uint32_t cpu_sum;
+uint32_t cpu_max;
+long rx1_sum, rx1_max;
+long rx2_sum, rx2_max;
+int rx2_count;
+uint32_t on1_sum, on2_sum;
+uint32_t tx_sum, tx_max;
+
+static uint32_t to_cycles(uint32_t us)
+{
+  return us * (SystemCoreClock / 1000000);
+}
+
+static void cycle_done(lora_event_t event)
+{
+  unsigned long cpu, on1, on2;
+  long rx1, rx2;
+
+  if (event == LORA_EVENT_TX_DONE)
+  {
+    uint32_t tx = lora.getTxLatency();
+    tx_sum += tx;
+    if (tx > tx_max)
+      tx_max = tx;
+    return;
+  }
+
+  lora.getCycleStats(&cpu, &rx1, &rx2);
+  lora.getRxOnTime(&on1, &on2);
+  on1_sum += on1;
+  cpu_sum += cpu;
+  if (cpu > cpu_max)
+    cpu_max = cpu;
+  rx1_sum += rx1;
+  if (rx1 > rx1_max)
+    rx1_max = rx1;
+  if (event == LORA_EVENT_RX_TIMEOUT)
+  {
+    rx2_sum += rx2;
+    if (rx2 > rx2_max)
+      rx2_max = rx2;
+    on2_sum += on2;
+    rx2_count++;
+  }
+  frames++;
+}
+
+static void reset_stats()
+{
+  frames = 0;
+  cpu_sum = cpu_max = 0;
+  rx1_sum = rx1_max = 0;
+  rx2_sum = rx2_max = 0;
+  rx2_count = 0;
+  on1_sum = on2_sum = 0;
+  tx_sum = tx_max = 0;
+  start = millis();
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("\nBeelan LoRaWAN MAC benchmark");
+  if (!lora.init())
+  {
+    Serial.println("RF not detected");
+    abort();
+  }
+  lora.setDeviceClass(CLASS_A);
+  lora.setDataRate(SF7BW125);
+  lora.setChannel(MULTI);
+  lora.setNwkSKey(nwkSKey);
+  lora.setAppSKey(appSKey);
+  lora.setDevAddr(devAddr);
+  lora.onEvent(cycle_done);
+  reset_stats();
+}
+
+void loop()
+{
+  if (!lora.busy() && (long)(millis() - lora.earliestTxTime(PAYLOAD_SIZE)) >= 0)
+  {
+    lora.sendUplink(Payload, PAYLOAD_SIZE, 0);
+  }
+  lora.update();
+
+  if (frames == FRAMES)
+  {
+    uint32_t elapsed = millis() - start;
+    Serial.printf("rate : %u.%03u frames/s\n", (unsigned)(FRAMES * 1000 / elapsed), (unsigned)((FRAMES * 1000000UL / elapsed) % 1000));
+    Serial.printf("mac  : %u cycles/frame, max %u\n", (unsigned)to_cycles(cpu_sum / FRAMES), (unsigned)to_cycles(cpu_max));
+    Serial.printf("tx   : %u us, max %u us\n", (unsigned)(tx_sum / FRAMES), (unsigned)tx_max);
+    Serial.printf("rx1  : %ld us late, max %ld us\n", rx1_sum / FRAMES, rx1_max);
+    if (rx2_count)
+      Serial.printf("rx2  : %ld us late, max %ld us\n", rx2_sum / rx2_count, rx2_max);
+    Serial.printf("on   : rx1 %u us", (unsigned)(on1_sum / FRAMES));
+    if (rx2_count)
+      Serial.printf(", rx2 %u us", (unsigned)(on2_sum / rx2_count));
+    Serial.println();
+    reset_stats();
+  }
+}
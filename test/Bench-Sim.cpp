@@ -0,0 +1,128 @@
+/****************************************************************************************
+* File:     Bench-Sim.cpp
+*
+* Benchmark of the stack on the host simulator, not a ctest:
+*   Bench-Sim [frames] [uplink loss %] [collisions %]
+* Sends unconfirmed uplinks as fast as the duty cycle lets them, every fourth with a
+* downlink queued at the network server and every eighth answered in RX2. Reports the
+* frames per second of host and virtual time, the host CPU time of update() per frame
+* and how late the windows opened.
+****************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "Host.h"
+#include "SX127x.h"
+#include "Network-Server.h"
+#include "beelan-lorawan.h"
+
+const sRFM_pins RFM_pins = {RF_SEL, RF_RST, RF_DIO0, RF_DIO1, RF_DIO2, -1};
+
+static const char *NwkSKey = "44024241ed4ce9a68c6a8bc055233fd3";
+static const char *AppSKey = "ec925802ae430ca77fd3dd73cb2cc588";
+static const char *DevAddr = "49be7df1";
+
+static bool Cycle_Done = false;
+static unsigned long Downlinks = 0;
+
+static void Bench_Event(lora_event_t Event)
+{
+	if(Event == LORA_EVENT_RX_DONE || Event == LORA_EVENT_RX_TIMEOUT)
+	{
+		Cycle_Done = true;
+	}
+}
+
+static void Bench_Downlink_Handler(const sLoRa_Downlink *Received)
+{
+	(void)Received;
+	Downlinks++;
+}
+
+int main(int argc, char **argv)
+{
+	typedef std::chrono::steady_clock Clock;
+	unsigned long Frames = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200;
+	sNetwork_Server_Config Config = {0, 0, 0, 0, 1};
+	Clock::duration Update_Time(0);
+	Clock::time_point Start;
+	double Host_Seconds, Virtual_Seconds;
+	unsigned long Cpu, Queued = 0, Updates = 0, Rx_Count[2] = {0, 0}, i;
+	long Rx_Error[2], Rx_Max[2] = {0, 0};
+	double Rx_Sum[2] = {0, 0};
+	uint64_t Virtual_Start;
+	char Data[] = "bench payload";
+
+	Config.Uplink_Loss = (argc > 2) ? (unsigned char)atoi(argv[2]) : 0;
+	Config.Uplink_Collisions = (argc > 3) ? (unsigned char)atoi(argv[3]) : 0;
+	Config.Downlink_Loss = Config.Uplink_Loss;
+	Config.Downlink_Collisions = Config.Uplink_Collisions;
+
+	SX127x_Enable_Modem(true);
+	Network_Server_Init(DevAddr, NwkSKey, AppSKey, &Config);
+	if(!lora.init())
+	{
+		printf("No radio\n");
+		return 1;
+	}
+	lora.setDeviceClass(CLASS_A);
+	lora.setNwkSKey(NwkSKey);
+	lora.setAppSKey(AppSKey);
+	lora.setDevAddr(DevAddr);
+	lora.setDataRate(SF9BW125);
+	lora.onEvent(Bench_Event);
+	lora.onDownlink(5, Bench_Downlink_Handler);
+
+	Start = Clock::now();
+	Virtual_Start = Host_Time();
+	for(i = 0; i < Frames; i++)
+	{
+		if(i % 4 == 0)
+		{
+			Config.Rx_Window = (i % 8 == 0) ? 2 : 1;
+			Network_Server_Configure(&Config);
+			Queued += Network_Server_Queue(5, (const unsigned char *)"ack", 3) ? 1 : 0;
+		}
+		Cycle_Done = false;
+		lora.sendUplink(Data, sizeof(Data) - 1, 0, 1);
+		while(!Cycle_Done || lora.busy())
+		{
+			Clock::time_point Update = Clock::now();
+
+			lora.update();
+			Update_Time += Clock::now() - Update;
+			Updates++;
+			sys_sleep();
+		}
+
+		lora.getCycleStats(&Cpu, &Rx_Error[0], &Rx_Error[1]);
+		for(int w = 0; w < 2; w++)
+		{
+			if(Rx_Error[w] != 0)
+			{
+				Rx_Count[w]++;
+				Rx_Sum[w] += Rx_Error[w];
+				Rx_Max[w] = (Rx_Error[w] > Rx_Max[w]) ? Rx_Error[w] : Rx_Max[w];
+			}
+		}
+	}
+	Host_Seconds = std::chrono::duration<double>(Clock::now() - Start).count();
+	Virtual_Seconds = (Host_Time() - Virtual_Start) / 1e6;
+
+	printf("%lu frames, %u %% loss, %u %% collisions\n", Frames, Config.Uplink_Loss, Config.Uplink_Collisions);
+	printf("  %.0f frames/s host time, %.4f frames/s virtual time\n", Frames / Host_Seconds, Frames / Virtual_Seconds);
+	printf("  MAC CPU %.2f us/frame in %lu calls of update() per frame\n",
+		   std::chrono::duration<double, std::micro>(Update_Time).count() / Frames, Updates / Frames);
+	for(int w = 0; w < 2; w++)
+	{
+		printf("  RX%d late %.1f us mean, %ld us max over %lu windows\n", w + 1,
+			   Rx_Count[w] ? Rx_Sum[w] / Rx_Count[w] : 0.0, Rx_Max[w], Rx_Count[w]);
+	}
+	printf("  server: %lu received, %lu lost, %lu collisions, %lu MIC errors\n", Network_Server_Stats.Received,
+		   Network_Server_Stats.Lost, Network_Server_Stats.Collisions, Network_Server_Stats.MIC_Errors);
+	printf("  downlinks: %lu queued, %lu sent, %lu lost, %lu delivered\n", Queued, Network_Server_Stats.Downlinks,
+		   Network_Server_Stats.Downlinks_Lost, Downlinks);
+	return 0;
+}
@@ -0,0 +1,294 @@
+/****************************************************************************************
+* File:     Network-Server.cpp
+*
+* Network server stand-in of the host simulator, see Network-Server.h. Frames of
+* LoRaWAN 1.0.x, the MIC and the encryption are built with Reference-AES.cpp and not
+* with the code of the stack.
+****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "Network-Server.h"
+#include <RFTiming.h>
+#include "Reference-AES.h"
+#include "Host.h"
+#include "SX127x.h"
+
+//us from the end of the uplink to RX1, RX2 is one second later
+#define NETWORK_SERVER_RECEIVE_DELAY 1000000
+
+//869.525 MHz and SF12 of RX2
+#define NETWORK_SERVER_RX2_FRF 0xD96199
+#define NETWORK_SERVER_RX2_SF 12
+
+sNetwork_Server_Stats Network_Server_Stats;
+
+static sNetwork_Server_Config Config;
+static unsigned char Dev_Addr[4];		//as in the frame, least significant byte first
+static unsigned char Nwk_Key[16];
+static unsigned char App_Key[16];
+static unsigned long Frame_Counter_Up;	//next expected
+static unsigned long Frame_Counter_Down;
+static bool Any_Uplink;
+static sSX127x_Frame Uplink;
+
+static bool Queued;
+static unsigned char Queued_Port;
+static unsigned char Queued_Length;
+static unsigned char Queued_Data[242];
+
+static unsigned long Random_State;
+
+static void Network_Server_Receive(void);
+
+static unsigned int Network_Server_Hex(const char *Hex, unsigned char *Data, unsigned int Length)
+{
+	unsigned int Byte, i;
+
+	for(i = 0; i < Length && sscanf(&Hex[2 * i], "%2x", &Byte) == 1; i++)
+	{
+		Data[i] = (unsigned char)Byte;
+	}
+	return i;
+}
+
+//xorshift32, true for Percent of the calls
+static bool Network_Server_Chance(unsigned char Percent)
+{
+	Random_State ^= (Random_State << 13) & 0xFFFFFFFFUL;
+	Random_State ^= Random_State >> 17;
+	Random_State ^= (Random_State << 5) & 0xFFFFFFFFUL;
+	return (Random_State % 100) < Percent;
+}
+
+//A or B0 block of a frame
+static void Network_Server_Block(unsigned char *Block, unsigned char Type, unsigned char Direction, unsigned long Frame_Counter, unsigned char Last)
+{
+	memset(Block, 0x00, 16);
+	Block[0] = Type;
+	Block[5] = Direction;
+	memcpy(&Block[6], Dev_Addr, 4);
+	Block[10] = Frame_Counter & 0xFF;
+	Block[11] = (Frame_Counter >> 8) & 0xFF;
+	Block[12] = (Frame_Counter >> 16) & 0xFF;
+	Block[13] = (Frame_Counter >> 24) & 0xFF;
+	Block[15] = Last;
+}
+
+//FRMPayload encryption, the same both ways
+static void Network_Server_Crypt(unsigned char *Data, unsigned char Length, const unsigned char *Key, unsigned char Direction, unsigned long Frame_Counter)
+{
+	unsigned char Block[16], Stream[16];
+	unsigned int i;
+
+	for(i = 0; i < Length; i++)
+	{
+		if(i % 16 == 0)
+		{
+			Network_Server_Block(Block, 0x01, Direction, Frame_Counter, (unsigned char)(i / 16 + 1));
+			Reference_AES_Encrypt(Key, Block, Stream);
+		}
+		Data[i] ^= Stream[i % 16];
+	}
+}
+
+static void Network_Server_MIC(const unsigned char *Frame, unsigned char Length, unsigned char Direction, unsigned long Frame_Counter, unsigned char *MIC)
+{
+	unsigned char Message[16 + 255], CMAC[16];
+
+	Network_Server_Block(Message, 0x49, Direction, Frame_Counter, Length);
+	memcpy(&Message[16], Frame, Length);
+	Reference_CMAC(Nwk_Key, Message, 16 + Length, CMAC);
+	memcpy(MIC, CMAC, 4);
+}
+
+//The gateway sees the start of the uplink, the frame is taken at its end
+static void Network_Server_Transmit(const sSX127x_Frame *Frame)
+{
+	Uplink = *Frame;
+	Host_Schedule(Frame->End, Network_Server_Receive);
+}
+
+static void Network_Server_Send(bool Ack)
+{
+	sSX127x_Frame Frame;
+	rf_timing_t Timing;
+	unsigned char Size = 0;
+	unsigned long Delay = NETWORK_SERVER_RECEIVE_DELAY;
+
+	Frame.Data[Size++] = 0x60;
+	memcpy(&Frame.Data[Size], Dev_Addr, 4);
+	Size += 4;
+	Frame.Data[Size++] = Ack ? 0x20 : 0x00;
+	Frame.Data[Size++] = Frame_Counter_Down & 0xFF;
+	Frame.Data[Size++] = (Frame_Counter_Down >> 8) & 0xFF;
+	if(Queued)
+	{
+		Frame.Data[Size++] = Queued_Port;
+		memcpy(&Frame.Data[Size], Queued_Data, Queued_Length);
+		Network_Server_Crypt(&Frame.Data[Size], Queued_Length, App_Key, 0x01, Frame_Counter_Down);
+		Size += Queued_Length;
+		Queued = false;
+	}
+	Network_Server_MIC(Frame.Data, Size, 0x01, Frame_Counter_Down, &Frame.Data[Size]);
+	Frame.Length = Size + 4;
+	Frame_Counter_Down++;
+
+	//RX1 on the uplink channel and data rate, RX2 on its own, 4/5 without CRC like a downlink
+	Frame.Frf = Uplink.Frf;
+	Frame.SF = Uplink.SF;
+	Frame.BW = Uplink.BW;
+	if(Config.Rx_Window == 2)
+	{
+		Frame.Frf = NETWORK_SERVER_RX2_FRF;
+		Frame.SF = NETWORK_SERVER_RX2_SF;
+		Frame.BW = 7;
+		Delay += 1000000;
+	}
+	Frame.Preamble = 8;
+	Frame.Inverted_IQ = true;
+	Frame.Crc_Error = Network_Server_Chance(Config.Downlink_Collisions);
+	Frame.SNR = 5 * 4;
+	Frame.RSSI = -90;
+	Frame.Start = Uplink.End + Delay;
+	rfTimingInit(&Timing);
+	Timing.bandwidth = 125000UL << (Frame.BW - 7);	//125, 250 or 500 kHz of the band plan
+	Timing.sf = Frame.SF;
+	Frame.End = Frame.Start + rfTimeOnAir(&Timing, Frame.Length);
+
+	Network_Server_Stats.Downlinks++;
+	if(Ack)
+	{
+		Network_Server_Stats.Acks++;
+	}
+	if(Network_Server_Chance(Config.Downlink_Loss))
+	{
+		Network_Server_Stats.Downlinks_Lost++;
+		return;
+	}
+	SX127x_Air(&Frame);
+}
+
+static void Network_Server_Receive(void)
+{
+	const unsigned char *Data = Uplink.Data;
+	unsigned char Length = Uplink.Length;
+	unsigned char MIC[4], Options, Start;
+	unsigned long Frame_Counter;
+	bool Confirmed, Retransmission = false;
+
+	Network_Server_Stats.Uplinks++;
+	if(Network_Server_Chance(Config.Uplink_Loss))
+	{
+		Network_Server_Stats.Lost++;
+		return;
+	}
+	if(Network_Server_Chance(Config.Uplink_Collisions))
+	{
+		Network_Server_Stats.Collisions++;
+		return;
+	}
+
+	//Data uplinks of the node only
+	if(Length < 12 || (Data[0] != 0x40 && Data[0] != 0x80) || memcmp(&Data[1], Dev_Addr, 4) != 0)
+	{
+		return;
+	}
+	Confirmed = Data[0] == 0x80;
+	Options = Data[5] & 0x0F;
+	Start = 8 + Options;
+	if(Start + 4 > Length)
+	{
+		return;
+	}
+
+	//32-bit counter from the 16 bits of the frame
+	Frame_Counter = (Frame_Counter_Up & 0xFFFF0000UL) | Data[6] | (Data[7] << 8);
+	if(Any_Uplink && Frame_Counter < Frame_Counter_Up - 1 && Frame_Counter + 0x10000 - Frame_Counter_Up < 0x8000)
+	{
+		Frame_Counter += 0x10000;
+	}
+
+	Network_Server_MIC(Data, Length - 4, 0x00, Frame_Counter, MIC);
+	if(memcmp(MIC, &Data[Length - 4], 4) != 0)
+	{
+		Network_Server_Stats.MIC_Errors++;
+		return;
+	}
+
+	if(Any_Uplink && Frame_Counter < Frame_Counter_Up)
+	{
+		Retransmission = Confirmed && Frame_Counter == Frame_Counter_Up - 1;
+		if(!Retransmission)
+		{
+			Network_Server_Stats.Replays++;
+			return;
+		}
+		Network_Server_Stats.Retransmissions++;
+	}
+	else
+	{
+		Any_Uplink = true;
+		Frame_Counter_Up = Frame_Counter + 1;
+		Network_Server_Stats.Received++;
+		Network_Server_Stats.Frame_Counter = Frame_Counter;
+		Network_Server_Stats.Confirmed = Confirmed;
+		Network_Server_Stats.Port = 0;
+		Network_Server_Stats.Length = 0;
+		if(Start + 4 < Length)
+		{
+			Network_Server_Stats.Port = Data[Start];
+			Network_Server_Stats.Length = Length - 4 - Start - 1;
+			memcpy(Network_Server_Stats.Payload, &Data[Start + 1], Network_Server_Stats.Length);
+			Network_Server_Crypt(Network_Server_Stats.Payload, Network_Server_Stats.Length,
+								 (Network_Server_Stats.Port == 0) ? Nwk_Key : App_Key, 0x00, Frame_Counter);
+		}
+	}
+
+	if(Confirmed || Queued)
+	{
+		Network_Server_Send(Confirmed);
+	}
+}
+
+void Network_Server_Init(const char *DevAddr, const char *NwkSKey, const char *AppSKey, const sNetwork_Server_Config *Settings)
+{
+	unsigned char Address[4];
+	unsigned char i;
+
+	Network_Server_Hex(DevAddr, Address, 4);
+	for(i = 0; i < 4; i++)
+	{
+		Dev_Addr[i] = Address[3 - i];
+	}
+	Network_Server_Hex(NwkSKey, Nwk_Key, 16);
+	Network_Server_Hex(AppSKey, App_Key, 16);
+
+	memset(&Network_Server_Stats, 0x00, sizeof(Network_Server_Stats));
+	Frame_Counter_Up = 0;
+	Frame_Counter_Down = 0;
+	Any_Uplink = false;
+	Queued = false;
+	Random_State = 2463534242UL;
+	Network_Server_Configure(Settings);
+
+	SX127x_Transmit = Network_Server_Transmit;
+}
+
+void Network_Server_Configure(const sNetwork_Server_Config *Settings)
+{
+	Config = *Settings;
+}
+
+bool Network_Server_Queue(unsigned char Port, const unsigned char *Data, unsigned char Length)
+{
+	if(Queued || Length > sizeof(Queued_Data))
+	{
+		return false;
+	}
+	Queued_Port = Port;
+	Queued_Length = Length;
+	memcpy(Queued_Data, Data, Length);
+	Queued = true;
+	return true;
+}
@@ -0,0 +1,52 @@
+/****************************************************************************************
+* File:     Network-Server.h
+*
+* Network server and gateway of one ABP node for the host simulator, on the air of the
+* SX127x model. It receives the uplinks at their end, checks the MIC, drops replays and
+* decrypts the payload with the reference AES. A queued downlink or the ACK of a
+* confirmed uplink goes out in RX1 or RX2 of the uplink, RECEIVE_DELAY1 and 2 after it
+* at the time of the gateway. Uplinks and downlinks can be lost or hit by a collision,
+* the choice is random but the same on every run. Only the EU868 band plan: RX1 on the
+* frequency and data rate of the uplink, RX2 on 869.525 MHz with SF12.
+****************************************************************************************/
+
+#ifndef NETWORK_SERVER_H
+#define NETWORK_SERVER_H
+
+//Percent of the frames, Rx_Window 1 or 2
+typedef struct {
+	unsigned char Uplink_Loss;			//missed by the gateway
+	unsigned char Uplink_Collisions;	//lost in a collision at the gateway
+	unsigned char Downlink_Loss;		//do not reach the node
+	unsigned char Downlink_Collisions;	//reach the node with a CRC error
+	unsigned char Rx_Window;
+} sNetwork_Server_Config;
+
+typedef struct {
+	unsigned long Uplinks;			//sent by the node
+	unsigned long Lost;
+	unsigned long Collisions;
+	unsigned long MIC_Errors;
+	unsigned long Replays;			//frame counter not above the last one, not a retransmission
+	unsigned long Retransmissions;	//confirmed uplink again with the same frame counter
+	unsigned long Received;			//new frames with a valid MIC
+	unsigned long Downlinks;		//sent by the gateway, with the lost ones
+	unsigned long Downlinks_Lost;
+	unsigned long Acks;
+	//Last new frame
+	unsigned int Frame_Counter;
+	bool Confirmed;
+	unsigned char Port;
+	unsigned char Length;
+	unsigned char Payload[255];
+} sNetwork_Server_Stats;
+
+extern sNetwork_Server_Stats Network_Server_Stats;
+
+//Keys and address as hex strings like the sketch gives them to the stack
+void Network_Server_Init(const char *DevAddr, const char *NwkSKey, const char *AppSKey, const sNetwork_Server_Config *Config);
+void Network_Server_Configure(const sNetwork_Server_Config *Config);
+//Downlink with the answer to the next uplink, false while one is queued
+bool Network_Server_Queue(unsigned char Port, const unsigned char *Data, unsigned char Length);
+
+#endif
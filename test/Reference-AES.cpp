@@ -0,0 +1,192 @@
+/****************************************************************************************
+* File:     Reference-AES.cpp
+*
+* AES-128 of FIPS-197 on a state of 4 x 4 bytes, the S-box is calculated from the
+* inverse in GF(2^8) and the affine transformation instead of a table. CMAC of RFC 4493.
+****************************************************************************************/
+
+#include <string.h>
+#include "Reference-AES.h"
+
+static unsigned char Reference_Multiply(unsigned char A, unsigned char B)
+{
+	unsigned char Product = 0;
+
+	while(B != 0)
+	{
+		if(B & 0x01)
+		{
+			Product ^= A;
+		}
+		A = (unsigned char)((A << 1) ^ ((A & 0x80) ? 0x1B : 0x00));
+		B >>= 1;
+	}
+	return Product;
+}
+
+static unsigned char Reference_Sbox_Byte(unsigned char Byte)
+{
+	unsigned char Inverse = 0;
+	unsigned char Result;
+	unsigned int i;
+
+	//0 has no inverse and stays 0
+	for(i = 1; i < 256 && Byte != 0; i++)
+	{
+		if(Reference_Multiply(Byte, (unsigned char)i) == 0x01)
+		{
+			Inverse = (unsigned char)i;
+			break;
+		}
+	}
+
+	Result = 0x63;
+	for(i = 0; i < 5; i++)
+	{
+		Result ^= (unsigned char)((Inverse << i) | (Inverse >> (8 - i)));
+	}
+	return Result;
+}
+
+static unsigned char Reference_Sbox(unsigned char Byte)
+{
+	static unsigned char Sbox[256];
+	static bool Sbox_Ready = false;
+	unsigned int i;
+
+	if(!Sbox_Ready)
+	{
+		for(i = 0; i < 256; i++)
+		{
+			Sbox[i] = Reference_Sbox_Byte((unsigned char)i);
+		}
+		Sbox_Ready = true;
+	}
+	return Sbox[Byte];
+}
+
+void Reference_AES_Encrypt(const unsigned char *Key, const unsigned char *In, unsigned char *Out)
+{
+	unsigned char Round_Key[176];
+	unsigned char State[16];
+	unsigned char Column[4];
+	unsigned char Rcon = 0x01;
+	unsigned char Temp;
+	unsigned int Round, i, c;
+
+	//Key expansion of section 5.2
+	memcpy(Round_Key, Key, 16);
+	for(i = 16; i < 176; i += 4)
+	{
+		memcpy(Column, &Round_Key[i - 4], 4);
+		if(i % 16 == 0)
+		{
+			Temp = Column[0];
+			Column[0] = Reference_Sbox(Column[1]) ^ Rcon;
+			Column[1] = Reference_Sbox(Column[2]);
+			Column[2] = Reference_Sbox(Column[3]);
+			Column[3] = Reference_Sbox(Temp);
+			Rcon = Reference_Multiply(Rcon, 0x02);
+		}
+		for(c = 0; c < 4; c++)
+		{
+			Round_Key[i + c] = Round_Key[i - 16 + c] ^ Column[c];
+		}
+	}
+
+	//The state is column by column, byte r of column c at 4 * c + r
+	for(i = 0; i < 16; i++)
+	{
+		State[i] = In[i] ^ Round_Key[i];
+	}
+
+	for(Round = 1; Round <= 10; Round++)
+	{
+		unsigned char Shifted[16];
+
+		//SubBytes and ShiftRows
+		for(c = 0; c < 4; c++)
+		{
+			for(i = 0; i < 4; i++)
+			{
+				Shifted[4 * c + i] = Reference_Sbox(State[4 * ((c + i) % 4) + i]);
+			}
+		}
+
+		//MixColumns, not in the last round
+		for(c = 0; c < 4; c++)
+		{
+			const unsigned char *S = &Shifted[4 * c];
+
+			if(Round == 10)
+			{
+				memcpy(&State[4 * c], S, 4);
+				continue;
+			}
+			State[4 * c + 0] = Reference_Multiply(S[0], 2) ^ Reference_Multiply(S[1], 3) ^ S[2] ^ S[3];
+			State[4 * c + 1] = S[0] ^ Reference_Multiply(S[1], 2) ^ Reference_Multiply(S[2], 3) ^ S[3];
+			State[4 * c + 2] = S[0] ^ S[1] ^ Reference_Multiply(S[2], 2) ^ Reference_Multiply(S[3], 3);
+			State[4 * c + 3] = Reference_Multiply(S[0], 3) ^ S[1] ^ S[2] ^ Reference_Multiply(S[3], 2);
+		}
+
+		for(i = 0; i < 16; i++)
+		{
+			State[i] ^= Round_Key[16 * Round + i];
+		}
+	}
+
+	memcpy(Out, State, 16);
+}
+
+static void Reference_Double(unsigned char *Block)
+{
+	unsigned char Carry = Block[0] & 0x80;
+	unsigned int i;
+
+	for(i = 0; i < 15; i++)
+	{
+		Block[i] = (unsigned char)((Block[i] << 1) | (Block[i + 1] >> 7));
+	}
+	Block[15] = (unsigned char)(Block[15] << 1);
+	if(Carry)
+	{
+		Block[15] ^= 0x87;
+	}
+}
+
+void Reference_CMAC(const unsigned char *Key, const unsigned char *Data, unsigned int Length, unsigned char *MAC)
+{
+	unsigned char Subkey[16] = {0};
+	unsigned char Last[16];
+	unsigned char X[16] = {0};
+	unsigned int Blocks = (Length + 15) / 16;
+	unsigned int i, b;
+
+	//Subkey K1, doubled again to K2 for an incomplete last block
+	Reference_AES_Encrypt(Key, Subkey, Subkey);
+	Reference_Double(Subkey);
+
+	if(Blocks == 0)
+	{
+		Blocks = 1;
+	}
+
+	memset(Last, 0x00, 16);
+	memcpy(Last, &Data[16 * (Blocks - 1)], Length - 16 * (Blocks - 1));
+	if(Length == 0 || Length % 16 != 0)
+	{
+		Last[Length - 16 * (Blocks - 1)] = 0x80;
+		Reference_Double(Subkey);
+	}
+
+	for(b = 0; b < Blocks; b++)
+	{
+		for(i = 0; i < 16; i++)
+		{
+			X[i] ^= (b == Blocks - 1) ? (unsigned char)(Last[i] ^ Subkey[i]) : Data[16 * b + i];
+		}
+		Reference_AES_Encrypt(Key, X, X);
+	}
+
+	memcpy(MAC, X, 16);
+}
@@ -0,0 +1,14 @@
+/****************************************************************************************
+* File:     Reference-AES.h
+*
+* AES-128 as FIPS-197 writes it down and the CMAC of RFC 4493 on top of it. Slow and
+* independent of the backends of the stack, the tests compare the backends with it.
+****************************************************************************************/
+
+#ifndef REFERENCE_AES_H
+#define REFERENCE_AES_H
+
+void Reference_AES_Encrypt(const unsigned char *Key, const unsigned char *In, unsigned char *Out);
+void Reference_CMAC(const unsigned char *Key, const unsigned char *Data, unsigned int Length, unsigned char *MAC);
+
+#endif
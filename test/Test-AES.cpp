@@ -0,0 +1,313 @@
+/****************************************************************************************
+* File:     Test-AES.cpp
+*
+* AES-128 backend of the build against the FIPS-197 and RFC 4493 vectors, a LoRaWAN data
+* frame and the reference of Reference-AES.cpp. Built once per backend, see CMakeLists.txt,
+* so the backends are bit-exact with each other when they all pass. The hardware backend
+* runs AESClass.h on the model of the peripheral in host/AES-Peripheral.cpp.
+****************************************************************************************/
+
+#include <time.h>
+#include "Test.h"
+#include "Reference-AES.h"
+#include "AES-128.h"
+#include "Encrypt.h"
+
+#if defined(AES_HARDWARE)
+#include "AES-Peripheral.h"
+#define TEST_BACKEND "AES peripheral model"
+#elif defined(AES_T_TABLE_FULL)
+#define TEST_BACKEND "T-table, four tables"
+#elif defined(AES_T_TABLE)
+#define TEST_BACKEND "T-table, one table"
+#else
+#define TEST_BACKEND "S-table"
+#endif
+
+//Random blocks and keys compared with the reference
+#define TEST_RANDOM_BLOCKS 2000
+
+static void Test_FIPS_197(void)
+{
+	static const char *Vectors[][3] = {
+		//Appendix B
+		{"2b7e151628aed2a6abf7158809cf4f3c", "3243f6a8885a308d313198a2e0370734", "3925841d02dc09fbdc118597196a0b32"},
+		//Appendix C.1
+		{"000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a"},
+	};
+	unsigned char Key[16], Data[16], Expected[16];
+	sAES_Expanded_Key Expanded_Key;
+	unsigned int v;
+
+	for(v = 0; v < sizeof(Vectors) / sizeof(Vectors[0]); v++)
+	{
+		Test_Hex(Vectors[v][0], Key);
+		Test_Hex(Vectors[v][2], Expected);
+
+		Test_Hex(Vectors[v][1], Data);
+		AES_Encrypt(Data, Key);
+		TEST_CHECK_BYTES(Data, Expected, 16);
+
+		Test_Hex(Vectors[v][1], Data);
+		AES_Expand_Key(Key, &Expanded_Key);
+		AES_Encrypt_Expanded(Data, &Expanded_Key);
+		TEST_CHECK_BYTES(Data, Expected, 16);
+
+		Test_Hex(Vectors[v][1], Data);
+		Reference_AES_Encrypt(Key, Data, Data);
+		TEST_CHECK_BYTES(Data, Expected, 16);
+	}
+}
+
+static void Test_Random_Blocks(void)
+{
+	unsigned char Key[16], Data[16], Expected[16];
+	sAES_Expanded_Key Expanded_Key;
+	unsigned int n;
+
+	for(n = 0; n < TEST_RANDOM_BLOCKS; n++)
+	{
+		Test_Random_Bytes(Key, 16);
+		Test_Random_Bytes(Data, 16);
+		Reference_AES_Encrypt(Key, Data, Expected);
+
+		AES_Expand_Key(Key, &Expanded_Key);
+		AES_Encrypt_Expanded(Data, &Expanded_Key);
+		TEST_CHECK_BYTES(Data, Expected, 16);
+	}
+}
+
+//CTR key stream of every length a LoRaWAN payload can have
+static void Test_CTR(void)
+{
+	unsigned char Key[16], Counter[16], Counter_Copy[16], Block[16];
+	unsigned char Data[255], Expected[255];
+	sAES_Expanded_Key Expanded_Key;
+	unsigned int Length, i;
+
+	Test_Random_Bytes(Key, 16);
+	AES_Expand_Key(Key, &Expanded_Key);
+
+	for(Length = 0; Length <= 255; Length++)
+	{
+		Test_Random_Bytes(Counter, 16);
+		//Start close to the carry into byte 14 now and then
+		if(Length % 4 == 0)
+		{
+			Counter[15] = 0xFE;
+		}
+		memcpy(Counter_Copy, Counter, 16);
+		Test_Random_Bytes(Data, Length);
+		memcpy(Expected, Data, Length);
+
+		for(i = 0; i < Length; i++)
+		{
+			if(i % 16 == 0)
+			{
+				Reference_AES_Encrypt(Key, Counter_Copy, Block);
+				if(++Counter_Copy[15] == 0x00)
+				{
+					Counter_Copy[14]++;
+				}
+			}
+			Expected[i] ^= Block[i % 16];
+		}
+
+		memcpy(Counter_Copy, Counter, 16);
+		AES_Encrypt_CTR(Data, (unsigned char)Length, Counter, &Expanded_Key);
+		TEST_CHECK_BYTES(Data, Expected, Length);
+		TEST_CHECK_BYTES(Counter, Counter_Copy, 16);
+	}
+}
+
+static void Test_CBC_MAC(void)
+{
+	unsigned char Key[16], Chain[16], Expected[16];
+	unsigned char Data[16 * 16];
+	sAES_Expanded_Key Expanded_Key;
+	unsigned int Blocks, b, i;
+
+	Test_Random_Bytes(Key, 16);
+	AES_Expand_Key(Key, &Expanded_Key);
+
+	for(Blocks = 0; Blocks <= 16; Blocks++)
+	{
+		Test_Random_Bytes(Chain, 16);
+		Test_Random_Bytes(Data, 16 * Blocks);
+
+		memcpy(Expected, Chain, 16);
+		for(b = 0; b < Blocks; b++)
+		{
+			for(i = 0; i < 16; i++)
+			{
+				Expected[i] ^= Data[16 * b + i];
+			}
+			Reference_AES_Encrypt(Key, Expected, Expected);
+		}
+
+		AES_CBC_MAC(Chain, Data, (unsigned char)Blocks, &Expanded_Key);
+		TEST_CHECK_BYTES(Chain, Expected, 16);
+	}
+}
+
+//RFC 4493 section 4, in one part and in parts of every split
+static void Test_CMAC(void)
+{
+	static const char *Message = "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+								 "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+	static const struct {
+		unsigned char Length;
+		const char *MAC;
+	} Vectors[] = {
+		{0,  "bb1d6929e95937287fa37d129b756746"},
+		{16, "070a16b46b4d4144f79bdd9dd04a287c"},
+		{40, "dfa66747de9ae63030ca32611497c827"},
+		{64, "51f0bebf7e3b9d92fc49741779363cfe"},
+	};
+	unsigned char Key[16], Data[64], Expected[16], MIC[4];
+	sAES_Expanded_Key Expanded_Key;
+	sCMAC_Key CMAC_Key;
+	sCMAC_Context CMAC;
+	unsigned int v, Split;
+
+	Test_Hex("2b7e151628aed2a6abf7158809cf4f3c", Key);
+	Test_Hex(Message, Data);
+	AES_Expand_Key(Key, &Expanded_Key);
+	CMAC_Key_Init(&CMAC_Key, &Expanded_Key);
+
+	for(v = 0; v < sizeof(Vectors) / sizeof(Vectors[0]); v++)
+	{
+		Test_Hex(Vectors[v].MAC, Expected);
+
+		for(Split = 0; Split <= Vectors[v].Length; Split++)
+		{
+			CMAC_Init(&CMAC, &CMAC_Key);
+			CMAC_Update(&CMAC, Data, (unsigned char)Split);
+			CMAC_Update(&CMAC, &Data[Split], (unsigned char)(Vectors[v].Length - Split));
+			CMAC_Final(&CMAC, MIC);
+			TEST_CHECK_BYTES(MIC, Expected, 4);
+		}
+
+		Reference_CMAC(Key, Data, Vectors[v].Length, Expected);
+		TEST_CHECK_BYTES(MIC, Expected, 4);
+	}
+}
+
+//Unconfirmed uplink "test" on FPort 1, FCnt 2 of DevAddr 49BE7DF1
+static void Test_LoRaWAN_Frame(void)
+{
+	unsigned char NwkSKey[16], AppSKey[16], DevAddr[4] = {0x49, 0xBE, 0x7D, 0xF1};
+	unsigned char Frame[17], Expected[17];
+	unsigned int Frame_Counter = 2;
+	sAES_Expanded_Key NwkSKey_Expanded, AppSKey_Expanded;
+	sCMAC_Key NwkSKey_CMAC;
+	sKeystream Keystream;
+	sLoRa_Session Session;
+	sLoRa_Message Message;
+	sBuffer Payload, Buffer;
+
+	Test_Hex("44024241ed4ce9a68c6a8bc055233fd3", NwkSKey);
+	Test_Hex("ec925802ae430ca77fd3dd73cb2cc588", AppSKey);
+	Test_Hex("40f17dbe4900020001954378762b11ff0d", Expected);
+	Test_Hex("40f17dbe490002000174657374", Frame);
+
+	AES_Expand_Key(NwkSKey, &NwkSKey_Expanded);
+	AES_Expand_Key(AppSKey, &AppSKey_Expanded);
+	CMAC_Key_Init(&NwkSKey_CMAC, &NwkSKey_Expanded);
+
+	memset(&Session, 0x00, sizeof(Session));
+	Session.NwkSKey = NwkSKey;
+	Session.AppSKey = AppSKey;
+	Session.DevAddr = DevAddr;
+	Session.Frame_Counter = &Frame_Counter;
+	Session.NwkSKey_Expanded = &NwkSKey_Expanded;
+	Session.AppSKey_Expanded = &AppSKey_Expanded;
+	Session.NwkSKey_CMAC = &NwkSKey_CMAC;
+
+	memset(&Message, 0x00, sizeof(Message));
+	memcpy(Message.DevAddr, DevAddr, 4);
+	Message.Frame_Counter = Frame_Counter;
+	Message.Direction = 0x00;
+
+	Payload.Data = &Frame[9];
+	Payload.Counter = 4;
+	Encrypt_Payload(&Payload, &AppSKey_Expanded, &Message);
+	Buffer.Data = Frame;
+	Buffer.Counter = 13;
+	Construct_Data_MIC(&Buffer, &Session, &Message);
+	memcpy(&Frame[13], Message.MIC, 4);
+	TEST_CHECK_BYTES(Frame, Expected, 17);
+
+	//The same frame from the key stream prepared in idle time
+	Keystream.Length = 13;
+	Session.Keystream = &Keystream;
+	Keystream_Prepare(&Keystream, &Session);
+	Test_Hex("40f17dbe490002000174657374", Frame);
+	TEST_CHECK(Keystream_Encrypt(&Payload, &Keystream, &Message));
+	Construct_Data_MIC(&Buffer, &Session, &Message);
+	memcpy(&Frame[13], Message.MIC, 4);
+	TEST_CHECK_BYTES(Frame, Expected, 17);
+
+	//Decryption is the same operation
+	Encrypt_Payload(&Payload, &AppSKey_Expanded, &Message);
+	TEST_CHECK_BYTES(&Frame[9], "test", 4);
+}
+
+static void Test_Speed(void)
+{
+	unsigned char Key[16] = {0}, Data[16] = {0};
+	sAES_Expanded_Key Expanded_Key;
+	unsigned long n, Blocks = 200000;
+	clock_t Start;
+
+	AES_Expand_Key(Key, &Expanded_Key);
+	Start = clock();
+	for(n = 0; n < Blocks; n++)
+	{
+		AES_Encrypt_Expanded(Data, &Expanded_Key);
+	}
+	printf("%s: %.0f ns per block on the host\n", TEST_BACKEND,
+		   (double)(clock() - Start) * 1e9 / CLOCKS_PER_SEC / Blocks);
+}
+
+#if defined(AES_HARDWARE)
+//CTR and CBC hand the whole buffer to the peripheral, which only chains from the
+//initialization vector for the first block
+static void Test_Peripheral(void)
+{
+	unsigned char Key[16] = {0}, Counter[16] = {0}, Data[64] = {0};
+	sAES_Expanded_Key Expanded_Key;
+	unsigned long Blocks, New_Messages;
+
+	AES_Expand_Key(Key, &Expanded_Key);
+
+	Blocks = Host_AES_Blocks;
+	New_Messages = Host_AES_New_Messages;
+	AES_Encrypt_CTR(Data, 40, Counter, &Expanded_Key);
+	TEST_CHECK(Host_AES_Blocks - Blocks == 3);
+	TEST_CHECK(Host_AES_New_Messages - New_Messages == 1);
+
+	Blocks = Host_AES_Blocks;
+	New_Messages = Host_AES_New_Messages;
+	AES_CBC_MAC(Counter, Data, 4, &Expanded_Key);
+	TEST_CHECK(Host_AES_Blocks - Blocks == 4);
+	TEST_CHECK(Host_AES_New_Messages - New_Messages == 1);
+
+	TEST_CHECK(Host_AES_Errors == 0);
+}
+#endif
+
+int main(void)
+{
+	Test_FIPS_197();
+	Test_Random_Blocks();
+	Test_CTR();
+	Test_CBC_MAC();
+	Test_CMAC();
+	Test_LoRaWAN_Frame();
+#if defined(AES_HARDWARE)
+	Test_Peripheral();
+#endif
+	Test_Speed();
+	return Test_Result("AES-128 " TEST_BACKEND);
+}
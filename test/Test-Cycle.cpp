@@ -0,0 +1,304 @@
+/****************************************************************************************
+* File:     Test-Cycle.cpp
+*
+* Class A cycle of LORA_Cycle on the virtual board of host/, the way a sketch runs it:
+* update() from the main loop while the clock moves on in steps. The test plays the
+* radio, it raises TxDone, RxTimeout and RxDone on the DIO lines and loads the downlink
+* into the FIFO. Checks that update() never waits, that the windows open on the channel,
+* data rate and time of the band plan and that a downlink of RX1 reaches the sketch.
+* A transfer to the RFM keeps the interrupt mask of its caller in class A and class C.
+****************************************************************************************/
+
+#include "Test.h"
+#include "Reference-AES.h"
+#include "Host.h"
+#include "SX127x.h"
+#include "beelan-lorawan.h"
+
+//Step of the main loop in us, the windows open at most one step late
+#define TEST_STEP 100
+
+//Symbols of SF9 and SF12 at 125 kHz in us
+#define TEST_SYMBOL_SF9 4096
+#define TEST_SYMBOL_SF12 32768
+
+const sRFM_pins RFM_pins = {RF_SEL, RF_RST, RF_DIO0, RF_DIO1, RF_DIO2, -1};
+
+static const char *NwkSKey = "44024241ed4ce9a68c6a8bc055233fd3";
+static const char *AppSKey = "ec925802ae430ca77fd3dd73cb2cc588";
+static const char *DevAddr = "49be7df1";
+
+static lora_event_t Events[8];
+static unsigned int Event_Count = 0;
+static unsigned char Downlink[16];
+static unsigned char Downlink_Length = 0;
+static unsigned char Downlink_Port = 0;
+static unsigned long Update_Waits = 0;
+
+static void Test_Event(lora_event_t Event)
+{
+	if(Event_Count < sizeof(Events) / sizeof(Events[0]))
+	{
+		Events[Event_Count] = Event;
+	}
+	Event_Count++;
+}
+
+static void Test_Downlink_Handler(const sLoRa_Downlink *Received)
+{
+	Downlink_Port = Received->Port;
+	Downlink_Length = Received->Length;
+	memcpy(Downlink, Received->Data, Received->Length);
+}
+
+//update() of the main loop, it may not move the clock
+static void Test_Update(void)
+{
+	uint64_t Time = Host_Time();
+
+	lora.update();
+	if(Host_Time() != Time)
+	{
+		Update_Waits++;
+	}
+}
+
+static bool Test_Mode(unsigned char Mode)
+{
+	return SX127x_Register(0x01) == (0x80 | Mode);
+}
+
+//Main loop until the radio is in the mode, returns false after Limit us
+static bool Test_Run_Until_Mode(unsigned char Mode, uint64_t Limit)
+{
+	uint64_t End = Host_Time() + Limit;
+
+	while(Host_Time() < End)
+	{
+		Test_Update();
+		if(Test_Mode(Mode))
+		{
+			return true;
+		}
+		Host_Advance(TEST_STEP);
+	}
+	return false;
+}
+
+//The radio raises a DIO line with the IRQ flags set
+static void Test_Pulse(uint32_t Pin, unsigned char Flags)
+{
+	SX127x_Set_Register(0x12, SX127x_Register(0x12) | Flags);
+	SX127x_Set_Register(0x01, 0x81);
+	Host_Set_Pin(Pin, HIGH);
+	Host_Set_Pin(Pin, LOW);
+}
+
+static uint32_t Test_Frf(void)
+{
+	return ((uint32_t)SX127x_Register(0x06) << 16) | ((uint32_t)SX127x_Register(0x07) << 8) | SX127x_Register(0x08);
+}
+
+//Data downlink of the network server, FRMPayload and MIC of LoRaWAN 1.0 with the reference AES
+static unsigned char Test_Build_Downlink(unsigned char *Frame, unsigned short Frame_Counter, unsigned char Port, const char *Payload)
+{
+	unsigned char Nwk_Key[16], App_Key[16], Block[16 + 64], Stream[16], MIC[16];
+	unsigned char Length = (unsigned char)strlen(Payload);
+	unsigned char Size = 0;
+	unsigned char i;
+
+	Test_Hex(NwkSKey, Nwk_Key);
+	Test_Hex(AppSKey, App_Key);
+
+	Frame[Size++] = 0x60;
+	Frame[Size++] = 0xF1;
+	Frame[Size++] = 0x7D;
+	Frame[Size++] = 0xBE;
+	Frame[Size++] = 0x49;
+	Frame[Size++] = 0x00;
+	Frame[Size++] = Frame_Counter & 0xFF;
+	Frame[Size++] = Frame_Counter >> 8;
+	Frame[Size++] = Port;
+
+	//A1 block of the keystream, direction 1, Length is below 16 bytes
+	memset(Block, 0x00, 16);
+	Block[0] = 0x01;
+	Block[5] = 0x01;
+	memcpy(&Block[6], &Frame[1], 4);
+	Block[10] = Frame[6];
+	Block[11] = Frame[7];
+	Block[15] = 0x01;
+	Reference_AES_Encrypt(App_Key, Block, Stream);
+	for(i = 0; i < Length; i++)
+	{
+		Frame[Size++] = Payload[i] ^ Stream[i];
+	}
+
+	//B0 and the frame
+	Block[0] = 0x49;
+	Block[15] = Size;
+	memcpy(&Block[16], Frame, Size);
+	Reference_CMAC(Nwk_Key, Block, 16 + Size, MIC);
+	memcpy(&Frame[Size], MIC, 4);
+	return Size + 4;
+}
+
+static void Test_Setup(void)
+{
+	TEST_CHECK(lora.init());
+	lora.setDeviceClass(CLASS_A);
+	lora.setNwkSKey(NwkSKey);
+	lora.setAppSKey(AppSKey);
+	lora.setDevAddr(DevAddr);
+	lora.setDataRate(SF9BW125);
+	lora.setChannel(0);
+	lora.onEvent(Test_Event);
+	lora.onDownlink(5, Test_Downlink_Handler);
+}
+
+//Uplink without a downlink, RX1 and RX2 time out
+static void Test_Timeouts(void)
+{
+	unsigned char Frame[64];
+	uint64_t Tx_Done, Rx1, Rx2;
+	unsigned long Cpu;
+	long Rx1_Error, Rx2_Error;
+	char Data[] = "test";
+
+	Event_Count = 0;
+	TEST_CHECK(lora.sendUplink(Data, 4, 0, 1));
+
+	//Transmission on 868.1 MHz with SF9
+	TEST_CHECK(Test_Run_Until_Mode(0x03, 10000));
+	TEST_CHECK(lora.busy());
+	TEST_CHECK(Test_Frf() == 0xD90666);
+	TEST_CHECK((SX127x_Register(0x1E) >> 4) == 9);
+	TEST_CHECK(SX127x_Register(0x40) == 0x40);
+	TEST_CHECK(SX127x_Register(0x22) == 17);
+	SX127x_Fifo_Read(SX127x_Register(0x0E), Frame, SX127x_Register(0x22));
+	TEST_CHECK(Frame[0] == 0x40);
+	TEST_CHECK(Frame[1] == 0xF1 && Frame[4] == 0x49);
+	TEST_CHECK(Frame[8] == 1);
+
+	//Nothing happens until TxDone
+	for(int i = 0; i < 100; i++)
+	{
+		Host_Advance(TEST_STEP);
+		Test_Update();
+	}
+	TEST_CHECK(Event_Count == 0);
+	TEST_CHECK(Test_Mode(0x03));
+
+	Tx_Done = Host_Time();
+	Test_Pulse(RF_DIO0, 0x08);
+	Test_Update();
+	TEST_CHECK(Event_Count == 1 && Events[0] == LORA_EVENT_TX_DONE);
+
+	//RX1 on the channel of the uplink, opened during the 8 symbols of the preamble
+	TEST_CHECK(Test_Run_Until_Mode(0x06, 1100000));
+	Rx1 = Host_Time();
+	TEST_CHECK(Rx1 - Tx_Done >= 1000000 && Rx1 - Tx_Done < 1000000 + 8 * TEST_SYMBOL_SF9);
+	TEST_CHECK(Test_Frf() == 0xD90666);
+	TEST_CHECK((SX127x_Register(0x1E) >> 4) == 9);
+	TEST_CHECK(SX127x_Register(0x33) == 0x67);
+	TEST_CHECK(SX127x_Register(0x40) == 0x00);
+
+	Host_Advance(20000);
+	Test_Pulse(RF_DIO1, 0x80);
+	Test_Update();
+	TEST_CHECK(Event_Count == 1);
+	TEST_CHECK((SX127x_Register(0x12) & 0x80) == 0x00);
+
+	//RX2 on 869.525 MHz with SF12
+	TEST_CHECK(Test_Run_Until_Mode(0x06, 1100000));
+	Rx2 = Host_Time();
+	TEST_CHECK(Rx2 - Tx_Done >= 2000000 && Rx2 - Tx_Done < 2000000 + 8 * TEST_SYMBOL_SF12);
+	TEST_CHECK(Test_Frf() == 0xD96199);
+	TEST_CHECK((SX127x_Register(0x1E) >> 4) == 12);
+
+	Host_Advance(200000);
+	Test_Pulse(RF_DIO1, 0x80);
+	Test_Update();
+	TEST_CHECK(Event_Count == 2 && Events[1] == LORA_EVENT_RX_TIMEOUT);
+	TEST_CHECK(!lora.busy());
+
+	//The clock stands still in update(), no CPU time, windows at most one step late
+	lora.getCycleStats(&Cpu, &Rx1_Error, &Rx2_Error);
+	TEST_CHECK(Cpu == 0);
+	TEST_CHECK(Rx1_Error >= 0 && Rx1_Error < TEST_STEP);
+	TEST_CHECK(Rx2_Error >= 0 && Rx2_Error < TEST_STEP);
+}
+
+//Uplink answered in RX1
+static void Test_Downlink(void)
+{
+	unsigned char Frame[32], Length;
+	unsigned long Rx1_On, Rx2_On;
+	char Data[] = "next";
+	char Buffer[256];
+
+	//The duty cycle of 1 % holds the next frame for about 20 s
+	Event_Count = 0;
+	TEST_CHECK(lora.sendUplink(Data, 4, 0, 1));
+	TEST_CHECK(Test_Run_Until_Mode(0x03, 60000000));
+
+	Host_Advance(200000);
+	Test_Pulse(RF_DIO0, 0x08);
+	Test_Update();
+	TEST_CHECK(Event_Count == 1 && Events[0] == LORA_EVENT_TX_DONE);
+	TEST_CHECK(Test_Run_Until_Mode(0x06, 1100000));
+
+	//RxDone with the package at the start of the FIFO
+	Host_Advance(30000);
+	Length = Test_Build_Downlink(Frame, 1, 5, "ok");
+	SX127x_Fifo_Write(0x00, Frame, Length);
+	SX127x_Set_Register(0x10, 0x00);
+	SX127x_Set_Register(0x13, Length);
+	SX127x_Set_Register(0x19, 0x20);
+	SX127x_Set_Register(0x1A, 100);
+	Test_Pulse(RF_DIO0, 0x40);
+	Test_Update();
+
+	TEST_CHECK(Event_Count == 2 && Events[1] == LORA_EVENT_RX_DONE);
+	TEST_CHECK(!lora.busy());
+	TEST_CHECK(Downlink_Port == 5);
+	TEST_CHECK(Downlink_Length == 2 && memcmp(Downlink, "ok", 2) == 0);
+	//The handler took the payload
+	TEST_CHECK(lora.readData(Buffer) == 0);
+
+	lora.getRxOnTime(&Rx1_On, &Rx2_On);
+	TEST_CHECK(Rx1_On >= 30000 && Rx1_On < 30000 + TEST_STEP);
+	TEST_CHECK(Rx2_On == 0);
+}
+
+//The lock of a transfer gives back the PRIMASK of the caller, masked or not
+static void Test_Interrupt_Mask(void)
+{
+	noInterrupts();
+	RFM_Write(0x39, 0x34);
+	TEST_CHECK(__get_PRIMASK() == 1);
+	interrupts();
+	RFM_Write(0x39, 0x34);
+	TEST_CHECK(__get_PRIMASK() == 0);
+
+	//Class C, the transfers mask the RxDone interrupt
+	lora.setDeviceClass(CLASS_C);
+	noInterrupts();
+	RFM_Write(0x39, 0x34);
+	TEST_CHECK(__get_PRIMASK() == 1);
+	interrupts();
+	RFM_Write(0x39, 0x34);
+	TEST_CHECK(__get_PRIMASK() == 0);
+	lora.setDeviceClass(CLASS_A);
+	TEST_CHECK(__get_PRIMASK() == 0);
+}
+
+int main(void)
+{
+	Test_Setup();
+	Test_Timeouts();
+	Test_Downlink();
+	Test_Interrupt_Mask();
+	TEST_CHECK(Update_Waits == 0);
+	return Test_Result("LoRaMAC class A cycle");
+}
@@ -0,0 +1,134 @@
+/****************************************************************************************
+* File:     Test-Frag-Decoder.cpp
+*
+* Forward error correction of Frag-Decoder.cpp on a block in RAM, the host run of
+* examples/arduino_beelan_frag_bench. The fragments are sent as the network would, the
+* uncoded ones and after them the coded ones, each lost with the loss rate. The rebuilt
+* block is checked byte for byte. Prints the coded fragments needed for the lost ones
+* of every loss rate. More lost fragments than FRAG_MAX_REDUNDANCY fail the block.
+****************************************************************************************/
+
+#include "Test.h"
+#include "Frag-Decoder.h"
+
+#define TEST_NB_FRAG 200
+#define TEST_FRAG_SIZE 50
+#define TEST_BLOCKS 5
+
+//Coded fragments the network sends at most, after the uncoded ones
+#define TEST_MAX_CODED (2 * TEST_NB_FRAG)
+
+static const unsigned char Test_Loss[] = {0, 5, 10, 20, 30, 40};
+
+static unsigned char Block[TEST_NB_FRAG * TEST_FRAG_SIZE];
+static unsigned char Sent[TEST_NB_FRAG * TEST_FRAG_SIZE];
+static unsigned char Fragment[TEST_FRAG_SIZE];
+static unsigned char Row[(TEST_NB_FRAG + 7) / 8];
+static sFrag_Decoder Decoder;
+
+static void Test_Block_Read(unsigned long Offset, unsigned char *Data, unsigned char Length)
+{
+	memcpy(Data, &Block[Offset], Length);
+}
+
+static void Test_Block_Write(unsigned long Offset, const unsigned char *Data, unsigned char Length)
+{
+	memcpy(&Block[Offset], Data, Length);
+}
+
+//Fragment N of the network, 1 to TEST_NB_FRAG uncoded and from there coded
+static void Test_Fragment(unsigned int N)
+{
+	unsigned int i, j;
+
+	if(N <= TEST_NB_FRAG)
+	{
+		memcpy(Fragment, &Sent[(N - 1) * TEST_FRAG_SIZE], TEST_FRAG_SIZE);
+		return;
+	}
+
+	memset(Fragment, 0x00, TEST_FRAG_SIZE);
+	Frag_Parity_Row(N - TEST_NB_FRAG, TEST_NB_FRAG, Row);
+	for(i = 0; i < TEST_NB_FRAG; i++)
+	{
+		if(Row[i >> 3] & (1 << (i & 7)))
+		{
+			for(j = 0; j < TEST_FRAG_SIZE; j++)
+			{
+				Fragment[j] ^= Sent[i * TEST_FRAG_SIZE + j];
+			}
+		}
+	}
+}
+
+static void Test_Start(void)
+{
+	Test_Random_Bytes(Sent, sizeof(Sent));
+	memset(Block, 0xFF, sizeof(Block));
+	TEST_CHECK(Frag_Decoder_Init(&Decoder, TEST_NB_FRAG, TEST_FRAG_SIZE, Test_Block_Read, Test_Block_Write));
+}
+
+//Fragments until the decoder is done or the network stops. Each is lost with Loss %, the
+//uncoded ones up to Lost_Up_To always
+static unsigned char Test_Send(unsigned char Loss, unsigned int Lost_Up_To)
+{
+	unsigned char Status = FRAG_DECODER_ONGOING;
+	unsigned int N;
+
+	for(N = 1; Status == FRAG_DECODER_ONGOING && N <= TEST_NB_FRAG + TEST_MAX_CODED; N++)
+	{
+		if(N <= Lost_Up_To || Test_Random() % 100 < Loss)
+		{
+			continue;
+		}
+		Test_Fragment(N);
+		Status = Frag_Decoder_Process(&Decoder, N, Fragment);
+	}
+	return Status;
+}
+
+static void Test_Loss_Rates(void)
+{
+	unsigned int l, b;
+
+	printf("%u fragments of %u bytes, %u blocks per loss rate\n", TEST_NB_FRAG, TEST_FRAG_SIZE, TEST_BLOCKS);
+	for(l = 0; l < sizeof(Test_Loss); l++)
+	{
+		unsigned long Lost = 0, Coded = 0;
+
+		for(b = 0; b < TEST_BLOCKS; b++)
+		{
+			Test_Start();
+			TEST_CHECK(Test_Send(Test_Loss[l], 0) == FRAG_DECODER_DONE);
+			TEST_CHECK_BYTES(Block, Sent, sizeof(Block));
+			TEST_CHECK(Decoder.Nb_Coded >= Decoder.Nb_Lost);
+			TEST_CHECK(Frag_Decoder_Missing(&Decoder) == 0);
+			Lost += Decoder.Nb_Lost;
+			Coded += Decoder.Nb_Coded;
+		}
+		printf("  loss %2u %%: %3lu lost, %3lu coded, %2lu extra per block\n", Test_Loss[l],
+			   Lost / TEST_BLOCKS, Coded / TEST_BLOCKS, (Coded - Lost) / TEST_BLOCKS);
+	}
+}
+
+//FRAG_MAX_REDUNDANCY lost fragments are rebuilt, one more fails at the first coded fragment
+static void Test_Redundancy(void)
+{
+	Test_Start();
+	TEST_CHECK(Test_Send(0, FRAG_MAX_REDUNDANCY) == FRAG_DECODER_DONE);
+	TEST_CHECK(Decoder.Nb_Lost == FRAG_MAX_REDUNDANCY);
+	TEST_CHECK_BYTES(Block, Sent, sizeof(Block));
+
+	Test_Start();
+	TEST_CHECK(Test_Send(0, FRAG_MAX_REDUNDANCY + 1) == FRAG_DECODER_FAILED);
+	TEST_CHECK(Decoder.Nb_Coded <= 1);
+	Test_Fragment(TEST_NB_FRAG + 2);
+	TEST_CHECK(Frag_Decoder_Process(&Decoder, TEST_NB_FRAG + 2, Fragment) == FRAG_DECODER_FAILED);
+}
+
+int main(void)
+{
+	Test_Loss_Rates();
+	Test_Redundancy();
+	return Test_Result("Fragmentation decoder");
+}
@@ -0,0 +1,104 @@
+/****************************************************************************************
+* File:     Test-LoRa.cpp
+*
+* Smoke test of the LoRa library on the SX127x model: a packet written with print()
+* leaves on the frequency and spreading factor that were set and takes its time on air,
+* a frame on the air is read back with parsePacket() after a continuous receive.
+****************************************************************************************/
+
+#include "Test.h"
+#include "Host.h"
+#include "SX127x.h"
+#include <LoRa.h>
+
+#define TEST_FREQUENCY 868100000
+#define TEST_FRF 0xD90666			//TEST_FREQUENCY / (32 MHz / 2^19)
+
+static sSX127x_Frame Sent;
+static unsigned int Sent_Count = 0;
+
+static void Test_Transmit(const sSX127x_Frame *Frame)
+{
+	Sent = *Frame;
+	Sent_Count++;
+}
+
+static void Test_Setup(void)
+{
+	SX127x_Enable_Modem(true);
+	SX127x_Transmit = Test_Transmit;
+
+	TEST_CHECK(LoRa.begin(TEST_FREQUENCY) == 1);
+	LoRa.setSpreadingFactor(9);
+	LoRa.setSignalBandwidth(125E3);
+	LoRa.setCodingRate4(5);
+	LoRa.enableCrc();
+}
+
+static void Test_Send(void)
+{
+	rf_timing_t Timing;
+	uint64_t Start = Host_Time();
+
+	TEST_CHECK(LoRa.beginPacket() == 1);
+	TEST_CHECK(LoRa.print("hello") == 5);
+	TEST_CHECK(LoRa.endPacket() == 1);
+
+	TEST_CHECK(Sent_Count == 1);
+	TEST_CHECK(Sent.Length == 5 && memcmp(Sent.Data, "hello", 5) == 0);
+	TEST_CHECK(Sent.Frf == TEST_FRF);
+	TEST_CHECK(Sent.SF == 9 && Sent.BW == 7 && !Sent.Inverted_IQ);
+
+	//endPacket() waits for TxDone, the clock moved on by the time on air
+	rfTimingInit(&Timing);
+	Timing.sf = 9;
+	Timing.crc = 1;
+	TEST_CHECK(Sent.End - Sent.Start == rfTimeOnAir(&Timing, 5));
+	TEST_CHECK(Host_Time() >= Start + (Sent.End - Sent.Start));
+}
+
+static void Test_Receive(void)
+{
+	sSX127x_Frame Frame;
+	char Data[8];
+	int Length, i;
+
+	memset(&Frame, 0x00, sizeof(Frame));
+	Frame.Frf = TEST_FRF;
+	Frame.SF = 9;
+	Frame.BW = 7;
+	Frame.Preamble = 8;
+	Frame.SNR = 6 * 4;
+	Frame.RSSI = -80;
+	Frame.Length = 5;
+	memcpy(Frame.Data, "world", 5);
+
+	LoRa.receive();
+	TEST_CHECK(LoRa.parsePacket() == 0);
+	LoRa.receive();
+	Frame.Start = Host_Time() + 1000;
+	Frame.End = Frame.Start + 200000;
+	SX127x_Air(&Frame);
+	Host_Advance_To(Frame.End + 1);
+
+	Length = LoRa.parsePacket();
+	TEST_CHECK(Length == 5);
+	TEST_CHECK(LoRa.available() == 5);
+	for(i = 0; i < Length && i < (int)sizeof(Data); i++)
+	{
+		Data[i] = (char)LoRa.read();
+	}
+	TEST_CHECK(memcmp(Data, "world", 5) == 0);
+	TEST_CHECK(LoRa.read() == -1);
+	TEST_CHECK(LoRa.packetRssi() == -80);
+	TEST_CHECK(LoRa.packetSnr() == 6.0f);
+}
+
+int main(void)
+{
+	Test_Setup();
+	Test_Send();
+	Test_Receive();
+	LoRa.end();
+	return Test_Result("LoRa library on the SX127x model");
+}
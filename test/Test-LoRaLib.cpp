@@ -0,0 +1,99 @@
+/****************************************************************************************
+* File:     Test-LoRaLib.cpp
+*
+* Smoke test of the SX127x driver of LoRaLib on the SX127x model: begin() finds the chip,
+* startTransmit() sends on the frequency and spreading factor of begin() and raises DIO0
+* after the time on air of RFTiming, a frame on the air is read with readData() after
+* startReceive(). transmit() and receive() poll micros() without yield(), the clock of
+* the host only moves on while the test sleeps, so the test waits for DIO0 itself.
+****************************************************************************************/
+
+#include "Test.h"
+#include "Host.h"
+#include "SX127x.h"
+#include <LoRaLib.h>
+
+#define TEST_FRF 0xD90666			//868.1 MHz / (32 MHz / 2^19)
+#define TEST_WAIT 2000000
+
+static SX1276 Radio = new LoRa;
+static sSX127x_Frame Sent;
+static unsigned int Sent_Count = 0;
+
+static void Test_Transmit(const sSX127x_Frame *Frame)
+{
+	Sent = *Frame;
+	Sent_Count++;
+}
+
+//Main loop of a sketch until the radio raises DIO0
+static bool Test_Wait_Dio0(void)
+{
+	uint64_t End = Host_Time() + TEST_WAIT;
+
+	while(!digitalRead(RF_DIO0) && Host_Time() < End)
+	{
+		sys_sleep();
+	}
+	return digitalRead(RF_DIO0);
+}
+
+static void Test_Send(void)
+{
+	uint8_t Data[] = "hello";
+	rf_timing_t Timing;
+
+	TEST_CHECK(Radio.startTransmit(Data, 5) == ERR_NONE);
+	TEST_CHECK(Sent_Count == 1);
+	TEST_CHECK(Sent.Length == 5 && memcmp(Sent.Data, "hello", 5) == 0);
+	TEST_CHECK(Sent.Frf >= TEST_FRF - 1 && Sent.Frf <= TEST_FRF + 1);
+	TEST_CHECK(Sent.SF == 9 && Sent.BW == 7 && !Sent.Inverted_IQ);
+
+	rfTimingInit(&Timing);
+	Timing.sf = 9;
+	Timing.crc = 1;
+	TEST_CHECK(Sent.End - Sent.Start == rfTimeOnAir(&Timing, 5));
+	TEST_CHECK(Test_Wait_Dio0());
+	TEST_CHECK(Host_Time() == Sent.End);
+	TEST_CHECK(Radio.standby() == ERR_NONE);
+}
+
+static void Test_Receive(void)
+{
+	sSX127x_Frame Frame;
+	uint8_t Data[8];
+
+	memset(&Frame, 0x00, sizeof(Frame));
+	Frame.Frf = Sent.Frf;
+	Frame.SF = 9;
+	Frame.BW = 7;
+	Frame.Preamble = 8;
+	Frame.SNR = 6 * 4;
+	Frame.RSSI = -80;
+	Frame.Length = 5;
+	memcpy(Frame.Data, "world", 5);
+
+	TEST_CHECK(Radio.startReceive() == ERR_NONE);
+	Frame.Start = Host_Time() + 1000;
+	Frame.End = Frame.Start + 200000;
+	SX127x_Air(&Frame);
+	TEST_CHECK(Test_Wait_Dio0());
+	TEST_CHECK(Host_Time() == Frame.End);
+
+	TEST_CHECK(Radio.getPacketLength() == 5);
+	TEST_CHECK(Radio.readData(Data, 5) == ERR_NONE);
+	TEST_CHECK(memcmp(Data, "world", 5) == 0);
+	TEST_CHECK(Radio.getRSSI() == -80.0f);
+	TEST_CHECK(Radio.getSNR() == 6.0f);
+}
+
+int main(void)
+{
+	SX127x_Enable_Modem(true);
+	SX127x_Transmit = Test_Transmit;
+
+	TEST_CHECK(Radio.begin(868.1, 125.0, 9, 5) == ERR_NONE);
+	Test_Send();
+	Test_Receive();
+	return Test_Result("LoRaLib SX127x on the SX127x model");
+}
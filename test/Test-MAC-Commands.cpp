@@ -0,0 +1,149 @@
+/****************************************************************************************
+* File:     Test-MAC-Commands.cpp
+*
+* LinkADRReq blocks of MAC_Process on the US_915 plan with sub-band 1, channels 8 to 15.
+* A network sends the mask of the 64 channels as a block that starts with ChMaskCntl 7
+* or 6. The masks of a block are applied in order, the data rate, power and NbTrans are
+* those of the last command and every LinkADRAns of the block has the same status.
+****************************************************************************************/
+
+#include "Test.h"
+#include "MAC-Commands.h"
+#include "Band-Plan.h"
+#include "beelan-lorawan.h"
+
+//RFM95.cpp of RXParamSetupReq and NewChannelReq needs the pins
+const sRFM_pins RFM_pins = {RF_SEL, RF_RST, RF_DIO0, RF_DIO1, RF_DIO2, -1};
+
+static sMAC_Commands MAC;
+static sLoRa_Message Message;
+static sSettings Settings;
+static unsigned char Commands[15];
+static unsigned char Length;
+
+//LinkADRReq at the end of the commands
+static void Test_Link_ADR(unsigned char Datarate, unsigned char Power, unsigned int Mask, unsigned char Mask_Control, unsigned char Nb_Trans)
+{
+	Commands[Length++] = 0x03;
+	Commands[Length++] = (Datarate << 4) | Power;
+	Commands[Length++] = Mask & 0xFF;
+	Commands[Length++] = Mask >> 8;
+	Commands[Length++] = (Mask_Control << 4) | Nb_Trans;
+}
+
+static void Test_Process(void)
+{
+	MAC_Sent(&MAC);
+	MAC_Process(Commands, Length, &MAC, &Message, &Settings);
+	Length = 0;
+}
+
+//Count LinkADRAns with Status, nothing else in the answers
+static bool Test_Answers(unsigned char Count, unsigned char Status)
+{
+	unsigned char i;
+
+	if(MAC.Answer_Length != 2 * Count)
+	{
+		return false;
+	}
+	for(i = 0; i < Count; i++)
+	{
+		if(MAC.Answer[2 * i] != 0x03 || MAC.Answer[2 * i + 1] != Status)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void Test_Setup(void)
+{
+	memset(&Settings, 0x00, sizeof(Settings));
+	memset(&Message, 0x00, sizeof(Message));
+	Settings.Channel_Mask = BAND_PLAN.Channel_Mask;
+	Settings.Nb_Trans = 1;
+	Band_Set_Datarate(BAND_PLAN.Datarate_Tx, &Settings);
+	MAC_Init(&MAC);
+	Length = 0;
+}
+
+//All 125 kHz channels off, then the ones of our sub-band on
+static void Test_Off_Then_On(void)
+{
+	Test_Link_ADR(3, 0, 0x0000, 7, 0);
+	Test_Link_ADR(3, 2, 0xFF00, 0, 0);
+	Test_Process();
+	TEST_CHECK(Test_Answers(2, 0x07));
+	TEST_CHECK(Settings.Channel_Mask == 0xFF);
+	TEST_CHECK(Settings.Datarate_Tx == 3);
+
+	//Data rate, power and NbTrans of the last command
+	Test_Link_ADR(0, 0, 0x0000, 7, 0);
+	Test_Link_ADR(1, 0, 0x0F00, 0, 3);
+	Test_Process();
+	TEST_CHECK(Test_Answers(2, 0x07));
+	TEST_CHECK(Settings.Channel_Mask == 0x0F);
+	TEST_CHECK(Settings.Datarate_Tx == 1);
+	TEST_CHECK(Settings.Nb_Trans == 3);
+}
+
+//A block that leaves no channel or has a bad command changes nothing
+static void Test_Rejected(void)
+{
+	Test_Link_ADR(2, 0, 0x0000, 7, 0);
+	Test_Process();
+	TEST_CHECK(Test_Answers(1, 0x06));
+	TEST_CHECK(Settings.Channel_Mask == 0x0F);
+	TEST_CHECK(Settings.Datarate_Tx == 1);
+
+	Test_Link_ADR(0, 0, 0x0000, 6, 0);
+	Test_Link_ADR(5, 0, 0xFF00, 0, 0);
+	Test_Process();
+	TEST_CHECK(Test_Answers(2, 0x05));
+	TEST_CHECK(Settings.Channel_Mask == 0x0F);
+	TEST_CHECK(Settings.Datarate_Tx == 1);
+
+	Test_Link_ADR(2, 0, 0xFF00, 5, 0);
+	Test_Link_ADR(2, 0, 0xFF00, 0, 0);
+	Test_Process();
+	TEST_CHECK(Test_Answers(2, 0x06));
+	TEST_CHECK(Settings.Channel_Mask == 0x0F);
+}
+
+//All on, then a mask of ours and one of other channels that does not touch ours
+static void Test_On_Then_Mask(void)
+{
+	Test_Link_ADR(0, 0, 0x0000, 6, 0);
+	Test_Link_ADR(0, 0, 0x3000, 0, 0);
+	Test_Link_ADR(15, 15, 0xFFFF, 1, 0);
+	Test_Process();
+	TEST_CHECK(Test_Answers(3, 0x07));
+	TEST_CHECK(Settings.Channel_Mask == 0x30);
+	TEST_CHECK(Settings.Datarate_Tx == 1);
+}
+
+//Commands between two LinkADRReqs end the block
+static void Test_Two_Blocks(void)
+{
+	Test_Link_ADR(2, 0, 0x0000, 7, 0);
+	Commands[Length++] = 0x06;
+	Test_Link_ADR(2, 0, 0x0100, 0, 0);
+	Test_Process();
+	TEST_CHECK(MAC.Answer_Length == 7);
+	TEST_CHECK(MAC.Answer[0] == 0x03 && MAC.Answer[1] == 0x06);
+	TEST_CHECK(MAC.Answer[2] == 0x06);
+	TEST_CHECK(MAC.Answer[5] == 0x03 && MAC.Answer[6] == 0x07);
+	TEST_CHECK(Settings.Channel_Mask == 0x01);
+	TEST_CHECK(Settings.Datarate_Tx == 2);
+}
+
+int main(void)
+{
+	Test_Setup();
+	Test_Off_Then_On();
+	Test_Rejected();
+	Test_On_Then_Mask();
+	Test_Two_Blocks();
+	return Test_Result("LinkADRReq blocks");
+}
@@ -0,0 +1,284 @@
+/****************************************************************************************
+* File:     Test-Sim.cpp
+*
+* The stack on the host simulator: the modem of the SX127x model sends the frames on the
+* virtual air to the network server of Network-Server.cpp and receives its downlinks in
+* RX1 or RX2. The main loop is the one of a sketch, update() and sys_sleep(). Checks the
+* payloads at both ends, lost and broken downlinks, a confirmed uplink that needs a
+* retransmission, queued records held by the duty cycle and a saved session that is not
+* written again by uplinks and downlinks.
+****************************************************************************************/
+
+#include "Test.h"
+#include "Host.h"
+#include "SX127x.h"
+#include "NVMClass.h"
+#include "Network-Server.h"
+#include "beelan-lorawan.h"
+
+//Longest wait for the end of a class A cycle, the duty cycle holds a frame up to 40 s
+#define TEST_CYCLE_LIMIT 120000000
+
+//How late the windows may open with update() after every interrupt and ms tick
+#define TEST_RX_ERROR 1000
+
+const sRFM_pins RFM_pins = {RF_SEL, RF_RST, RF_DIO0, RF_DIO1, RF_DIO2, -1};
+
+static const char *NwkSKey = "44024241ed4ce9a68c6a8bc055233fd3";
+static const char *AppSKey = "ec925802ae430ca77fd3dd73cb2cc588";
+static const char *DevAddr = "49be7df1";
+
+static lora_event_t Last_Event = LORA_EVENT_NONE;
+static unsigned int Tx_Done_Count = 0;
+static unsigned char Downlink[16];
+static unsigned char Downlink_Length = 0;
+static unsigned char Downlink_Port = 0;
+static bool Confirm_Called = false;
+static bool Confirm_Ack = false;
+static unsigned char Confirm_Tries = 0;
+
+static void Test_Event(lora_event_t Event)
+{
+	if(Event == LORA_EVENT_TX_DONE)
+	{
+		Tx_Done_Count++;
+	}
+	else
+	{
+		Last_Event = Event;
+	}
+}
+
+static void Test_Downlink_Handler(const sLoRa_Downlink *Received)
+{
+	Downlink_Port = Received->Port;
+	Downlink_Length = Received->Length;
+	memcpy(Downlink, Received->Data, Received->Length);
+}
+
+static void Test_Confirm(unsigned int Frame_Counter, bool Acked, unsigned char Attempts, short RSSI)
+{
+	(void)Frame_Counter;
+	(void)RSSI;
+	Confirm_Called = true;
+	Confirm_Ack = Acked;
+	Confirm_Tries = Attempts;
+}
+
+static void Test_Configure(unsigned char Downlink_Loss, unsigned char Downlink_Collisions, unsigned char Rx_Window)
+{
+	sNetwork_Server_Config Config = {0, 0, Downlink_Loss, Downlink_Collisions, Rx_Window};
+
+	Network_Server_Configure(&Config);
+}
+
+//Main loop of a sketch until the cycle of the frame ends with a downlink or a timeout
+static bool Test_Run_Cycle(void)
+{
+	uint64_t End = Host_Time() + TEST_CYCLE_LIMIT;
+
+	while(Host_Time() < End)
+	{
+		lora.update();
+		if(Last_Event != LORA_EVENT_NONE && !lora.busy())
+		{
+			return true;
+		}
+		sys_sleep();
+	}
+	return false;
+}
+
+static bool Test_Uplink(const char *Data, unsigned char Confirm)
+{
+	char Buffer[16];
+
+	strcpy(Buffer, Data);
+	Last_Event = LORA_EVENT_NONE;
+	Downlink_Length = 0;
+	Downlink_Port = 0;
+	return lora.sendUplink(Buffer, strlen(Buffer), Confirm, 1) && Test_Run_Cycle();
+}
+
+static void Test_Windows(bool Rx1, bool Rx2)
+{
+	unsigned long Cpu, Rx1_On, Rx2_On;
+	long Rx1_Error, Rx2_Error;
+
+	lora.getCycleStats(&Cpu, &Rx1_Error, &Rx2_Error);
+	lora.getRxOnTime(&Rx1_On, &Rx2_On);
+	TEST_CHECK(Rx1_Error >= 0 && Rx1_Error < TEST_RX_ERROR);
+	TEST_CHECK(Rx2_Error >= 0 && Rx2_Error < TEST_RX_ERROR);
+	TEST_CHECK((Rx1_On != 0) == Rx1);
+	TEST_CHECK((Rx2_On != 0) == Rx2);
+}
+
+static void Test_Setup(void)
+{
+	sNetwork_Server_Config Config = {0, 0, 0, 0, 1};
+
+	SX127x_Enable_Modem(true);
+	Network_Server_Init(DevAddr, NwkSKey, AppSKey, &Config);
+
+	TEST_CHECK(lora.init());
+	lora.setDeviceClass(CLASS_A);
+	lora.setNwkSKey(NwkSKey);
+	lora.setAppSKey(AppSKey);
+	lora.setDevAddr(DevAddr);
+	lora.setDataRate(SF9BW125);
+	lora.onEvent(Test_Event);
+	lora.onDownlink(5, Test_Downlink_Handler);
+	lora.onConfirm(Test_Confirm);
+}
+
+//Uplinks reach the server, a queued downlink comes back in RX1
+static void Test_Rx1(void)
+{
+	TEST_CHECK(Test_Uplink("hello", 0));
+	TEST_CHECK(Last_Event == LORA_EVENT_RX_TIMEOUT);
+	TEST_CHECK(Network_Server_Stats.Received == 1);
+	TEST_CHECK(Network_Server_Stats.Port == 1 && !Network_Server_Stats.Confirmed);
+	TEST_CHECK(Network_Server_Stats.Length == 5 && memcmp(Network_Server_Stats.Payload, "hello", 5) == 0);
+	Test_Windows(true, true);
+
+	TEST_CHECK(Network_Server_Queue(5, (const unsigned char *)"hi", 2));
+	TEST_CHECK(Test_Uplink("world", 0));
+	TEST_CHECK(Last_Event == LORA_EVENT_RX_DONE);
+	TEST_CHECK(Network_Server_Stats.Received == 2);
+	TEST_CHECK(Network_Server_Stats.Frame_Counter == Network_Server_Stats.Received - 1);
+	TEST_CHECK(Network_Server_Stats.Length == 5 && memcmp(Network_Server_Stats.Payload, "world", 5) == 0);
+	TEST_CHECK(Downlink_Port == 5 && Downlink_Length == 2 && memcmp(Downlink, "hi", 2) == 0);
+	Test_Windows(true, false);
+}
+
+static void Test_Rx2(void)
+{
+	Test_Configure(0, 0, 2);
+	TEST_CHECK(Network_Server_Queue(5, (const unsigned char *)"rx2", 3));
+	TEST_CHECK(Test_Uplink("late", 0));
+	TEST_CHECK(Last_Event == LORA_EVENT_RX_DONE);
+	TEST_CHECK(Downlink_Port == 5 && Downlink_Length == 3 && memcmp(Downlink, "rx2", 3) == 0);
+	Test_Windows(true, true);
+	Test_Configure(0, 0, 1);
+}
+
+//A lost downlink ends in RX2 with a timeout, one with a CRC error as well
+static void Test_Lost(void)
+{
+	unsigned long Lost = Network_Server_Stats.Downlinks_Lost;
+
+	Test_Configure(100, 0, 1);
+	TEST_CHECK(Network_Server_Queue(5, (const unsigned char *)"gone", 4));
+	TEST_CHECK(Test_Uplink("lost", 0));
+	TEST_CHECK(Last_Event == LORA_EVENT_RX_TIMEOUT);
+	TEST_CHECK(Downlink_Length == 0);
+	TEST_CHECK(Network_Server_Stats.Downlinks_Lost == Lost + 1);
+	Test_Windows(true, true);
+
+	Test_Configure(0, 100, 1);
+	TEST_CHECK(Network_Server_Queue(5, (const unsigned char *)"crc", 3));
+	TEST_CHECK(Test_Uplink("broken", 0));
+	TEST_CHECK(Last_Event == LORA_EVENT_RX_TIMEOUT);
+	TEST_CHECK(Downlink_Length == 0);
+	Test_Windows(true, true);
+	Test_Configure(0, 0, 1);
+}
+
+//The first ACK is lost, the server sees the retransmission with the same frame counter
+static void Test_Confirmed(void)
+{
+	uint64_t End = Host_Time() + TEST_CYCLE_LIMIT;
+	unsigned long Received = Network_Server_Stats.Received;
+	unsigned long Acks = Network_Server_Stats.Acks;
+	char Data[] = "confirm";
+	char Other[] = "other";
+	bool Refused = false;
+
+	Test_Configure(100, 0, 1);
+	Confirm_Called = false;
+	TEST_CHECK(lora.sendUplink(Data, strlen(Data), 1, 1));
+	while(Host_Time() < End && !Confirm_Called)
+	{
+		lora.update();
+		//An uplink during the airtime of the confirmed one is refused, it would take its buffer
+		if(lora.busy() && !Refused)
+		{
+			TEST_CHECK(!lora.sendUplink(Other, strlen(Other), 0, 1));
+			Refused = true;
+		}
+		if(Network_Server_Stats.Acks == Acks + 1)
+		{
+			Test_Configure(0, 0, 1);
+		}
+		sys_sleep();
+	}
+
+	TEST_CHECK(Refused);
+	TEST_CHECK(Confirm_Called && Confirm_Ack);
+	TEST_CHECK(Confirm_Tries == 2);
+	TEST_CHECK(Network_Server_Stats.Received == Received + 1);
+	TEST_CHECK(Network_Server_Stats.Confirmed);
+	TEST_CHECK(Network_Server_Stats.Retransmissions == 1);
+	TEST_CHECK(Network_Server_Stats.Acks == Acks + 2);
+	TEST_CHECK(Network_Server_Stats.Length == 7 && memcmp(Network_Server_Stats.Payload, "confirm", 7) == 0);
+}
+
+//Queued records held by the duty cycle keep Buffer_Tx, a sendUplink() meanwhile is refused
+static void Test_Queue(void)
+{
+	char Data[] = "direct";
+
+	lora.setChannel(0);
+	TEST_CHECK(Test_Uplink("first", 0));
+
+	TEST_CHECK(lora.queueUplink("ab", 2, 0));
+	TEST_CHECK(lora.queueUplink("cde", 3, 0));
+	Last_Event = LORA_EVENT_NONE;
+	lora.update();
+	TEST_CHECK(!lora.busy());
+	TEST_CHECK(!lora.sendUplink(Data, strlen(Data), 0, 1));
+
+	TEST_CHECK(Test_Run_Cycle());
+	TEST_CHECK(Network_Server_Stats.Length == 7 && memcmp(Network_Server_Stats.Payload, "\x02" "ab" "\x03" "cde", 7) == 0);
+	lora.setChannel(MULTI);
+}
+
+//Hopping, the RX1 data rate and the ADR margins of a downlink leave the row of saveSession() as it is
+static void Test_Session(void)
+{
+	unsigned long Erases;
+
+	lora.setADR(true);
+	TEST_CHECK(lora.saveSession());
+	Erases = Host_NVM_Erases;
+
+	TEST_CHECK(Network_Server_Queue(5, (const unsigned char *)"adr", 3));
+	TEST_CHECK(Test_Uplink("save", 0));
+	TEST_CHECK(Last_Event == LORA_EVENT_RX_DONE);
+	TEST_CHECK(Test_Uplink("again", 0));
+	TEST_CHECK(lora.saveSession());
+	TEST_CHECK(Host_NVM_Erases == Erases);
+
+	//As after a wake up, the callbacks are set again
+	TEST_CHECK(lora.restoreSession());
+	lora.onEvent(Test_Event);
+	lora.onDownlink(5, Test_Downlink_Handler);
+	lora.onConfirm(Test_Confirm);
+	TEST_CHECK(Test_Uplink("restored", 0));
+	TEST_CHECK(Network_Server_Stats.Length == 8 && memcmp(Network_Server_Stats.Payload, "restored", 8) == 0);
+	lora.setADR(false);
+}
+
+int main(void)
+{
+	Test_Setup();
+	Test_Rx1();
+	Test_Rx2();
+	Test_Lost();
+	Test_Confirmed();
+	Test_Queue();
+	Test_Session();
+	TEST_CHECK(Network_Server_Stats.MIC_Errors == 0 && Network_Server_Stats.Replays == 0);
+	TEST_CHECK(Network_Server_Stats.Uplinks == Tx_Done_Count);
+	return Test_Result("Simulated node and network server");
+}
@@ -0,0 +1,147 @@
+/****************************************************************************************
+* File:     Test-Time-On-Air.cpp
+*
+* Integer time on air of RFTiming.cpp against the formula of the SX1276 datasheet 4.1.1.6
+* in floating point, for every spreading factor, bandwidth, coding rate, header mode, CRC
+* and payload length with a set of preamble lengths. The integer times are rounded up, a
+* reference within 1e-6 us of a whole us counts as that us.
+****************************************************************************************/
+
+#include <math.h>
+#include "Test.h"
+#include "RFTiming.h"
+
+//Bandwidths of RegModemConfig1
+static const uint32_t Bandwidths[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+
+//The time on air is linear in the preamble, the ends of the register and around the default
+static const uint16_t Preambles[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 12, 16, 32, 100, 255, 256, 1024, 4096, 65535};
+
+//Rounded up us of a time in s, cut like the integer times
+static bool Test_Rounded_Up(uint32_t Value, long double Seconds)
+{
+	long double Us = Seconds * 1000000.0L;
+
+	if(Us > 4294967295.0L)
+	{
+		return Value == 0xFFFFFFFF;
+	}
+	return Value >= Us - 1e-6L && Value < Us + 1.0L - 1e-6L;
+}
+
+static long double Test_Symbol_Time(const rf_timing_t *Timing)
+{
+	return ldexpl(1.0L, Timing->sf) / Timing->bandwidth;
+}
+
+static bool Test_Low_Data_Rate(const rf_timing_t *Timing)
+{
+	return Test_Symbol_Time(Timing) >= 0.016L;
+}
+
+static long double Test_Payload_Symbols(const rf_timing_t *Timing, uint8_t Length)
+{
+	long double Bits = 8.0L * Length - 4.0L * Timing->sf + 28 + 16.0L * Timing->crc - 20.0L * Timing->implicitHeader;
+	long double Per_Block = 4.0L * (Timing->sf - 2 * (Test_Low_Data_Rate(Timing) ? 1 : 0));
+
+	return 8 + fmaxl(ceill(Bits / Per_Block) * Timing->cr, 0.0L);
+}
+
+static long double Test_Time_On_Air(const rf_timing_t *Timing, uint8_t Length)
+{
+	long double Symbol = Test_Symbol_Time(Timing);
+
+	return (Timing->preamble + 4.25L) * Symbol + Test_Payload_Symbols(Timing, Length) * Symbol;
+}
+
+static void Test_Reset(void)
+{
+	rf_timing_t Timing;
+
+	rfTimingInit(&Timing);
+	TEST_CHECK(Timing.bandwidth == 125000);
+	TEST_CHECK(Timing.sf == 7);
+	TEST_CHECK(Timing.cr == 5);
+	TEST_CHECK(Timing.preamble == 8);
+	TEST_CHECK(Timing.implicitHeader == 0 && Timing.crc == 0);
+
+	//The LoRaWAN numbers: 1.024 ms symbols and 41.216 ms for 10 bytes with CRC
+	Timing.crc = 1;
+	TEST_CHECK(rfSymbolTime(&Timing) == 1024);
+	TEST_CHECK(rfTimeOnAir(&Timing, 10) == 41216);
+}
+
+//Symbol times and the low data rate optimization, once per spreading factor and bandwidth
+static void Test_Symbols(void)
+{
+	static const uint32_t Counts[] = {0, 1, 5, 8, 37, 1023, 65535};
+	rf_timing_t Timing;
+	unsigned int b, c;
+
+	rfTimingInit(&Timing);
+	for(Timing.sf = 6; Timing.sf <= 12; Timing.sf++)
+	{
+		for(b = 0; b < sizeof(Bandwidths) / sizeof(Bandwidths[0]); b++)
+		{
+			Timing.bandwidth = Bandwidths[b];
+			TEST_CHECK(rfLowDataRate(&Timing) == Test_Low_Data_Rate(&Timing));
+			TEST_CHECK(Test_Rounded_Up(rfSymbolTime(&Timing), Test_Symbol_Time(&Timing)));
+			for(c = 0; c < sizeof(Counts) / sizeof(Counts[0]); c++)
+			{
+				TEST_CHECK(Test_Rounded_Up(rfSymbolsTime(&Timing, Counts[c]), Counts[c] * Test_Symbol_Time(&Timing)));
+			}
+		}
+	}
+}
+
+static void Test_Exhaustive(void)
+{
+	rf_timing_t Timing;
+	unsigned long Checks = 0, Failures = 0;
+	unsigned int b, p, Length;
+
+	rfTimingInit(&Timing);
+	for(Timing.sf = 6; Timing.sf <= 12; Timing.sf++)
+	for(b = 0; b < sizeof(Bandwidths) / sizeof(Bandwidths[0]); b++)
+	for(Timing.cr = 5; Timing.cr <= 8; Timing.cr++)
+	for(Timing.implicitHeader = 0; Timing.implicitHeader <= 1; Timing.implicitHeader++)
+	for(Timing.crc = 0; Timing.crc <= 1; Timing.crc++)
+	{
+		Timing.bandwidth = Bandwidths[b];
+		for(Length = 0; Length <= 255; Length++)
+		{
+			if(rfPayloadSymbols(&Timing, Length) != Test_Payload_Symbols(&Timing, Length))
+			{
+				Failures++;
+			}
+			for(p = 0; p < sizeof(Preambles) / sizeof(Preambles[0]); p++)
+			{
+				Timing.preamble = Preambles[p];
+				if(!Test_Rounded_Up(rfTimeOnAir(&Timing, Length), Test_Time_On_Air(&Timing, Length)))
+				{
+					//The first few are enough to see what is wrong
+					if(Failures < 10)
+					{
+						printf("SF%u %lu Hz 4/%u preamble %u IH %u CRC %u length %u: %lu us, reference %.3Lf us\n",
+							   Timing.sf, (unsigned long)Timing.bandwidth, Timing.cr, Timing.preamble, Timing.implicitHeader,
+							   Timing.crc, Length, (unsigned long)rfTimeOnAir(&Timing, Length),
+							   Test_Time_On_Air(&Timing, Length) * 1000000.0L);
+					}
+					Failures++;
+				}
+				Checks++;
+			}
+		}
+	}
+
+	printf("%lu times on air checked\n", Checks);
+	TEST_CHECK(Failures == 0);
+}
+
+int main(void)
+{
+	Test_Reset();
+	Test_Symbols();
+	Test_Exhaustive();
+	return Test_Result("Time on air");
+}
@@ -0,0 +1,94 @@
+/****************************************************************************************
+* File:     Test.h
+*
+* Checks of the host tests. A failed check prints its line and the test goes on, the
+* exit code of Test_Result() tells ctest if all checks passed.
+****************************************************************************************/
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+static int Test_Failures = 0;
+
+#define TEST_CHECK(Condition) \
+	do { \
+		if(!(Condition)) \
+		{ \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Condition); \
+			Test_Failures++; \
+		} \
+	} while(0)
+
+#define TEST_CHECK_BYTES(Data, Expected, Length) \
+	do { \
+		if(memcmp((Data), (Expected), (Length)) != 0) \
+		{ \
+			printf("%s:%d: check failed: %s == %s\n", __FILE__, __LINE__, #Data, #Expected); \
+			Test_Print_Hex("  got      ", (const unsigned char *)(Data), (Length)); \
+			Test_Print_Hex("  expected ", (const unsigned char *)(Expected), (Length)); \
+			Test_Failures++; \
+		} \
+	} while(0)
+
+static inline void Test_Print_Hex(const char *Name, const unsigned char *Data, unsigned int Length)
+{
+	unsigned int i;
+
+	printf("%s", Name);
+	for(i = 0; i < Length; i++)
+	{
+		printf("%02x", Data[i]);
+	}
+	printf("\n");
+}
+
+//Bytes of a hex string, returns the number of bytes
+static inline unsigned int Test_Hex(const char *Hex, unsigned char *Data)
+{
+	unsigned int Length = 0;
+	unsigned int Byte;
+
+	while(Hex[0] != '\0' && Hex[1] != '\0' && sscanf(Hex, "%2x", &Byte) == 1)
+	{
+		Data[Length++] = (unsigned char)Byte;
+		Hex += 2;
+	}
+	return Length;
+}
+
+//xorshift32, the same sequence on every run
+static inline unsigned long Test_Random(void)
+{
+	static unsigned long State = 2463534242UL;
+
+	State ^= (State << 13) & 0xFFFFFFFFUL;
+	State ^= State >> 17;
+	State ^= (State << 5) & 0xFFFFFFFFUL;
+	return State;
+}
+
+static inline void Test_Random_Bytes(unsigned char *Data, unsigned int Length)
+{
+	unsigned int i;
+
+	for(i = 0; i < Length; i++)
+	{
+		Data[i] = (unsigned char)Test_Random();
+	}
+}
+
+static inline int Test_Result(const char *Name)
+{
+	if(Test_Failures != 0)
+	{
+		printf("%s: %d checks failed\n", Name, Test_Failures);
+		return 1;
+	}
+	printf("%s: passed\n", Name);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,219 @@
+/****************************************************************************************
+* File:     AES-Peripheral.cpp
+*
+* Model of the SAMR34 AES peripheral (datasheet chapter AES) for the modes the stack uses,
+* encryption with a 128-bit key in ECB, CBC and CTR mode with the automatic start. Four
+* writes of INDATA start a block, ENCCMP is set when it is done and is cleared by a read of
+* INDATA. With NEWMSG set the block chains from the initialization vector, else from the
+* block before. In CTR mode the peripheral increments the 16-bit block counter in the last
+* two bytes of the counter block. The cipher is the one of Reference-AES.cpp.
+****************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <samr3.h>
+#include "AES-Peripheral.h"
+#include "Reference-AES.h"
+
+#define HOST_AES_MODE_ECB 0
+#define HOST_AES_MODE_CBC 1
+#define HOST_AES_MODE_CTR 4
+
+Aes Host_AES;
+
+unsigned long Host_AES_Blocks = 0;
+unsigned long Host_AES_New_Messages = 0;
+unsigned long Host_AES_Errors = 0;
+
+static uint32_t Ctrla = 0;
+static uint32_t Ctrlb = 0;
+static uint32_t Intflag = 0;
+static unsigned char Pointer = 0;
+static unsigned char Key[32];
+static unsigned char Vector[16];
+static unsigned char In[16];
+static unsigned char Out[16];
+static unsigned char Chain[16];
+
+Aes::Aes()
+{
+	unsigned char i;
+
+	CTRLA.reg = Host_AES_Register(HOST_AES_CTRLA);
+	CTRLB.reg = Host_AES_Register(HOST_AES_CTRLB);
+	INTENCLR.reg = Host_AES_Register(HOST_AES_INTENCLR);
+	INTENSET.reg = Host_AES_Register(HOST_AES_INTENSET);
+	INTFLAG.reg = Host_AES_Register(HOST_AES_INTFLAG);
+	DATABUFPTR.reg = Host_AES_Register(HOST_AES_DATABUFPTR);
+	for(i = 0; i < 8; i++)
+	{
+		KEYWORD[i].reg = Host_AES_Register(HOST_AES_KEYWORD, i);
+	}
+	INDATA.reg = Host_AES_Register(HOST_AES_INDATA);
+	for(i = 0; i < 4; i++)
+	{
+		INTVECTV[i].reg = Host_AES_Register(HOST_AES_INTVECTV, i);
+	}
+	RANDSEED.reg = Host_AES_Register(HOST_AES_RANDSEED);
+}
+
+static void Host_AES_Error(const char *Reason)
+{
+	printf("AES peripheral: %s\n", Reason);
+	Host_AES_Errors++;
+}
+
+//Words hold the bytes in the order of the memory, as convert_byte_array_to_32_bit gives them
+static void Host_AES_Store(unsigned char *Bytes, uint32_t Value)
+{
+	memcpy(Bytes, &Value, 4);
+}
+
+static uint32_t Host_AES_Load(const unsigned char *Bytes)
+{
+	uint32_t Value;
+
+	memcpy(&Value, Bytes, 4);
+	return Value;
+}
+
+static void Host_AES_Process(void)
+{
+	unsigned char Mode = (Ctrla & AES_CTRLA_AESMODE_Msk) >> AES_CTRLA_AESMODE_Pos;
+	bool New_Message = (Ctrlb & AES_CTRLB_NEWMSG) != 0;
+	unsigned char Stream[16];
+	unsigned char i;
+
+	if(!(Ctrla & AES_CTRLA_ENABLE))
+	{
+		Host_AES_Error("block started while disabled");
+		return;
+	}
+	if(!(Ctrla & AES_CTRLA_CIPHER) || (Ctrla & AES_CTRLA_KEYSIZE_Msk) != 0)
+	{
+		Host_AES_Error("only encryption with 128-bit keys is modelled");
+		return;
+	}
+
+	if(New_Message)
+	{
+		memcpy(Chain, Vector, 16);
+		Host_AES_New_Messages++;
+	}
+
+	switch(Mode)
+	{
+		case HOST_AES_MODE_ECB:
+			Reference_AES_Encrypt(Key, In, Out);
+			break;
+
+		case HOST_AES_MODE_CBC:
+			for(i = 0; i < 16; i++)
+			{
+				Chain[i] ^= In[i];
+			}
+			Reference_AES_Encrypt(Key, Chain, Chain);
+			memcpy(Out, Chain, 16);
+			break;
+
+		case HOST_AES_MODE_CTR:
+			Reference_AES_Encrypt(Key, Chain, Stream);
+			for(i = 0; i < 16; i++)
+			{
+				Out[i] = In[i] ^ Stream[i];
+			}
+			if(++Chain[15] == 0x00)
+			{
+				Chain[14]++;
+			}
+			break;
+
+		default:
+			Host_AES_Error("mode is not modelled");
+			return;
+	}
+
+	Host_AES_Blocks++;
+	Intflag |= AES_INTFLAG_ENCCMP;
+}
+
+uint32_t Host_AES_Read(host_aes_register_t Register, unsigned char Index)
+{
+	uint32_t Value;
+
+	(void)Index;
+	switch(Register)
+	{
+		case HOST_AES_CTRLA:
+			return Ctrla;
+		case HOST_AES_CTRLB:
+			return Ctrlb;
+		case HOST_AES_INTFLAG:
+			return Intflag;
+		case HOST_AES_DATABUFPTR:
+			return Pointer;
+		case HOST_AES_INDATA:
+			Value = Host_AES_Load(&Out[4 * Pointer]);
+			Pointer = (Pointer + 1) & 0x03;
+			Intflag &= ~AES_INTFLAG_ENCCMP;
+			return Value;
+		default:
+			return 0;
+	}
+}
+
+void Host_AES_Write(host_aes_register_t Register, unsigned char Index, uint32_t Value)
+{
+	switch(Register)
+	{
+		case HOST_AES_CTRLA:
+			if(Value & AES_CTRLA_SWRST)
+			{
+				Ctrla = 0;
+				Ctrlb = 0;
+				Intflag = 0;
+				Pointer = 0;
+				break;
+			}
+			//Everything but ENABLE is enable-protected
+			if((Ctrla & AES_CTRLA_ENABLE) && (Value & AES_CTRLA_ENABLE) && ((Ctrla ^ Value) & ~AES_CTRLA_ENABLE))
+			{
+				Host_AES_Error("CTRLA changed while enabled");
+				break;
+			}
+			Ctrla = Value;
+			break;
+
+		case HOST_AES_CTRLB:
+			Ctrlb = Value;
+			break;
+
+		case HOST_AES_INTFLAG:
+			Intflag &= ~Value;
+			break;
+
+		case HOST_AES_DATABUFPTR:
+			Pointer = Value & 0x03;
+			break;
+
+		case HOST_AES_KEYWORD:
+			Host_AES_Store(&Key[4 * Index], Value);
+			break;
+
+		case HOST_AES_INTVECTV:
+			Host_AES_Store(&Vector[4 * Index], Value);
+			break;
+
+		case HOST_AES_INDATA:
+			Host_AES_Store(&In[4 * Pointer], Value);
+			Pointer = (Pointer + 1) & 0x03;
+			if(Pointer == 0 && (Ctrla & AES_CTRLA_STARTMODE))
+			{
+				Host_AES_Process();
+			}
+			break;
+
+		default:
+			break;
+	}
+}
@@ -0,0 +1,16 @@
+/****************************************************************************************
+* File:     AES-Peripheral.h
+*
+* Model of the SAMR34 AES peripheral behind the registers of the host samr3.h. It checks
+* the driver as well: a mode change while enabled, a block that starts while disabled or
+* a mode the model does not have counts as an error.
+****************************************************************************************/
+
+#ifndef AES_PERIPHERAL_H
+#define AES_PERIPHERAL_H
+
+extern unsigned long Host_AES_Blocks;          //Blocks the peripheral processed
+extern unsigned long Host_AES_New_Messages;    //Blocks that started from the initialization vector
+extern unsigned long Host_AES_Errors;          //Register accesses the peripheral would not take
+
+#endif
@@ -0,0 +1,388 @@
+/****************************************************************************************
+* File:     Arduino.cpp
+*
+* Virtual clock, pins and interrupts of the host board, see Host.h.
+****************************************************************************************/
+
+#include <Arduino.h>
+#include "interface.h"
+#include "Host.h"
+#include "SX127x.h"
+
+#define HOST_PINS   32
+#define HOST_TIMERS 16
+
+typedef struct {
+	uint64_t Time;
+	host_timer_t Callback;
+} sHost_Timer;
+
+HostSerial Serial;
+uint32_t Host_RTC_Backup[4];
+
+static uint64_t Host_Clock = 0;
+static sHost_Timer Host_Timers[HOST_TIMERS];
+static unsigned char Host_Levels[HOST_PINS];
+static voidFuncPtr Host_Isr[HOST_PINS];
+static unsigned char Host_Isr_Mode[HOST_PINS];
+static unsigned char Host_Isr_Pending[HOST_PINS];
+static bool Host_Masked = false;
+
+//Sleeps until the next timer or the SysTick, which wakes the core every ms
+static void Host_Idle_Default(void)
+{
+	uint64_t Next = Host_Next_Timer();
+	uint64_t Tick = (Host_Clock / 1000 + 1) * 1000;
+
+	Host_Advance_To((Next < Tick) ? Next : Tick);
+}
+
+void (*Host_Idle)(void) = Host_Idle_Default;
+
+uint64_t Host_Time(void)
+{
+	return Host_Clock;
+}
+
+uint64_t Host_Next_Timer(void)
+{
+	uint64_t Next = UINT64_MAX;
+	unsigned int i;
+
+	for(i = 0; i < HOST_TIMERS; i++)
+	{
+		if(Host_Timers[i].Callback != NULL && Host_Timers[i].Time < Next)
+		{
+			Next = Host_Timers[i].Time;
+		}
+	}
+	return Next;
+}
+
+void Host_Advance_To(uint64_t Time)
+{
+	unsigned int i, First;
+
+	//Run the timers in the order of their time, a callback may schedule new ones
+	for(;;)
+	{
+		First = HOST_TIMERS;
+		for(i = 0; i < HOST_TIMERS; i++)
+		{
+			if(Host_Timers[i].Callback != NULL && Host_Timers[i].Time <= Time &&
+			   (First == HOST_TIMERS || Host_Timers[i].Time < Host_Timers[First].Time))
+			{
+				First = i;
+			}
+		}
+		if(First == HOST_TIMERS)
+		{
+			break;
+		}
+
+		host_timer_t Callback = Host_Timers[First].Callback;
+		if(Host_Timers[First].Time > Host_Clock)
+		{
+			Host_Clock = Host_Timers[First].Time;
+		}
+		Host_Timers[First].Callback = NULL;
+		Callback();
+	}
+
+	if(Time > Host_Clock)
+	{
+		Host_Clock = Time;
+	}
+}
+
+void Host_Advance(uint64_t Us)
+{
+	Host_Advance_To(Host_Clock + Us);
+}
+
+void Host_Schedule(uint64_t Time, host_timer_t Callback)
+{
+	unsigned int i, Free = HOST_TIMERS;
+
+	for(i = 0; i < HOST_TIMERS; i++)
+	{
+		if(Host_Timers[i].Callback == Callback || (Free == HOST_TIMERS && Host_Timers[i].Callback == NULL))
+		{
+			Free = i;
+			if(Host_Timers[i].Callback == Callback)
+			{
+				break;
+			}
+		}
+	}
+	if(Free == HOST_TIMERS)
+	{
+		fprintf(stderr, "host: no free timer\n");
+		abort();
+	}
+	Host_Timers[Free].Time = Time;
+	Host_Timers[Free].Callback = Callback;
+}
+
+void Host_Cancel(host_timer_t Callback)
+{
+	unsigned int i;
+
+	for(i = 0; i < HOST_TIMERS; i++)
+	{
+		if(Host_Timers[i].Callback == Callback)
+		{
+			Host_Timers[i].Callback = NULL;
+		}
+	}
+}
+
+static void Host_Run_Isr(uint32_t Pin)
+{
+	if(Host_Masked)
+	{
+		Host_Isr_Pending[Pin] = 1;
+		return;
+	}
+	Host_Isr_Pending[Pin] = 0;
+	Host_Isr[Pin]();
+}
+
+void Host_Set_Pin(uint32_t Pin, int Level)
+{
+	unsigned char Old;
+
+	if(Pin >= HOST_PINS)
+	{
+		return;
+	}
+	Old = Host_Levels[Pin];
+	Host_Levels[Pin] = (Level != LOW);
+
+	if(Host_Isr[Pin] == NULL || Old == Host_Levels[Pin])
+	{
+		return;
+	}
+	if(Host_Isr_Mode[Pin] == CHANGE || (Host_Isr_Mode[Pin] == RISING && Host_Levels[Pin]) ||
+	   (Host_Isr_Mode[Pin] == FALLING && !Host_Levels[Pin]))
+	{
+		Host_Run_Isr(Pin);
+	}
+}
+
+int Host_Pin(uint32_t Pin)
+{
+	return (Pin < HOST_PINS) ? Host_Levels[Pin] : LOW;
+}
+
+unsigned int millis(void)
+{
+	return (unsigned int)(Host_Clock / 1000);
+}
+
+unsigned int micros(void)
+{
+	return (unsigned int)Host_Clock;
+}
+
+void delay(unsigned int ms)
+{
+	Host_Advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	Host_Advance(us);
+}
+
+void pinMode(uint32_t pin, uint32_t mode)
+{
+	(void)pin;
+	(void)mode;
+}
+
+void digitalWrite(uint32_t pin, uint32_t value)
+{
+	if(pin == RF_SEL)
+	{
+		SX127x_Select(value == LOW);
+	}
+	else if(pin == RF_RST && value == LOW)
+	{
+		SX127x_Reset();
+	}
+	if(pin < HOST_PINS)
+	{
+		Host_Levels[pin] = (value != LOW);
+	}
+}
+
+int digitalRead(uint32_t pin)
+{
+	return Host_Pin(pin);
+}
+
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode)
+{
+	if(pin < HOST_PINS)
+	{
+		Host_Isr[pin] = callback;
+		Host_Isr_Mode[pin] = (unsigned char)mode;
+	}
+}
+
+void detachInterrupt(uint32_t pin)
+{
+	if(pin < HOST_PINS)
+	{
+		Host_Isr[pin] = NULL;
+	}
+}
+
+void noInterrupts(void)
+{
+	Host_Masked = true;
+}
+
+void interrupts(void)
+{
+	uint32_t Pin;
+
+	Host_Masked = false;
+	for(Pin = 0; Pin < HOST_PINS; Pin++)
+	{
+		if(Host_Isr_Pending[Pin] && Host_Isr[Pin] != NULL)
+		{
+			Host_Run_Isr(Pin);
+		}
+	}
+}
+
+uint32_t __get_PRIMASK(void)
+{
+	return Host_Masked ? 1 : 0;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+	if(priMask & 1)
+	{
+		noInterrupts();
+	}
+	else
+	{
+		interrupts();
+	}
+}
+
+void __disable_irq(void)
+{
+	noInterrupts();
+}
+
+void __enable_irq(void)
+{
+	interrupts();
+}
+
+void sys_set_sleep_mode(enum sleep_mode_e sleep_mode)
+{
+	(void)sleep_mode;
+}
+
+//The WFI, a pending interrupt ends it even with the interrupts masked
+void sys_sleep(void)
+{
+	uint32_t Pin;
+
+	for(Pin = 0; Pin < HOST_PINS; Pin++)
+	{
+		if(Host_Isr_Pending[Pin])
+		{
+			return;
+		}
+	}
+	Host_Idle();
+}
+
+long random(long howbig)
+{
+	return (howbig > 0) ? rand() % howbig : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+	return (howbig > howsmall) ? howsmall + random(howbig - howsmall) : howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+	srand((unsigned int)seed);
+}
+
+uint32_t rnd(void)
+{
+	static uint32_t State = 0x2545F491;
+
+	State ^= State << 13;
+	State ^= State >> 17;
+	State ^= State << 5;
+	return State;
+}
+
+//Number conversions of interface.h, digits up to base 16 like the core
+static char *Host_To_String(unsigned long Value, bool Negative, char *Result, int Base)
+{
+	char Digits[sizeof(unsigned long) * 8 + 1];
+	char *Out = Result;
+	int Count = 0;
+
+	if(Base < 2 || Base > 16)
+	{
+		*Result = 0;
+		return Result;
+	}
+	do
+	{
+		Digits[Count++] = "0123456789abcdef"[Value % Base];
+		Value /= Base;
+	} while(Value != 0);
+	if(Negative)
+	{
+		*Out++ = '-';
+	}
+	while(Count > 0)
+	{
+		*Out++ = Digits[--Count];
+	}
+	*Out = 0;
+	return Result;
+}
+
+char *itoa(int value, char *result, int base)
+{
+	return ltoa(value, result, base);
+}
+
+char *ltoa(long value, char *result, int base)
+{
+	unsigned long Magnitude = (value < 0) ? 0UL - (unsigned long)value : (unsigned long)value;
+
+	return Host_To_String(Magnitude, value < 0, result, base);
+}
+
+char *utoa(unsigned value, char *result, int base)
+{
+	return Host_To_String(value, false, result, base);
+}
+
+char *ultoa(unsigned long value, char *result, int base)
+{
+	return Host_To_String(value, false, result, base);
+}
+
+//Nothing else runs on the core, the wait of a driver sleeps until the next timer or ms
+void yield(void)
+{
+	sys_sleep();
+}
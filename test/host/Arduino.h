@@ -0,0 +1,116 @@
+/****************************************************************************************
+* File:     Arduino.h
+*
+* Host stand-in of the Arduino core of the SAMR34 for the parts the libraries use. Time
+* is the virtual clock of Host.h and the RF pins are wired to the radio of SX127x.cpp.
+* String, Print and Stream are the ones of the core in arduino/arduino.
+****************************************************************************************/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+//Guard of Arduino.h of the core, Print.cpp and Stream.cpp of the core are built with this one
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "binary.h"
+#include "WString.h"
+#include "Stream.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef void (*voidFuncPtr)(void);
+
+#define LOW             0
+#define HIGH            1
+
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define CHANGE          2
+#define FALLING         3
+#define RISING          4
+
+#define bitRead(value, bit)             (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)              ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)            ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue)  (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+
+//Pins of the radio on the SAMR34
+#define RF_SEL          10
+#define RF_RST          11
+#define RF_DIO0         12
+#define RF_DIO1         13
+#define RF_DIO2         14
+#define RF_TCXO         15
+#define RF_SWITCH       16
+
+//variant.h, the pin is the number of its external interrupt
+#define digitalPinToInterrupt(P)    (P)
+
+enum sleep_mode_e
+{
+	SLEEP_MODE_IDLE,
+	SLEEP_MODE_STANDBY,
+	SLEEP_MODE_BACKUP,
+};
+
+unsigned int millis(void);
+unsigned int micros(void);
+void delay(unsigned int ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode);
+void detachInterrupt(uint32_t pin);
+void interrupts(void);
+void noInterrupts(void);
+void yield(void);
+
+//core_cmFunc.h of CMSIS, PRIMASK is the mask of noInterrupts()
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+void sys_set_sleep_mode(enum sleep_mode_e sleep_mode);
+void sys_sleep(void);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+//True random number generator of the core, a fixed sequence on the host
+uint32_t rnd(void);
+
+//interface.h of the core, the bytes in the order of the memory
+static inline uint32_t convert_byte_array_to_32_bit(uint8_t *data)
+{
+	uint32_t value;
+
+	memcpy(&value, data, 4);
+	return value;
+}
+
+//Debug output of the libraries goes nowhere
+class HostSerial
+{
+public:
+	void begin(unsigned long) {}
+	template<typename T> size_t print(T) { return 0; }
+	template<typename T> size_t print(T, int) { return 0; }
+	template<typename T> size_t println(T) { return 0; }
+	template<typename T> size_t println(T, int) { return 0; }
+	size_t println(void) { return 0; }
+	size_t printf(const char *, ...) { return 0; }
+};
+
+extern HostSerial Serial;
+
+#endif
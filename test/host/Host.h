@@ -0,0 +1,37 @@
+/****************************************************************************************
+* File:     Host.h
+*
+* Controls of the virtual board for the tests. The clock only moves when a test or a
+* model advances it, delay() and the idle sleep of the core included. Timers of the
+* models run in the order of their time while the clock passes it. A pin that rises
+* runs its interrupt, with the interrupts masked it runs at interrupts().
+****************************************************************************************/
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+
+typedef void (*host_timer_t)(void);
+
+//Virtual time in us since the start
+uint64_t Host_Time(void);
+void Host_Advance(uint64_t Us);
+void Host_Advance_To(uint64_t Time);
+
+//One pending call per callback, a new time replaces the old one
+void Host_Schedule(uint64_t Time, host_timer_t Callback);
+void Host_Cancel(host_timer_t Callback);
+//Time of the next timer, UINT64_MAX if none
+uint64_t Host_Next_Timer(void);
+
+void Host_Set_Pin(uint32_t Pin, int Level);
+int Host_Pin(uint32_t Pin);
+
+//Called by sys_sleep(), by default the clock moves on to the next timer or ms
+extern void (*Host_Idle)(void);
+
+//Backup registers of the RTC
+extern uint32_t Host_RTC_Backup[4];
+
+#endif
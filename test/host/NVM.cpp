@@ -0,0 +1,40 @@
+/****************************************************************************************
+* File:     NVM.cpp
+*
+* Flash of the host NVM library, see NVMClass.h.
+****************************************************************************************/
+
+#include <NVMClass.h>
+
+#define HOST_FLASH_SIZE     0x40000
+#define HOST_RWW_ADDRESS    0x400000
+#define HOST_RWW_SIZE       0x2000
+
+unsigned long Host_NVM_Erases = 0;
+unsigned long Host_NVM_Writes = 0;
+
+static uint8_t Flash[HOST_FLASH_SIZE];
+static uint8_t RWW[HOST_RWW_SIZE];
+static bool Erased = false;
+
+uint8_t *Host_NVM(uint32_t Address, uint32_t Length)
+{
+	//A new chip is erased
+	if(!Erased)
+	{
+		memset(Flash, 0xFF, sizeof(Flash));
+		memset(RWW, 0xFF, sizeof(RWW));
+		Erased = true;
+	}
+
+	if(Address < HOST_FLASH_SIZE && Length <= HOST_FLASH_SIZE - Address)
+	{
+		return &Flash[Address];
+	}
+	if(Address >= HOST_RWW_ADDRESS && Address - HOST_RWW_ADDRESS < HOST_RWW_SIZE &&
+	   Length <= HOST_RWW_SIZE - (Address - HOST_RWW_ADDRESS))
+	{
+		return &RWW[Address - HOST_RWW_ADDRESS];
+	}
+	return NULL;
+}
@@ -0,0 +1,68 @@
+/****************************************************************************************
+* File:     NVMClass.h
+*
+* Host stand-in of the NVM library of the SAMR34, the 256 KB main array from 0 and the
+* 8 KB RWW EEPROM from 0x400000 in memory. An erase sets a row to 0xFF, a write can only
+* clear bits like the flash. The checks and return values are the ones of the library.
+****************************************************************************************/
+
+#ifndef HOST_NVM_H
+#define HOST_NVM_H
+
+#include <Arduino.h>
+
+#define NVM_PAGE_SIZE 64
+#define NVM_ROW_SIZE 256
+
+#define NVM_OK 0
+#define NVM_ERROR_ADDRESS -1
+#define NVM_ERROR_LENGTH -2
+#define NVM_ERROR_WRITE -3
+
+//Memory of the address, NULL outside of the flash
+uint8_t *Host_NVM(uint32_t Address, uint32_t Length);
+
+//Erases and writes since the start
+extern unsigned long Host_NVM_Erases;
+extern unsigned long Host_NVM_Writes;
+
+class NVMClass
+{
+public:
+	NVMClass() {}
+
+	int erase_row(uint32_t address)
+	{
+		uint8_t *mem = Host_NVM(address, NVM_ROW_SIZE);
+		if(mem == NULL || (address & (NVM_ROW_SIZE - 1)))
+			return NVM_ERROR_ADDRESS;
+		memset(mem, 0xFF, NVM_ROW_SIZE);
+		Host_NVM_Erases++;
+		return NVM_OK;
+	}
+
+	int write_page(uint32_t address, const void *vData, int len)
+	{
+		uint8_t *mem = Host_NVM(address, NVM_PAGE_SIZE);
+		if(mem == NULL || (address & (NVM_PAGE_SIZE - 1)))
+			return NVM_ERROR_ADDRESS;
+		if(len > NVM_PAGE_SIZE)
+			return NVM_ERROR_LENGTH;
+		const uint8_t *data = (const uint8_t *)vData;
+		for(int i = 0; i < len; i++)
+			mem[i] &= data[i];
+		Host_NVM_Writes++;
+		return NVM_OK;
+	}
+
+	int read(uint32_t address, void *vData, int len)
+	{
+		uint8_t *mem = Host_NVM(address, len);
+		if(mem == NULL)
+			return NVM_ERROR_ADDRESS;
+		memcpy(vData, mem, len);
+		return NVM_OK;
+	}
+};
+
+#endif
@@ -0,0 +1,72 @@
+/****************************************************************************************
+* File:     RF.h
+*
+* Host stand-in of the RF port of the SAMR34 core, the SPI of the radio. The bytes go to
+* the model of SX127x.cpp, RF_SEL selects it.
+****************************************************************************************/
+
+#ifndef HOST_RF_H
+#define HOST_RF_H
+
+#include <Arduino.h>
+#include "SX127x.h"
+
+#define MSBFIRST    1
+#define SPI_MODE0   0x02
+
+class SPISettings
+{
+public:
+	SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) { (void)clock; (void)bitOrder; (void)dataMode; }
+};
+
+class RFClass
+{
+public:
+	void begin() { reset(); }
+	void resume() {}
+	void end() {}
+	void enableOscilator() { digitalWrite(RF_TCXO, 1); delay(1); }
+	void disableOscilator() { digitalWrite(RF_TCXO, 0); }
+	void beginTransaction(SPISettings settings) { (void)settings; }
+	void endTransaction() {}
+	void usingInterrupt(int interruptNumber) { (void)interruptNumber; }
+	void notUsingInterrupt(int interruptNumber) { (void)interruptNumber; }
+
+	void reset()
+	{
+		digitalWrite(RF_SEL, 1);
+		delay(1);
+		digitalWrite(RF_RST, 0);
+		delay(10);
+		digitalWrite(RF_RST, 1);
+		delay(10);
+	}
+
+	uint8_t transfer(uint8_t data) { return SX127x_Transfer(data); }
+
+	//Sends the buffer and receives into it
+	void transfer(void *buf, size_t count)
+	{
+		uint8_t *data = (uint8_t *)buf;
+		for(size_t i = 0; i < count; i++)
+			data[i] = SX127x_Transfer(data[i]);
+	}
+
+	//Either buffer may be NULL, 0xFF is sent then
+	void transfer(const void *txbuf, void *rxbuf, size_t count)
+	{
+		const uint8_t *tx = (const uint8_t *)txbuf;
+		uint8_t *rx = (uint8_t *)rxbuf;
+		for(size_t i = 0; i < count; i++)
+		{
+			uint8_t data = SX127x_Transfer(tx ? tx[i] : 0xFF);
+			if(rx)
+				rx[i] = data;
+		}
+	}
+};
+
+extern RFClass RF;
+
+#endif
@@ -0,0 +1,41 @@
+/****************************************************************************************
+* File:     RTC.h
+*
+* Host stand-in of the RTC of the SAMR34 core with the four backup registers, they are
+* Host_RTC_Backup of Host.h.
+****************************************************************************************/
+
+#ifndef HOST_RTC_H
+#define HOST_RTC_H
+
+#include <stdarg.h>
+#include <Arduino.h>
+#include "Host.h"
+
+class RTCClass
+{
+public:
+	void set_backup(int n_values, ...)
+	{
+		va_list values;
+		va_start(values, n_values);
+		for(int i = 0; i < n_values && i < 4; i++)
+			Host_RTC_Backup[i] = va_arg(values, uint32_t);
+		va_end(values);
+	}
+
+	void get_backup(int n_values, ...)
+	{
+		va_list values;
+		va_start(values, n_values);
+		for(int i = 0; i < n_values && i < 4; i++)
+		{
+			uint32_t *value = va_arg(values, uint32_t *);
+			if(value)
+				*value = Host_RTC_Backup[i];
+		}
+		va_end(values);
+	}
+};
+
+#endif
@@ -0,0 +1,432 @@
+/****************************************************************************************
+* File:     SX127x.cpp
+*
+* Register file, FIFO and LoRa modem of the SX1276 model, see SX127x.h. RF of the SAMR34
+* core is the SPI port of the radio. Times on air come from RFTiming.cpp, which is tested
+* against the datasheet formula.
+****************************************************************************************/
+
+#include <Arduino.h>
+#include <RF.h>
+#include <RFTiming.h>
+#include "Host.h"
+#include "SX127x.h"
+
+#define SX127X_FIFO             0x00
+#define SX127X_OP_MODE          0x01
+#define SX127X_FIFO_ADDR_PTR    0x0D
+#define SX127X_FIFO_TX_BASE     0x0E
+#define SX127X_FIFO_RX_BASE     0x0F
+#define SX127X_FIFO_RX_CURRENT  0x10
+#define SX127X_IRQ_FLAGS_MASK   0x11
+#define SX127X_IRQ_FLAGS        0x12
+#define SX127X_RX_BYTES         0x13
+#define SX127X_PKT_SNR          0x19
+#define SX127X_PKT_RSSI         0x1A
+#define SX127X_MODEM_CONFIG_1   0x1D
+#define SX127X_MODEM_CONFIG_2   0x1E
+#define SX127X_SYMB_TIMEOUT     0x1F
+#define SX127X_PREAMBLE_MSB     0x20
+#define SX127X_PREAMBLE_LSB     0x21
+#define SX127X_PAYLOAD_LENGTH   0x22
+#define SX127X_INVERT_IQ        0x33
+#define SX127X_DIO_MAPPING_1    0x40
+#define SX127X_VERSION          0x42
+
+#define SX127X_MODE_STANDBY     0x01
+#define SX127X_MODE_TX          0x03
+#define SX127X_MODE_RX_CONT     0x05
+#define SX127X_MODE_RX_SINGLE   0x06
+
+#define SX127X_IRQ_RX_TIMEOUT   0x80
+#define SX127X_IRQ_RX_DONE      0x40
+#define SX127X_IRQ_CRC_ERROR    0x20
+#define SX127X_IRQ_VALID_HEADER 0x10
+#define SX127X_IRQ_TX_DONE      0x08
+
+#define SX127X_AIR_FRAMES       8
+
+typedef enum {SX127X_NONE, SX127X_TX_DONE, SX127X_RX_DONE, SX127X_RX_TIMEOUT} sx127x_event_t;
+
+RFClass RF;
+
+void (*SX127x_Transmit)(const sSX127x_Frame *Frame) = NULL;
+unsigned long SX127x_Transfers = 0;
+
+static uint8_t Registers[128];
+static uint8_t Fifo[256];
+static bool Selected = false;
+//Register of the next data byte of the transfer, -1 while the address byte is due
+static int Address = -1;
+static bool Write = false;
+
+static bool Modem = false;
+static sx127x_event_t Event = SX127X_NONE;
+static uint64_t Rx_Start;
+static sSX127x_Frame Air[SX127X_AIR_FRAMES];
+static bool Air_Used[SX127X_AIR_FRAMES];
+//Frame of the air the receiver locked on, -1 for none
+static int Receiving = -1;
+
+static void SX127x_Event(void);
+
+void SX127x_Reset(void)
+{
+	memset(Registers, 0x00, sizeof(Registers));
+	//FSK standby, 434 MHz, see the reset values of the datasheet
+	Registers[SX127X_OP_MODE] = 0x09;
+	Registers[0x06] = 0x6C;
+	Registers[0x07] = 0x80;
+	Registers[0x08] = 0x00;
+	Registers[SX127X_VERSION] = 0x12;
+	//Modem settings of the LoRa mode: 125 kHz, 4/5, explicit header, SF7, 8 symbols of preamble
+	Registers[SX127X_MODEM_CONFIG_1] = 0x72;
+	Registers[SX127X_MODEM_CONFIG_2] = 0x70;
+	Registers[SX127X_SYMB_TIMEOUT] = 0x64;
+	Registers[SX127X_PREAMBLE_LSB] = 0x08;
+
+	Event = SX127X_NONE;
+	Receiving = -1;
+	Host_Cancel(SX127x_Event);
+}
+
+//Power on reset
+static struct SX127x_Power_On
+{
+	SX127x_Power_On() { SX127x_Reset(); }
+} Power_On;
+
+//Settings of the modem registers
+static void SX127x_Timing(rf_timing_t *Timing, uint8_t BW)
+{
+	static const uint32_t Bandwidth[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+
+	rfTimingInit(Timing);
+	Timing->bandwidth = Bandwidth[(BW < 10) ? BW : 7];
+	Timing->sf = Registers[SX127X_MODEM_CONFIG_2] >> 4;
+	Timing->cr = 4 + ((Registers[SX127X_MODEM_CONFIG_1] >> 1) & 0x07);
+	Timing->implicitHeader = Registers[SX127X_MODEM_CONFIG_1] & 0x01;
+	Timing->crc = (Registers[SX127X_MODEM_CONFIG_2] >> 2) & 0x01;
+	Timing->preamble = (Registers[SX127X_PREAMBLE_MSB] << 8) | Registers[SX127X_PREAMBLE_LSB];
+}
+
+static uint32_t SX127x_Frf(void)
+{
+	return ((uint32_t)Registers[0x06] << 16) | ((uint32_t)Registers[0x07] << 8) | Registers[0x08];
+}
+
+//The DIO lines follow the IRQ flags their mapping selects
+static void SX127x_Dio(void)
+{
+	static const uint8_t Dio0[4] = {SX127X_IRQ_RX_DONE, SX127X_IRQ_TX_DONE, 0x04, 0x00};
+	static const uint8_t Dio1[4] = {SX127X_IRQ_RX_TIMEOUT, 0x02, 0x01, 0x00};
+	uint8_t Mapping = Registers[SX127X_DIO_MAPPING_1];
+	uint8_t Flags = Registers[SX127X_IRQ_FLAGS];
+
+	Host_Set_Pin(RF_DIO0, (Flags & Dio0[Mapping >> 6]) != 0);
+	Host_Set_Pin(RF_DIO1, (Flags & Dio1[(Mapping >> 4) & 0x03]) != 0);
+	Host_Set_Pin(RF_DIO2, (Flags & 0x02) != 0);
+}
+
+static void SX127x_Irq(uint8_t Flags)
+{
+	Registers[SX127X_IRQ_FLAGS] |= Flags & ~Registers[SX127X_IRQ_FLAGS_MASK];
+	SX127x_Dio();
+}
+
+static void SX127x_Standby(void)
+{
+	Registers[SX127X_OP_MODE] = (Registers[SX127X_OP_MODE] & ~0x07) | SX127X_MODE_STANDBY;
+}
+
+//Looks for the first frame the receiver can lock on, else the symbol timeout of a single receive
+static void SX127x_Listen(void)
+{
+	rf_timing_t Timing;
+	uint64_t Symbol, Detect, First = UINT64_MAX, Preamble_End, Timeout;
+	bool Single = (Registers[SX127X_OP_MODE] & 0x07) == SX127X_MODE_RX_SINGLE;
+	bool Inverted = (Registers[SX127X_INVERT_IQ] & 0x40) != 0;
+	uint8_t BW = Registers[SX127X_MODEM_CONFIG_1] >> 4;
+	int i;
+
+	SX127x_Timing(&Timing, BW);
+	Symbol = rfSymbolTime(&Timing);
+	Timeout = Rx_Start + Symbol * (((Registers[SX127X_MODEM_CONFIG_2] & 0x03) << 8) | Registers[SX127X_SYMB_TIMEOUT]);
+
+	Receiving = -1;
+	for(i = 0; i < SX127X_AIR_FRAMES; i++)
+	{
+		if(!Air_Used[i] || Air[i].Frf != SX127x_Frf() || Air[i].SF != Timing.sf || Air[i].BW != BW || Air[i].Inverted_IQ != Inverted)
+		{
+			continue;
+		}
+
+		//The receiver needs SX127X_DETECT_SYMBOLS of the preamble, before the symbol timeout
+		Detect = ((Rx_Start > Air[i].Start) ? Rx_Start : Air[i].Start) + SX127X_DETECT_SYMBOLS * Symbol;
+		Preamble_End = Air[i].Start + Symbol * (4 * Air[i].Preamble + 17) / 4;
+		if(Detect > Preamble_End || (Single && Detect > Timeout) || Detect >= First)
+		{
+			continue;
+		}
+		First = Detect;
+		Receiving = i;
+	}
+
+	if(Receiving >= 0)
+	{
+		Event = SX127X_RX_DONE;
+		Host_Schedule(Air[Receiving].End, SX127x_Event);
+	}
+	else if(Single)
+	{
+		Event = SX127X_RX_TIMEOUT;
+		Host_Schedule((Timeout > Host_Time()) ? Timeout : Host_Time(), SX127x_Event);
+	}
+	else
+	{
+		Event = SX127X_NONE;
+		Host_Cancel(SX127x_Event);
+	}
+}
+
+static void SX127x_Start_Transmit(void)
+{
+	sSX127x_Frame Frame;
+	rf_timing_t Timing;
+
+	Frame.BW = Registers[SX127X_MODEM_CONFIG_1] >> 4;
+	SX127x_Timing(&Timing, Frame.BW);
+	Frame.Frf = SX127x_Frf();
+	Frame.SF = Timing.sf;
+	Frame.Preamble = Timing.preamble;
+	Frame.Inverted_IQ = (Registers[SX127X_INVERT_IQ] & 0x40) != 0;
+	Frame.Crc_Error = false;
+	Frame.SNR = 0;
+	Frame.RSSI = 0;
+	Frame.Length = Registers[SX127X_PAYLOAD_LENGTH];
+	SX127x_Fifo_Read(Registers[SX127X_FIFO_TX_BASE], Frame.Data, Frame.Length);
+	Frame.Start = Host_Time();
+	Frame.End = Frame.Start + rfTimeOnAir(&Timing, Frame.Length);
+
+	if(SX127x_Transmit != NULL)
+	{
+		SX127x_Transmit(&Frame);
+	}
+	Event = SX127X_TX_DONE;
+	Host_Schedule(Frame.End, SX127x_Event);
+}
+
+static void SX127x_Event(void)
+{
+	sSX127x_Frame *Frame;
+	int RSSI;
+
+	switch(Event)
+	{
+		case SX127X_TX_DONE:
+			SX127x_Standby();
+			Event = SX127X_NONE;
+			SX127x_Irq(SX127X_IRQ_TX_DONE);
+			break;
+
+		case SX127X_RX_DONE:
+			Frame = &Air[Receiving];
+			Air_Used[Receiving] = false;
+			Receiving = -1;
+
+			SX127x_Fifo_Write(Registers[SX127X_FIFO_RX_BASE], Frame->Data, Frame->Length);
+			Registers[SX127X_FIFO_RX_CURRENT] = Registers[SX127X_FIFO_RX_BASE];
+			Registers[SX127X_RX_BYTES] = Frame->Length;
+			Registers[SX127X_PKT_SNR] = (uint8_t)Frame->SNR;
+			RSSI = Frame->RSSI + 157;
+			Registers[SX127X_PKT_RSSI] = (RSSI < 0) ? 0 : (RSSI > 255) ? 255 : RSSI;
+
+			//A single receive ends, a continuous one goes on with the next frame
+			Event = SX127X_NONE;
+			if((Registers[SX127X_OP_MODE] & 0x07) == SX127X_MODE_RX_SINGLE)
+			{
+				SX127x_Standby();
+			}
+			else
+			{
+				Rx_Start = Host_Time();
+				SX127x_Listen();
+			}
+			SX127x_Irq(SX127X_IRQ_RX_DONE | SX127X_IRQ_VALID_HEADER | (Frame->Crc_Error ? SX127X_IRQ_CRC_ERROR : 0));
+			break;
+
+		case SX127X_RX_TIMEOUT:
+			SX127x_Standby();
+			Event = SX127X_NONE;
+			SX127x_Irq(SX127X_IRQ_RX_TIMEOUT);
+			break;
+
+		default:
+			break;
+	}
+}
+
+//A new mode ends what the modem was doing
+static void SX127x_Mode(uint8_t Value)
+{
+	Event = SX127X_NONE;
+	Receiving = -1;
+	Host_Cancel(SX127x_Event);
+
+	if(!(Value & 0x80))
+	{
+		return;
+	}
+	switch(Value & 0x07)
+	{
+		case SX127X_MODE_TX:
+			SX127x_Start_Transmit();
+			break;
+
+		case SX127X_MODE_RX_CONT:
+		case SX127X_MODE_RX_SINGLE:
+			Rx_Start = Host_Time();
+			SX127x_Listen();
+			break;
+
+		default:
+			break;
+	}
+}
+
+void SX127x_Enable_Modem(bool Enable)
+{
+	Modem = Enable;
+	if(!Modem)
+	{
+		Event = SX127X_NONE;
+		Host_Cancel(SX127x_Event);
+	}
+}
+
+void SX127x_Air(const sSX127x_Frame *Frame)
+{
+	int i, Free = -1;
+
+	//Frames that are over make room
+	for(i = 0; i < SX127X_AIR_FRAMES; i++)
+	{
+		if(Air_Used[i] && Air[i].End < Host_Time() && i != Receiving)
+		{
+			Air_Used[i] = false;
+		}
+		if(!Air_Used[i] && Free < 0)
+		{
+			Free = i;
+		}
+	}
+	if(Free < 0)
+	{
+		fprintf(stderr, "SX127x: no room on the air\n");
+		abort();
+	}
+	Air[Free] = *Frame;
+	Air_Used[Free] = true;
+
+	//A receiver that has not locked on yet may find it
+	if(Modem && Receiving < 0 && (Event == SX127X_RX_TIMEOUT || (Registers[SX127X_OP_MODE] & 0x87) == (0x80 | SX127X_MODE_RX_CONT)))
+	{
+		SX127x_Listen();
+	}
+}
+
+void SX127x_Select(bool Select)
+{
+	if(Select && !Selected)
+	{
+		SX127x_Transfers++;
+	}
+	Selected = Select;
+	Address = -1;
+}
+
+uint8_t SX127x_Transfer(uint8_t Data)
+{
+	uint8_t Value = 0x00;
+
+	if(!Selected)
+	{
+		return 0x00;
+	}
+	if(Address < 0)
+	{
+		Address = Data & 0x7F;
+		Write = (Data & 0x80) != 0;
+		return 0x00;
+	}
+
+	if(Address == SX127X_FIFO)
+	{
+		if(Write)
+		{
+			Fifo[Registers[SX127X_FIFO_ADDR_PTR]] = Data;
+		}
+		else
+		{
+			Value = Fifo[Registers[SX127X_FIFO_ADDR_PTR]];
+		}
+		Registers[SX127X_FIFO_ADDR_PTR]++;
+		return Value;
+	}
+
+	Value = Registers[Address];
+	if(Write && Address == SX127X_IRQ_FLAGS)
+	{
+		Registers[Address] &= ~Data;
+	}
+	else if(Write && Address != SX127X_VERSION)
+	{
+		Registers[Address] = Data;
+	}
+
+	if(Write && Modem)
+	{
+		if(Address == SX127X_OP_MODE)
+		{
+			SX127x_Mode(Data);
+		}
+		//RFM_Write masks the interrupts, a line that rises here interrupts after the transfer
+		if(Address == SX127X_IRQ_FLAGS || Address == SX127X_DIO_MAPPING_1)
+		{
+			SX127x_Dio();
+		}
+	}
+
+	Address = (Address + 1) & 0x7F;
+	return Value;
+}
+
+uint8_t SX127x_Register(uint8_t Address)
+{
+	return Registers[Address & 0x7F];
+}
+
+void SX127x_Set_Register(uint8_t Address, uint8_t Value)
+{
+	Registers[Address & 0x7F] = Value;
+}
+
+void SX127x_Fifo_Write(uint8_t Address, const uint8_t *Data, uint8_t Length)
+{
+	uint8_t i;
+
+	for(i = 0; i < Length; i++)
+	{
+		Fifo[(uint8_t)(Address + i)] = Data[i];
+	}
+}
+
+void SX127x_Fifo_Read(uint8_t Address, uint8_t *Data, uint8_t Length)
+{
+	uint8_t i;
+
+	for(i = 0; i < Length; i++)
+	{
+		Data[i] = Fifo[(uint8_t)(Address + i)];
+	}
+}
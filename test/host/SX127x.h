@@ -0,0 +1,62 @@
+/****************************************************************************************
+* File:     SX127x.h
+*
+* Model of the SX1276 behind the RF port of the SAMR34 (datasheet chapter 4.1 and 2.2),
+* the register file and the 256 byte FIFO on the SPI. A transfer starts with the address
+* byte, bit 7 set for a write, the next bytes go to the following registers. Register
+* 0x00 is the FIFO at FifoAddrPtr, it stays at 0x00 in a burst and FifoAddrPtr counts.
+* RegIrqFlags clears the bits written with 1.
+*
+* Without the modem the test plays the radio and drives the DIO lines. With the modem a
+* LoRa transmission ends with TxDone after its time on air, a receive finds the frames of
+* SX127x_Air() on its frequency, spreading factor, bandwidth and IQ or ends with
+* RxTimeout after the symbol timeout. The IRQ flags drive the DIO lines as RegDioMapping1
+* maps them.
+****************************************************************************************/
+
+#ifndef SX127X_H
+#define SX127X_H
+
+#include <stdint.h>
+
+//Symbols of the preamble the receiver needs to lock on
+#define SX127X_DETECT_SYMBOLS 4
+
+//A LoRa frame on the air
+typedef struct {
+	uint64_t Start;				//us of the first symbol of the preamble
+	uint64_t End;				//us after the last symbol
+	uint32_t Frf;				//RegFrf
+	uint8_t SF;
+	uint8_t BW;					//bandwidth of RegModemConfig1, 7 is 125 kHz
+	uint16_t Preamble;			//programmed preamble symbols
+	bool Inverted_IQ;			//downlink
+	bool Crc_Error;				//the receiver gets it with PayloadCrcError
+	int8_t SNR;					//0.25 dB, RegPktSnrValue
+	int16_t RSSI;				//dBm
+	uint8_t Length;
+	uint8_t Data[255];
+} sSX127x_Frame;
+
+//RF_SEL low selects the radio, high ends the transfer
+void SX127x_Select(bool Selected);
+//RF_RST low, the registers go back to their reset values
+void SX127x_Reset(void);
+uint8_t SX127x_Transfer(uint8_t Data);
+
+//Access of the tests, without the side effects of the SPI
+uint8_t SX127x_Register(uint8_t Address);
+void SX127x_Set_Register(uint8_t Address, uint8_t Value);
+void SX127x_Fifo_Write(uint8_t Address, const uint8_t *Data, uint8_t Length);
+void SX127x_Fifo_Read(uint8_t Address, uint8_t *Data, uint8_t Length);
+
+void SX127x_Enable_Modem(bool Enable);
+//A frame of another transmitter, the receiver may find it from Frame->Start on
+void SX127x_Air(const sSX127x_Frame *Frame);
+//Called at the start of a transmission with the whole frame
+extern void (*SX127x_Transmit)(const sSX127x_Frame *Frame);
+
+//SPI transfers, one per selection of the radio
+extern unsigned long SX127x_Transfers;
+
+#endif
@@ -0,0 +1,25 @@
+/****************************************************************************************
+* File:     interface.h
+*
+* Host stand-in of interface.h of the SAMR34 core for WString.cpp of the core, the number
+* conversions that the C library of the host does not have.
+****************************************************************************************/
+
+#ifndef HOST_INTERFACE_H
+#define HOST_INTERFACE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+char *itoa(int value, char *result, int base);
+char *ltoa(long value, char *result, int base);
+char *utoa(unsigned value, char *result, int base);
+char *ultoa(unsigned long value, char *result, int base);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+/****************************************************************************************
+* File:     samr3.h
+*
+* Host stand-in of the SAMR34 device header with the AES peripheral only. The registers
+* are proxies, reads and writes go to the model of AES-Peripheral.cpp, so AESClass.h runs
+* unchanged on the host. Values of the bit fields are the ones of component/aes.h.
+****************************************************************************************/
+
+#ifndef HOST_SAMR3_H
+#define HOST_SAMR3_H
+
+#include <stdint.h>
+
+#define AES_CTRLA_SWRST_Pos         0
+#define AES_CTRLA_SWRST             (0x1U << AES_CTRLA_SWRST_Pos)
+#define AES_CTRLA_ENABLE_Pos        1
+#define AES_CTRLA_ENABLE            (0x1U << AES_CTRLA_ENABLE_Pos)
+#define AES_CTRLA_AESMODE_Pos       2
+#define AES_CTRLA_AESMODE_Msk       (0x7U << AES_CTRLA_AESMODE_Pos)
+#define AES_CTRLA_CFBS_Pos          5
+#define AES_CTRLA_KEYSIZE_Pos       8
+#define AES_CTRLA_KEYSIZE_Msk       (0x3U << AES_CTRLA_KEYSIZE_Pos)
+#define AES_CTRLA_CIPHER_Pos        10
+#define AES_CTRLA_CIPHER            (0x1U << AES_CTRLA_CIPHER_Pos)
+#define AES_CTRLA_STARTMODE_Pos     11
+#define AES_CTRLA_STARTMODE         (0x1U << AES_CTRLA_STARTMODE_Pos)
+#define AES_CTRLA_LOD_Pos           12
+#define AES_CTRLA_KEYGEN_Pos        13
+#define AES_CTRLA_XORKEY_Pos        14
+#define AES_CTRLA_CTYPE_Pos         16
+#define AES_CTRLA_CTYPE_Msk         (0xFU << AES_CTRLA_CTYPE_Pos)
+#define AES_CTRLA_CTYPE(value)      (AES_CTRLA_CTYPE_Msk & ((uint32_t)(value) << AES_CTRLA_CTYPE_Pos))
+
+#define AES_CTRLB_START_Pos         0
+#define AES_CTRLB_START             (0x1U << AES_CTRLB_START_Pos)
+#define AES_CTRLB_NEWMSG_Pos        1
+#define AES_CTRLB_NEWMSG            (0x1U << AES_CTRLB_NEWMSG_Pos)
+
+#define AES_INTENCLR_MASK           0x03U
+
+#define AES_INTFLAG_ENCCMP_Pos      0
+#define AES_INTFLAG_ENCCMP          (0x1U << AES_INTFLAG_ENCCMP_Pos)
+#define AES_INTFLAG_GFMCMP_Pos      1
+#define AES_INTFLAG_GFMCMP          (0x1U << AES_INTFLAG_GFMCMP_Pos)
+#define AES_INTFLAG_MASK            0x03U
+
+typedef enum {
+	HOST_AES_CTRLA,
+	HOST_AES_CTRLB,
+	HOST_AES_INTENCLR,
+	HOST_AES_INTENSET,
+	HOST_AES_INTFLAG,
+	HOST_AES_DATABUFPTR,
+	HOST_AES_KEYWORD,
+	HOST_AES_INDATA,
+	HOST_AES_INTVECTV,
+	HOST_AES_RANDSEED,
+} host_aes_register_t;
+
+uint32_t Host_AES_Read(host_aes_register_t Register, unsigned char Index);
+void Host_AES_Write(host_aes_register_t Register, unsigned char Index, uint32_t Value);
+
+//A register of the peripheral, AES->CTRLA.reg reads and writes through the model
+class Host_AES_Register
+{
+public:
+	Host_AES_Register(host_aes_register_t Register = HOST_AES_CTRLA, unsigned char Index = 0) : Register(Register), Index(Index) {}
+
+	operator uint32_t() const { return Host_AES_Read(Register, Index); }
+	Host_AES_Register &operator=(uint32_t Value) { Host_AES_Write(Register, Index, Value); return *this; }
+	Host_AES_Register &operator|=(uint32_t Value) { return *this = (uint32_t)*this | Value; }
+	Host_AES_Register &operator&=(uint32_t Value) { return *this = (uint32_t)*this & Value; }
+
+private:
+	host_aes_register_t Register;
+	unsigned char Index;
+};
+
+typedef struct {
+	Host_AES_Register reg;
+} Host_AES_Reg;
+
+typedef struct Aes {
+	Aes();
+	Host_AES_Reg CTRLA;
+	Host_AES_Reg CTRLB;
+	Host_AES_Reg INTENCLR;
+	Host_AES_Reg INTENSET;
+	Host_AES_Reg INTFLAG;
+	Host_AES_Reg DATABUFPTR;
+	Host_AES_Reg KEYWORD[8];
+	Host_AES_Reg INDATA;
+	Host_AES_Reg INTVECTV[4];
+	Host_AES_Reg RANDSEED;
+} Aes;
+
+extern Aes Host_AES;
+#define AES (&Host_AES)
+
+#endif